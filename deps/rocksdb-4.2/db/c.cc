@@ -31,8 +31,11 @@
 #include "rocksdb/slice_transform.h"
 #include "rocksdb/table.h"
 #include "rocksdb/utilities/backupable_db.h"
+#include "rocksdb/utilities/table_properties_collectors.h"
 #include "utilities/merge_operators.h"
 #include "util/coding.h"
+#include "util/compression.h"
+#include "db/write_batch_internal.h"
 
 using rocksdb::Cache;
 using rocksdb::ColumnFamilyDescriptor;
@@ -71,6 +74,7 @@ using rocksdb::Snapshot;
 using rocksdb::Status;
 using rocksdb::WritableFile;
 using rocksdb::WriteBatch;
+using rocksdb::WriteBatchInternal;
 using rocksdb::WriteOptions;
 using rocksdb::LiveFileMetaData;
 using rocksdb::BackupEngine;
@@ -78,6 +82,7 @@ using rocksdb::BackupableDBOptions;
 using rocksdb::BackupInfo;
 using rocksdb::RestoreOptions;
 using rocksdb::CompactRangeOptions;
+using rocksdb::NewCompactOnDeletionCollectorFactory;
 using rocksdb::port::Mutex;
 
 using std::shared_ptr;
@@ -686,6 +691,10 @@ void rocksdb_column_family_handle_destroy(rocksdb_column_family_handle_t* handle
   delete handle;
 }
 
+uint32_t rocksdb_column_family_handle_get_id(rocksdb_column_family_handle_t* handle) {
+  return handle->rep->GetID();
+}
+
 void rocksdb_put(
     rocksdb_t* db,
     const rocksdb_writeoptions_t* options,
@@ -995,6 +1004,12 @@ void rocksdb_flush(
   SaveError(errptr, db->rep->Flush(options->rep));
 }
 
+void rocksdb_sync_wal(
+    rocksdb_t* db,
+    char** errptr) {
+  SaveError(errptr, db->rep->SyncWAL());
+}
+
 void rocksdb_disable_file_deletions(
     rocksdb_t* db,
     char** errptr) {
@@ -1260,6 +1275,36 @@ void rocksdb_writebatch_iterate(
   b->rep.Iterate(&handler);
 }
 
+void rocksdb_writebatch_iterate_cf(
+    rocksdb_writebatch_t* b,
+    void* state,
+    void (*put)(void*, uint32_t cf, const char* k, size_t klen, const char* v, size_t vlen),
+    void (*deleted)(void*, uint32_t cf, const char* k, size_t klen)) {
+  class H : public WriteBatch::Handler {
+   public:
+    void* state_;
+    void (*put_)(void*, uint32_t cf, const char* k, size_t klen, const char* v, size_t vlen);
+    void (*deleted_)(void*, uint32_t cf, const char* k, size_t klen);
+    virtual Status PutCF(uint32_t cf, const Slice& key, const Slice& value) override {
+      (*put_)(state_, cf, key.data(), key.size(), value.data(), value.size());
+      return Status::OK();
+    }
+    virtual Status DeleteCF(uint32_t cf, const Slice& key) override {
+      (*deleted_)(state_, cf, key.data(), key.size());
+      return Status::OK();
+    }
+  };
+  H handler;
+  handler.state_ = state;
+  handler.put_ = put;
+  handler.deleted_ = deleted;
+  b->rep.Iterate(&handler);
+}
+
+void rocksdb_writebatch_append(rocksdb_writebatch_t* dst, rocksdb_writebatch_t* src) {
+  WriteBatchInternal::Append(&dst->rep, &src->rep);
+}
+
 const char* rocksdb_writebatch_data(rocksdb_writebatch_t* b, size_t* size) {
   *size = b->rep.GetDataSize();
   return b->rep.Data().c_str();
@@ -1576,6 +1621,10 @@ void rocksdb_options_set_compression(rocksdb_options_t* opt, int t) {
   opt->rep.compression = static_cast<CompressionType>(t);
 }
 
+unsigned char rocksdb_compression_supported(int t) {
+  return rocksdb::CompressionTypeSupported(static_cast<CompressionType>(t));
+}
+
 void rocksdb_options_set_compression_per_level(rocksdb_options_t* opt,
                                                int* level_values,
                                                size_t num_levels) {
@@ -1598,6 +1647,12 @@ void rocksdb_options_set_prefix_extractor(
   opt->rep.prefix_extractor.reset(prefix_extractor);
 }
 
+void rocksdb_options_add_compact_on_deletion_collector_factory(
+    rocksdb_options_t* opt, size_t window_size, size_t num_dels_trigger) {
+  opt->rep.table_properties_collector_factories.emplace_back(
+      NewCompactOnDeletionCollectorFactory(window_size, num_dels_trigger));
+}
+
 void rocksdb_options_set_disable_data_sync(
     rocksdb_options_t* opt, int disable_data_sync) {
   opt->rep.disableDataSync = disable_data_sync;
@@ -1951,6 +2006,11 @@ unsigned char rocksdb_compactionfiltercontext_is_manual_compaction(
   return context->rep.is_manual_compaction;
 }
 
+uint32_t rocksdb_compactionfiltercontext_column_family_id(
+    rocksdb_compactionfiltercontext_t* context) {
+  return context->rep.column_family_id;
+}
+
 rocksdb_compactionfilterfactory_t* rocksdb_compactionfilterfactory_create(
     void* state, void (*destructor)(void*),
     rocksdb_compactionfilter_t* (*create_compaction_filter)(
@@ -2121,6 +2181,11 @@ void rocksdb_readoptions_set_tailing(
   opt->rep.tailing = v;
 }
 
+void rocksdb_readoptions_set_total_order_seek(
+    rocksdb_readoptions_t* opt, unsigned char v) {
+  opt->rep.total_order_seek = v;
+}
+
 rocksdb_writeoptions_t* rocksdb_writeoptions_create() {
   return new rocksdb_writeoptions_t;
 }
@@ -211,6 +211,9 @@ extern ROCKSDB_LIBRARY_API void rocksdb_drop_column_family(
 extern ROCKSDB_LIBRARY_API void rocksdb_column_family_handle_destroy(
     rocksdb_column_family_handle_t*);
 
+extern ROCKSDB_LIBRARY_API uint32_t rocksdb_column_family_handle_get_id(
+    rocksdb_column_family_handle_t*);
+
 extern ROCKSDB_LIBRARY_API void rocksdb_close(rocksdb_t* db);
 
 extern ROCKSDB_LIBRARY_API void rocksdb_put(
@@ -331,6 +334,10 @@ extern ROCKSDB_LIBRARY_API const rocksdb_livefiles_t* rocksdb_livefiles(
 extern ROCKSDB_LIBRARY_API void rocksdb_flush(
     rocksdb_t* db, const rocksdb_flushoptions_t* options, char** errptr);
 
+extern ROCKSDB_LIBRARY_API void rocksdb_sync_wal(
+    rocksdb_t* db,
+    char** errptr);
+
 extern ROCKSDB_LIBRARY_API void rocksdb_disable_file_deletions(rocksdb_t* db,
                                                                char** errptr);
 
@@ -424,6 +431,12 @@ extern ROCKSDB_LIBRARY_API void rocksdb_writebatch_iterate(
     rocksdb_writebatch_t*, void* state,
     void (*put)(void*, const char* k, size_t klen, const char* v, size_t vlen),
     void (*deleted)(void*, const char* k, size_t klen));
+extern ROCKSDB_LIBRARY_API void rocksdb_writebatch_iterate_cf(
+    rocksdb_writebatch_t*, void* state,
+    void (*put)(void*, uint32_t cf, const char* k, size_t klen, const char* v, size_t vlen),
+    void (*deleted)(void*, uint32_t cf, const char* k, size_t klen));
+extern ROCKSDB_LIBRARY_API void rocksdb_writebatch_append(
+    rocksdb_writebatch_t* dst, rocksdb_writebatch_t* src);
 extern ROCKSDB_LIBRARY_API const char* rocksdb_writebatch_data(
     rocksdb_writebatch_t*, size_t* size);
 
@@ -545,6 +558,9 @@ extern ROCKSDB_LIBRARY_API void rocksdb_options_set_compression_options(
     rocksdb_options_t*, int, int, int);
 extern ROCKSDB_LIBRARY_API void rocksdb_options_set_prefix_extractor(
     rocksdb_options_t*, rocksdb_slicetransform_t*);
+extern ROCKSDB_LIBRARY_API void
+rocksdb_options_add_compact_on_deletion_collector_factory(
+    rocksdb_options_t*, size_t window_size, size_t num_dels_trigger);
 extern ROCKSDB_LIBRARY_API void rocksdb_options_set_num_levels(
     rocksdb_options_t*, int);
 extern ROCKSDB_LIBRARY_API void
@@ -704,6 +720,8 @@ enum {
 };
 extern ROCKSDB_LIBRARY_API void rocksdb_options_set_compression(
     rocksdb_options_t*, int);
+/* whether this build of the library can read and write the compression */
+extern ROCKSDB_LIBRARY_API unsigned char rocksdb_compression_supported(int);
 
 enum {
   rocksdb_level_compaction = 0,
@@ -742,6 +760,10 @@ extern ROCKSDB_LIBRARY_API unsigned char
 rocksdb_compactionfiltercontext_is_manual_compaction(
     rocksdb_compactionfiltercontext_t* context);
 
+extern ROCKSDB_LIBRARY_API uint32_t
+rocksdb_compactionfiltercontext_column_family_id(
+    rocksdb_compactionfiltercontext_t* context);
+
 /* Compaction Filter Factory */
 
 extern ROCKSDB_LIBRARY_API rocksdb_compactionfilterfactory_t*
@@ -817,6 +839,8 @@ extern ROCKSDB_LIBRARY_API void rocksdb_readoptions_set_read_tier(
     rocksdb_readoptions_t*, int);
 extern ROCKSDB_LIBRARY_API void rocksdb_readoptions_set_tailing(
     rocksdb_readoptions_t*, unsigned char);
+extern ROCKSDB_LIBRARY_API void rocksdb_readoptions_set_total_order_seek(
+    rocksdb_readoptions_t*, unsigned char);
 
 /* Write options */
 
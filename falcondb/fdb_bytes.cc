@@ -8,17 +8,25 @@
 struct fdb_bytes_t{
   const char* data_;
   size_t length_;
+  fdb_arena_t* arena_;
 };
 
 fdb_bytes_t* fdb_bytes_create(const char* data, size_t len){
-  fdb_bytes_t *bytes = (fdb_bytes_t*)fdb_malloc(sizeof(fdb_bytes_t));
+  return fdb_bytes_create_in(NULL, data, len);
+}
+
+fdb_bytes_t* fdb_bytes_create_in(fdb_arena_t* arena, const char* data, size_t len){
+  fdb_bytes_t *bytes = (fdb_bytes_t*)fdb_malloc_in(arena, sizeof(fdb_bytes_t));
   bytes->data_ = data;
   bytes->length_ = len;
+  bytes->arena_ = arena;
   return bytes;
 }
 
 void fdb_bytes_destroy(void* bytes){
-  fdb_free(bytes);
+  if(bytes != NULL){
+    fdb_free_in(((fdb_bytes_t*)bytes)->arena_, bytes);
+  }
 }
 
 int fdb_bytes_skip(fdb_bytes_t* bytes, size_t n){
@@ -7,8 +7,11 @@
 #include <stdint.h>
 
 typedef struct  fdb_bytes_t     fdb_bytes_t;
+typedef struct  fdb_arena_t     fdb_arena_t;
 
 fdb_bytes_t* fdb_bytes_create(const char* data, size_t len);
+//living in arena, NULL for the heap
+fdb_bytes_t* fdb_bytes_create_in(fdb_arena_t* arena, const char* data, size_t len);
 void fdb_bytes_destroy(void* bytes);
 
 int fdb_bytes_skip(fdb_bytes_t* bytes, size_t n);
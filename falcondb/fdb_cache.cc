@@ -0,0 +1,327 @@
+#include "fdb_cache.h"
+#include "fdb_malloc.h"
+
+#include <pthread.h>
+#include <string.h>
+
+
+struct fdb_cache_entry_t{
+    struct fdb_cache_entry_t*   next_;
+    struct fdb_cache_entry_t*   clock_prev_;
+    struct fdb_cache_entry_t*   clock_next_;
+    uint64_t                    hash_;
+    uint64_t                    id_;
+    void*                       val_;
+    fdb_cache_deleter_t         deleter_;
+    size_t                      charge_;
+    int                         referenced_;
+    size_t                      klen_;
+    char                        key_[1];
+};
+
+struct fdb_cache_shard_t{
+    pthread_rwlock_t            lock_;
+    struct fdb_cache_entry_t**  buckets_;
+    size_t                      num_buckets_;
+    size_t                      count_;
+    size_t                      usage_;
+    size_t                      capacity_;
+    struct fdb_cache_entry_t*   hand_;
+};
+
+struct fdb_cache_t{
+    struct fdb_cache_shard_t*   shards_;
+    size_t                      num_shards_;
+    size_t                      num_ids_;
+    uint64_t*                   hits_;
+    uint64_t*                   misses_;
+    uint64_t*                   evictions_;
+};
+
+typedef struct fdb_cache_entry_t    fdb_cache_entry_t;
+typedef struct fdb_cache_shard_t    fdb_cache_shard_t;
+
+#define FDB_CACHE_BUCKETS_INIT  64
+
+
+static uint64_t fdb_cache_hash(uint64_t id, const char* key, size_t klen){
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i=0; i<sizeof(uint64_t); ++i){
+        hash ^= (uint8_t)(id >> (i*8));
+        hash *= 1099511628211ull;
+    }
+    for(size_t i=0; i<klen; ++i){
+        hash ^= (uint8_t)key[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static fdb_cache_shard_t* fdb_cache_shard(fdb_cache_t* cache, uint64_t hash){
+    return &cache->shards_[(hash >> 32) % cache->num_shards_];
+}
+
+static void fdb_cache_count(fdb_cache_t* cache, uint64_t* counters, uint64_t id){
+    if(id < cache->num_ids_){
+        __sync_add_and_fetch(&counters[id], 1);
+    }
+}
+
+static fdb_cache_entry_t** fdb_cache_find(fdb_cache_shard_t* shard, uint64_t hash, uint64_t id, const char* key, size_t klen){
+    fdb_cache_entry_t **pe = &shard->buckets_[hash & (shard->num_buckets_ - 1)];
+    while(*pe != NULL){
+        fdb_cache_entry_t *e = *pe;
+        if(e->hash_ == hash && e->id_ == id && e->klen_ == klen && memcmp(e->key_, key, klen)==0){
+            break;
+        }
+        pe = &e->next_;
+    }
+    return pe;
+}
+
+static void fdb_cache_resize(fdb_cache_shard_t* shard){
+    size_t num_buckets = shard->num_buckets_ * 2;
+    fdb_cache_entry_t **buckets = (fdb_cache_entry_t**)fdb_malloc(num_buckets * sizeof(fdb_cache_entry_t*));
+    memset(buckets, 0, num_buckets * sizeof(fdb_cache_entry_t*));
+    for(size_t i=0; i<shard->num_buckets_; ++i){
+        fdb_cache_entry_t *e = shard->buckets_[i];
+        while(e != NULL){
+            fdb_cache_entry_t *next = e->next_;
+            fdb_cache_entry_t **pe = &buckets[e->hash_ & (num_buckets - 1)];
+            e->next_ = *pe;
+            *pe = e;
+            e = next;
+        }
+    }
+    fdb_free(shard->buckets_);
+    shard->buckets_ = buckets;
+    shard->num_buckets_ = num_buckets;
+}
+
+//unlinking *pe from its bucket and the clock, called with the shard locked for writing
+static void fdb_cache_remove(fdb_cache_shard_t* shard, fdb_cache_entry_t** pe){
+    fdb_cache_entry_t *e = *pe;
+    *pe = e->next_;
+    if(e->clock_next_ == e){
+        shard->hand_ = NULL;
+    }else{
+        e->clock_prev_->clock_next_ = e->clock_next_;
+        e->clock_next_->clock_prev_ = e->clock_prev_;
+        if(shard->hand_ == e){
+            shard->hand_ = e->clock_next_;
+        }
+    }
+    shard->count_ -= 1;
+    shard->usage_ -= e->charge_;
+    e->deleter_(e->val_);
+    fdb_free(e);
+}
+
+//the hand clears the referenced bits it passes and evicts the first entry found clear
+static void fdb_cache_evict(fdb_cache_t* cache, fdb_cache_shard_t* shard){
+    while(shard->usage_ > shard->capacity_ && shard->hand_ != NULL){
+        fdb_cache_entry_t *e = shard->hand_;
+        if(__atomic_load_n(&e->referenced_, __ATOMIC_RELAXED)){
+            __atomic_store_n(&e->referenced_, 0, __ATOMIC_RELAXED);
+            shard->hand_ = e->clock_next_;
+            continue;
+        }
+        fdb_cache_count(cache, cache->evictions_, e->id_);
+        fdb_cache_remove(shard, fdb_cache_find(shard, e->hash_, e->id_, e->key_, e->klen_));
+    }
+}
+
+fdb_cache_t* fdb_cache_create(size_t capacity, size_t num_shards, size_t num_ids){
+    fdb_cache_t *cache = (fdb_cache_t*)fdb_malloc(sizeof(fdb_cache_t));
+    cache->num_shards_ = num_shards > 0 ? num_shards : 1;
+    cache->shards_ = (fdb_cache_shard_t*)fdb_malloc(cache->num_shards_ * sizeof(fdb_cache_shard_t));
+    for(size_t i=0; i<cache->num_shards_; ++i){
+        fdb_cache_shard_t *shard = &cache->shards_[i];
+        pthread_rwlock_init(&shard->lock_, NULL);
+        shard->num_buckets_ = FDB_CACHE_BUCKETS_INIT;
+        shard->buckets_ = (fdb_cache_entry_t**)fdb_malloc(shard->num_buckets_ * sizeof(fdb_cache_entry_t*));
+        memset(shard->buckets_, 0, shard->num_buckets_ * sizeof(fdb_cache_entry_t*));
+        shard->count_ = 0;
+        shard->usage_ = 0;
+        shard->capacity_ = capacity / cache->num_shards_;
+        shard->hand_ = NULL;
+    }
+    cache->num_ids_ = num_ids;
+    cache->hits_ = (uint64_t*)fdb_malloc(num_ids * sizeof(uint64_t));
+    cache->misses_ = (uint64_t*)fdb_malloc(num_ids * sizeof(uint64_t));
+    cache->evictions_ = (uint64_t*)fdb_malloc(num_ids * sizeof(uint64_t));
+    memset(cache->hits_, 0, num_ids * sizeof(uint64_t));
+    memset(cache->misses_, 0, num_ids * sizeof(uint64_t));
+    memset(cache->evictions_, 0, num_ids * sizeof(uint64_t));
+    return cache;
+}
+
+void fdb_cache_destroy(fdb_cache_t* cache){
+    if(cache!=NULL){
+        for(size_t i=0; i<cache->num_shards_; ++i){
+            fdb_cache_shard_t *shard = &cache->shards_[i];
+            for(size_t j=0; j<shard->num_buckets_; ++j){
+                while(shard->buckets_[j] != NULL){
+                    fdb_cache_remove(shard, &shard->buckets_[j]);
+                }
+            }
+            fdb_free(shard->buckets_);
+            pthread_rwlock_destroy(&shard->lock_);
+        }
+        fdb_free(cache->shards_);
+        fdb_free(cache->hits_);
+        fdb_free(cache->misses_);
+        fdb_free(cache->evictions_);
+    }
+    fdb_free(cache);
+}
+
+void* fdb_cache_lookup(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen){
+    uint64_t hash = fdb_cache_hash(id, key, klen);
+    fdb_cache_shard_t *shard = fdb_cache_shard(cache, hash);
+    void *val = NULL;
+
+    //readers share the shard, the referenced bit is the only thing they write
+    pthread_rwlock_rdlock(&shard->lock_);
+    fdb_cache_entry_t *e = *fdb_cache_find(shard, hash, id, key, klen);
+    if(e != NULL){
+        if(!__atomic_load_n(&e->referenced_, __ATOMIC_RELAXED)){
+            __atomic_store_n(&e->referenced_, 1, __ATOMIC_RELAXED);
+        }
+        val = e->val_;
+        fdb_incr_ref_count(val);
+    }
+    pthread_rwlock_unlock(&shard->lock_);
+
+    fdb_cache_count(cache, val != NULL ? cache->hits_ : cache->misses_, id);
+    return val;
+}
+
+static int fdb_cache_put(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen, void* val,
+                         size_t charge, fdb_cache_deleter_t deleter, int replace){
+    uint64_t hash = fdb_cache_hash(id, key, klen);
+    fdb_cache_shard_t *shard = fdb_cache_shard(cache, hash);
+
+    fdb_cache_entry_t *e = (fdb_cache_entry_t*)fdb_malloc(sizeof(fdb_cache_entry_t) + klen);
+    e->hash_ = hash;
+    e->id_ = id;
+    e->val_ = val;
+    e->deleter_ = deleter;
+    e->charge_ = sizeof(fdb_cache_entry_t) + klen + charge;
+    e->referenced_ = 0;
+    e->klen_ = klen;
+    memcpy(e->key_, key, klen);
+    fdb_incr_ref_count(val);
+
+    pthread_rwlock_wrlock(&shard->lock_);
+    fdb_cache_entry_t **pe = fdb_cache_find(shard, hash, id, key, klen);
+    if(*pe != NULL){
+        if(!replace){
+            pthread_rwlock_unlock(&shard->lock_);
+            deleter(val);
+            fdb_free(e);
+            return 0;
+        }
+        fdb_cache_remove(shard, pe);
+    }
+    if(e->charge_ > shard->capacity_){
+        //never fits, the old value is gone anyway
+        pthread_rwlock_unlock(&shard->lock_);
+        deleter(val);
+        fdb_free(e);
+        return 0;
+    }
+    if(shard->count_ >= shard->num_buckets_){
+        fdb_cache_resize(shard);
+    }
+    pe = &shard->buckets_[hash & (shard->num_buckets_ - 1)];
+    e->next_ = *pe;
+    *pe = e;
+    //right behind the hand, so it is the last one the hand comes to
+    if(shard->hand_ == NULL){
+        e->clock_prev_ = e;
+        e->clock_next_ = e;
+        shard->hand_ = e;
+    }else{
+        e->clock_next_ = shard->hand_;
+        e->clock_prev_ = shard->hand_->clock_prev_;
+        e->clock_prev_->clock_next_ = e;
+        shard->hand_->clock_prev_ = e;
+    }
+    shard->count_ += 1;
+    shard->usage_ += e->charge_;
+    fdb_cache_evict(cache, shard);
+    pthread_rwlock_unlock(&shard->lock_);
+    return 1;
+}
+
+void fdb_cache_insert(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen, void* val,
+                      size_t charge, fdb_cache_deleter_t deleter){
+    fdb_cache_put(cache, id, key, klen, val, charge, deleter, 1);
+}
+
+int fdb_cache_add(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen, void* val,
+                  size_t charge, fdb_cache_deleter_t deleter){
+    return fdb_cache_put(cache, id, key, klen, val, charge, deleter, 0);
+}
+
+void fdb_cache_erase(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen){
+    uint64_t hash = fdb_cache_hash(id, key, klen);
+    fdb_cache_shard_t *shard = fdb_cache_shard(cache, hash);
+
+    pthread_rwlock_wrlock(&shard->lock_);
+    fdb_cache_entry_t **pe = fdb_cache_find(shard, hash, id, key, klen);
+    if(*pe != NULL){
+        fdb_cache_remove(shard, pe);
+    }
+    pthread_rwlock_unlock(&shard->lock_);
+}
+
+void fdb_cache_erase_id(fdb_cache_t* cache, uint64_t id){
+    for(size_t i=0; i<cache->num_shards_; ++i){
+        fdb_cache_shard_t *shard = &cache->shards_[i];
+        pthread_rwlock_wrlock(&shard->lock_);
+        for(size_t j=0; j<shard->num_buckets_; ++j){
+            fdb_cache_entry_t **pe = &shard->buckets_[j];
+            while(*pe != NULL){
+                if((*pe)->id_ == id){
+                    fdb_cache_remove(shard, pe);
+                }else{
+                    pe = &(*pe)->next_;
+                }
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock_);
+    }
+}
+
+void fdb_cache_stats(fdb_cache_t* cache, uint64_t id, uint64_t* hits, uint64_t* misses, uint64_t* evictions){
+    if(id >= cache->num_ids_){
+        *hits = *misses = *evictions = 0;
+        return;
+    }
+    *hits = __sync_add_and_fetch(&cache->hits_[id], 0);
+    *misses = __sync_add_and_fetch(&cache->misses_[id], 0);
+    *evictions = __sync_add_and_fetch(&cache->evictions_[id], 0);
+}
+
+size_t fdb_cache_usage(fdb_cache_t* cache){
+    size_t usage = 0;
+    for(size_t i=0; i<cache->num_shards_; ++i){
+        fdb_cache_shard_t *shard = &cache->shards_[i];
+        pthread_rwlock_rdlock(&shard->lock_);
+        usage += shard->usage_;
+        pthread_rwlock_unlock(&shard->lock_);
+    }
+    return usage;
+}
+
+void fdb_cache_set_capacity(fdb_cache_t* cache, size_t capacity){
+    for(size_t i=0; i<cache->num_shards_; ++i){
+        fdb_cache_shard_t *shard = &cache->shards_[i];
+        pthread_rwlock_wrlock(&shard->lock_);
+        shard->capacity_ = capacity / cache->num_shards_;
+        fdb_cache_evict(cache, shard);
+        pthread_rwlock_unlock(&shard->lock_);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef FDB_CACHE_H
+#define FDB_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct fdb_cache_t                  fdb_cache_t;
+
+typedef void (*fdb_cache_deleter_t)(void* val);
+
+//metadata cache shared by all slots, capacity bytes split over num_shards shards, each shard
+//evicts by CLOCK, keys are (id, key) pairs where id is the slot, values start with a fdb_ref_t
+//and the cache holds a reference of its own, dropped by deleter
+fdb_cache_t* fdb_cache_create(size_t capacity, size_t num_shards, size_t num_ids);
+
+void fdb_cache_destroy(fdb_cache_t* cache);
+
+//the value with a reference taken for the caller, or NULL
+void* fdb_cache_lookup(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen);
+
+//replacing whatever was cached under the key, charge is the memory of the value
+void fdb_cache_insert(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen, void* val,
+                      size_t charge, fdb_cache_deleter_t deleter);
+
+//inserting only if nothing is cached under the key, so a value read before a concurrent
+//write does not replace what the write cached, returns 1 if inserted
+int fdb_cache_add(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen, void* val,
+                  size_t charge, fdb_cache_deleter_t deleter);
+
+void fdb_cache_erase(fdb_cache_t* cache, uint64_t id, const char* key, size_t klen);
+
+//dropping every key of id
+void fdb_cache_erase_id(fdb_cache_t* cache, uint64_t id);
+
+//lookups of id found and not found, its keys evicted for room
+void fdb_cache_stats(fdb_cache_t* cache, uint64_t id, uint64_t* hits, uint64_t* misses, uint64_t* evictions);
+
+//bytes charged over all shards
+size_t fdb_cache_usage(fdb_cache_t* cache);
+
+//splitting capacity over the shards anew, a smaller one evicts right away
+void fdb_cache_set_capacity(fdb_cache_t* cache, size_t capacity);
+
+
+#endif //FDB_CACHE_H
@@ -0,0 +1,313 @@
+#include "fdb_codec.h"
+#include "fdb_define.h"
+#include "fdb_malloc.h"
+#include "util.h"
+
+#include <rocksdb/c.h>
+#include <string.h>
+
+
+char* fdb_codec_buf(char* stack, size_t size){
+    if(size <= FDB_CODEC_STACK_SIZE){
+        return stack;
+    }
+    return (char*)fdb_malloc(size);
+}
+
+void fdb_codec_buf_free(char* stack, char* buf){
+    if(buf != stack){
+        fdb_free(buf);
+    }
+}
+
+static void set_view(fdb_view_t* view, const char* data, size_t length){
+    if(view != NULL){
+        view->data_ = data;
+        view->length_ = length;
+    }
+}
+
+
+size_t fdb_codec_keys_key_size(size_t keylen){
+    return 2 + keylen;
+}
+
+size_t fdb_codec_encode_keys_key(char* buf, const char* key, size_t keylen){
+    buf[0] = FDB_DATA_TYPE_KEYS;
+    buf[1] = '+';
+    if(keylen > 0) memcpy(buf + 2, key, keylen);
+    return 2 + keylen;
+}
+
+int fdb_codec_decode_keys_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key){
+    if(fdbkeylen < 2 || fdbkey[0] != FDB_DATA_TYPE_KEYS){
+        return -1;
+    }
+    set_view(key, fdbkey + 2, fdbkeylen - 2);
+    return 0;
+}
+
+
+size_t fdb_codec_dels_key_size(size_t keylen){
+    return 2 + keylen;
+}
+
+size_t fdb_codec_encode_dels_key(char* buf, const char* key, size_t keylen){
+    buf[0] = FDB_DATA_TYPE_DELS;
+    buf[1] = '-';
+    if(keylen > 0) memcpy(buf + 2, key, keylen);
+    return 2 + keylen;
+}
+
+int fdb_codec_decode_dels_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key){
+    if(fdbkeylen < 2 || fdbkey[0] != FDB_DATA_TYPE_DELS){
+        return -1;
+    }
+    set_view(key, fdbkey + 2, fdbkeylen - 2);
+    return 0;
+}
+
+
+size_t fdb_codec_ttl_key_size(size_t keylen){
+    return 1 + sizeof(uint64_t) + keylen;
+}
+
+size_t fdb_codec_encode_ttl_key(char* buf, const char* key, size_t keylen, int64_t ts){
+    buf[0] = FDB_DATA_TYPE_TTL;
+    rocksdb_encode_fixed64(buf + 1, big_endian_uint64((uint64_t)ts));
+    if(keylen > 0) memcpy(buf + 1 + sizeof(uint64_t), key, keylen);
+    return 1 + sizeof(uint64_t) + keylen;
+}
+
+int fdb_codec_decode_ttl_key(const char* fdbkey, size_t fdbkeylen, int64_t* ts, fdb_view_t* key){
+    if(fdbkeylen < 1 + sizeof(uint64_t) || fdbkey[0] != FDB_DATA_TYPE_TTL){
+        return -1;
+    }
+    if(ts != NULL){
+        *ts = (int64_t)big_endian_uint64(rocksdb_decode_fixed64(fdbkey + 1));
+    }
+    set_view(key, fdbkey + 1 + sizeof(uint64_t), fdbkeylen - 1 - sizeof(uint64_t));
+    return 0;
+}
+
+
+size_t fdb_codec_size_key_size(size_t keylen){
+    return 1 + keylen;
+}
+
+size_t fdb_codec_encode_size_key(char* buf, uint8_t type, const char* key, size_t keylen){
+    buf[0] = type;
+    if(keylen > 0) memcpy(buf + 1, key, keylen);
+    return 1 + keylen;
+}
+
+int fdb_codec_decode_size_key(const char* fdbkey, size_t fdbkeylen, uint8_t type, fdb_view_t* key){
+    if(fdbkeylen < 1 || (uint8_t)fdbkey[0] != type){
+        return -1;
+    }
+    set_view(key, fdbkey + 1, fdbkeylen - 1);
+    return 0;
+}
+
+
+size_t fdb_codec_member_key_size(size_t keylen, size_t memberlen){
+    return 2 + keylen + 1 + memberlen;
+}
+
+size_t fdb_codec_encode_member_key(char* buf, uint8_t type, const char* key, size_t keylen,
+                                   const char* member, size_t memberlen){
+    char *p = buf;
+    *p++ = type;
+    *p++ = (uint8_t)keylen;
+    if(keylen > 0) memcpy(p, key, keylen);
+    p += keylen;
+    *p++ = '=';
+    if(memberlen > 0) memcpy(p, member, memberlen);
+    p += memberlen;
+    return p - buf;
+}
+
+int fdb_codec_decode_member_key(const char* fdbkey, size_t fdbkeylen, uint8_t type,
+                                fdb_view_t* key, fdb_view_t* member){
+    if(fdbkeylen < 2 || (uint8_t)fdbkey[0] != type){
+        return -1;
+    }
+    size_t keylen = (uint8_t)fdbkey[1];
+    if(fdbkeylen < 2 + keylen + 1){
+        return -1;
+    }
+    set_view(key, fdbkey + 2, keylen);
+    set_view(member, fdbkey + 2 + keylen + 1, fdbkeylen - 2 - keylen - 1);
+    return 0;
+}
+
+
+size_t fdb_codec_zscore_key_size(size_t keylen, size_t memberlen){
+    return 2 + keylen + sizeof(uint64_t) + 1 + memberlen;
+}
+
+size_t fdb_codec_encode_zscore_key(char* buf, const char* key, size_t keylen, const char* member,
+                                   size_t memberlen, double score){
+    char *p = buf;
+    *p++ = FDB_DATA_TYPE_ZSCORE;
+    *p++ = (uint8_t)keylen;
+    if(keylen > 0) memcpy(p, key, keylen);
+    p += keylen;
+    rocksdb_encode_fixed64(p, double_to_lex(score));
+    p += sizeof(uint64_t);
+    *p++ = '=';
+    if(memberlen > 0) memcpy(p, member, memberlen);
+    p += memberlen;
+    return p - buf;
+}
+
+int fdb_codec_decode_zscore_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key,
+                                fdb_view_t* member, double* score){
+    if(fdbkeylen < 2 || fdbkey[0] != FDB_DATA_TYPE_ZSCORE){
+        return -1;
+    }
+    size_t keylen = (uint8_t)fdbkey[1];
+    if(fdbkeylen < 2 + keylen + sizeof(uint64_t) + 1){
+        return -1;
+    }
+    set_view(key, fdbkey + 2, keylen);
+    if(score != NULL){
+        *score = lex_to_double(rocksdb_decode_fixed64(fdbkey + 2 + keylen));
+    }
+    size_t head = 2 + keylen + sizeof(uint64_t) + 1;
+    set_view(member, fdbkey + head, fdbkeylen - head);
+    return 0;
+}
+
+
+size_t fdb_codec_zrank_key_size(size_t keylen){
+    return 2 + keylen + sizeof(uint32_t);
+}
+
+size_t fdb_codec_encode_zrank_key(char* buf, const char* key, size_t keylen, uint32_t id){
+    char *p = buf;
+    *p++ = FDB_DATA_TYPE_ZRANK;
+    *p++ = (uint8_t)keylen;
+    if(keylen > 0) memcpy(p, key, keylen);
+    p += keylen;
+    rocksdb_encode_fixed32(p, big_endian_uint32(id));
+    p += sizeof(uint32_t);
+    return p - buf;
+}
+
+int fdb_codec_decode_zrank_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key, uint32_t* id){
+    if(fdbkeylen < 2 || fdbkey[0] != FDB_DATA_TYPE_ZRANK){
+        return -1;
+    }
+    size_t keylen = (uint8_t)fdbkey[1];
+    if(fdbkeylen != 2 + keylen + sizeof(uint32_t)){
+        return -1;
+    }
+    set_view(key, fdbkey + 2, keylen);
+    if(id != NULL){
+        *id = big_endian_uint32(rocksdb_decode_fixed32(fdbkey + 2 + keylen));
+    }
+    return 0;
+}
+
+
+size_t fdb_codec_subkey_prefix_size(const char* fdbkey, size_t fdbkeylen){
+    if(fdbkeylen < 2){
+        return 0;
+    }
+    switch(fdbkey[0]){
+        case FDB_DATA_TYPE_HASH:
+        case FDB_DATA_TYPE_SET:
+        case FDB_DATA_TYPE_ZSET:
+        case FDB_DATA_TYPE_ZSCORE:
+        case FDB_DATA_TYPE_ZRANK:
+            break;
+        default:
+            return 0;
+    }
+    size_t size = 2 + (uint8_t)fdbkey[1];
+    return (fdbkeylen >= size) ? size : 0;
+}
+
+
+size_t fdb_codec_varint32_size(uint32_t v){
+    size_t size = 1;
+    while(v >= 0x80){
+        v >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+size_t fdb_codec_encode_varint32(char* buf, uint32_t v){
+    unsigned char *p = (unsigned char*)buf;
+    while(v >= 0x80){
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p - (unsigned char*)buf;
+}
+
+int fdb_codec_decode_varint32(const char** p, const char* limit, uint32_t* v){
+    uint32_t result = 0;
+    for(int shift = 0; shift <= 28 && *p < limit; shift += 7){
+        uint32_t byte = (unsigned char)(**p);
+        ++(*p);
+        result |= (byte & 0x7f) << shift;
+        if((byte & 0x80) == 0){
+            *v = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+size_t fdb_codec_subkeys_payload_size(){
+    return 1 + sizeof(uint64_t);
+}
+
+size_t fdb_codec_encode_subkeys_payload(char* buf, uint64_t count){
+    buf[0] = 0;
+    rocksdb_encode_fixed64(buf + 1, count);
+    return 1 + sizeof(uint64_t);
+}
+
+int fdb_codec_decode_subkeys_payload(const char* payload, size_t payloadlen, uint64_t* count){
+    if(payloadlen != 1 + sizeof(uint64_t) || payload[0] != 0){
+        return -1;
+    }
+    *count = rocksdb_decode_fixed64(payload + 1);
+    return 0;
+}
+
+
+size_t fdb_codec_keys_val_size(size_t payloadlen){
+    return 2 + sizeof(uint32_t) + sizeof(uint64_t) + payloadlen;
+}
+
+size_t fdb_codec_encode_keys_val(char* buf, uint8_t type, uint8_t stat, uint32_t seq, int64_t ts,
+                                 const char* payload, size_t payloadlen){
+    buf[0] = type;
+    buf[1] = stat;
+    rocksdb_encode_fixed32(buf + 2, seq);
+    rocksdb_encode_fixed64(buf + 2 + sizeof(uint32_t), (uint64_t)ts);
+    size_t head = 2 + sizeof(uint32_t) + sizeof(uint64_t);
+    if(payloadlen > 0) memcpy(buf + head, payload, payloadlen);
+    return head + payloadlen;
+}
+
+int fdb_codec_decode_keys_val(const char* val, size_t vallen, uint8_t* type, uint8_t* stat,
+                              uint32_t* seq, int64_t* ts, fdb_view_t* payload){
+    size_t head = 2 + sizeof(uint32_t) + sizeof(uint64_t);
+    if(vallen < head){
+        return -1;
+    }
+    *type = (uint8_t)val[0];
+    *stat = (uint8_t)val[1];
+    *seq = rocksdb_decode_fixed32(val + 2);
+    *ts = (int64_t)rocksdb_decode_fixed64(val + 2 + sizeof(uint32_t));
+    set_view(payload, val + head, vallen - head);
+    return 0;
+}
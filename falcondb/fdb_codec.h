@@ -0,0 +1,90 @@
+#ifndef FDB_CODEC_H
+#define FDB_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//encoders write into a buffer of the caller, sized up front by the matching _size function,
+//so a key is built in one pass without growing, decoders point into the encoded bytes and
+//allocate nothing, they return 0 on success, -1 on malformed input
+
+//a piece of encoded bytes, valid as long as they are
+struct fdb_view_t {
+    const char* data_;
+    size_t      length_;
+};
+
+typedef struct fdb_view_t       fdb_view_t;
+
+//room for most keys on the stack, bigger ones fall back to the heap
+#define FDB_CODEC_STACK_SIZE    256
+
+//stack if size fits in it, the heap otherwise, given back by fdb_codec_buf_free
+char* fdb_codec_buf(char* stack, size_t size);
+void  fdb_codec_buf_free(char* stack, char* buf);
+
+
+//main key, type '+' key
+size_t fdb_codec_keys_key_size(size_t keylen);
+size_t fdb_codec_encode_keys_key(char* buf, const char* key, size_t keylen);
+int    fdb_codec_decode_keys_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key);
+
+//deleted seqs of a key, type '-' key
+size_t fdb_codec_dels_key_size(size_t keylen);
+size_t fdb_codec_encode_dels_key(char* buf, const char* key, size_t keylen);
+int    fdb_codec_decode_dels_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key);
+
+//expire index, type be64(ts) key
+size_t fdb_codec_ttl_key_size(size_t keylen);
+size_t fdb_codec_encode_ttl_key(char* buf, const char* key, size_t keylen, int64_t ts);
+int    fdb_codec_decode_ttl_key(const char* fdbkey, size_t fdbkeylen, int64_t* ts, fdb_view_t* key);
+
+//length of a collection, type key, with type one of hsize, ssize and zsize
+size_t fdb_codec_size_key_size(size_t keylen);
+size_t fdb_codec_encode_size_key(char* buf, uint8_t type, const char* key, size_t keylen);
+int    fdb_codec_decode_size_key(const char* fdbkey, size_t fdbkeylen, uint8_t type, fdb_view_t* key);
+
+//field of a hash, member of a set or a zset, type len(key) key '=' member
+size_t fdb_codec_member_key_size(size_t keylen, size_t memberlen);
+size_t fdb_codec_encode_member_key(char* buf, uint8_t type, const char* key, size_t keylen,
+                                   const char* member, size_t memberlen);
+int    fdb_codec_decode_member_key(const char* fdbkey, size_t fdbkeylen, uint8_t type,
+                                   fdb_view_t* key, fdb_view_t* member);
+
+//score of a zset member, type len(key) key lex(score) '=' member
+size_t fdb_codec_zscore_key_size(size_t keylen, size_t memberlen);
+size_t fdb_codec_encode_zscore_key(char* buf, const char* key, size_t keylen, const char* member,
+                                   size_t memberlen, double score);
+int    fdb_codec_decode_zscore_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key,
+                                   fdb_view_t* member, double* score);
+
+//node of the rank tree of a zset, type len(key) key be32(id), id 0 holds the root
+size_t fdb_codec_zrank_key_size(size_t keylen);
+size_t fdb_codec_encode_zrank_key(char* buf, const char* key, size_t keylen, uint32_t id);
+int    fdb_codec_decode_zrank_key(const char* fdbkey, size_t fdbkeylen, fdb_view_t* key, uint32_t* id);
+
+//collection prefix type len(key) key shared by the subkeys of one hash, set or zset, it is
+//what the prefix extractor of the slots hands to the prefix blooms, 0 for other keys
+size_t fdb_codec_subkey_prefix_size(const char* fdbkey, size_t fdbkeylen);
+
+//lengths inside packed values, 7 bits a byte low first, the decoder moves p past the varint
+size_t fdb_codec_varint32_size(uint32_t v);
+size_t fdb_codec_encode_varint32(char* buf, uint32_t v);
+int    fdb_codec_decode_varint32(const char** p, const char* limit, uint32_t* v);
+
+//payload of a collection kept in subkeys, a zero byte and the fixed64 count of its members,
+//a packed payload with a zero count is the one byte, so the two are told apart by length,
+//decode returns -1 for a payload of any other kind
+size_t fdb_codec_subkeys_payload_size();
+size_t fdb_codec_encode_subkeys_payload(char* buf, uint64_t count);
+int    fdb_codec_decode_subkeys_payload(const char* payload, size_t payloadlen, uint64_t* count);
+
+//value of a main key, type stat seq ts and the payload, the string of a string key, the
+//members of a packed collection, see t_packed.h, or the count of one kept in subkeys
+size_t fdb_codec_keys_val_size(size_t payloadlen);
+size_t fdb_codec_encode_keys_val(char* buf, uint8_t type, uint8_t stat, uint32_t seq, int64_t ts,
+                                 const char* payload, size_t payloadlen);
+int    fdb_codec_decode_keys_val(const char* val, size_t vallen, uint8_t* type, uint8_t* stat,
+                                 uint32_t* seq, int64_t* ts, fdb_view_t* payload);
+
+#endif //FDB_CODEC_H
@@ -0,0 +1,267 @@
+#include "fdb_committer.h"
+#include "fdb_types.h"
+#include "fdb_define.h"
+#include "fdb_malloc.h"
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+
+struct fdb_commit_req_t{
+    rocksdb_writebatch_t*       batch_;
+    size_t                      bytes_;
+    int                         durability_;
+    uint64_t                    sync_ms_;
+    uint64_t                    sync_bytes_;
+    uint64_t                    start_us_;
+    char*                       errptr_;
+    int                         done_;
+    struct fdb_commit_req_t*    next_;
+};
+
+struct fdb_committer_t{
+    fdb_context_t*              context_;
+    size_t                      max_bytes_;
+    int                         leading_;
+    struct fdb_commit_req_t*    head_;
+    struct fdb_commit_req_t*    tail_;
+    rocksdb_writebatch_t*       group_;
+    pthread_mutex_t             mutex_;
+    pthread_cond_t              cond_;
+    uint64_t                    groups_;
+    uint64_t                    batches_;
+    uint64_t                    bytes_;
+    uint64_t                    latency_us_;
+    uint64_t                    depth_;
+    uint64_t                    depth_max_;
+    uint64_t                    syncs_;
+    uint64_t                    unsynced_bytes_;
+    uint64_t                    last_sync_us_;
+    uint64_t                    sync_due_us_;
+};
+
+
+static uint64_t time_us(){
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_usec;
+}
+
+//periodic slots write like async ones, so the two share a group
+static int fdb_committer_wal_mode(int durability){
+    return durability == FDB_DURABILITY_PERIODIC ? FDB_DURABILITY_ASYNC : durability;
+}
+
+//called by the lead only, so nothing is written while the wal is synced
+static void fdb_committer_sync_wal(fdb_committer_t* committer, char** errptr){
+    uint64_t start = time_us();
+    rocksdb_sync_wal(committer->context_->db_, errptr);
+    if(*errptr == NULL){
+        pthread_mutex_lock(&committer->mutex_);
+        committer->syncs_ += 1;
+        committer->unsynced_bytes_ = 0;
+        committer->last_sync_us_ = start;
+        committer->sync_due_us_ = UINT64_MAX;
+        pthread_mutex_unlock(&committer->mutex_);
+    }
+}
+
+fdb_committer_t* fdb_committer_create(fdb_context_t* context, size_t max_bytes){
+    fdb_committer_t *committer = (fdb_committer_t*)fdb_malloc(sizeof(fdb_committer_t));
+    committer->context_ = context;
+    committer->max_bytes_ = max_bytes;
+    committer->leading_ = 0;
+    committer->head_ = NULL;
+    committer->tail_ = NULL;
+    committer->group_ = rocksdb_writebatch_create();
+    pthread_mutex_init(&committer->mutex_, NULL);
+    pthread_cond_init(&committer->cond_, NULL);
+    committer->groups_ = 0;
+    committer->batches_ = 0;
+    committer->bytes_ = 0;
+    committer->latency_us_ = 0;
+    committer->depth_ = 0;
+    committer->depth_max_ = 0;
+    committer->syncs_ = 0;
+    committer->unsynced_bytes_ = 0;
+    committer->last_sync_us_ = time_us();
+    committer->sync_due_us_ = UINT64_MAX;
+    return committer;
+}
+
+void fdb_committer_destroy(fdb_committer_t* committer){
+    if(committer!=NULL){
+        rocksdb_writebatch_destroy(committer->group_);
+        pthread_cond_destroy(&committer->cond_);
+        pthread_mutex_destroy(&committer->mutex_);
+    }
+    fdb_free(committer);
+}
+
+void fdb_committer_write(fdb_committer_t* committer, rocksdb_writebatch_t* batch, int durability,
+                         uint64_t sync_ms, uint64_t sync_bytes, char** errptr){
+    struct fdb_commit_req_t req;
+    req.batch_ = batch;
+    rocksdb_writebatch_data(batch, &req.bytes_);
+    req.durability_ = durability;
+    req.sync_ms_ = sync_ms;
+    req.sync_bytes_ = sync_bytes;
+    req.start_us_ = time_us();
+    req.errptr_ = NULL;
+    req.done_ = 0;
+    req.next_ = NULL;
+
+    pthread_mutex_lock(&committer->mutex_);
+    if(committer->tail_ != NULL){
+        committer->tail_->next_ = &req;
+    }else{
+        committer->head_ = &req;
+    }
+    committer->tail_ = &req;
+    if(++committer->depth_ > committer->depth_max_){
+        committer->depth_max_ = committer->depth_;
+    }
+    while(!req.done_){
+        //a follower sleeps until some leader has written its batch or the lead is free
+        if(committer->leading_){
+            pthread_cond_wait(&committer->cond_, &committer->mutex_);
+            continue;
+        }
+
+        //leading the requests queued so far up to max_bytes_ and written the same way,
+        //which may not reach our own
+        committer->leading_ = 1;
+        struct fdb_commit_req_t *first = committer->head_, *last = first;
+        size_t bytes = first->bytes_, count = 1;
+        int mode = fdb_committer_wal_mode(first->durability_);
+        while(last->next_ != NULL && bytes + last->next_->bytes_ <= committer->max_bytes_ &&
+              fdb_committer_wal_mode(last->next_->durability_) == mode){
+            last = last->next_;
+            bytes += last->bytes_;
+            ++count;
+        }
+        committer->head_ = last->next_;
+        if(committer->head_ == NULL){
+            committer->tail_ = NULL;
+        }
+        last->next_ = NULL;
+        committer->depth_ -= count;
+        pthread_mutex_unlock(&committer->mutex_);
+
+        char *err = NULL;
+        rocksdb_writeoptions_t *writeoptions = committer->context_->writeoptions_[mode];
+        if(count == 1){
+            rocksdb_write(committer->context_->db_, writeoptions, first->batch_, &err);
+        }else{
+            //a leader at a time, so the group batch is not shared
+            for(struct fdb_commit_req_t *r = first; r != NULL; r = r->next_){
+                rocksdb_writebatch_append(committer->group_, r->batch_);
+            }
+            rocksdb_write(committer->context_->db_, writeoptions, committer->group_, &err);
+            rocksdb_writebatch_clear(committer->group_);
+        }
+
+        if(err == NULL && mode == FDB_DURABILITY_SYNC){
+            //a synced write syncs everything in the wal before it as well
+            pthread_mutex_lock(&committer->mutex_);
+            committer->unsynced_bytes_ = 0;
+            committer->last_sync_us_ = time_us();
+            committer->sync_due_us_ = UINT64_MAX;
+            pthread_mutex_unlock(&committer->mutex_);
+        }else if(err == NULL && mode == FDB_DURABILITY_ASYNC){
+            //the wal is shared by all slots, a periodic slot syncs what the async ones wrote too
+            int sync = 0;
+            pthread_mutex_lock(&committer->mutex_);
+            committer->unsynced_bytes_ += bytes;
+            for(struct fdb_commit_req_t *r = first; r != NULL; r = r->next_){
+                if(r->durability_ != FDB_DURABILITY_PERIODIC){
+                    continue;
+                }
+                if(r->sync_ms_ > 0 && committer->last_sync_us_ + r->sync_ms_ * 1000 < committer->sync_due_us_){
+                    committer->sync_due_us_ = committer->last_sync_us_ + r->sync_ms_ * 1000;
+                }
+                if(r->sync_bytes_ > 0 && committer->unsynced_bytes_ >= r->sync_bytes_){
+                    sync = 1;
+                }
+            }
+            if(time_us() >= committer->sync_due_us_){
+                sync = 1;
+            }
+            pthread_mutex_unlock(&committer->mutex_);
+            if(sync){
+                fdb_committer_sync_wal(committer, &err);
+            }
+        }
+
+        uint64_t now = time_us(), latency = 0;
+        pthread_mutex_lock(&committer->mutex_);
+        for(struct fdb_commit_req_t *r = first; r != NULL;){
+            //r lives on the stack of its thread, which may return as soon as the mutex is released
+            struct fdb_commit_req_t *next = r->next_;
+            latency += (now - r->start_us_);
+            if(err != NULL){
+                r->errptr_ = strdup(err);
+            }
+            r->done_ = 1;
+            r = next;
+        }
+        committer->groups_ += 1;
+        committer->batches_ += count;
+        committer->bytes_ += bytes;
+        committer->latency_us_ += latency;
+        committer->leading_ = 0;
+        pthread_cond_broadcast(&committer->cond_);
+        if(err != NULL) rocksdb_free(err);
+    }
+    pthread_mutex_unlock(&committer->mutex_);
+    *errptr = req.errptr_;
+}
+
+int fdb_committer_sync(fdb_committer_t* committer, int due){
+    pthread_mutex_lock(&committer->mutex_);
+    while(committer->leading_){
+        pthread_cond_wait(&committer->cond_, &committer->mutex_);
+    }
+    if(committer->unsynced_bytes_ == 0 || (due && time_us() < committer->sync_due_us_)){
+        pthread_mutex_unlock(&committer->mutex_);
+        return 0;
+    }
+    committer->leading_ = 1;
+    pthread_mutex_unlock(&committer->mutex_);
+
+    char *errptr = NULL;
+    fdb_committer_sync_wal(committer, &errptr);
+
+    pthread_mutex_lock(&committer->mutex_);
+    committer->leading_ = 0;
+    pthread_cond_broadcast(&committer->cond_);
+    pthread_mutex_unlock(&committer->mutex_);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_sync_wal fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    return 1;
+}
+
+void fdb_committer_sync_stats(fdb_committer_t* committer, uint64_t* syncs, uint64_t* unsynced_bytes){
+    pthread_mutex_lock(&committer->mutex_);
+    *syncs = committer->syncs_;
+    *unsynced_bytes = committer->unsynced_bytes_;
+    pthread_mutex_unlock(&committer->mutex_);
+}
+
+void fdb_committer_stats(fdb_committer_t* committer, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                         uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max){
+    pthread_mutex_lock(&committer->mutex_);
+    *groups = committer->groups_;
+    *batches = committer->batches_;
+    *bytes = committer->bytes_;
+    *latency_us = committer->latency_us_;
+    *depth = committer->depth_;
+    *depth_max = committer->depth_max_;
+    pthread_mutex_unlock(&committer->mutex_);
+}
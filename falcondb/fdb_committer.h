@@ -0,0 +1,36 @@
+#ifndef FDB_COMMITTER_H
+#define FDB_COMMITTER_H
+
+#include "fdb_context.h"
+#include <rocksdb/c.h>
+#include <stdint.h>
+
+typedef struct fdb_committer_t              fdb_committer_t;
+
+//group commit, batches of concurrent commands from all slots are merged into one write,
+//the first waiting command writes for the group, the group holds at most max_bytes unless
+//a single batch is bigger
+fdb_committer_t* fdb_committer_create(fdb_context_t* context, size_t max_bytes);
+
+void fdb_committer_destroy(fdb_committer_t* committer);
+
+//writing batch as part of a group, returns once the group is written, *errptr is set if it failed,
+//a group only holds batches of the same wal mode, see FDB_DURABILITY_*, a periodic batch syncs
+//the wal once sync_ms passed or sync_bytes were written since the last sync, 0 for never
+void fdb_committer_write(fdb_committer_t* committer, rocksdb_writebatch_t* batch, int durability,
+                         uint64_t sync_ms, uint64_t sync_bytes, char** errptr);
+
+//syncing the wal if anything was written unsynced, or only if a periodic sync is due,
+//returns 1 if synced, 0 if not needed and -1 on error
+int fdb_committer_sync(fdb_committer_t* committer, int due);
+
+//wal syncs done by the committer and bytes written since the last one
+void fdb_committer_sync_stats(fdb_committer_t* committer, uint64_t* syncs, uint64_t* unsynced_bytes);
+
+//groups written, batches and bytes in them, summed wait of the batches in microseconds,
+//batches waiting now and the most ever waiting
+void fdb_committer_stats(fdb_committer_t* committer, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                         uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max);
+
+
+#endif //FDB_COMMITTER_H
@@ -1,11 +1,20 @@
 #include "fdb_types.h"
 #include "fdb_context.h"
+#include "fdb_define.h"
 #include "fdb_malloc.h"
+#include "fdb_sweeper.h"
+#include "fdb_filter.h"
+#include "fdb_committer.h"
+#include "fdb_cache.h"
+#include "fdb_waiter.h"
+#include "fdb_codec.h"
+#include "fdb_slice.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C" { 
@@ -24,25 +33,282 @@ void fdb_drop_db(const char*name){
 }
 
 
+//subkeys of one collection share their prefix, so a scan of a collection or a miss on one of
+//its members can skip the tables and memtables whose prefix blooms do not hold it, other keys
+//are their own prefix, which only the memtable bloom looks at
+static char* fdb_prefix_transform(void* state, const char* key, size_t length, size_t* dst_length){
+    size_t size = fdb_codec_subkey_prefix_size(key, length);
+    *dst_length = (size > 0) ? size : length;
+    return (char*)key;
+}
+
+static unsigned char fdb_prefix_in_domain(void* state, const char* key, size_t length){
+    return fdb_codec_subkey_prefix_size(key, length) > 0;
+}
+
+static unsigned char fdb_prefix_in_range(void* state, const char* key, size_t length){
+    return fdb_codec_subkey_prefix_size(key, length) == length;
+}
+
+static const char* fdb_prefix_name(void* state){
+    return "falcondb.SubkeyPrefix";
+}
+
+static void fdb_prefix_destructor(void* state){
+}
+
+//tables written before the prefix extractor have no prefixes in their filters, a prefix seek
+//would take them for empty, so they are rewritten once and the db marked
+static int fdb_context_upgrade_prefix(fdb_context_t* context){
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    char *errptr = NULL;
+    size_t vallen = 0;
+    char *val = rocksdb_get_cf(context->db_, context->readoptions_, slots[0]->handle_, FDB_PREFIX_MARKER,
+                               strlen(FDB_PREFIX_MARKER), &vallen, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    if(val != NULL){
+        rocksdb_free(val);
+        return 0;
+    }
+    for(size_t i=0; i<context->num_slots_; ++i){
+        rocksdb_compact_range_cf(context->db_, slots[i]->handle_, NULL, 0, NULL, 0);
+    }
+    rocksdb_put_cf(context->db_, context->writeoptions_[FDB_DURABILITY_SYNC], slots[0]->handle_, FDB_PREFIX_MARKER,
+                   strlen(FDB_PREFIX_MARKER), "1", 1, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_put_cf fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    return 1;
+}
+
+struct fdb_profile_t {
+    int     compaction_style_;
+    int     compression_[FDB_PROFILE_LEVELS];
+    size_t  block_size_;
+    int     bloom_bits_;
+    size_t  write_buffer_percent_;      //of the write_buffer_size of the context
+    int     write_buffer_number_;
+};
+
+static const struct fdb_profile_t fdb_profiles[FDB_PROFILE_NUM] = {
+    //FDB_PROFILE_DEFAULT
+    {rocksdb_level_compaction,
+     {rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_snappy_compression,
+      rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_snappy_compression},
+     4*1024, 10, 100, 2},
+    //FDB_PROFILE_WRITE_HEAVY, fewer rewrites of each entry, flushes and the first merges left uncompressed
+    {rocksdb_universal_compaction,
+     {rocksdb_no_compression, rocksdb_no_compression, rocksdb_snappy_compression, rocksdb_snappy_compression,
+      rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_snappy_compression},
+     16*1024, 10, 400, 4},
+    //FDB_PROFILE_READ_HEAVY, the recent levels most reads end in are not decompressed
+    {rocksdb_level_compaction,
+     {rocksdb_no_compression, rocksdb_no_compression, rocksdb_snappy_compression, rocksdb_snappy_compression,
+      rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_snappy_compression},
+     4*1024, 16, 100, 2},
+    //FDB_PROFILE_CACHE
+    {rocksdb_level_compaction,
+     {rocksdb_no_compression, rocksdb_no_compression, rocksdb_no_compression, rocksdb_no_compression,
+      rocksdb_no_compression, rocksdb_no_compression, rocksdb_no_compression},
+     4*1024, 10, 200, 2},
+    //FDB_PROFILE_COLD
+    {rocksdb_level_compaction,
+     {rocksdb_snappy_compression, rocksdb_snappy_compression, rocksdb_lz4_compression, rocksdb_lz4_compression,
+      rocksdb_zlib_compression, rocksdb_zlib_compression, rocksdb_zlib_compression},
+     64*1024, 6, 50, 2},
+};
+
+//a compression the library was built without falls back to snappy, then to none
+static int fdb_profile_compression(int compression){
+    if(rocksdb_compression_supported(compression)){
+        return compression;
+    }
+    return rocksdb_compression_supported(rocksdb_snappy_compression) ? rocksdb_snappy_compression : rocksdb_no_compression;
+}
+
+static void fdb_profile_create(fdb_context_t* context, int profile, size_t write_buffer_size){
+    const struct fdb_profile_t *p = &fdb_profiles[profile];
+    size_t memtable_size = write_buffer_size*1024*1024/100*p->write_buffer_percent_;
+    rocksdb_block_based_table_options_t *table_options = rocksdb_block_based_options_create();
+    rocksdb_block_based_options_set_block_cache(table_options, context->block_cache_);
+    rocksdb_block_based_options_set_block_size(table_options, p->block_size_);
+    rocksdb_block_based_options_set_filter_policy(table_options, rocksdb_filterpolicy_create_bloom(p->bloom_bits_));
+    rocksdb_options_t *options = rocksdb_options_create();
+    rocksdb_options_set_max_open_files(options, 10000);
+    rocksdb_options_set_create_if_missing(options, 1);
+    rocksdb_options_set_create_missing_column_families(options, 1);
+    rocksdb_options_set_write_buffer_size(options, memtable_size);
+    rocksdb_options_set_max_write_buffer_number(options, p->write_buffer_number_);
+    rocksdb_options_set_block_based_table_factory(options, table_options);
+    rocksdb_options_set_compaction_style(options, p->compaction_style_);
+    int compression[FDB_PROFILE_LEVELS];
+    for(int i=0; i<FDB_PROFILE_LEVELS; ++i){
+        compression[i] = fdb_profile_compression(p->compression_[i]);
+    }
+    rocksdb_options_set_compression(options, compression[FDB_PROFILE_LEVELS-1]);
+    rocksdb_options_set_compression_per_level(options, compression, FDB_PROFILE_LEVELS);
+    rocksdb_options_set_compaction_filter_factory(options, fdb_filter_factory_create(context));
+    rocksdb_options_set_prefix_extractor(options,
+                                         rocksdb_slicetransform_create(NULL, fdb_prefix_destructor, fdb_prefix_transform,
+                                                                       fdb_prefix_in_domain, fdb_prefix_in_range,
+                                                                       fdb_prefix_name));
+    //a table dense with deletes, as a big range removal or a reclaim leaves, is compacted soon
+    //rather than left for scans to step over
+    rocksdb_options_add_compact_on_deletion_collector_factory(options, FDB_COMPACT_DELETES_WINDOW,
+                                                              FDB_COMPACT_DELETES_TRIGGER);
+    //a bit for every 8 bytes of memtable
+    rocksdb_options_set_memtable_prefix_bloom_bits(options, (uint32_t)(memtable_size/8));
+    context->options_[profile] = options;
+    context->table_options_[profile] = table_options;
+}
+
+static void fdb_profile_marker(char* buff, uint64_t id){
+    sprintf(buff, "%s%lu", FDB_PROFILE_MARKER, (size_t)id);
+}
+
+//profiles the slots are opened with, a slot keeps the one it was created with, a family from
+//before the profiles is a default one, the others take the profile asked for, returns 0, -1
+static int fdb_context_load_profiles(fdb_context_t* context, const char* name, size_t num_slots,
+                                     const int* profiles, int* slot_profiles){
+    for(size_t i=0; i<num_slots; ++i){
+        slot_profiles[i] = (i > 0 && profiles != NULL) ? profiles[i-1] : FDB_PROFILE_DEFAULT;
+    }
+    char *errptr = NULL;
+    size_t num_families = 0;
+    char **families = rocksdb_list_column_families(context->options_[FDB_PROFILE_DEFAULT], name, &num_families, &errptr);
+    if(errptr != NULL){
+        //a new db
+        rocksdb_free(errptr);
+        return 0;
+    }
+    //the markers are read before the families have to be opened with their options
+    rocksdb_t *db = rocksdb_open_for_read_only(context->options_[FDB_PROFILE_DEFAULT], name, 0, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_open_for_read_only fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        rocksdb_list_column_families_destroy(families, num_families);
+        return -1;
+    }
+    int ret = 0;
+    char buff[64] = {0};
+    for(size_t i=1; i<num_slots && ret==0; ++i){
+        sprintf(buff, "slot-%lu", i);
+        for(size_t j=0; j<num_families; ++j){
+            if(strcmp(families[j], buff) == 0){
+                slot_profiles[i] = FDB_PROFILE_DEFAULT;
+                break;
+            }
+        }
+        fdb_profile_marker(buff, i);
+        size_t vallen = 0;
+        char *val = rocksdb_get(db, context->readoptions_, buff, strlen(buff), &vallen, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s rocksdb_get fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            errptr = NULL;
+            ret = -1;
+        }else if(val != NULL){
+            if(vallen == 1 && (uint8_t)val[0] < FDB_PROFILE_NUM){
+                slot_profiles[i] = (uint8_t)val[0];
+            }
+            rocksdb_free(val);
+        }
+    }
+    rocksdb_close(db);
+    rocksdb_list_column_families_destroy(families, num_families);
+    return ret;
+}
+
+static int fdb_context_save_profile(fdb_context_t* context, uint64_t id, int profile){
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    char *errptr = NULL;
+    char buff[64] = {0};
+    char val = (char)profile;
+    fdb_profile_marker(buff, id);
+    rocksdb_put_cf(context->db_, context->writeoptions_[FDB_DURABILITY_SYNC], slots[0]->handle_, buff, strlen(buff),
+                   &val, 1, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_put_cf fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    return 0;
+}
+
+static int fdb_context_load_ttl_indexed(fdb_context_t* context){
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    char buff[64] = {0};
+    for(size_t i=0; i<context->num_slots_; ++i){
+        char *errptr = NULL;
+        size_t vallen = 0;
+        sprintf(buff, "%s%lu", FDB_TTL_MARKER, i);
+        char *val = rocksdb_get_cf(context->db_, context->readoptions_, slots[0]->handle_, buff, strlen(buff), &vallen, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            return -1;
+        }
+        if(val != NULL){
+            slots[i]->ttl_indexed_ = 1;
+            rocksdb_free(val);
+        }
+    }
+    return 0;
+}
+
 fdb_context_t* fdb_context_create(const char* name, size_t write_buffer_size, size_t cache_size, size_t num_slots){
+    return fdb_context_create_profiles(name, write_buffer_size, cache_size, num_slots, NULL);
+}
+
+fdb_context_t* fdb_context_create_profiles(const char* name, size_t write_buffer_size, size_t cache_size, size_t num_slots,
+                                           const int* profiles){
+    for(size_t i=0; profiles!=NULL && i<num_slots; ++i){
+        if(profiles[i] < 0 || profiles[i] >= FDB_PROFILE_NUM){
+            fprintf(stderr, "%s unknown profile %d of slot %lu.\n", __func__, profiles[i], i + 1);
+            return NULL;
+        }
+    }
     fdb_context_t* context = (fdb_context_t*)(fdb_malloc(sizeof(fdb_context_t)));
     ++num_slots;
     context->num_slots_ = num_slots;
+    context->db_ = NULL;
     context->slots_ = NULL;
+    context->sweeper_ = NULL;
+    context->committer_ = NULL;
+    context->keys_cache_ = NULL;
+    context->waiter_ = NULL;
+    context->packed_entries_ = FDB_PACKED_ENTRIES;
+    context->packed_bytes_ = FDB_PACKED_BYTES;
+    context->mutex_ = rocksdb_mutex_create();
+    //built once and shared by all the reads and writes
+    context->readoptions_ = rocksdb_readoptions_create();
+    context->scanoptions_ = rocksdb_readoptions_create();
+    rocksdb_readoptions_set_fill_cache(context->scanoptions_, 0);
+    //walks across prefixes, forward scans of one collection get prefix seeks in fdb_iterator_create
+    rocksdb_readoptions_set_total_order_seek(context->scanoptions_, 1);
+    context->writeoptions_ = (rocksdb_writeoptions_t**)fdb_malloc(FDB_DURABILITY_NUM * sizeof(rocksdb_writeoptions_t*));
+    for(int i=0; i<FDB_DURABILITY_NUM; ++i){
+        context->writeoptions_[i] = rocksdb_writeoptions_create();
+    }
+    rocksdb_writeoptions_disable_WAL(context->writeoptions_[FDB_DURABILITY_NO_WAL], 1);
+    rocksdb_writeoptions_set_sync(context->writeoptions_[FDB_DURABILITY_SYNC], 1);
+    //one block cache for all the profiles
     context->block_cache_ = rocksdb_cache_create_lru(cache_size*1024*1024);
-    rocksdb_filterpolicy_t *policy = rocksdb_filterpolicy_create_bloom(10);
-    context->table_options_ = rocksdb_block_based_options_create();
-    rocksdb_block_based_options_set_block_cache(context->table_options_, context->block_cache_);
-    rocksdb_block_based_options_set_filter_policy(context->table_options_, policy);
-    context->options_ = rocksdb_options_create();
-    rocksdb_options_set_max_open_files(context->options_, 10000);
-    rocksdb_options_set_create_if_missing(context->options_, 1);
-    rocksdb_options_set_create_missing_column_families(context->options_, 1);
-    rocksdb_options_set_write_buffer_size(context->options_, write_buffer_size*1024*1024);
-    rocksdb_options_set_block_based_table_factory(context->options_, context->table_options_);
-    rocksdb_options_set_compression(context->options_, rocksdb_snappy_compression); 
+    context->options_ = (rocksdb_options_t**)fdb_malloc(FDB_PROFILE_NUM * sizeof(rocksdb_options_t*));
+    context->table_options_ = (rocksdb_block_based_table_options_t**)fdb_malloc(FDB_PROFILE_NUM * sizeof(rocksdb_block_based_table_options_t*));
+    for(int i=0; i<FDB_PROFILE_NUM; ++i){
+        fdb_profile_create(context, i, write_buffer_size);
+    }
 
     int num_column_families = (int)num_slots;
+    char* rocksdb_error = NULL;
+    fdb_slot_t** slots = NULL;
     char** slot_names = (char**)fdb_malloc(num_slots * sizeof(char*));
     for(size_t i=0; i<num_slots; ++i){
         char* buff = (char*)fdb_malloc(64);
@@ -57,14 +323,23 @@ fdb_context_t* fdb_context_create(const char* name, size_t write_buffer_size, si
 
     const char** column_family_names = (const char**)slot_names;
     const rocksdb_options_t **column_family_options = (const rocksdb_options_t**)fdb_malloc(num_slots * sizeof(rocksdb_options_t*));
+    rocksdb_column_family_handle_t **column_family_handles = (rocksdb_column_family_handle_t**)malloc(num_slots * sizeof(rocksdb_column_family_handle_t*));
+    int *slot_profiles = (int*)fdb_malloc(num_slots * sizeof(int));
+    if(fdb_context_load_profiles(context, name, num_slots, profiles, slot_profiles) < 0){
+        for(size_t i=0; i<num_slots; ++i){
+            fdb_free(slot_names[i]);
+        }
+        fdb_free(slot_names);
+        fdb_free(column_family_options);
+        fdb_free(column_family_handles);
+        fdb_free(slot_profiles);
+        goto err;
+    }
     for(size_t i=0; i<num_slots; ++i){
-        column_family_options[i] = context->options_;
+        column_family_options[i] = context->options_[slot_profiles[i]];
     }
-    rocksdb_column_family_handle_t **column_family_handles = (rocksdb_column_family_handle_t**)malloc(num_slots * sizeof(rocksdb_column_family_handle_t*));
     
-    char* rocksdb_error = NULL;
-    fdb_slot_t** slots = NULL;
-    context->db_ = rocksdb_open_column_families(context->options_, 
+    context->db_ = rocksdb_open_column_families(context->options_[FDB_PROFILE_DEFAULT], 
                                                 name, 
                                                 num_column_families, 
                                                 column_family_names, 
@@ -75,8 +350,12 @@ fdb_context_t* fdb_context_create(const char* name, size_t write_buffer_size, si
         fdb_free(slot_names[i]);
     }
     fdb_free(slot_names);
+    fdb_free(column_family_options);
     if(rocksdb_error!=NULL){
         fprintf(stderr, "rocksdb_open_column_families error %s\n", rocksdb_error);
+        rocksdb_free(rocksdb_error);
+        fdb_free(column_family_handles);
+        fdb_free(slot_profiles);
         goto err;
     }
 
@@ -85,102 +364,680 @@ fdb_context_t* fdb_context_create(const char* name, size_t write_buffer_size, si
         slots[i] = (fdb_slot_t*)fdb_malloc(sizeof(fdb_slot_t));
         slots[i]->id_ = (uint64_t)i;
         slots[i]->handle_ = column_family_handles[i];
-        slots[i]->keys_cache_ = rocksdb_cache_create_lru(1024*1024*20);
-        slots[i]->batch_ = rocksdb_writebatch_create();
-        slots[i]->mutex_ = rocksdb_mutex_create();
+        slots[i]->cf_id_ = rocksdb_column_family_handle_get_id(column_family_handles[i]);
+        slots[i]->handle_mutex_ = rocksdb_mutex_create();
+        slots[i]->dels_mutex_ = rocksdb_mutex_create();
+        slots[i]->durability_mutex_ = rocksdb_mutex_create();
+        slots[i]->keys_mutex_ = (rocksdb_mutex_t**)fdb_malloc(FDB_SLOT_KEYS_MUTEX_NUM * sizeof(rocksdb_mutex_t*));
+        for(size_t j=0; j<FDB_SLOT_KEYS_MUTEX_NUM; ++j){
+            slots[i]->keys_mutex_[j] = rocksdb_mutex_create();
+        }
+        slots[i]->keys_pins_ = (uint64_t*)fdb_malloc(FDB_SLOT_KEYS_MUTEX_NUM * sizeof(uint64_t));
+        memset(slots[i]->keys_pins_, 0, FDB_SLOT_KEYS_MUTEX_NUM * sizeof(uint64_t));
+        slots[i]->dels_markers_ = 0;
+        slots[i]->dels_subkeys_ = 0;
+        slots[i]->dels_bytes_ = 0;
+        slots[i]->durability_ = FDB_DURABILITY_ASYNC;
+        slots[i]->sync_ms_ = 0;
+        slots[i]->sync_bytes_ = 0;
+        slots[i]->profile_ = slot_profiles[i];
+        slots[i]->ttl_indexed_ = 0;
+        slots[i]->ttl_cursor_ = NULL;
+        slots[i]->keys_absent_hits_ = 0;
+        slots[i]->keys_absent_fills_ = 0;
     }
     context->slots_ = slots;
-    fdb_free(column_family_options);
+    context->keys_cache_ = fdb_cache_create(FDB_KEYS_CACHE_SIZE, FDB_KEYS_CACHE_SHARDS, num_slots);
+    context->committer_ = fdb_committer_create(context, FDB_COMMIT_GROUP_BYTES);
+    context->waiter_ = fdb_waiter_create(FDB_WAITER_BUCKETS);
     fdb_free(column_family_handles);
+    fdb_free(slot_profiles);
+    for(size_t i=1; i<num_slots; ++i){
+        if(fdb_context_save_profile(context, slots[i]->id_, slots[i]->profile_) < 0){
+            fdb_context_destroy(context);
+            return NULL;
+        }
+    }
+    if(fdb_context_load_ttl_indexed(context) < 0 || fdb_context_upgrade_prefix(context) < 0){
+        fdb_context_destroy(context);
+        return NULL;
+    }
     return context;
 
 err:
     if(context->db_!=NULL){
         rocksdb_close(context->db_);
     }
-    if(context->block_cache_!=NULL){
-        rocksdb_cache_destroy(context->block_cache_);
-    }
-    if(context->options_!=NULL){
-        rocksdb_options_destroy(context->options_);
+    for(int i=0; i<FDB_PROFILE_NUM; ++i){
+        rocksdb_options_destroy(context->options_[i]);
+        rocksdb_block_based_options_destroy(context->table_options_[i]);
     }
-    if(context->table_options_!=NULL){
-        rocksdb_block_based_options_destroy(context->table_options_);
+    fdb_free(context->options_);
+    fdb_free(context->table_options_);
+    rocksdb_cache_destroy(context->block_cache_);
+    rocksdb_readoptions_destroy(context->readoptions_);
+    rocksdb_readoptions_destroy(context->scanoptions_);
+    for(int i=0; i<FDB_DURABILITY_NUM; ++i){
+        rocksdb_writeoptions_destroy(context->writeoptions_[i]);
     }
+    fdb_free(context->writeoptions_);
+    rocksdb_mutex_destroy(context->mutex_);
     fdb_free(context);
     return NULL;
 }
 
 void fdb_context_destroy(fdb_context_t* context){
     if(context!=NULL){
-        if(context->slots_!=NULL){
-            size_t num_slots = context->num_slots_;
-            fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+        fdb_context_stop_sweeper(context);
+        //callers parked in fdb_zpop_wait are sent back before anything they hold goes away
+        fdb_waiter_shutdown((fdb_waiter_t*)context->waiter_);
+        size_t num_slots = context->num_slots_;
+        fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+        if(slots!=NULL){
             for(size_t i=0; i<num_slots; ++i){
+                rocksdb_mutex_lock(slots[i]->handle_mutex_);
+                slots[i]->cf_id_ = FDB_SLOT_CF_ID_NONE;
                 if(slots[i]->handle_ !=NULL){
                     rocksdb_column_family_handle_destroy(slots[i]->handle_);
+                    slots[i]->handle_ = NULL;
                 }
-                rocksdb_cache_destroy(slots[i]->keys_cache_);
-                rocksdb_writebatch_destroy(slots[i]->batch_);
-                rocksdb_mutex_destroy(slots[i]->mutex_); 
-                fdb_free((void*)slots[i]);
+                rocksdb_mutex_unlock(slots[i]->handle_mutex_);
             }
-            fdb_free((void*)slots);
         }
 
+        //waits for the background compactions, which may still look at the slots
         rocksdb_close(context->db_);
+        if(slots!=NULL){
+            for(size_t i=0; i<num_slots; ++i){
+                rocksdb_mutex_destroy(slots[i]->dels_mutex_);
+                rocksdb_mutex_destroy(slots[i]->durability_mutex_);
+                rocksdb_mutex_destroy(slots[i]->handle_mutex_);
+                for(size_t j=0; j<FDB_SLOT_KEYS_MUTEX_NUM; ++j){
+                    rocksdb_mutex_destroy(slots[i]->keys_mutex_[j]);
+                }
+                fdb_free((void*)slots[i]->keys_mutex_);
+                fdb_free((void*)slots[i]->keys_pins_);
+                fdb_slice_destroy((fdb_slice_t*)slots[i]->ttl_cursor_);
+                fdb_free((void*)slots[i]);
+            }
+            fdb_free((void*)slots);
+        }
+        fdb_committer_destroy((fdb_committer_t*)context->committer_);
+        fdb_cache_destroy((fdb_cache_t*)context->keys_cache_);
+        fdb_waiter_destroy((fdb_waiter_t*)context->waiter_);
+        for(int i=0; i<FDB_PROFILE_NUM; ++i){
+            rocksdb_options_destroy(context->options_[i]);
+            rocksdb_block_based_options_destroy(context->table_options_[i]);
+        }
+        fdb_free(context->options_);
+        fdb_free(context->table_options_);
         rocksdb_cache_destroy(context->block_cache_);
-        rocksdb_options_destroy(context->options_);
-        rocksdb_block_based_options_destroy(context->table_options_);
+        rocksdb_readoptions_destroy(context->readoptions_);
+        rocksdb_readoptions_destroy(context->scanoptions_);
+        for(int i=0; i<FDB_DURABILITY_NUM; ++i){
+            rocksdb_writeoptions_destroy(context->writeoptions_[i]);
+        }
+        fdb_free(context->writeoptions_);
+        rocksdb_mutex_destroy(context->mutex_);
     }
     fdb_free(context); 
 }
 
+void fdb_context_start_sweeper(fdb_context_t* context, uint64_t interval_ms, uint64_t budget, uint64_t budget_ms){
+    if(context->sweeper_ == NULL){
+        context->sweeper_ = fdb_sweeper_create(context, interval_ms, budget, budget_ms);
+    }
+}
+
+void fdb_context_stop_sweeper(fdb_context_t* context){
+    if(context->sweeper_ != NULL){
+        fdb_sweeper_destroy((fdb_sweeper_t*)context->sweeper_);
+        context->sweeper_ = NULL;
+    }
+}
+
 void fdb_context_drop_slot(fdb_context_t* context, fdb_slot_t* slot){
     char *rocksdb_error = NULL;
+    rocksdb_mutex_lock(context->mutex_);
+    //compaction filters stop using the handle first, dropping may wait for a stalled write
+    rocksdb_mutex_lock(slot->handle_mutex_);
+    uint32_t cf_id = slot->cf_id_;
+    slot->cf_id_ = FDB_SLOT_CF_ID_NONE;
+    rocksdb_mutex_unlock(slot->handle_mutex_);
     rocksdb_drop_column_family(context->db_, slot->handle_, &rocksdb_error);
     if(rocksdb_error!=NULL){ 
         fprintf(stderr, "%s rocksdb_drop_column_family fail %s.\n", __func__, rocksdb_error);
         rocksdb_free(rocksdb_error);
+        rocksdb_mutex_lock(slot->handle_mutex_);
+        slot->cf_id_ = cf_id;
+        rocksdb_mutex_unlock(slot->handle_mutex_);
     }else{
+        rocksdb_mutex_lock(slot->handle_mutex_);
         rocksdb_column_family_handle_destroy(slot->handle_);
         slot->handle_ = NULL;
-        rocksdb_cache_destroy(slot->keys_cache_);
+        rocksdb_mutex_unlock(slot->handle_mutex_);
+        fdb_cache_erase_id((fdb_cache_t*)context->keys_cache_, slot->id_);
     }
+    rocksdb_mutex_unlock(context->mutex_);
 }
 
 void fdb_context_create_slot(fdb_context_t* context, fdb_slot_t* slot){
+    fdb_context_create_slot_profile(context, slot, slot->profile_);
+}
+
+int fdb_context_create_slot_profile(fdb_context_t* context, fdb_slot_t* slot, int profile){
+    if(profile < 0 || profile >= FDB_PROFILE_NUM){
+        return FDB_ERR;
+    }
+    int retval = FDB_OK;
     char *rocksdb_error = NULL;
     char buff[64] = {0};
     sprintf(buff, "slot-%lu", (size_t)slot->id_);
-    slot->handle_ = rocksdb_create_column_family(context->db_, context->options_, buff, &rocksdb_error);
+    rocksdb_mutex_lock(context->mutex_);
+    //saved ahead of the family, a restart in between creates the family under the profile
+    if(fdb_context_save_profile(context, slot->id_, profile) < 0){
+        rocksdb_mutex_unlock(context->mutex_);
+        return FDB_ERR;
+    }
+    slot->profile_ = profile;
+    rocksdb_column_family_handle_t *handle = rocksdb_create_column_family(context->db_, context->options_[profile], buff, &rocksdb_error);
     if(rocksdb_error!=NULL){
         fprintf(stderr, "%s rocksdb_create_column_family fail %s.\n", __func__, rocksdb_error);
         rocksdb_free(rocksdb_error); 
+        retval = FDB_ERR;
     }else{ 
-        slot->keys_cache_ = rocksdb_cache_create_lru(1024*1024*20);
+        rocksdb_mutex_lock(slot->handle_mutex_);
+        slot->handle_ = handle;
+        slot->cf_id_ = rocksdb_column_family_handle_get_id(handle);
+        rocksdb_mutex_unlock(slot->handle_mutex_);
+    }
+    rocksdb_mutex_unlock(context->mutex_);
+    return retval;
+}
+
+int fdb_context_set_durability(fdb_context_t* context, fdb_slot_t* slot, int durability, uint64_t sync_ms, uint64_t sync_bytes){
+    if(durability < 0 || durability >= FDB_DURABILITY_NUM){
+        return FDB_ERR;
+    }
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    rocksdb_mutex_lock(context->mutex_);
+    for(size_t i=0; i<context->num_slots_; ++i){
+        if(slot == NULL || slots[i] == slot){
+            //commits read the three together, see fdb_slot_durability
+            rocksdb_mutex_lock(slots[i]->durability_mutex_);
+            slots[i]->durability_ = durability;
+            slots[i]->sync_ms_ = sync_ms;
+            slots[i]->sync_bytes_ = sync_bytes;
+            rocksdb_mutex_unlock(slots[i]->durability_mutex_);
+        }
+    }
+    rocksdb_mutex_unlock(context->mutex_);
+    //whatever the slot left unsynced is synced by the switch to a synced mode
+    if(durability == FDB_DURABILITY_SYNC && fdb_context_sync(context) == -1){
+        return FDB_ERR;
+    }
+    return FDB_OK;
+}
+
+int fdb_context_set_ttl_indexed(fdb_context_t* context, fdb_slot_t* slot){
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    char *errptr = NULL;
+    char buff[64] = {0};
+    sprintf(buff, "%s%lu", FDB_TTL_MARKER, (size_t)slot->id_);
+    rocksdb_put_cf(context->db_, context->writeoptions_[FDB_DURABILITY_SYNC], slots[0]->handle_, buff, strlen(buff),
+                   "1", 1, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_put_cf fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+    slot->ttl_indexed_ = 1;
+    return FDB_OK;
+}
+
+void fdb_context_set_packed_limits(fdb_context_t* context, size_t entries, size_t bytes){
+    context->packed_entries_ = entries;
+    context->packed_bytes_ = bytes;
+}
+
+int fdb_context_sync(fdb_context_t* context){
+    if(fdb_committer_sync((fdb_committer_t*)context->committer_, 0) == -1){
+        return FDB_ERR;
+    }
+    return FDB_OK;
+}
+
+//a consistent snapshot of the durability of the slot, which fdb_context_set_durability may be changing,
+//under a lock of its own as compaction holds handle_mutex_ while it filters
+static int fdb_slot_durability(fdb_slot_t* slot, uint64_t* sync_ms, uint64_t* sync_bytes){
+    rocksdb_mutex_lock(slot->durability_mutex_);
+    int durability = slot->durability_;
+    if(sync_ms != NULL) *sync_ms = slot->sync_ms_;
+    if(sync_bytes != NULL) *sync_bytes = slot->sync_bytes_;
+    rocksdb_mutex_unlock(slot->durability_mutex_);
+    return durability;
+}
+
+rocksdb_writeoptions_t* fdb_slot_writeoptions(fdb_context_t* context, fdb_slot_t* slot){
+    int durability = fdb_slot_durability(slot, NULL, NULL);
+    return context->writeoptions_[durability == FDB_DURABILITY_PERIODIC ? FDB_DURABILITY_ASYNC : durability];
+}
+
+static size_t fdb_slot_key_stripe(const char* key, size_t klen){
+    uint32_t hash = 2166136261u;
+    for(size_t i=0; i<klen; ++i){
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash % FDB_SLOT_KEYS_MUTEX_NUM;
+}
+
+rocksdb_mutex_t* fdb_slot_key_mutex(fdb_slot_t* slot, const char* key, size_t klen){
+    return slot->keys_mutex_[fdb_slot_key_stripe(key, klen)];
+}
+
+//a main key changed by the batch of a thread, cached once the batch is written
+struct fdb_thread_cached_t{
+    uint64_t                id_;
+    fdb_slice_t*            key_;
+    void*                   val_;
+    size_t                  charge_;
+    fdb_cache_deleter_t     deleter_;
+};
+
+//a stripe pinned by the running command of a thread
+struct fdb_thread_pin_t{
+    fdb_slot_t*     slot_;
+    size_t          stripe_;
+};
+
+//the last put or delete of a key in the batch of a thread, by where it sits in the batch data,
+//found by hash, an entry of an older generation is free
+struct fdb_thread_written_t{
+    uint64_t        gen_;
+    uint64_t        hash_;
+    fdb_slot_t*     slot_;
+    size_t          koff_;
+    size_t          klen_;
+    size_t          voff_;
+    size_t          vlen_;
+    int             deleted_;
+};
+
+//each thread builds its command in a batch of its own, reused from one command to the next,
+//along with the index of the keys it writes, the main keys the batch changes and the stripes
+//the command pins
+struct fdb_thread_batch_t{
+    rocksdb_writebatch_t*           batch_;
+    struct fdb_thread_written_t*    written_;
+    size_t                          num_written_;
+    size_t                          cap_written_;   //a power of 2
+    uint64_t                        gen_;
+    struct fdb_thread_cached_t*     cached_;
+    size_t                          num_cached_;
+    size_t                          cap_cached_;
+    struct fdb_thread_pin_t*        pins_;
+    size_t                          num_pins_;
+    size_t                          cap_pins_;
+};
+
+static pthread_key_t fdb_thread_batch_key;
+static pthread_once_t fdb_thread_batch_once = PTHREAD_ONCE_INIT;
+
+static void fdb_thread_batch_drop_cached(struct fdb_thread_batch_t* tb){
+    for(size_t i=0; i<tb->num_cached_; ++i){
+        tb->cached_[i].deleter_(tb->cached_[i].val_);
+        fdb_slice_destroy(tb->cached_[i].key_);
+    }
+    tb->num_cached_ = 0;
+}
+
+static void fdb_thread_batch_destroy(void* ptr){
+    struct fdb_thread_batch_t *tb = (struct fdb_thread_batch_t*)ptr;
+    fdb_thread_batch_drop_cached(tb);
+    rocksdb_writebatch_destroy(tb->batch_);
+    fdb_free(tb->written_);
+    fdb_free(tb->cached_);
+    fdb_free(tb->pins_);
+    fdb_free(tb);
+}
+
+//the pins of a command go when it leaves, its chunked commits stay covered until then
+static void fdb_thread_batch_unpin(){
+    struct fdb_thread_batch_t *tb = (struct fdb_thread_batch_t*)pthread_getspecific(fdb_thread_batch_key);
+    if(tb == NULL){
+        return;
+    }
+    for(size_t i=0; i<tb->num_pins_; ++i){
+        __sync_sub_and_fetch(&tb->pins_[i].slot_->keys_pins_[tb->pins_[i].stripe_], 1);
+    }
+    tb->num_pins_ = 0;
+}
+
+static void fdb_thread_batch_init(){
+    pthread_key_create(&fdb_thread_batch_key, fdb_thread_batch_destroy);
+    fdb_arena_set_leave_hook(fdb_thread_batch_unpin);
+}
+
+static struct fdb_thread_batch_t* fdb_thread_batch_state(){
+    pthread_once(&fdb_thread_batch_once, fdb_thread_batch_init);
+    struct fdb_thread_batch_t *tb = (struct fdb_thread_batch_t*)pthread_getspecific(fdb_thread_batch_key);
+    if(tb == NULL){
+        tb = (struct fdb_thread_batch_t*)fdb_malloc(sizeof(struct fdb_thread_batch_t));
+        memset(tb, 0, sizeof(struct fdb_thread_batch_t));
+        tb->batch_ = rocksdb_writebatch_create();
+        tb->gen_ = 1;
+        pthread_setspecific(fdb_thread_batch_key, tb);
+    }
+    return tb;
+}
+
+static rocksdb_writebatch_t* fdb_thread_batch(){
+    return fdb_thread_batch_state()->batch_;
+}
+
+void fdb_slot_key_pin(fdb_slot_t* slot, const char* key, size_t klen){
+    if(fdb_arena_current() == NULL){
+        return;
+    }
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    if(tb->num_pins_ == tb->cap_pins_){
+        tb->cap_pins_ = (tb->cap_pins_ == 0) ? 8 : tb->cap_pins_ * 2;
+        tb->pins_ = (struct fdb_thread_pin_t*)fdb_realloc(tb->pins_, tb->cap_pins_ * sizeof(struct fdb_thread_pin_t));
+    }
+    size_t stripe = fdb_slot_key_stripe(key, klen);
+    tb->pins_[tb->num_pins_].slot_ = slot;
+    tb->pins_[tb->num_pins_].stripe_ = stripe;
+    ++tb->num_pins_;
+    __sync_add_and_fetch(&slot->keys_pins_[stripe], 1);
+}
+
+int fdb_slot_key_pinned(fdb_slot_t* slot, const char* key, size_t klen){
+    return __sync_add_and_fetch(&slot->keys_pins_[fdb_slot_key_stripe(key, klen)], 0) > 0;
+}
+
+static struct fdb_thread_cached_t* fdb_thread_batch_find_cached(struct fdb_thread_batch_t* tb, uint64_t id,
+                                                                const char* key, size_t klen){
+    for(size_t i=0; i<tb->num_cached_; ++i){
+        struct fdb_thread_cached_t *cached = &tb->cached_[i];
+        if(cached->id_ == id && fdb_slice_length(cached->key_) == klen &&
+           memcmp(fdb_slice_data(cached->key_), key, klen) == 0){
+            return cached;
+        }
+    }
+    return NULL;
+}
+
+void fdb_slot_writebatch_cache(fdb_slot_t* slot, const char* key, size_t klen, void* val, size_t charge,
+                               void (*deleter)(void*)){
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    fdb_incr_ref_count(val);
+    struct fdb_thread_cached_t *cached = fdb_thread_batch_find_cached(tb, slot->id_, key, klen);
+    if(cached != NULL){
+        cached->deleter_(cached->val_);
+    }else{
+        if(tb->num_cached_ == tb->cap_cached_){
+            tb->cap_cached_ = (tb->cap_cached_ == 0) ? 8 : tb->cap_cached_ * 2;
+            tb->cached_ = (struct fdb_thread_cached_t*)fdb_realloc(tb->cached_,
+                                                                   tb->cap_cached_ * sizeof(struct fdb_thread_cached_t));
+        }
+        cached = &tb->cached_[tb->num_cached_++];
+        cached->id_ = slot->id_;
+        cached->key_ = fdb_slice_create(key, klen);
+    }
+    cached->val_ = val;
+    cached->charge_ = charge;
+    cached->deleter_ = deleter;
+}
+
+void* fdb_slot_writebatch_cached(fdb_slot_t* slot, const char* key, size_t klen){
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    struct fdb_thread_cached_t *cached = fdb_thread_batch_find_cached(tb, slot->id_, key, klen);
+    if(cached == NULL){
+        return NULL;
+    }
+    fdb_incr_ref_count(cached->val_);
+    return cached->val_;
+}
+
+static uint64_t fdb_thread_written_hash(fdb_slot_t* slot, const char* key, size_t klen){
+    uint64_t hash = 14695981039346656037ull ^ slot->id_;
+    for(size_t i=0; i<klen; ++i){
+        hash ^= (uint8_t)key[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+//the entry of key, or the free one it goes in
+static struct fdb_thread_written_t* fdb_thread_written_probe(struct fdb_thread_batch_t* tb, const char* data, uint64_t hash,
+                                                             fdb_slot_t* slot, const char* key, size_t klen){
+    size_t mask = tb->cap_written_ - 1;
+    for(size_t i=hash & mask; ; i=(i + 1) & mask){
+        struct fdb_thread_written_t *written = &tb->written_[i];
+        if(written->gen_ != tb->gen_){
+            return written;
+        }
+        if(written->hash_ == hash && written->slot_ == slot && written->klen_ == klen &&
+           memcmp(data + written->koff_, key, klen) == 0){
+            return written;
+        }
+    }
+}
+
+static void fdb_thread_written_grow(struct fdb_thread_batch_t* tb){
+    struct fdb_thread_written_t *old = tb->written_;
+    size_t cap = tb->cap_written_;
+    uint64_t gen = tb->gen_;
+    tb->cap_written_ = (cap == 0) ? 64 : cap * 2;
+    tb->written_ = (struct fdb_thread_written_t*)fdb_malloc(tb->cap_written_ * sizeof(struct fdb_thread_written_t));
+    memset(tb->written_, 0, tb->cap_written_ * sizeof(struct fdb_thread_written_t));
+    size_t mask = tb->cap_written_ - 1;
+    for(size_t i=0; i<cap; ++i){
+        if(old[i].gen_ != gen){
+            continue;
+        }
+        size_t at = old[i].hash_ & mask;
+        while(tb->written_[at].gen_ == gen){
+            at = (at + 1) & mask;
+        }
+        tb->written_[at] = old[i];
+    }
+    fdb_free(old);
+}
+
+static size_t fdb_varint_length(uint64_t v){
+    size_t len = 1;
+    while(v >= 128){
+        v >>= 7;
+        ++len;
+    }
+    return len;
+}
+
+//key was just written at the end of the batch, its value, if a put, is the last vlen bytes and
+//the key comes before the varint of vlen
+static void fdb_thread_written_note(fdb_slot_t* slot, const char* key, size_t klen, size_t vlen, int deleted){
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    if(2*(tb->num_written_ + 1) > tb->cap_written_){
+        fdb_thread_written_grow(tb);
+    }
+    size_t size = 0;
+    const char *data = rocksdb_writebatch_data(tb->batch_, &size);
+    uint64_t hash = fdb_thread_written_hash(slot, key, klen);
+    struct fdb_thread_written_t *written = fdb_thread_written_probe(tb, data, hash, slot, key, klen);
+    if(written->gen_ != tb->gen_){
+        written->gen_ = tb->gen_;
+        written->hash_ = hash;
+        written->slot_ = slot;
+        written->klen_ = klen;
+        ++tb->num_written_;
+    }
+    written->deleted_ = deleted;
+    written->vlen_ = deleted ? 0 : vlen;
+    written->voff_ = size - written->vlen_;
+    written->koff_ = deleted ? size - klen : size - vlen - fdb_varint_length(vlen) - klen;
+}
+
+//the index goes along with the batch, by a new generation
+static void fdb_thread_written_clear(struct fdb_thread_batch_t* tb){
+    if(tb->num_written_ > 0){
+        ++tb->gen_;
+        tb->num_written_ = 0;
     }
 }
 
 void fdb_slot_writebatch_put(fdb_slot_t* slot, const char* key, size_t klen, const char* val, size_t vlen){
-    rocksdb_mutex_lock(slot->mutex_);
-    rocksdb_writebatch_put_cf(slot->batch_, slot->handle_, key, klen, val, vlen); 
-    rocksdb_mutex_unlock(slot->mutex_);
+    rocksdb_writebatch_put_cf(fdb_thread_batch(), slot->handle_, key, klen, val, vlen); 
+    fdb_thread_written_note(slot, key, klen, vlen, 0);
 }
 
 void fdb_slot_writebatch_delete(fdb_slot_t* slot, const char* key, size_t klen){
-    rocksdb_mutex_lock(slot->mutex_);
-    rocksdb_writebatch_delete_cf(slot->batch_, slot->handle_, key, klen);
-    rocksdb_mutex_unlock(slot->mutex_); 
+    rocksdb_writebatch_delete_cf(fdb_thread_batch(), slot->handle_, key, klen);
+    fdb_thread_written_note(slot, key, klen, 0, 1);
+}
+
+//-1 if the batch of the calling thread has not touched key, 0 if it deleted it, 1 if it put it,
+//with a copy of the value freed by rocksdb_free like the values of rocksdb_get_cf
+static int fdb_slot_writebatch_find(fdb_slot_t* slot, struct fdb_thread_batch_t* tb, const char* key, size_t klen,
+                                    char** val, size_t* vlen){
+    *val = NULL;
+    if(tb->num_written_ == 0){
+        return -1;
+    }
+    size_t size = 0;
+    const char *data = rocksdb_writebatch_data(tb->batch_, &size);
+    uint64_t hash = fdb_thread_written_hash(slot, key, klen);
+    struct fdb_thread_written_t *written = fdb_thread_written_probe(tb, data, hash, slot, key, klen);
+    if(written->gen_ != tb->gen_){
+        return -1;
+    }
+    if(written->deleted_){
+        return 0;
+    }
+    *val = (char*)malloc(written->vlen_ > 0 ? written->vlen_ : 1);
+    memcpy(*val, data + written->voff_, written->vlen_);
+    *vlen = written->vlen_;
+    return 1;
+}
+
+char* fdb_slot_writebatch_get(fdb_context_t* context, fdb_slot_t* slot, const char* key, size_t klen, size_t* vlen, char** errptr){
+    char *val = NULL;
+    if(fdb_slot_writebatch_find(slot, fdb_thread_batch_state(), key, klen, &val, vlen) >= 0){
+        return val;
+    }
+    return rocksdb_get_cf(context->db_, context->readoptions_, slot->handle_, key, klen, vlen, errptr);
+}
+
+int fdb_slot_writebatch_multi_get(fdb_context_t* context, fdb_slot_t* slot, size_t num, const char* const* keys,
+                                  const size_t* klens, char** vals, size_t* vlens, char** errptr){
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    fdb_arena_t *arena = fdb_arena_current();
+    //the keys the batch leaves open, read with one MultiGet
+    size_t *pos = (size_t*)fdb_malloc_in(arena, num * sizeof(size_t));
+    const char **dbkeys = (const char**)fdb_malloc_in(arena, num * sizeof(char*));
+    size_t *dbklens = (size_t*)fdb_malloc_in(arena, num * sizeof(size_t));
+    const rocksdb_column_family_handle_t **handles =
+        (const rocksdb_column_family_handle_t**)fdb_malloc_in(arena, num * sizeof(rocksdb_column_family_handle_t*));
+    char **errs = (char**)fdb_malloc_in(arena, num * sizeof(char*));
+    size_t m = 0;
+    for(size_t i=0; i<num; ++i){
+        vals[i] = NULL;
+        vlens[i] = 0;
+        if(fdb_slot_writebatch_find(slot, tb, keys[i], klens[i], &vals[i], &vlens[i]) >= 0){
+            continue;
+        }
+        pos[m] = i;
+        dbkeys[m] = keys[i];
+        dbklens[m] = klens[i];
+        handles[m] = slot->handle_;
+        ++m;
+    }
+
+    int ret = 0;
+    if(m > 0){
+        char **dbvals = (char**)fdb_malloc_in(arena, m * sizeof(char*));
+        size_t *dbvlens = (size_t*)fdb_malloc_in(arena, m * sizeof(size_t));
+        rocksdb_multi_get_cf(context->db_, context->readoptions_, handles, m, dbkeys, dbklens, dbvals, dbvlens, errs);
+        for(size_t j=0; j<m; ++j){
+            if(errs[j] != NULL){
+                if(*errptr == NULL){
+                    *errptr = errs[j];
+                }else{
+                    rocksdb_free(errs[j]);
+                }
+                ret = -1;
+            }
+            vals[pos[j]] = dbvals[j];
+            vlens[pos[j]] = dbvlens[j];
+        }
+        fdb_free_in(arena, dbvals);
+        fdb_free_in(arena, dbvlens);
+    }
+    fdb_free_in(arena, pos);
+    fdb_free_in(arena, dbkeys);
+    fdb_free_in(arena, dbklens);
+    fdb_free_in(arena, handles);
+    fdb_free_in(arena, errs);
+    return ret;
 }
 
 void fdb_slot_writebatch_commit(fdb_context_t* context, fdb_slot_t* slot, char** errptr){
-    rocksdb_writeoptions_t *writeoptions = rocksdb_writeoptions_create();
-    rocksdb_mutex_lock(slot->mutex_); 
-    rocksdb_write(context->db_, writeoptions, slot->batch_, errptr);
-    rocksdb_writebatch_clear(slot->batch_);
-    rocksdb_mutex_unlock(slot->mutex_);
-    rocksdb_writeoptions_destroy(writeoptions);
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    fdb_cache_t *cache = (fdb_cache_t*)context->keys_cache_;
+    if(rocksdb_writebatch_count(tb->batch_) > 0){
+        //readers go to the db while the write is under way, they find the old values there
+        //until it lands and the new ones after
+        for(size_t i=0; i<tb->num_cached_; ++i){
+            struct fdb_thread_cached_t *cached = &tb->cached_[i];
+            fdb_cache_erase(cache, cached->id_, fdb_slice_data(cached->key_), fdb_slice_length(cached->key_));
+        }
+        uint64_t sync_ms = 0, sync_bytes = 0;
+        int durability = fdb_slot_durability(slot, &sync_ms, &sync_bytes);
+        fdb_committer_write((fdb_committer_t*)context->committer_, tb->batch_, durability,
+                            sync_ms, sync_bytes, errptr);
+        if(*errptr == NULL){
+            for(size_t i=0; i<tb->num_cached_; ++i){
+                struct fdb_thread_cached_t *cached = &tb->cached_[i];
+                fdb_cache_insert(cache, cached->id_, fdb_slice_data(cached->key_), fdb_slice_length(cached->key_),
+                                 cached->val_, cached->charge_, cached->deleter_);
+            }
+        }
+        rocksdb_writebatch_clear(tb->batch_);
+    }
+    fdb_thread_written_clear(tb);
+    fdb_thread_batch_drop_cached(tb);
+}
+
+void fdb_slot_writebatch_discard(fdb_context_t* context, fdb_slot_t* slot){
+    struct fdb_thread_batch_t *tb = fdb_thread_batch_state();
+    if(rocksdb_writebatch_count(tb->batch_) > 0){
+        rocksdb_writebatch_clear(tb->batch_);
+    }
+    fdb_thread_written_clear(tb);
+    fdb_thread_batch_drop_cached(tb);
+}
+
+void fdb_context_commit_stats(fdb_context_t* context, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                              uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max){
+    fdb_committer_stats((fdb_committer_t*)context->committer_, groups, batches, bytes, latency_us, depth, depth_max);
+}
+
+void fdb_context_set_keys_cache_size(fdb_context_t* context, size_t size){
+    fdb_cache_set_capacity((fdb_cache_t*)context->keys_cache_, size > 0 ? size : FDB_KEYS_CACHE_SIZE);
+}
+
+void fdb_context_keys_cache_stats(fdb_context_t* context, fdb_slot_t* slot, uint64_t* hits, uint64_t* misses, uint64_t* evictions){
+    fdb_cache_stats((fdb_cache_t*)context->keys_cache_, slot->id_, hits, misses, evictions);
+}
+
+void fdb_context_keys_absent_stats(fdb_context_t* context, fdb_slot_t* slot, uint64_t* hits, uint64_t* fills){
+    *hits = __sync_add_and_fetch(&slot->keys_absent_hits_, 0);
+    *fills = __sync_add_and_fetch(&slot->keys_absent_fills_, 0);
+}
+
+void fdb_context_sync_stats(fdb_context_t* context, uint64_t* syncs, uint64_t* unsynced_bytes){
+    fdb_committer_sync_stats((fdb_committer_t*)context->committer_, syncs, unsynced_bytes);
 }
 
 #ifdef __cplusplus
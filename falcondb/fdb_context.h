@@ -2,6 +2,7 @@
 #define FDB_CONTEXT_H
 
 #include <string.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,20 +10,87 @@ extern "C" {
 
 typedef struct fdb_context_t                fdb_context_t;
 typedef struct fdb_slot_t                   fdb_slot_t;
+typedef struct rocksdb_mutex_t              rocksdb_mutex_t;
+typedef struct rocksdb_writeoptions_t       rocksdb_writeoptions_t;
 
 //database
 extern void fdb_drop_db(const char* name);
 
 //context
 extern fdb_context_t* fdb_context_create(const char* name, size_t write_buffer_size, size_t cache_size, size_t num_slots);
+//profiles[i] is the FDB_PROFILE_* of slot i+1, or NULL for the default one, it goes to the slots
+//created by this call only, a slot keeps the profile it was created with across restarts
+extern fdb_context_t* fdb_context_create_profiles(const char* name, size_t write_buffer_size, size_t cache_size, size_t num_slots,
+                                                  const int* profiles);
 extern void fdb_context_destroy(fdb_context_t* context);
 extern void fdb_context_drop_slot(fdb_context_t* context, fdb_slot_t* slot);
+//recreating a dropped slot under the profile it had
 extern void fdb_context_create_slot(fdb_context_t* context, fdb_slot_t* slot);
+//recreating a dropped slot under another profile, see FDB_PROFILE_*
+extern int fdb_context_create_slot_profile(fdb_context_t* context, fdb_slot_t* slot, int profile);
 
-//writebatch
+//durability of the commands of a slot, or of all slots if slot is NULL, see FDB_DURABILITY_*,
+//slots start async, the choice outlives dropping and recreating the slot, sync_ms and sync_bytes
+//bound what a periodic slot may lose, 0 for no bound
+extern int fdb_context_set_durability(fdb_context_t* context, fdb_slot_t* slot, int durability, uint64_t sync_ms, uint64_t sync_bytes);
+//syncing whatever is in the wal unsynced
+extern int fdb_context_sync(fdb_context_t* context);
+//prebuilt write options for the durability of the slot
+extern rocksdb_writeoptions_t* fdb_slot_writeoptions(fdb_context_t* context, fdb_slot_t* slot);
+
+//marking the main keys of the slot all indexed by expiry, in memory and in the default slot
+extern int fdb_context_set_ttl_indexed(fdb_context_t* context, fdb_slot_t* slot);
+
+//collections of up to entries members and bytes of payload are packed in their main key, one
+//growing past either goes to subkeys, 0 entries leaves new collections in subkeys
+extern void fdb_context_set_packed_limits(fdb_context_t* context, size_t entries, size_t bytes);
+
+//background sweeper
+extern void fdb_context_start_sweeper(fdb_context_t* context, uint64_t interval_ms, uint64_t budget, uint64_t budget_ms);
+extern void fdb_context_stop_sweeper(fdb_context_t* context);
+
+//stripe lock serializing the metadata updates of one key with the sweeper
+extern rocksdb_mutex_t* fdb_slot_key_mutex(fdb_slot_t* slot, const char* key, size_t klen);
+//keeping the sweeper off the stripe of key until the running command leaves, so what the command
+//writes under the seq it found is not committed after the key expired, taken under the stripe
+//lock, nothing is pinned outside of a command
+extern void fdb_slot_key_pin(fdb_slot_t* slot, const char* key, size_t klen);
+//whether a running command pins the stripe of key, checked under the stripe lock
+extern int fdb_slot_key_pinned(fdb_slot_t* slot, const char* key, size_t klen);
+
+//writebatch, a command puts into a batch of its calling thread and commits it once at the end,
+//the commits of concurrent commands are written as a group
 extern void fdb_slot_writebatch_put(fdb_slot_t* slot, const char* key, size_t klen, const char* val, size_t vlen);
 extern void fdb_slot_writebatch_delete(fdb_slot_t* slot, const char* key, size_t klen);
 extern void fdb_slot_writebatch_commit(fdb_context_t* context, fdb_slot_t* slot, char** errptr);
+//dropping what a failed command has put so far, along with the main keys it was to cache
+extern void fdb_slot_writebatch_discard(fdb_context_t* context, fdb_slot_t* slot);
+//the main key val the batch leaves under key, the batch holds a reference of its own and
+//the commit puts val in the keys cache once written, other threads keep the old one until then
+extern void fdb_slot_writebatch_cache(fdb_slot_t* slot, const char* key, size_t klen, void* val, size_t charge,
+                                      void (*deleter)(void*));
+//the val the batch of the calling thread holds under key with a reference taken for the caller,
+//or NULL
+extern void* fdb_slot_writebatch_cached(fdb_slot_t* slot, const char* key, size_t klen);
+
+//reading a key as the batch will leave it, falling back to the db, the result is freed by rocksdb_free
+extern char* fdb_slot_writebatch_get(fdb_context_t* context, fdb_slot_t* slot, const char* key, size_t klen, size_t* vlen, char** errptr);
+//fdb_slot_writebatch_get of num keys, the ones the batch leaves open are read together with one
+//MultiGet, vals[i] is NULL for a key not there, returns 0, -1 with the first error in errptr
+extern int fdb_slot_writebatch_multi_get(fdb_context_t* context, fdb_slot_t* slot, size_t num, const char* const* keys,
+                                         const size_t* klens, char** vals, size_t* vlens, char** errptr);
+
+//group commit counters, see fdb_committer_stats
+extern void fdb_context_commit_stats(fdb_context_t* context, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                                     uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max);
+//bounding the main keys cached over all slots, 0 for FDB_KEYS_CACHE_SIZE, a smaller bound evicts right away
+extern void fdb_context_set_keys_cache_size(fdb_context_t* context, size_t size);
+//keys cache counters of the slot, see fdb_cache_stats
+extern void fdb_context_keys_cache_stats(fdb_context_t* context, fdb_slot_t* slot, uint64_t* hits, uint64_t* misses, uint64_t* evictions);
+//main keys found absent in the keys cache, and absent ones read from the db and cached
+extern void fdb_context_keys_absent_stats(fdb_context_t* context, fdb_slot_t* slot, uint64_t* hits, uint64_t* fills);
+//wal sync counters, see fdb_committer_sync_stats
+extern void fdb_context_sync_stats(fdb_context_t* context, uint64_t* syncs, uint64_t* unsynced_bytes);
 
 #ifdef __cplusplus
 }
@@ -11,11 +11,13 @@
 #define FDB_DATA_TYPE_ZSET                   's'
 #define FDB_DATA_TYPE_ZSCORE                 'z'
 #define FDB_DATA_TYPE_ZSIZE                  'Z'
+#define FDB_DATA_TYPE_ZRANK                  'r'
 #define FDB_DATA_TYPE_SET                    'e'
 #define FDB_DATA_TYPE_SSIZE                  'E'
 #define FDB_DATA_TYPE_TTL                    'l'
 #define FDB_DATA_TYPE_KEYS                   'k'
 #define FDB_DATA_TYPE_DELS                   'd'
+#define FDB_DATA_TYPE_INT64                  'i'     //a string kept as a binary int64, on disk only
 
 //main key stat
 #define FDB_KEY_STAT_NORMAL                   0
@@ -24,6 +26,26 @@
 //main sequence number start from
 #define FDB_KEY_INIT_SEQ                      0x0000FF01
 
+//slot durability, what a command has written when it returns
+#define FDB_DURABILITY_NO_WAL                 0     //memtable only, lost on crash
+#define FDB_DURABILITY_ASYNC                  1     //in the wal, lost on machine crash
+#define FDB_DURABILITY_SYNC                   2     //wal synced
+#define FDB_DURABILITY_PERIODIC               3     //in the wal, synced every sync_ms or sync_bytes
+#define FDB_DURABILITY_NUM                    4
+
+//slot option profile, how the column family of a slot is compacted, compressed and cached
+#define FDB_PROFILE_DEFAULT                   0     //level compaction, snappy
+#define FDB_PROFILE_WRITE_HEAVY               1     //universal compaction, big memtables
+#define FDB_PROFILE_READ_HEAVY                2     //level compaction, denser blooms, upper levels uncompressed
+#define FDB_PROFILE_CACHE                     3     //uncompressed, for a working set held in the block cache
+#define FDB_PROFILE_COLD                      4     //big blocks, lower levels in lz4 then zlib
+#define FDB_PROFILE_NUM                       5
+
+//how a zset store combines the weighted scores a member has in several sources
+#define FDB_ZSET_AGGREGATE_SUM                0
+#define FDB_ZSET_AGGREGATE_MIN                1
+#define FDB_ZSET_AGGREGATE_MAX                2
+
 
 
 #define FDB_OK_RANGE_HAVE_NONE                  12
@@ -0,0 +1,80 @@
+#include "fdb_filter.h"
+#include "fdb_types.h"
+#include "fdb_define.h"
+#include "fdb_malloc.h"
+#include "t_keys.h"
+#include "util.h"
+
+
+struct fdb_filter_t{
+    fdb_context_t*  context_;
+    fdb_slot_t*     slot_;
+    uint32_t        cf_id_;
+    int64_t         now_;
+};
+
+typedef struct fdb_filter_t fdb_filter_t;
+
+
+static void fdb_filter_destroy(void* state){
+    fdb_free(state);
+}
+
+static unsigned char fdb_filter_filter(void* state, int level, const char* key, size_t klen, const char* val, size_t vlen,
+                                       char** new_val, size_t* new_vlen, unsigned char* val_changed){
+    if(klen == 0 || key[0] != FDB_DATA_TYPE_KEYS){
+        return 0;
+    }
+    fdb_filter_t *filter = (fdb_filter_t*)state;
+    int ret = 0;
+    //the slot may be dropped while the compaction runs, see fdb_context_drop_slot
+    rocksdb_mutex_lock(filter->slot_->handle_mutex_);
+    if(filter->slot_->cf_id_ == filter->cf_id_){
+        ret = keys_filter(filter->context_, filter->slot_, key, klen, val, vlen, filter->now_);
+    }
+    rocksdb_mutex_unlock(filter->slot_->handle_mutex_);
+    return ret == 1 ? 1 : 0;
+}
+
+static const char* fdb_filter_name(void* state){
+    return "fdb_filter";
+}
+
+static rocksdb_compactionfilter_t* fdb_filter_create(void* state, rocksdb_compactionfiltercontext_t* ccontext){
+    fdb_context_t *context = (fdb_context_t*)state;
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    if(slots == NULL){
+        return NULL;
+    }
+
+    uint32_t cf_id = rocksdb_compactionfiltercontext_column_family_id(ccontext);
+    fdb_slot_t *slot = NULL;
+    for(size_t i=0; i<context->num_slots_ && slot==NULL; ++i){
+        rocksdb_mutex_lock(slots[i]->handle_mutex_);
+        if(slots[i]->cf_id_ == cf_id){
+            slot = slots[i];
+        }
+        rocksdb_mutex_unlock(slots[i]->handle_mutex_);
+    }
+    if(slot == NULL){
+        return NULL;
+    }
+
+    fdb_filter_t *filter = (fdb_filter_t*)fdb_malloc(sizeof(fdb_filter_t));
+    filter->context_ = context;
+    filter->slot_ = slot;
+    filter->cf_id_ = cf_id;
+    filter->now_ = (int64_t)time_ms();
+    return rocksdb_compactionfilter_create(filter, fdb_filter_destroy, fdb_filter_filter, fdb_filter_name);
+}
+
+static void fdb_filter_factory_destroy(void* state){
+}
+
+static const char* fdb_filter_factory_name(void* state){
+    return "fdb_filter_factory";
+}
+
+rocksdb_compactionfilterfactory_t* fdb_filter_factory_create(fdb_context_t* context){
+    return rocksdb_compactionfilterfactory_create(context, fdb_filter_factory_destroy, fdb_filter_create, fdb_filter_factory_name);
+}
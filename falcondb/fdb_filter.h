@@ -0,0 +1,12 @@
+#ifndef FDB_FILTER_H
+#define FDB_FILTER_H
+
+#include "fdb_context.h"
+#include <rocksdb/c.h>
+
+//compaction filter factory for the slot column families, compactions drop
+//expired strings and the main keys of collections whose subkeys are reclaimed
+rocksdb_compactionfilterfactory_t* fdb_filter_factory_create(fdb_context_t* context);
+
+
+#endif //FDB_FILTER_H
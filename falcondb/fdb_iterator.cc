@@ -1,6 +1,7 @@
 #include "fdb_types.h"
 #include "fdb_iterator.h"
 #include "fdb_malloc.h"
+#include "fdb_codec.h"
 
 #include "util.h"
 
@@ -11,13 +12,26 @@
 fdb_iterator_t* fdb_iterator_create(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* start, 
                                     fdb_slice_t* end, uint64_t limit, int direction){
     fdb_iterator_t *iterator = (fdb_iterator_t*)fdb_malloc(sizeof(fdb_iterator_t));
-    fdb_incr_ref_count(end);
-    iterator->end_ = end;
+    //its own copy, end may live in the arena of a command the iterator outlives
+    iterator->end_ = fdb_slice_create(fdb_slice_data(end), fdb_slice_length(end));
     iterator->direction_ = direction;
     iterator->limit_ = limit;
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    rocksdb_readoptions_set_fill_cache(readoptions, 0);
-    iterator->iterator_ = rocksdb_create_iterator_cf(context->db_, readoptions, slot->handle_);
+    iterator->options_ = NULL;
+    if(direction == FORWARD && fdb_slice_length(end) > 0){
+        //rocksdb stops at end itself, and a range inside one collection only looks at the
+        //tables and memtables whose prefix blooms hold it, backward scans stay in total order
+        //since a prefix seek can not step back out of its prefix
+        iterator->options_ = rocksdb_readoptions_create();
+        rocksdb_readoptions_set_fill_cache(iterator->options_, 0);
+        rocksdb_readoptions_set_iterate_upper_bound(iterator->options_, fdb_slice_data(iterator->end_),
+                                                    fdb_slice_length(iterator->end_));
+        size_t prefix = fdb_codec_subkey_prefix_size(fdb_slice_data(start), fdb_slice_length(start));
+        int same = (prefix > 0 && prefix == fdb_codec_subkey_prefix_size(fdb_slice_data(end), fdb_slice_length(end)) &&
+                    memcmp(fdb_slice_data(start), fdb_slice_data(end), prefix) == 0);
+        rocksdb_readoptions_set_total_order_seek(iterator->options_, same ? 0 : 1);
+    }
+    rocksdb_readoptions_t *options = (iterator->options_ != NULL) ? iterator->options_ : context->scanoptions_;
+    iterator->iterator_ = rocksdb_create_iterator_cf(context->db_, options, slot->handle_);
     rocksdb_iter_seek(iterator->iterator_, fdb_slice_data(start), fdb_slice_length(start));
 
     if(iterator->direction_ == FORWARD){
@@ -36,7 +50,6 @@ fdb_iterator_t* fdb_iterator_create(fdb_context_t* context, fdb_slot_t* slot, fd
         }
     }
 
-    rocksdb_readoptions_destroy(readoptions);
     return iterator;
 }
 
@@ -44,6 +57,9 @@ void fdb_iterator_destroy(fdb_iterator_t* iterator){
     if(iterator!=NULL){
         fdb_slice_destroy(iterator->end_);
         rocksdb_iter_destroy(iterator->iterator_);
+        if(iterator->options_ != NULL){
+            rocksdb_readoptions_destroy(iterator->options_);
+        }
     }
     fdb_free(iterator);
 }
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <pthread.h>
 #include "config.h"
 
 
@@ -23,7 +24,7 @@
 
 void fdb_incr_ref_count(void* ptr){
     fdb_ref_t *ref = (fdb_ref_t*)ptr;
-    ref->refcnt_ += 1;
+    __sync_add_and_fetch(&ref->refcnt_, 1);
 }
 
 static void fdb_malloc_oom(size_t size) {
@@ -77,3 +78,148 @@ char *fdb_strdup_with_length(const char *s, size_t len) {
     p[len] = '\0';
     return p;
 }
+
+
+#define FDB_ARENA_BLOCK_SIZE    4096
+#define FDB_ARENA_ALIGN         8
+
+struct fdb_arena_block_t {
+    struct fdb_arena_block_t *next_;
+    size_t size_;
+    char data_[1];
+};
+
+struct fdb_arena_t {
+    struct fdb_arena_block_t *head_;
+    struct fdb_arena_block_t *large_;
+    size_t used_;
+    size_t block_size_;
+    size_t usage_;
+    int depth_;
+};
+
+typedef struct fdb_arena_block_t fdb_arena_block_t;
+
+static fdb_arena_block_t* fdb_arena_block_create(size_t size){
+    fdb_arena_block_t *block = (fdb_arena_block_t*)fdb_malloc(sizeof(fdb_arena_block_t) + size);
+    block->next_ = NULL;
+    block->size_ = size;
+    return block;
+}
+
+fdb_arena_t* fdb_arena_create(size_t block_size){
+    fdb_arena_t *arena = (fdb_arena_t*)fdb_malloc(sizeof(fdb_arena_t));
+    arena->block_size_ = block_size;
+    arena->head_ = fdb_arena_block_create(block_size);
+    arena->large_ = NULL;
+    arena->used_ = 0;
+    arena->usage_ = 0;
+    arena->depth_ = 0;
+    return arena;
+}
+
+void fdb_arena_destroy(fdb_arena_t* arena){
+    if(arena == NULL) return;
+    fdb_arena_reset(arena);
+    fdb_free(arena->head_);
+    fdb_free(arena);
+}
+
+void* fdb_arena_alloc(fdb_arena_t* arena, size_t size){
+    size = (size + FDB_ARENA_ALIGN - 1) & ~(size_t)(FDB_ARENA_ALIGN - 1);
+    if(arena->used_ + size > arena->head_->size_){
+        //big ones get a block of their own, the rest of the current block stays in use
+        if(size > arena->block_size_ / 4){
+            fdb_arena_block_t *block = fdb_arena_block_create(size);
+            block->next_ = arena->large_;
+            arena->large_ = block;
+            arena->usage_ += size;
+            return block->data_;
+        }
+        fdb_arena_block_t *block = fdb_arena_block_create(arena->block_size_);
+        block->next_ = arena->head_;
+        arena->head_ = block;
+        arena->used_ = 0;
+    }
+    void *ptr = arena->head_->data_ + arena->used_;
+    arena->used_ += size;
+    arena->usage_ += size;
+    return ptr;
+}
+
+void fdb_arena_reset(fdb_arena_t* arena){
+    while(arena->large_ != NULL){
+        fdb_arena_block_t *next = arena->large_->next_;
+        fdb_free(arena->large_);
+        arena->large_ = next;
+    }
+    //the first block is at the tail
+    while(arena->head_->next_ != NULL){
+        fdb_arena_block_t *next = arena->head_->next_;
+        fdb_free(arena->head_);
+        arena->head_ = next;
+    }
+    arena->used_ = 0;
+    arena->usage_ = 0;
+}
+
+size_t fdb_arena_usage(fdb_arena_t* arena){
+    return arena->usage_;
+}
+
+static pthread_key_t fdb_thread_arena_key;
+static pthread_once_t fdb_thread_arena_once = PTHREAD_ONCE_INIT;
+
+static void fdb_thread_arena_destroy(void* arena){
+    fdb_arena_destroy((fdb_arena_t*)arena);
+}
+
+static void fdb_thread_arena_init(){
+    pthread_key_create(&fdb_thread_arena_key, fdb_thread_arena_destroy);
+}
+
+static fdb_arena_t* fdb_thread_arena(){
+    pthread_once(&fdb_thread_arena_once, fdb_thread_arena_init);
+    fdb_arena_t *arena = (fdb_arena_t*)pthread_getspecific(fdb_thread_arena_key);
+    if(arena == NULL){
+        arena = fdb_arena_create(FDB_ARENA_BLOCK_SIZE);
+        pthread_setspecific(fdb_thread_arena_key, arena);
+    }
+    return arena;
+}
+
+static void (*fdb_arena_leave_hook)() = NULL;
+
+void fdb_arena_set_leave_hook(void (*hook)()){
+    fdb_arena_leave_hook = hook;
+}
+
+void fdb_arena_enter(){
+    fdb_thread_arena()->depth_ += 1;
+}
+
+void fdb_arena_leave(){
+    fdb_arena_t *arena = fdb_thread_arena();
+    if(--arena->depth_ == 0){
+        if(fdb_arena_leave_hook != NULL){
+            fdb_arena_leave_hook();
+        }
+        fdb_arena_reset(arena);
+    }
+}
+
+fdb_arena_t* fdb_arena_current(){
+    //threads that never ran a command, such as the compaction ones, get no arena
+    pthread_once(&fdb_thread_arena_once, fdb_thread_arena_init);
+    fdb_arena_t *arena = (fdb_arena_t*)pthread_getspecific(fdb_thread_arena_key);
+    return (arena != NULL && arena->depth_ > 0) ? arena : NULL;
+}
+
+void* fdb_malloc_in(fdb_arena_t* arena, size_t size){
+    if(arena == NULL) return fdb_malloc(size);
+    return fdb_arena_alloc(arena, size);
+}
+
+void fdb_free_in(fdb_arena_t* arena, void* ptr){
+    if(arena == NULL) fdb_free(ptr);
+}
@@ -3,12 +3,14 @@
 
 #include <stdlib.h>
 
+//shared objects start with a fdb_ref_t, counted atomically as readers may share them
 struct fdb_ref_t {
     size_t refcnt_;
 };
 
 
 typedef struct fdb_ref_t  fdb_ref_t;
+typedef struct fdb_arena_t fdb_arena_t;
 
 void  fdb_incr_ref_count(void* ptr);
 void* fdb_malloc(size_t size);
@@ -17,4 +19,26 @@ void  fdb_free(void *ptr);
 char* fdb_strdup(const char *s);
 char* fdb_strdup_with_length(const char *s, size_t len);
 
+//bump allocator, memory is given back all at once by fdb_arena_reset
+fdb_arena_t* fdb_arena_create(size_t block_size);
+void  fdb_arena_destroy(fdb_arena_t* arena);
+void* fdb_arena_alloc(fdb_arena_t* arena, size_t size);
+//keeping the first block for the next user
+void  fdb_arena_reset(fdb_arena_t* arena);
+//bytes handed out since the last reset
+size_t fdb_arena_usage(fdb_arena_t* arena);
+
+//a command of the calling thread, its temporaries go to the arena of the thread
+//and are dropped when the outermost command leaves, commands may nest
+void  fdb_arena_enter();
+void  fdb_arena_leave();
+//run by the outermost fdb_arena_leave of a thread, for what a command holds until it ends
+void  fdb_arena_set_leave_hook(void (*hook)());
+//the arena of the running command, NULL outside of one
+fdb_arena_t* fdb_arena_current();
+
+//arena aware variants, a NULL arena is the heap
+void* fdb_malloc_in(fdb_arena_t* arena, size_t size);
+void  fdb_free_in(fdb_arena_t* arena, void* ptr);
+
 #endif //FDB_MALLOC_H
@@ -3,6 +3,7 @@ package fdb
 /*
 #include "fdb_session.h"
 #include "fdb_context.h"
+#include "fdb_define.h"
 */
 import "C"
 
@@ -20,6 +21,33 @@ const (
 	DOUBLE_SIZE   = unsafe.Sizeof(C.double(0.0))
 )
 
+const (
+	SWEEP_INTERVAL_MS = 100
+	SWEEP_BUDGET      = 4096
+	SWEEP_BUDGET_MS   = 10
+)
+
+const (
+	DURABILITY_NO_WAL   = C.FDB_DURABILITY_NO_WAL
+	DURABILITY_ASYNC    = C.FDB_DURABILITY_ASYNC
+	DURABILITY_SYNC     = C.FDB_DURABILITY_SYNC
+	DURABILITY_PERIODIC = C.FDB_DURABILITY_PERIODIC
+)
+
+const (
+	PROFILE_DEFAULT     = C.FDB_PROFILE_DEFAULT
+	PROFILE_WRITE_HEAVY = C.FDB_PROFILE_WRITE_HEAVY
+	PROFILE_READ_HEAVY  = C.FDB_PROFILE_READ_HEAVY
+	PROFILE_CACHE       = C.FDB_PROFILE_CACHE
+	PROFILE_COLD        = C.FDB_PROFILE_COLD
+)
+
+const (
+	AGGREGATE_SUM = C.FDB_ZSET_AGGREGATE_SUM
+	AGGREGATE_MIN = C.FDB_ZSET_AGGREGATE_MIN
+	AGGREGATE_MAX = C.FDB_ZSET_AGGREGATE_MAX
+)
+
 func ConvertCItemPointer2GoByte(items *C.fdb_item_t, i int, value *FdbValue) {
 	var item *C.fdb_item_t
 	item = (*C.fdb_item_t)(unsafe.Pointer(uintptr(unsafe.Pointer(items)) + uintptr(i)*FDB_ITEM_SIZE))
@@ -45,6 +73,25 @@ func ConvertCDoublePointer2Go(floats *C.double, i int, value *float64) {
 	}
 }
 
+//an item over b, left empty for an empty b such as the first cursor of a scan
+func fillScanItem(item *C.fdb_item_t, b []byte) {
+	if len(b) > 0 {
+		item.data_ = (*C.char)(unsafe.Pointer(&b[0]))
+		item.data_len_ = C.uint64_t(len(b))
+	}
+}
+
+//the cursor of the next chunk of a scan, nil once it is done, a nil cursor starts one
+func convertScanCursor(item *C.fdb_item_t) []byte {
+	if unsafe.Pointer(item) == CNULL {
+		return nil
+	}
+	defer C.destroy_fdb_item_array(item, 1)
+	var next FdbValue
+	ConvertCItemPointer2GoByte(item, 0, &next)
+	return next.Val
+}
+
 func getLockID(key string) uint32 {
 	v := crc32.ChecksumIEEE([]byte(key))
 	return uint32(v % uint32(LOCK_KEY_NUM))
@@ -86,6 +133,18 @@ func (slot *FdbSlot) Drop() {
 	C.fdb_drop_slot(slot.fdb.ctx, C.uint64_t(slot.slot))
 }
 
+func (slot *FdbSlot) DropProfile(profile int) error {
+	lock := slot.fetchSlotLock()
+	lock.acquire()
+	defer lock.release()
+
+	ret := int(C.fdb_drop_slot_profile(slot.fdb.ctx, C.uint64_t(slot.slot), C.int(profile)))
+	if ret != FDB_OK {
+		return &FdbError{retcode: ret}
+	}
+	return nil
+}
+
 type FdbManager struct {
 	inited bool
 	ctx    *C.fdb_context_t
@@ -120,6 +179,10 @@ func (fdb *FdbManager) DropDB(file_path string) {
 }
 
 func (fdb *FdbManager) InitDB(file_path string, cache_size int, write_buffer_size int, num_slots int) error {
+	return fdb.InitDBProfiles(file_path, cache_size, write_buffer_size, make([]int, num_slots))
+}
+
+func (fdb *FdbManager) InitDBProfiles(file_path string, cache_size int, write_buffer_size int, profiles []int) error {
 	fdb.lock.acquire()
 	defer fdb.lock.release()
 
@@ -129,7 +192,19 @@ func (fdb *FdbManager) InitDB(file_path string, cache_size int, write_buffer_siz
 	csPath := C.CString(file_path)
 	defer C.free(unsafe.Pointer(csPath))
 
-	fdb.ctx = C.fdb_context_create(csPath, C.size_t(cache_size), C.size_t(write_buffer_size), C.size_t(num_slots))
+	num_slots := len(profiles)
+	//one spare entry, so that there is a first one to pass with no slots
+	prim_profiles := make([]C.int, num_slots+1)
+	for i := 0; i < num_slots; i++ {
+		prim_profiles[i] = C.int(profiles[i])
+	}
+	ctx := C.fdb_context_create_profiles(csPath, C.size_t(cache_size), C.size_t(write_buffer_size), C.size_t(num_slots),
+		&prim_profiles[0])
+	if ctx == nil {
+		return &FdbError{retcode: FDB_ERR}
+	}
+	fdb.ctx = ctx
+	C.fdb_context_start_sweeper(fdb.ctx, C.uint64_t(SWEEP_INTERVAL_MS), C.uint64_t(SWEEP_BUDGET), C.uint64_t(SWEEP_BUDGET_MS))
 
 	fdb.slots = make([]*FdbSlot, num_slots)
 	for i := 0; i < num_slots; i++ {
@@ -144,11 +219,6 @@ func (fdb *FdbManager) InitDB(file_path string, cache_size int, write_buffer_siz
 		for j := 0; j < LOCK_KEY_NUM; j++ {
 			fdb.slots[i].lockKeys[j].pref = &(fdb.slots[i].lockSlot.lock)
 		}
-
-		//keys
-		go fdb.slots[i].keysCleaningHelper(i)
-
-		//dels
 	}
 	fdb.inited = true
 	return nil
@@ -164,6 +234,31 @@ func (fdb *FdbManager) CloseDB() {
 	}
 }
 
+func (fdb *FdbManager) Sync() error {
+	if ret := int(C.fdb_sync(fdb.ctx)); ret != FDB_OK {
+		return &FdbError{retcode: ret}
+	}
+	return nil
+}
+
+func (fdb *FdbManager) SyncStats() (syncs uint64, unsyncedBytes uint64) {
+	cSyncs, cUnsynced := C.uint64_t(0), C.uint64_t(0)
+	C.fdb_sync_stats(fdb.ctx, &cSyncs, &cUnsynced)
+	return uint64(cSyncs), uint64(cUnsynced)
+}
+
+// SetKeysCacheSize bounds the main keys cached over all slots, 0 for the default
+func (fdb *FdbManager) SetKeysCacheSize(size int) {
+	C.fdb_set_keys_cache_size(fdb.ctx, C.size_t(size))
+}
+
+func (fdb *FdbManager) CommitStats() (groups uint64, batches uint64, bytes uint64, latencyUs uint64, depth uint64, depthMax uint64) {
+	cGroups, cBatches, cBytes := C.uint64_t(0), C.uint64_t(0), C.uint64_t(0)
+	cLatency, cDepth, cDepthMax := C.uint64_t(0), C.uint64_t(0), C.uint64_t(0)
+	C.fdb_commit_stats(fdb.ctx, &cGroups, &cBatches, &cBytes, &cLatency, &cDepth, &cDepthMax)
+	return uint64(cGroups), uint64(cBatches), uint64(cBytes), uint64(cLatency), uint64(cDepth), uint64(cDepthMax)
+}
+
 func (slot *FdbSlot) fetchKeysLock(key string) *FdbLock {
 	id := getLockID(key)
 	return &(slot.lockKeys[id])
@@ -177,36 +272,30 @@ func (slot *FdbSlot) GetSlotID() uint64 {
 	return slot.slot
 }
 
-func (slot *FdbSlot) keysCleaningHelper(ind int) {
-	for {
-		time.Sleep(time.Duration(3600*ind) * time.Second)
-
-		keys := C.create_fdb_keys(slot.fdb.ctx, C.uint64_t(slot.slot), C.uint64_t(20*1000*1000))
-		if keys != (*C.fdb_keys_t)(CNULL) {
-			for {
-				time.Sleep(time.Duration(1) * time.Second)
-
-				item_keys := (*C.fdb_item_t)(CNULL)
-				length := C.int64_t(0)
-				limit := C.uint64_t(1000)
-				C.iterate_fdb_expired_keys(keys, limit, &item_keys, &length)
-				for i := 0; i < int(length); i++ {
-					var value FdbValue
-					ConvertCItemPointer2GoByte(item_keys, i, &value)
-					if value.Val != nil {
-						slot.CleanExpiredKey(value.Val)
-					}
-				}
-				if uint64(length) < uint64(limit) {
-					break
-				}
-			}
-			C.destroy_fdb_keys(keys)
-		}
+func (slot *FdbSlot) SetDurability(durability int, syncMs uint64, syncBytes uint64) error {
+	ret := int(C.fdb_set_durability(slot.fdb.ctx, C.uint64_t(slot.slot), C.int(durability), C.uint64_t(syncMs), C.uint64_t(syncBytes)))
+	if ret != FDB_OK {
+		return &FdbError{retcode: ret}
 	}
+	return nil
 }
 
-func (slot *FdbSlot) delsCleaningHelper() {
+func (slot *FdbSlot) DelsStats() (markers uint64, subkeys uint64, bytes uint64) {
+	cMarkers, cSubkeys, cBytes := C.uint64_t(0), C.uint64_t(0), C.uint64_t(0)
+	C.fdb_dels_stats(slot.fdb.ctx, C.uint64_t(slot.slot), &cMarkers, &cSubkeys, &cBytes)
+	return uint64(cMarkers), uint64(cSubkeys), uint64(cBytes)
+}
+
+func (slot *FdbSlot) KeysCacheStats() (hits uint64, misses uint64, evictions uint64) {
+	cHits, cMisses, cEvictions := C.uint64_t(0), C.uint64_t(0), C.uint64_t(0)
+	C.fdb_keys_cache_stats(slot.fdb.ctx, C.uint64_t(slot.slot), &cHits, &cMisses, &cEvictions)
+	return uint64(cHits), uint64(cMisses), uint64(cEvictions)
+}
+
+func (slot *FdbSlot) KeysAbsentStats() (hits uint64, fills uint64) {
+	cHits, cFills := C.uint64_t(0), C.uint64_t(0)
+	C.fdb_keys_absent_stats(slot.fdb.ctx, C.uint64_t(slot.slot), &cHits, &cFills)
+	return uint64(cHits), uint64(cFills)
 }
 
 func (slot *FdbSlot) CleanExpiredKey(key []byte) int64 {
@@ -340,6 +429,31 @@ func (slot *FdbSlot) Del(keys ...[]byte) (int64, error) {
 	return cnt, nil
 }
 
+func (slot *FdbSlot) Scan(cursor []byte, match []byte, count int64) ([][]byte, []byte, error) {
+	var item_cursor, item_match C.fdb_item_t
+	fillScanItem(&item_cursor, cursor)
+	fillScanItem(&item_match, match)
+
+	item_keys := (*C.fdb_item_t)(CNULL)
+	item_next := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_scan(slot.fdb.ctx, C.uint64_t(slot.slot), &item_cursor, &item_match, C.uint64_t(count), &item_keys, &length, &item_next)
+
+	if int(ret) == 0 {
+		defer C.destroy_fdb_item_array(item_keys, C.size_t(length))
+
+		_length := int(length)
+		retkeys := make([][]byte, _length)
+		var value FdbValue
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_keys, i, &value)
+			retkeys[i] = value.Val
+		}
+		return retkeys, convertScanCursor(item_next), nil
+	}
+	return nil, nil, &FdbError{retcode: int(ret)}
+}
+
 func (slot *FdbSlot) MSet(kvs []FdbPair) ([]error, error) {
 	return slot.mset(kvs, 1)
 }
@@ -680,6 +794,49 @@ func (slot *FdbSlot) HGetAll(key []byte) ([][]byte, [][]byte, error) {
 	return nil, nil, &FdbError{retcode: int(ret)}
 }
 
+func (slot *FdbSlot) HScan(key []byte, cursor []byte, match []byte, count int64) ([][]byte, [][]byte, []byte, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_cursor, item_match C.fdb_item_t
+	fillScanItem(&item_cursor, cursor)
+	fillScanItem(&item_match, match)
+
+	item_fvs := (*C.fdb_item_t)(CNULL)
+	item_next := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_hscan(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_cursor, &item_match, C.uint64_t(count), &item_fvs, &length, &item_next)
+
+	if int(ret) == 0 {
+		defer C.destroy_fdb_item_array(item_fvs, C.size_t(length))
+
+		_length := int(int(length) / 2)
+		ind := 0
+		retfields := make([][]byte, _length)
+		retvalues := make([][]byte, _length)
+		for i := 0; i < _length; i++ {
+			var field FdbValue
+			ConvertCItemPointer2GoByte(item_fvs, ind, &field)
+			retfields[i] = field.Val
+			ind++
+
+			var value FdbValue
+			ConvertCItemPointer2GoByte(item_fvs, ind, &value)
+			retvalues[i] = value.Val
+			ind++
+		}
+		return retfields, retvalues, convertScanCursor(item_next), nil
+	} else if ret > 0 {
+		return nil, nil, nil, nil
+	}
+	return nil, nil, nil, &FdbError{retcode: int(ret)}
+}
+
 func (slot *FdbSlot) HMset(key []byte, fields, values [][]byte) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -741,6 +898,70 @@ func (slot *FdbSlot) ZAdd(key []byte, members [][]byte, scores []float64) (int64
 	return 0, &FdbError{retcode: int(ret)}
 }
 
+func (slot *FdbSlot) ZAddCapped(key []byte, members [][]byte, scores []float64, cap int64, trimMax bool) (int64, int64, error) {
+	if cap < 0 {
+		cap = 0
+	}
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	item_mbrs := make([]C.fdb_item_t, len(members))
+	prim_scrs := make([]C.double, len(members))
+	for i := 0; i < len(members); i++ {
+		item_mbrs[i].data_ = (*C.char)(unsafe.Pointer(&(members[i][0])))
+		item_mbrs[i].data_len_ = C.uint64_t(len(members[i]))
+
+		prim_scrs[i] = C.double(scores[i])
+	}
+	trim := 0
+	if trimMax {
+		trim = 1
+	}
+
+	cnt := C.int64_t(0)
+	trimmed := C.int64_t(0)
+	ret := C.fdb_zadd_capped(slot.fdb.ctx,
+		C.uint64_t(slot.slot),
+		&item_key,
+		C.size_t(len(members)),
+		(*C.double)(unsafe.Pointer(&prim_scrs[0])),
+		(*C.fdb_item_t)(unsafe.Pointer(&item_mbrs[0])),
+		C.uint64_t(cap),
+		C.int(trim),
+		&cnt,
+		&trimmed)
+	if int(ret) == 0 {
+		return int64(cnt), int64(trimmed), nil
+	}
+	return 0, 0, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZWindowAdd(key []byte, member []byte, now float64, window float64, ttlMs int64) (int64, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_member C.fdb_item_t
+	item_member.data_ = (*C.char)(unsafe.Pointer(&member[0]))
+	item_member.data_len_ = C.uint64_t(len(member))
+
+	cnt := C.int64_t(0)
+	ret := C.fdb_zwindow_add(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_member, C.double(now), C.double(window), C.int64_t(ttlMs), &cnt)
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
+}
+
 func (slot *FdbSlot) ZCard(key []byte) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -781,6 +1002,49 @@ func (slot *FdbSlot) ZScore(key []byte, member []byte) (float64, error) {
 	}
 	return 0, &FdbError{retcode: int(ret)}
 }
+
+func (slot *FdbSlot) ZMScore(key []byte, members ...[]byte) ([]float64, []bool, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	item_mbrs := make([]C.fdb_item_t, len(members))
+	for i := 0; i < len(members); i++ {
+		item_mbrs[i].data_ = (*C.char)(unsafe.Pointer(&(members[i][0])))
+		item_mbrs[i].data_len_ = C.uint64_t(len(members[i]))
+	}
+	prim_scrs := (*C.double)(CNULL)
+	prim_rets := (*C.int)(CNULL)
+
+	ret := C.fdb_zmscore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, C.size_t(len(members)), (*C.fdb_item_t)(unsafe.Pointer(&item_mbrs[0])), &prim_scrs, &prim_rets)
+
+	retscores := make([]float64, len(members))
+	retexists := make([]bool, len(members))
+	if int(ret) == 0 {
+		defer C.free_double_array(prim_scrs)
+		defer C.free_int_array(prim_rets)
+
+		var score float64
+		tmpInt := int(0)
+		for i := 0; i < len(members); i++ {
+			ConvertCIntPointer2Go(prim_rets, i, &tmpInt)
+			if tmpInt < 0 {
+				return nil, nil, &FdbError{retcode: tmpInt}
+			}
+			ConvertCDoublePointer2Go(prim_scrs, i, &score)
+			retscores[i] = score
+			retexists[i] = (tmpInt == 0)
+		}
+		return retscores, retexists, nil
+	} else if int(ret) > 0 {
+		return retscores, retexists, nil
+	}
+	return nil, nil, &FdbError{retcode: int(ret)}
+}
 func (slot *FdbSlot) ZRem(key []byte, members ...[]byte) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -862,11 +1126,101 @@ func (slot *FdbSlot) ZRemRangeByScore(key []byte, min float64, max float64, rang
 }
 
 func (slot *FdbSlot) ZRemRangeByLex(key []byte, min []byte, max []byte, rangeType uint8) (int64, error) {
-	return 0, nil
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_min, item_max C.fdb_item_t
+	fillScanItem(&item_min, min)
+	fillScanItem(&item_max, max)
+
+	cnt := C.int64_t(0)
+	ret := C.fdb_zrem_range_by_lex(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_min, &item_max, C.uint8_t(rangeType), &cnt)
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	} else if int(ret) > 0 {
+		return 0, nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
 }
 
 func (slot *FdbSlot) ZLexCount(key []byte, min []byte, max []byte, rangeType uint8) (int64, error) {
-	return 0, nil
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_min, item_max C.fdb_item_t
+	fillScanItem(&item_min, min)
+	fillScanItem(&item_max, max)
+
+	cnt := C.int64_t(0)
+	ret := C.fdb_zlexcount(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_min, &item_max, C.uint8_t(rangeType), &cnt)
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	} else if int(ret) > 0 {
+		return 0, nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
+}
+
+//members from start to end in member order, rangeType opening either bound as with scores and
+//0x04 and 0x08 leaving start and end unbounded, a negative count for all
+func (slot *FdbSlot) zrangeByLex(key []byte, start []byte, end []byte, rangeType uint8, reverse int, offset int64, count int64) ([][]byte, error) {
+	if offset < 0 {
+		return nil, nil
+	}
+	if count < 0 {
+		count = 0
+	} else if count == 0 {
+		return nil, nil
+	}
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_start, item_end C.fdb_item_t
+	fillScanItem(&item_start, start)
+	fillScanItem(&item_end, end)
+
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_zrange_by_lex(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_start, &item_end, C.uint8_t(rangeType), C.int(reverse), C.uint64_t(offset), C.uint64_t(count), &item_mbrs, &length)
+
+	if int(ret) == 0 {
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		var value FdbValue
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+		}
+		return retmembers, nil
+	} else if ret > 0 {
+		return nil, nil
+	}
+	return nil, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZRangeByLex(key []byte, min []byte, max []byte, rangeType uint8, offset int64, count int64) ([][]byte, error) {
+	return slot.zrangeByLex(key, min, max, rangeType, 0, offset, count)
+}
+
+func (slot *FdbSlot) ZRevRangeByLex(key []byte, max []byte, min []byte, rangeType uint8, offset int64, count int64) ([][]byte, error) {
+	return slot.zrangeByLex(key, max, min, rangeType, 1, offset, count)
 }
 
 func (slot *FdbSlot) zrangeByRank(key []byte, start int, stop int, reverse int, withscore bool) ([][]byte, []float64, error) {
@@ -919,7 +1273,17 @@ func (slot *FdbSlot) ZRevRange(key []byte, start int, stop int, withscore bool)
 	return slot.zrangeByRank(key, start, stop, 1, withscore)
 }
 
-func (slot *FdbSlot) ZRank(key []byte, member []byte) (int64, error) {
+//members scored from start to end, the engine stops after count of them past offset and hands
+//back a cursor to go on from, a negative count for all, a cursor given takes the place of offset
+func (slot *FdbSlot) zrangeByScore(key []byte, start float64, end float64, rangeType uint8, reverse int, offset int64, count int64, cursor []byte, withscore bool) ([][]byte, []float64, []byte, error) {
+	if offset < 0 {
+		return nil, nil, nil, nil
+	}
+	if count < 0 {
+		count = 0
+	} else if count == 0 {
+		return nil, nil, nil, nil
+	}
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
 	defer lock.release()
@@ -928,12 +1292,218 @@ func (slot *FdbSlot) ZRank(key []byte, member []byte) (int64, error) {
 	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
 	item_key.data_len_ = C.uint64_t(len(key))
 
-	var item_mbr C.fdb_item_t
-	item_mbr.data_ = (*C.char)(unsafe.Pointer(&member[0]))
-	item_mbr.data_len_ = C.uint64_t(len(member))
-
-	rank := C.int64_t(0)
-	ret := C.fdb_zrank(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_mbr, C.int(0), &rank)
+	var item_cursor C.fdb_item_t
+	fillScanItem(&item_cursor, cursor)
+
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	prim_scrs := (*C.double)(CNULL)
+	item_next := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_zrange_by_score(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, C.double(start), C.double(end), C.uint8_t(rangeType), C.int(reverse), C.uint64_t(offset), C.uint64_t(count), &item_cursor, &prim_scrs, &item_mbrs, &length, &item_next)
+
+	if int(ret) == 0 {
+		defer C.free_double_array(prim_scrs)
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		retscores := make([]float64, _length)
+		var value FdbValue
+		var score float64
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+
+			ConvertCDoublePointer2Go(prim_scrs, i, &score)
+			retscores[i] = score
+		}
+		if !withscore {
+			retscores = nil
+		}
+		return retmembers, retscores, convertScanCursor(item_next), nil
+	} else if ret > 0 {
+		return nil, nil, nil, nil
+	}
+	return nil, nil, nil, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZRangeByScore(key []byte, min float64, max float64, rangeType uint8, offset int64, count int64, cursor []byte, withscore bool) ([][]byte, []float64, []byte, error) {
+	return slot.zrangeByScore(key, min, max, rangeType, 0, offset, count, cursor, withscore)
+}
+
+func (slot *FdbSlot) ZRevRangeByScore(key []byte, max float64, min float64, rangeType uint8, offset int64, count int64, cursor []byte, withscore bool) ([][]byte, []float64, []byte, error) {
+	return slot.zrangeByScore(key, max, min, rangeType, 1, offset, count, cursor, withscore)
+}
+
+func (slot *FdbSlot) zPop(key []byte, max int, count int64) ([][]byte, []float64, error) {
+	if count <= 0 {
+		return nil, nil, nil
+	}
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	prim_scrs := (*C.double)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_zpop(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, C.int(max), C.uint64_t(count), &prim_scrs, &item_mbrs, &length)
+
+	if int(ret) == 0 {
+		defer C.free_double_array(prim_scrs)
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		retscores := make([]float64, _length)
+		var value FdbValue
+		var score float64
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+
+			ConvertCDoublePointer2Go(prim_scrs, i, &score)
+			retscores[i] = score
+		}
+		return retmembers, retscores, nil
+	} else if ret > 0 {
+		return nil, nil, nil
+	}
+	return nil, nil, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZPopMin(key []byte, count int64) ([][]byte, []float64, error) {
+	return slot.zPop(key, 0, count)
+}
+
+func (slot *FdbSlot) ZPopMax(key []byte, count int64) ([][]byte, []float64, error) {
+	return slot.zPop(key, 1, count)
+}
+
+//one pop under the key lock, or a wait parked on key while it is held, which is waited on with
+//the lock let go of, so that the zadd waking it can take the lock
+func (slot *FdbSlot) zPopPark(key []byte, max int) ([]byte, float64, unsafe.Pointer, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	item_mbr := (*C.fdb_item_t)(CNULL)
+	prim_scr := C.double(0)
+	wait := unsafe.Pointer(nil)
+	ret := C.fdb_zpop_park(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, C.int(max), &prim_scr, &item_mbr, &wait)
+
+	if int(ret) == 0 {
+		defer C.destroy_fdb_item_array(item_mbr, C.size_t(1))
+
+		var value FdbValue
+		ConvertCItemPointer2GoByte(item_mbr, 0, &value)
+		return value.Val, float64(prim_scr), nil, nil
+	} else if ret > 0 {
+		return nil, 0, wait, nil
+	}
+	return nil, 0, nil, &FdbError{retcode: int(ret)}
+}
+
+//popping again each time a zadd on key wakes the wait, another caller may have taken the member,
+//a timeout of 0 waits for good, nil member once timed out, an error once the db is closed
+func (slot *FdbSlot) bzPop(key []byte, max int, timeoutMs int64) ([]byte, float64, error) {
+	var deadline time.Time
+	if timeoutMs > 0 {
+		deadline = time.Now().Add(time.Duration(timeoutMs) * time.Millisecond)
+	}
+	for {
+		member, score, wait, err := slot.zPopPark(key, max)
+		if err != nil || wait == nil {
+			return member, score, err
+		}
+		left := int64(0)
+		if timeoutMs > 0 {
+			left = int64(deadline.Sub(time.Now()) / time.Millisecond)
+			if left <= 0 {
+				left = 1
+			}
+		}
+		ret := int(C.fdb_zpop_wait(slot.fdb.ctx, wait, C.uint64_t(left)))
+		if ret == 0 {
+			return nil, 0, nil
+		} else if ret < 0 {
+			return nil, 0, &FdbError{retcode: FDB_ERR}
+		}
+	}
+}
+
+func (slot *FdbSlot) BZPopMin(key []byte, timeoutMs int64) ([]byte, float64, error) {
+	return slot.bzPop(key, 0, timeoutMs)
+}
+
+func (slot *FdbSlot) BZPopMax(key []byte, timeoutMs int64) ([]byte, float64, error) {
+	return slot.bzPop(key, 1, timeoutMs)
+}
+
+func (slot *FdbSlot) ZScan(key []byte, cursor []byte, match []byte, count int64) ([][]byte, []float64, []byte, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_cursor, item_match C.fdb_item_t
+	fillScanItem(&item_cursor, cursor)
+	fillScanItem(&item_match, match)
+
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	prim_scrs := (*C.double)(CNULL)
+	item_next := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_zscan(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_cursor, &item_match, C.uint64_t(count), &prim_scrs, &item_mbrs, &length, &item_next)
+
+	if int(ret) == 0 {
+		defer C.free_double_array(prim_scrs)
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		retscores := make([]float64, _length)
+		var value FdbValue
+		var score float64
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+
+			ConvertCDoublePointer2Go(prim_scrs, i, &score)
+			retscores[i] = score
+		}
+		return retmembers, retscores, convertScanCursor(item_next), nil
+	} else if ret > 0 {
+		return nil, nil, nil, nil
+	}
+	return nil, nil, nil, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZRank(key []byte, member []byte) (int64, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_mbr C.fdb_item_t
+	item_mbr.data_ = (*C.char)(unsafe.Pointer(&member[0]))
+	item_mbr.data_len_ = C.uint64_t(len(member))
+
+	rank := C.int64_t(0)
+	ret := C.fdb_zrank(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_mbr, C.int(0), &rank)
 
 	if int(ret) == 0 {
 		return int64(rank), nil
@@ -1017,6 +1587,41 @@ func (slot *FdbSlot) SMembers(key []byte) ([][]byte, error) {
 	return nil, &FdbError{retcode: int(ret)}
 }
 
+func (slot *FdbSlot) SScan(key []byte, cursor []byte, match []byte, count int64) ([][]byte, []byte, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	var item_cursor, item_match C.fdb_item_t
+	fillScanItem(&item_cursor, cursor)
+	fillScanItem(&item_match, match)
+
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	item_next := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	ret := C.fdb_sscan(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, &item_cursor, &item_match, C.uint64_t(count), &item_mbrs, &length, &item_next)
+
+	if int(ret) == 0 {
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		var value FdbValue
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+		}
+		return retmembers, convertScanCursor(item_next), nil
+	} else if ret > 0 {
+		return nil, nil, nil
+	}
+	return nil, nil, &FdbError{retcode: int(ret)}
+}
+
 func (slot *FdbSlot) SIsMember(key []byte, member []byte) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -1041,6 +1646,40 @@ func (slot *FdbSlot) SIsMember(key []byte, member []byte) (int64, error) {
 
 }
 
+func (slot *FdbSlot) SMIsMember(key []byte, members ...[]byte) ([]int64, error) {
+	lock := slot.fetchKeysLock(string(key))
+	lock.acquire()
+	defer lock.release()
+
+	var item_key C.fdb_item_t
+	item_key.data_ = (*C.char)(unsafe.Pointer(&key[0]))
+	item_key.data_len_ = C.uint64_t(len(key))
+
+	item_mbrs := make([]C.fdb_item_t, len(members))
+	for i := 0; i < len(members); i++ {
+		item_mbrs[i].data_ = (*C.char)(unsafe.Pointer(&(members[i][0])))
+		item_mbrs[i].data_len_ = C.uint64_t(len(members[i]))
+	}
+	prim_rets := (*C.int)(CNULL)
+
+	ret := C.fdb_smismember(slot.fdb.ctx, C.uint64_t(slot.slot), &item_key, C.size_t(len(members)), (*C.fdb_item_t)(unsafe.Pointer(&item_mbrs[0])), &prim_rets)
+
+	retvalues := make([]int64, len(members))
+	if int(ret) == 0 {
+		defer C.free_int_array(prim_rets)
+
+		tmpInt := int(0)
+		for i := 0; i < len(members); i++ {
+			ConvertCIntPointer2Go(prim_rets, i, &tmpInt)
+			retvalues[i] = int64(tmpInt)
+		}
+		return retvalues, nil
+	} else if int(ret) > 0 {
+		return retvalues, nil
+	}
+	return nil, &FdbError{retcode: int(ret)}
+}
+
 func (slot *FdbSlot) SCard(key []byte) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -1115,6 +1754,184 @@ func (slot *FdbSlot) SAdd(key []byte, members ...[]byte) (int64, error) {
 	return 0, &FdbError{retcode: int(ret)}
 }
 
+const (
+	setInter = iota
+	setUnion
+	setDiff
+)
+
+//keys of a multi-key set command as items
+func setKeyItems(keys [][]byte) []C.fdb_item_t {
+	item_keys := make([]C.fdb_item_t, len(keys))
+	for i := 0; i < len(keys); i++ {
+		item_keys[i].data_ = (*C.char)(unsafe.Pointer(&(keys[i][0])))
+		item_keys[i].data_len_ = C.uint64_t(len(keys[i]))
+	}
+	return item_keys
+}
+
+func (slot *FdbSlot) sCombine(op int, keys [][]byte) ([][]byte, error) {
+	if len(keys) == 0 {
+		return nil, &FdbError{retcode: FDB_ERR_WRONG_NUMBER_ARGUMENTS}
+	}
+	lock := slot.fetchSlotLock()
+	lock.acquire()
+	defer lock.release()
+
+	item_keys := setKeyItems(keys)
+	item_mbrs := (*C.fdb_item_t)(CNULL)
+	length := C.int64_t(0)
+	var ret C.int
+	switch op {
+	case setInter:
+		ret = C.fdb_sinter(slot.fdb.ctx, C.uint64_t(slot.slot), C.size_t(len(keys)), &item_keys[0], &item_mbrs, &length)
+	case setUnion:
+		ret = C.fdb_sunion(slot.fdb.ctx, C.uint64_t(slot.slot), C.size_t(len(keys)), &item_keys[0], &item_mbrs, &length)
+	default:
+		ret = C.fdb_sdiff(slot.fdb.ctx, C.uint64_t(slot.slot), C.size_t(len(keys)), &item_keys[0], &item_mbrs, &length)
+	}
+
+	if int(ret) == 0 {
+		if item_mbrs == (*C.fdb_item_t)(CNULL) {
+			return nil, nil
+		}
+		defer C.destroy_fdb_item_array(item_mbrs, C.size_t(length))
+
+		_length := int(length)
+		retmembers := make([][]byte, _length)
+		var value FdbValue
+		for i := 0; i < _length; i++ {
+			ConvertCItemPointer2GoByte(item_mbrs, i, &value)
+			retmembers[i] = value.Val
+		}
+		return retmembers, nil
+	}
+	return nil, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) sCombineStore(op int, dest []byte, keys [][]byte) (int64, error) {
+	if len(keys) == 0 {
+		return 0, &FdbError{retcode: FDB_ERR_WRONG_NUMBER_ARGUMENTS}
+	}
+	lock := slot.fetchSlotLock()
+	lock.acquire()
+	defer lock.release()
+
+	var item_dest C.fdb_item_t
+	item_dest.data_ = (*C.char)(unsafe.Pointer(&dest[0]))
+	item_dest.data_len_ = C.uint64_t(len(dest))
+
+	item_keys := setKeyItems(keys)
+	cnt := C.int64_t(0)
+	var ret C.int
+	switch op {
+	case setInter:
+		ret = C.fdb_sinterstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], &cnt)
+	case setUnion:
+		ret = C.fdb_sunionstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], &cnt)
+	default:
+		ret = C.fdb_sdiffstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], &cnt)
+	}
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) SInter(keys ...[]byte) ([][]byte, error) {
+	return slot.sCombine(setInter, keys)
+}
+
+func (slot *FdbSlot) SUnion(keys ...[]byte) ([][]byte, error) {
+	return slot.sCombine(setUnion, keys)
+}
+
+func (slot *FdbSlot) SDiff(keys ...[]byte) ([][]byte, error) {
+	return slot.sCombine(setDiff, keys)
+}
+
+func (slot *FdbSlot) SInterStore(dest []byte, keys ...[]byte) (int64, error) {
+	return slot.sCombineStore(setInter, dest, keys)
+}
+
+func (slot *FdbSlot) SUnionStore(dest []byte, keys ...[]byte) (int64, error) {
+	return slot.sCombineStore(setUnion, dest, keys)
+}
+
+func (slot *FdbSlot) SDiffStore(dest []byte, keys ...[]byte) (int64, error) {
+	return slot.sCombineStore(setDiff, dest, keys)
+}
+
+func (slot *FdbSlot) SInterCard(limit int64, keys ...[]byte) (int64, error) {
+	if len(keys) == 0 {
+		return 0, &FdbError{retcode: FDB_ERR_WRONG_NUMBER_ARGUMENTS}
+	}
+	if limit < 0 {
+		limit = 0
+	}
+	lock := slot.fetchSlotLock()
+	lock.acquire()
+	defer lock.release()
+
+	item_keys := setKeyItems(keys)
+	cnt := C.int64_t(0)
+	ret := C.fdb_sintercard(slot.fdb.ctx, C.uint64_t(slot.slot), C.size_t(len(keys)), &item_keys[0], C.uint64_t(limit), &cnt)
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
+}
+
+//weights nil for all 1, or one for each of keys
+func (slot *FdbSlot) zCombineStore(op int, dest []byte, keys [][]byte, weights []float64, aggregate int) (int64, error) {
+	if len(keys) == 0 || (weights != nil && len(weights) != len(keys)) {
+		return 0, &FdbError{retcode: FDB_ERR_WRONG_NUMBER_ARGUMENTS}
+	}
+	lock := slot.fetchSlotLock()
+	lock.acquire()
+	defer lock.release()
+
+	var item_dest C.fdb_item_t
+	item_dest.data_ = (*C.char)(unsafe.Pointer(&dest[0]))
+	item_dest.data_len_ = C.uint64_t(len(dest))
+
+	item_keys := setKeyItems(keys)
+	c_weights := (*C.double)(CNULL)
+	if weights != nil {
+		_weights := make([]C.double, len(weights))
+		for i := 0; i < len(weights); i++ {
+			_weights[i] = C.double(weights[i])
+		}
+		c_weights = &_weights[0]
+	}
+	cnt := C.int64_t(0)
+	var ret C.int
+	switch op {
+	case setInter:
+		ret = C.fdb_zinterstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], c_weights, C.int(aggregate), &cnt)
+	case setUnion:
+		ret = C.fdb_zunionstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], c_weights, C.int(aggregate), &cnt)
+	default:
+		ret = C.fdb_zdiffstore(slot.fdb.ctx, C.uint64_t(slot.slot), &item_dest, C.size_t(len(keys)), &item_keys[0], &cnt)
+	}
+	if int(ret) == 0 {
+		return int64(cnt), nil
+	}
+	return 0, &FdbError{retcode: int(ret)}
+}
+
+func (slot *FdbSlot) ZUnionStore(dest []byte, keys [][]byte, weights []float64, aggregate int) (int64, error) {
+	return slot.zCombineStore(setUnion, dest, keys, weights, aggregate)
+}
+
+func (slot *FdbSlot) ZInterStore(dest []byte, keys [][]byte, weights []float64, aggregate int) (int64, error) {
+	return slot.zCombineStore(setInter, dest, keys, weights, aggregate)
+}
+
+func (slot *FdbSlot) ZDiffStore(dest []byte, keys ...[]byte) (int64, error) {
+	return slot.zCombineStore(setDiff, dest, keys, nil, AGGREGATE_SUM)
+}
+
 func (slot *FdbSlot) PExpireAt(key []byte, when int64) (int64, error) {
 	lock := slot.fetchKeysLock(string(key))
 	lock.acquire()
@@ -6,16 +6,23 @@
 
 
 fdb_val_node_t* fdb_val_node_create(){
-    fdb_val_node_t *node = (fdb_val_node_t*)fdb_malloc(sizeof(fdb_val_node_t));
+    return fdb_val_node_create_in(NULL);
+}
+
+fdb_val_node_t* fdb_val_node_create_in(fdb_arena_t* arena){
+    fdb_val_node_t *node = (fdb_val_node_t*)fdb_malloc_in(arena, sizeof(fdb_val_node_t));
     if(node == NULL ){
         return NULL;
     }
     memset(node, 0, sizeof(fdb_val_node_t));
+    node->arena_ = arena;
     return node;
 }
 
 void fdb_val_node_destroy(fdb_val_node_t* node){
-    fdb_free(node);
+    if(node != NULL){
+        fdb_free_in(node->arena_, node);
+    }
 }
 
 fdb_list_t* fdb_list_create(){
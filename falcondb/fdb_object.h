@@ -16,7 +16,11 @@ typedef struct fdb_iter_t               fdb_list_iter_t;
 typedef struct fdb_array_t              fdb_array_t;
 
 
+typedef struct fdb_arena_t              fdb_arena_t;
+
 fdb_val_node_t* fdb_val_node_create();
+//living in arena, NULL for the heap
+fdb_val_node_t* fdb_val_node_create_in(fdb_arena_t* arena);
 void fdb_val_node_destroy(fdb_val_node_t* node);
 
 fdb_list_t* fdb_list_create();
@@ -120,27 +120,31 @@ void fdb_drop_slot(fdb_context_t* context, uint64_t id){
     fdb_context_create_slot(context, slot);
 }
 
-
-
-//keys
-fdb_keys_t* create_fdb_keys(fdb_context_t* context, uint64_t id, uint64_t limit){
+int fdb_drop_slot_profile(fdb_context_t* context, uint64_t id, int profile){
     fdb_slot_t *slot = get_slot(context, id);
-    fdb_iterator_t *self_iter = NULL;
-    if(keys_self_traversal_create(context, slot,  &self_iter, limit)==0){
-        fdb_keys_t *keys = (fdb_keys_t*)fdb_malloc(sizeof(fdb_keys_t));
-        keys->self_iter_ = self_iter;
-        return keys;
+    if(profile < 0 || profile >= FDB_PROFILE_NUM){
+        return FDB_ERR;
     }
-    return NULL;
+    fdb_context_drop_slot(context, slot);
+    return fdb_context_create_slot_profile(context, slot, profile);
 }
 
-void destroy_fdb_keys(fdb_keys_t* keys){
-    if(keys->self_iter_!=NULL){
-        keys_self_traversal_destroy((fdb_iterator_t*)(keys->self_iter_));
-    }
-    fdb_free(keys);
+int fdb_set_durability(fdb_context_t* context, uint64_t id, int durability, uint64_t sync_ms, uint64_t sync_bytes){
+    fdb_slot_t *slot = get_slot(context, id);
+    return fdb_context_set_durability(context, slot, durability, sync_ms, sync_bytes);
 }
 
+int fdb_sync(fdb_context_t* context){
+    return fdb_context_sync(context);
+}
+
+void fdb_sync_stats(fdb_context_t* context, uint64_t* syncs, uint64_t* unsynced_bytes){
+    fdb_context_sync_stats(context, syncs, unsynced_bytes);
+}
+
+
+
+//keys
 void clean_fdb_expired_key(fdb_context_t* context, uint64_t id, fdb_item_t* key, int64_t* count){
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
@@ -154,26 +158,95 @@ void clean_fdb_expired_key(fdb_context_t* context, uint64_t id, fdb_item_t* key,
 }
 
 
-void iterate_fdb_expired_keys(fdb_keys_t* keys, uint64_t max, fdb_item_t** pks, int64_t* length){
-    fdb_array_t *array = NULL;
-    int ret = keys_self_traversal_work((fdb_iterator_t*)(keys->self_iter_), &array, max);
-    if(ret > 0){
-        *length = array->length_;
-        fdb_item_t *_items = create_fdb_item_array(*length);
-        for(size_t i=0; i<(*length); ++i){ 
-            fdb_val_node_t *n_item = fdb_array_at(array, i);
-            if(n_item->retval_==FDB_OK){
-                decode_slice_value(&_items[i], (fdb_slice_t*)(n_item->val_.vval_), n_item->retval_);        
-                fdb_slice_destroy(n_item->val_.vval_);
-            }else{
-                decode_slice_value(&_items[i], (fdb_slice_t*)NULL, n_item->retval_);        
-            }
-        } 
-    }else{
-        *length = 0;
+//scans
+static uint64_t scan_count(uint64_t count){
+    if(count == 0){
+        return FDB_SCAN_COUNT;
     }
+    return (count > FDB_SCAN_COUNT_MAX) ? FDB_SCAN_COUNT_MAX : count;
 }
+
+static void fill_scan_cursor(fdb_slice_t* next, fdb_item_t** pcursor){
+    if(next == NULL){
+        *pcursor = NULL;
+        return;
+    }
+    *pcursor = create_fdb_item_array(1);
+    decode_slice_value(*pcursor, next, FDB_OK);
+    fdb_slice_destroy(next);
+}
+
+//the slice nodes of a scan chunk as items
+static void fill_scan_items(fdb_array_t* array, fdb_item_t** pitems, int64_t* length){
+    *length = array->length_;
+    if(array->length_ == 0){
+        *pitems = NULL;
+        return;
+    }
+    fdb_item_t *_items = create_fdb_item_array(array->length_);
+    for(size_t i=0; i<array->length_; ++i){
+        fdb_val_node_t *n_item = fdb_array_at(array, i);
+        decode_slice_value(&_items[i], (fdb_slice_t*)(n_item->val_.vval_), FDB_OK);
+        fdb_slice_destroy(n_item->val_.vval_);
+    }
+    *pitems = _items;
+}
+
+int fdb_scan(fdb_context_t* context,
+             uint64_t id,
+             fdb_item_t* cursor,
+             fdb_item_t* pattern,
+             uint64_t count,
+             fdb_item_t** pkeys,
+             int64_t* length,
+             fdb_item_t** pcursor){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_cursor = fdb_slice_create(cursor->data_, cursor->data_len_);
+    fdb_slice_t *slice_pattern = fdb_slice_create(pattern->data_, pattern->data_len_);
+    fdb_array_t *keys_array = NULL;
+    fdb_slice_t *next = NULL;
+
+    int retval = keys_scan(context, slot, slice_cursor, slice_pattern, scan_count(count), &keys_array, &next);
+    if(retval == FDB_OK){
+        fill_scan_items(keys_array, pkeys, length);
+        fill_scan_cursor(next, pcursor);
+    }
+    fdb_slice_destroy(slice_cursor);
+    fdb_slice_destroy(slice_pattern);
+    fdb_array_destroy(keys_array);
+    fdb_arena_leave();
+    return retval;
+}
+
 //dels
+void fdb_dels_stats(fdb_context_t* context, uint64_t id, uint64_t* markers, uint64_t* subkeys, uint64_t* bytes){
+    fdb_slot_t *slot = get_slot(context, id);
+    *markers = __sync_add_and_fetch(&slot->dels_markers_, 0);
+    *subkeys = __sync_add_and_fetch(&slot->dels_subkeys_, 0);
+    *bytes = __sync_add_and_fetch(&slot->dels_bytes_, 0);
+}
+
+//keys cache
+void fdb_set_keys_cache_size(fdb_context_t* context, size_t size){
+    fdb_context_set_keys_cache_size(context, size);
+}
+
+void fdb_keys_cache_stats(fdb_context_t* context, uint64_t id, uint64_t* hits, uint64_t* misses, uint64_t* evictions){
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_context_keys_cache_stats(context, slot, hits, misses, evictions);
+}
+
+void fdb_keys_absent_stats(fdb_context_t* context, uint64_t id, uint64_t* hits, uint64_t* fills){
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_context_keys_absent_stats(context, slot, hits, fills);
+}
+
+//group commit
+void fdb_commit_stats(fdb_context_t* context, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                      uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max){
+    fdb_context_commit_stats(context, groups, batches, bytes, latency_us, depth, depth_max);
+}
 
 
 //cmds
@@ -183,6 +256,7 @@ int fdb_set(fdb_context_t* context,
             fdb_item_t* val,
             int64_t duration, 
             int en, int* ef){  
+    fdb_arena_enter();
     int retval = 0;
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key, *slice_val;
@@ -199,38 +273,27 @@ int fdb_set(fdb_context_t* context,
     } else if(en == IS_EXIST){
         retval = string_set(context, slot, slice_key, slice_val);
     } else if(en == IS_EXIST_AND_EXPIRE){
-        retval = string_set(context, slot, slice_key, slice_val);
+        int64_t ts = time_ms() + duration*1000;
+        retval = string_setex(context, slot, slice_key, slice_val, ts);
         if(retval == FDB_OK){
-            fdb_slice_t *expiring_key = fdb_slice_create(key->data_, key->data_len_);
-            int64_t ts = time_ms() + duration*1000;
-            int64_t _count = 0;
-            retval = keys_pexpire_at(context, slot, expiring_key, ts, &_count);
-            if(retval == FDB_OK){
-                *ef = _count;
-            }else{
-                *ef = 0;
-            }
-            fdb_slice_destroy(expiring_key);
+            *ef = 1;
+        }else{
+            *ef = 0;
         }
     } else if(en == IS_NOT_EXIST_AND_EXPIRE){
-        retval = string_setnx(context, slot, slice_key, slice_val);
+        int64_t ts = time_ms() + duration*1000;
+        retval = string_setnxex(context, slot, slice_key, slice_val, ts);
         if(retval == FDB_OK){
-            fdb_slice_t *expiring_key = fdb_slice_create(key->data_, key->data_len_);
-            int64_t ts = time_ms() + duration*1000;
-            int64_t _count = 0;
-            retval = keys_pexpire_at(context, slot, expiring_key, ts, &_count);
-            if(retval == FDB_OK){
-                *ef = _count;
-            }else{
-                *ef = 0;
-            }
-            fdb_slice_destroy(expiring_key);
+            *ef = 1;
+        }else{
+            *ef = 0;
         }
     }
 
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_val);
 
+    fdb_arena_leave();
     return retval;
 }
 
@@ -240,16 +303,17 @@ int fdb_mset(fdb_context_t* context,
              fdb_item_t* kvs,
              int** rets,
              int en){
+    fdb_arena_enter();
     int retval = 0;
     fdb_slot_t *slot = get_slot(context, id);
     fdb_array_t *kvs_array = fdb_array_create(16);
     for(size_t i=0; i<length; ){
-        fdb_val_node_t *n_key = fdb_val_node_create();
+        fdb_val_node_t *n_key = fdb_val_node_create_in(fdb_arena_current());
         n_key->val_.vval_ = fdb_slice_create(kvs[i].data_, kvs[i].data_len_);
         fdb_array_push_back(kvs_array, n_key);
         ++i;
 
-        fdb_val_node_t *n_val = fdb_val_node_create();
+        fdb_val_node_t *n_val = fdb_val_node_create_in(fdb_arena_current());
         n_val->val_.vval_ = fdb_slice_create(kvs[i].data_, kvs[i].data_len_);
         fdb_array_push_back(kvs_array, n_val);
         ++i;
@@ -280,6 +344,7 @@ int fdb_mset(fdb_context_t* context,
 
     fdb_array_destroy(rets_array);
     fdb_array_destroy(kvs_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -288,6 +353,7 @@ int fdb_get(fdb_context_t* context,
             uint64_t id,
             fdb_item_t* key,
             fdb_item_t** pval){  
+    fdb_arena_enter();
     int retval = 0;
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key, *slice_val = NULL;
@@ -303,6 +369,7 @@ int fdb_get(fdb_context_t* context,
 end:
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_val);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -311,11 +378,12 @@ int fdb_mget(fdb_context_t* context,
              size_t length,
              fdb_item_t* keys,
              fdb_item_t** pvals){
+    fdb_arena_enter();
     int retval = 0;
     fdb_slot_t *slot = get_slot(context, id);
     fdb_array_t *keys_array = fdb_array_create(16);
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_key = fdb_val_node_create();
+        fdb_val_node_t *n_key = fdb_val_node_create_in(fdb_arena_current());
         n_key->val_.vval_ = fdb_slice_create(keys[i].data_, keys[i].data_len_);
         fdb_array_push_back(keys_array, n_key);
     }
@@ -342,6 +410,7 @@ int fdb_mget(fdb_context_t* context,
 
     fdb_array_destroy(keys_array);
     fdb_array_destroy(rets_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -350,6 +419,7 @@ int fdb_del(fdb_context_t* context,
             uint64_t id,
             fdb_item_t* key,
             int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     int64_t _count = 0;
@@ -358,6 +428,7 @@ int fdb_del(fdb_context_t* context,
         *count = _count; 
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -367,12 +438,14 @@ int fdb_incrby(fdb_context_t* context,
                int64_t init,
                int64_t by,
                int64_t *result){
+    fdb_arena_enter();
     int retval = 0;
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     retval = string_incr(context, slot, slice_key, init, by, result);
 
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval; 
 }
 
@@ -383,6 +456,7 @@ int fdb_hset(fdb_context_t* context,
         fdb_item_t* fld,
         fdb_item_t* val,
         int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_fld = fdb_slice_create(fld->data_, fld->data_len_);
@@ -397,6 +471,7 @@ int fdb_hset(fdb_context_t* context,
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_val);
     fdb_slice_destroy(slice_fld);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -406,6 +481,7 @@ int fdb_hsetnx(fdb_context_t* context,
                fdb_item_t* fld,
                fdb_item_t* val,
                int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_fld = fdb_slice_create(fld->data_, fld->data_len_);
@@ -420,6 +496,7 @@ int fdb_hsetnx(fdb_context_t* context,
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_val);
     fdb_slice_destroy(slice_fld);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -429,6 +506,7 @@ int fdb_hget(fdb_context_t* context,
         fdb_item_t* key,
         fdb_item_t* fld,
         fdb_item_t** pval){ 
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_fld = fdb_slice_create(fld->data_, fld->data_len_);
@@ -446,6 +524,7 @@ end:
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_fld);
     fdb_slice_destroy(slice_val);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -455,11 +534,12 @@ int fdb_hmget(fdb_context_t* context,
               size_t length,
               fdb_item_t* flds,
               fdb_item_t** pvals){              
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *flds_array = fdb_array_create(8), *rets_array = NULL;
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_fld = fdb_val_node_create();
+        fdb_val_node_t *n_fld = fdb_val_node_create_in(fdb_arena_current());
         n_fld->val_.vval_ = fdb_slice_create(flds[i].data_, flds[i].data_len_);
         fdb_array_push_back(flds_array, n_fld);
     }
@@ -486,6 +566,7 @@ int fdb_hmget(fdb_context_t* context,
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(flds_array);
     fdb_array_destroy(rets_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -495,11 +576,12 @@ int fdb_hdel(fdb_context_t* context,
              size_t length,
              fdb_item_t* flds,
              int64_t *count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *flds_array = fdb_array_create(8);
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_field = fdb_val_node_create();
+        fdb_val_node_t *n_field = fdb_val_node_create_in(fdb_arena_current());
         n_field->val_.vval_ = fdb_slice_create(flds[i].data_, flds[i].data_len_);
         fdb_array_push_back(flds_array, n_field);
     }
@@ -514,6 +596,7 @@ int fdb_hdel(fdb_context_t* context,
     }
     fdb_array_destroy(flds_array);
 
+    fdb_arena_leave();
     return retval;
 }
 
@@ -521,6 +604,7 @@ int fdb_hlen(fdb_context_t* context,
              uint64_t id,
              fdb_item_t* key,
              int64_t *length){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -529,6 +613,7 @@ int fdb_hlen(fdb_context_t* context,
     if(retval == FDB_OK){
         *length = _length;
     }
+    fdb_arena_leave();
     return retval;
 }
 
@@ -539,6 +624,7 @@ int fdb_hincrby(fdb_context_t* context,
                 fdb_item_t* fld,
                 int64_t by,
                 int64_t* result){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_fld = fdb_slice_create(fld->data_, fld->data_len_);
@@ -551,6 +637,7 @@ int fdb_hincrby(fdb_context_t* context,
     
     fdb_slice_destroy(slice_key); 
     fdb_slice_destroy(slice_fld);
+    fdb_arena_leave();
     return retval; 
 }
 
@@ -559,6 +646,7 @@ int fdb_hexists(fdb_context_t* context,
                 fdb_item_t* key,
                 fdb_item_t* fld,
                 int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_fld = fdb_slice_create(fld->data_, fld->data_len_);
@@ -571,6 +659,7 @@ int fdb_hexists(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_fld);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -580,11 +669,12 @@ int fdb_hmset(fdb_context_t* context,
               size_t length,
               fdb_item_t* fvs,
               int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *fvs_array = fdb_array_create(8);
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *node = fdb_val_node_create();
+        fdb_val_node_t *node = fdb_val_node_create_in(fdb_arena_current());
         node->val_.vval_ = fdb_slice_create(fvs[i].data_, fvs[i].data_len_);
         fdb_array_push_back(fvs_array, node);
     }
@@ -599,6 +689,7 @@ int fdb_hmset(fdb_context_t* context,
     }
     fdb_array_destroy(fvs_array);
     fdb_slice_destroy(slice_key); 
+    fdb_arena_leave();
     return retval; 
 }
 
@@ -607,6 +698,7 @@ int fdb_hgetall(fdb_context_t* context,
                 fdb_item_t* key,
                 fdb_item_t** pfvs,
                 int64_t* length){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *rets_array = NULL;
@@ -637,44 +729,132 @@ int fdb_hgetall(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(rets_array);
+    fdb_arena_leave();
     return retval;
 }
 
-int fdb_zadd(fdb_context_t* context,
-             uint64_t id,
-             fdb_item_t* key,
-             size_t length,
-             double* scores,
-             fdb_item_t* members,
-             int64_t* count){
-                 
+int fdb_hscan(fdb_context_t* context,
+              uint64_t id,
+              fdb_item_t* key,
+              fdb_item_t* cursor,
+              fdb_item_t* pattern,
+              uint64_t count,
+              fdb_item_t** pfvs,
+              int64_t* length,
+              fdb_item_t** pcursor){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_cursor = fdb_slice_create(cursor->data_, cursor->data_len_);
+    fdb_slice_t *slice_pattern = fdb_slice_create(pattern->data_, pattern->data_len_);
+    fdb_array_t *rets_array = NULL;
+    fdb_slice_t *next = NULL;
+
+    int retval = hash_hscan(context, slot, slice_key, slice_cursor, slice_pattern, scan_count(count), &rets_array, &next);
+    if(retval == FDB_OK){
+        fill_scan_items(rets_array, pfvs, length);
+        fill_scan_cursor(next, pcursor);
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_cursor);
+    fdb_slice_destroy(slice_pattern);
+    fdb_array_destroy(rets_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+//score and member nodes of a zadd, the members destroyed by destroy_zadd_array
+static fdb_array_t* create_zadd_array(size_t length, double* scores, fdb_item_t* members){
     fdb_array_t *sms_array = fdb_array_create(8);
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_score = fdb_val_node_create();
+        fdb_val_node_t *n_score = fdb_val_node_create_in(fdb_arena_current());
         n_score->val_.dval_ = scores[i];
         fdb_array_push_back(sms_array, n_score);
 
-        fdb_val_node_t *n_member = fdb_val_node_create();
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
         n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
         fdb_array_push_back(sms_array, n_member);
     }
+    return sms_array;
+}
+
+static void destroy_zadd_array(fdb_array_t* sms_array){
+    for(size_t ind=1; ind<sms_array->length_; ind+=2){
+        fdb_val_node_t *n_member = fdb_array_at(sms_array, ind);
+        fdb_slice_destroy(n_member->val_.vval_);
+    }
+    fdb_array_destroy(sms_array);
+}
+
+int fdb_zadd(fdb_context_t* context,
+             uint64_t id,
+             fdb_item_t* key,
+             size_t length,
+             double* scores,
+             fdb_item_t* members,
+             int64_t* count){
+    fdb_arena_enter();
+                 
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *sms_array = create_zadd_array(length, scores, members);
     int64_t _count = 0;
     int retval = zset_add(context, slot, slice_key, sms_array, &_count);
     if(retval == FDB_OK){
         *count = _count; 
     }
-    size_t ind = 0;
-    for(int i=0; i<length; ++i){ 
-        //skip score
-        ++ind;
-        fdb_val_node_t *n_member = fdb_array_at(sms_array, ind);
-        fdb_slice_destroy(n_member->val_.vval_);
-        ++ind; 
+    fdb_slice_destroy(slice_key);
+    destroy_zadd_array(sms_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zadd_capped(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* key,
+                    size_t length,
+                    double* scores,
+                    fdb_item_t* members,
+                    uint64_t cap,
+                    int trim_max,
+                    int64_t* count,
+                    int64_t* trimmed){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *sms_array = create_zadd_array(length, scores, members);
+    int64_t _count = 0, _trimmed = 0;
+    int retval = zset_add_capped(context, slot, slice_key, sms_array, cap, trim_max, &_count, &_trimmed);
+    if(retval == FDB_OK){
+        *count = _count;
+        *trimmed = _trimmed;
     }
     fdb_slice_destroy(slice_key);
-    fdb_array_destroy(sms_array);
+    destroy_zadd_array(sms_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zwindow_add(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* key,
+                    fdb_item_t* member,
+                    double now,
+                    double window,
+                    int64_t ttl,
+                    int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_member = fdb_slice_create(member->data_, member->data_len_);
+    int64_t _count = 0;
+    int retval = zset_window_add(context, slot, slice_key, slice_member, now, window, ttl, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_member);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -684,12 +864,13 @@ int fdb_zrem(fdb_context_t* context,
              size_t length,
              fdb_item_t* members,
              int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *mbr_array = fdb_array_create(8);
 
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_member = fdb_val_node_create();
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
         n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
         fdb_array_push_back(mbr_array, n_member); 
     }
@@ -704,6 +885,7 @@ int fdb_zrem(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -711,6 +893,7 @@ int fdb_zcard(fdb_context_t* context,
               uint64_t id,
               fdb_item_t* key,
               int64_t* size){ 
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -720,6 +903,7 @@ int fdb_zcard(fdb_context_t* context,
         *size = _size;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -728,6 +912,7 @@ int fdb_zscore(fdb_context_t* context,
                fdb_item_t* key,
                fdb_item_t* mbr,
                double* score){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_mbr = fdb_slice_create(mbr->data_, mbr->data_len_);
@@ -739,6 +924,46 @@ int fdb_zscore(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_mbr);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zmscore(fdb_context_t* context,
+                uint64_t id,
+                fdb_item_t* key,
+                size_t length,
+                fdb_item_t* members,
+                double** pscores,
+                int** prets){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *mbr_array = fdb_array_create(8), *rets_array = NULL;
+    for(size_t i=0; i<length; ++i){
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
+        n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
+        fdb_array_push_back(mbr_array, n_member); 
+    }
+    int retval = zset_mscore(context, slot, slice_key, mbr_array, &rets_array);
+    if(retval == FDB_OK){
+        double *scores_ = create_double_array(length);
+        int *rets_ = create_int_array(length);
+        for(size_t i=0; i<length; ++i){
+            fdb_val_node_t *n_ret = fdb_array_at(rets_array, i);
+            scores_[i] = (n_ret->retval_ == FDB_OK) ? n_ret->val_.dval_ : 0.0;
+            rets_[i] = n_ret->retval_;
+        }
+        *pscores = scores_;
+        *prets = rets_;
+    }
+    for(size_t i=0; i<length; ++i){
+        fdb_val_node_t *n_member = fdb_array_at(mbr_array, i);
+        fdb_slice_destroy(n_member->val_.vval_); 
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_array_destroy(mbr_array);
+    fdb_array_destroy(rets_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -749,6 +974,7 @@ int fdb_zcount(fdb_context_t* context,
                double end,
                uint8_t type,
                int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     
@@ -758,6 +984,7 @@ int fdb_zcount(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key); 
+    fdb_arena_leave();
     return retval;
 }
 
@@ -768,6 +995,7 @@ int fdb_zrem_range_by_rank(fdb_context_t* context,
                            int start,
                            int end,
                            int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     
@@ -777,6 +1005,7 @@ int fdb_zrem_range_by_rank(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -787,6 +1016,7 @@ int fdb_zrem_range_by_score(fdb_context_t* context,
                             double end,
                             uint8_t type,
                             int64_t *count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -796,6 +1026,97 @@ int fdb_zrem_range_by_score(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zlexcount(fdb_context_t* context,
+                  uint64_t id,
+                  fdb_item_t* key,
+                  fdb_item_t* start,
+                  fdb_item_t* end,
+                  uint8_t type,
+                  int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_start = fdb_slice_create(start->data_, start->data_len_);
+    fdb_slice_t *slice_end = fdb_slice_create(end->data_, end->data_len_);
+
+    int64_t _count = 0;
+    int retval = zset_lex_count(context, slot, slice_key, slice_start, slice_end, type, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_start);
+    fdb_slice_destroy(slice_end);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zrem_range_by_lex(fdb_context_t* context,
+                          uint64_t id,
+                          fdb_item_t* key,
+                          fdb_item_t* start,
+                          fdb_item_t* end,
+                          uint8_t type,
+                          int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_start = fdb_slice_create(start->data_, start->data_len_);
+    fdb_slice_t *slice_end = fdb_slice_create(end->data_, end->data_len_);
+
+    int64_t _count = 0;
+    int retval = zset_rem_range_by_lex(context, slot, slice_key, slice_start, slice_end, type, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_start);
+    fdb_slice_destroy(slice_end);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zrange_by_lex(fdb_context_t* context,
+                      uint64_t id,
+                      fdb_item_t* key,
+                      fdb_item_t* start,
+                      fdb_item_t* end,
+                      uint8_t type,
+                      int reverse,
+                      uint64_t offset,
+                      uint64_t count,
+                      fdb_item_t** pmembers,
+                      int64_t* length){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_start = fdb_slice_create(start->data_, start->data_len_);
+    fdb_slice_t *slice_end = fdb_slice_create(end->data_, end->data_len_);
+    fdb_array_t *sms_array = NULL;
+
+    *length = 0;
+    *pmembers = NULL;
+    int retval = zset_range_by_lex(context, slot, slice_key, slice_start, slice_end, type, reverse, offset, count, &sms_array);
+    if(retval == FDB_OK){
+        size_t len = sms_array->length_ /2;
+        *length = len;
+        fdb_item_t *_members = create_fdb_item_array(len);
+        for(size_t i=0; i<len; ++i){
+            fdb_val_node_t *n_member = fdb_array_at(sms_array, 2*i + 1);
+            decode_slice_value(&_members[i], (fdb_slice_t*)(n_member->val_.vval_), FDB_OK);
+            fdb_slice_destroy(n_member->val_.vval_);
+        }
+        *pmembers = _members;
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_start);
+    fdb_slice_destroy(slice_end);
+    fdb_array_destroy(sms_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -808,6 +1129,7 @@ int fdb_zrange(fdb_context_t* context,
                double** pscores,
                fdb_item_t** pmembers,
                int64_t* length){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *sms_array = NULL;
@@ -833,6 +1155,180 @@ int fdb_zrange(fdb_context_t* context,
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(sms_array);
 
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zrange_by_score(fdb_context_t* context,
+                        uint64_t id,
+                        fdb_item_t* key,
+                        double start,
+                        double end,
+                        uint8_t type,
+                        int reverse,
+                        uint64_t offset,
+                        uint64_t count,
+                        fdb_item_t* cursor,
+                        double** pscores,
+                        fdb_item_t** pmembers,
+                        int64_t* length,
+                        fdb_item_t** pcursor){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_cursor = fdb_slice_create(cursor->data_, cursor->data_len_);
+    fdb_array_t *sms_array = NULL;
+    fdb_slice_t *next = NULL;
+
+    *length = 0;
+    *pscores = NULL;
+    *pmembers = NULL;
+    *pcursor = NULL;
+    int retval = zset_range_by_score(context, slot, slice_key, start, end, type, reverse, offset, count,
+                                     slice_cursor, &sms_array, &next);
+    if(retval == FDB_OK){
+        size_t len = sms_array->length_ /2;
+        *length = len;
+        double *_scores = (double*)create_double_array(len);
+        fdb_item_t *_members = create_fdb_item_array(len);
+        for(size_t ind=0, i=0; i<len; ++i){
+            fdb_val_node_t *n_score = fdb_array_at(sms_array, ind++);
+            _scores[i] = n_score->val_.dval_;
+
+            fdb_val_node_t *n_member = fdb_array_at(sms_array, ind++);
+            decode_slice_value(&_members[i], (fdb_slice_t*)(n_member->val_.vval_), FDB_OK);
+            fdb_slice_destroy(n_member->val_.vval_);
+        }
+        *pscores = _scores;
+        *pmembers = _members;
+        fill_scan_cursor(next, pcursor);
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_cursor);
+    fdb_array_destroy(sms_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zpop(fdb_context_t* context,
+             uint64_t id,
+             fdb_item_t* key,
+             int max,
+             uint64_t count,
+             double** pscores,
+             fdb_item_t** pmembers,
+             int64_t* length){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *sms_array = NULL;
+
+    *length = 0;
+    *pscores = NULL;
+    *pmembers = NULL;
+    int retval = zset_pop(context, slot, slice_key, max, count, &sms_array);
+    if(retval == FDB_OK && sms_array->length_ > 0){
+        size_t len = sms_array->length_ /2;
+        *length = len;
+        double *_scores = (double*)create_double_array(len);
+        fdb_item_t *_members = create_fdb_item_array(len);
+        for(size_t ind=0, i=0; i<len; ++i){
+            fdb_val_node_t *n_score = fdb_array_at(sms_array, ind++);
+            _scores[i] = n_score->val_.dval_;
+
+            fdb_val_node_t *n_member = fdb_array_at(sms_array, ind++);
+            decode_slice_value(&_members[i], (fdb_slice_t*)(n_member->val_.vval_), FDB_OK);
+            fdb_slice_destroy(n_member->val_.vval_);
+        }
+        *pscores = _scores;
+        *pmembers = _members;
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_array_destroy(sms_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zpop_park(fdb_context_t* context,
+                  uint64_t id,
+                  fdb_item_t* key,
+                  int max,
+                  double* score,
+                  fdb_item_t** pmember,
+                  void** pwait){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *sms_array = NULL;
+    fdb_wait_t *wait = NULL;
+
+    *pmember = NULL;
+    int retval = zset_pop_park(context, slot, slice_key, max, &sms_array, &wait);
+    if(retval == FDB_OK){
+        *score = fdb_array_at(sms_array, 0)->val_.dval_;
+        fdb_val_node_t *n_member = fdb_array_at(sms_array, 1);
+        *pmember = create_fdb_item_array(1);
+        decode_slice_value(*pmember, (fdb_slice_t*)(n_member->val_.vval_), FDB_OK);
+        fdb_slice_destroy(n_member->val_.vval_);
+    }
+    *pwait = wait;
+    fdb_slice_destroy(slice_key);
+    fdb_array_destroy(sms_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zpop_wait(fdb_context_t* context,
+                  void* wait,
+                  uint64_t timeout_ms){
+    return fdb_waiter_wait((fdb_waiter_t*)context->waiter_, (fdb_wait_t*)wait, timeout_ms);
+}
+
+int fdb_zscan(fdb_context_t* context,
+              uint64_t id,
+              fdb_item_t* key,
+              fdb_item_t* cursor,
+              fdb_item_t* pattern,
+              uint64_t count,
+              double** pscores,
+              fdb_item_t** pmembers,
+              int64_t* length,
+              fdb_item_t** pcursor){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_cursor = fdb_slice_create(cursor->data_, cursor->data_len_);
+    fdb_slice_t *slice_pattern = fdb_slice_create(pattern->data_, pattern->data_len_);
+    fdb_array_t *sms_array = NULL;
+    fdb_slice_t *next = NULL;
+
+    int retval = zset_zscan(context, slot, slice_key, slice_cursor, slice_pattern, scan_count(count), &sms_array, &next);
+    if(retval == FDB_OK){
+        size_t len = sms_array->length_ /2;
+        *length = len;
+        *pscores = NULL;
+        *pmembers = NULL;
+        if(len > 0){
+            double *_scores = (double*)create_double_array(len);
+            fdb_item_t *_members = create_fdb_item_array(len);
+            for(size_t ind=0, i=0; i<len; ++i){
+                fdb_val_node_t *n_score = fdb_array_at(sms_array, ind++);
+                _scores[i] = n_score->val_.dval_;
+
+                fdb_val_node_t *n_member = fdb_array_at(sms_array, ind++);
+                decode_slice_value(&_members[i], (fdb_slice_t*)(n_member->val_.vval_), FDB_OK);
+                fdb_slice_destroy(n_member->val_.vval_);
+            }
+            *pscores = _scores;
+            *pmembers = _members;
+        }
+        fill_scan_cursor(next, pcursor);
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_cursor);
+    fdb_slice_destroy(slice_pattern);
+    fdb_array_destroy(sms_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -842,6 +1338,7 @@ int fdb_zrank(fdb_context_t* context,
               fdb_item_t* mbr,
               int reverse,
               int64_t* rank){ 
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_mbr = fdb_slice_create(mbr->data_, mbr->data_len_);
@@ -854,6 +1351,7 @@ int fdb_zrank(fdb_context_t* context,
 
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_mbr);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -863,6 +1361,7 @@ int fdb_zincrby(fdb_context_t* context,
                 fdb_item_t* mbr,
                 double by,
                 double* result){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_mbr = fdb_slice_create(mbr->data_, mbr->data_len_);
@@ -874,6 +1373,7 @@ int fdb_zincrby(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_mbr);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -882,6 +1382,7 @@ int fdb_smembers(fdb_context_t* context,
                  fdb_item_t* key,
                  fdb_item_t** pmembers,
                  int64_t* length){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
  
@@ -904,6 +1405,37 @@ int fdb_smembers(fdb_context_t* context,
 
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_sscan(fdb_context_t* context,
+              uint64_t id,
+              fdb_item_t* key,
+              fdb_item_t* cursor,
+              fdb_item_t* pattern,
+              uint64_t count,
+              fdb_item_t** pmembers,
+              int64_t* length,
+              fdb_item_t** pcursor){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_slice_t *slice_cursor = fdb_slice_create(cursor->data_, cursor->data_len_);
+    fdb_slice_t *slice_pattern = fdb_slice_create(pattern->data_, pattern->data_len_);
+    fdb_array_t *mbr_array = NULL;
+    fdb_slice_t *next = NULL;
+
+    int retval = set_sscan(context, slot, slice_key, slice_cursor, slice_pattern, scan_count(count), &mbr_array, &next);
+    if(retval == FDB_OK){
+        fill_scan_items(mbr_array, pmembers, length);
+        fill_scan_cursor(next, pcursor);
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_cursor);
+    fdb_slice_destroy(slice_pattern);
+    fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -912,6 +1444,7 @@ int fdb_sismember(fdb_context_t* context,
                   fdb_item_t* key,
                   fdb_item_t* mbr,
                   int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_slice_t *slice_mbr = fdb_slice_create(mbr->data_, mbr->data_len_);
@@ -923,6 +1456,41 @@ int fdb_sismember(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_mbr);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_smismember(fdb_context_t* context,
+                   uint64_t id,
+                   fdb_item_t* key,
+                   size_t length,
+                   fdb_item_t* members,
+                   int** pexists){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
+    fdb_array_t *mbr_array = fdb_array_create(8), *rets_array = NULL;
+    for(size_t i=0; i<length; ++i){
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
+        n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
+        fdb_array_push_back(mbr_array, n_member); 
+    }
+    int retval = set_member_mexists(context, slot, slice_key, mbr_array, &rets_array);
+    if(retval == FDB_OK){
+        int *exists_ = create_int_array(length);
+        for(size_t i=0; i<length; ++i){
+            exists_[i] = (int)(fdb_array_at(rets_array, i)->val_.uval_);
+        }
+        *pexists = exists_;
+    }
+    for(size_t i=0; i<length; ++i){
+        fdb_val_node_t *n_member = fdb_array_at(mbr_array, i);
+        fdb_slice_destroy(n_member->val_.vval_); 
+    }
+    fdb_slice_destroy(slice_key);
+    fdb_array_destroy(mbr_array);
+    fdb_array_destroy(rets_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -930,6 +1498,7 @@ int fdb_scard(fdb_context_t* context,
               uint64_t id,
               fdb_item_t* key,
               int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -939,6 +1508,7 @@ int fdb_scard(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -948,12 +1518,13 @@ int fdb_srem(fdb_context_t* context,
              size_t length,
              fdb_item_t* members,
              int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *mbr_array = fdb_array_create(8);
 
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_member = fdb_val_node_create();
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
         n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
         fdb_array_push_back(mbr_array, n_member); 
     }
@@ -968,6 +1539,7 @@ int fdb_srem(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -977,12 +1549,13 @@ int fdb_sadd(fdb_context_t* context,
              size_t length,
              fdb_item_t* members,
              int64_t* count){
+    fdb_arena_enter();
                  
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     fdb_array_t *mbr_array = fdb_array_create(8);
     for(size_t i=0; i<length; ++i){
-        fdb_val_node_t *n_member = fdb_val_node_create();
+        fdb_val_node_t *n_member = fdb_val_node_create_in(fdb_arena_current());
         n_member->val_.vval_ = fdb_slice_create(members[i].data_, members[i].data_len_);
         fdb_array_push_back(mbr_array, n_member);
     }
@@ -997,14 +1570,207 @@ int fdb_sadd(fdb_context_t* context,
     }
     fdb_slice_destroy(slice_key);
     fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+//the keys of a multi-key set command as slices
+static fdb_slice_t** create_key_slices(size_t length, fdb_item_t* keys){
+    fdb_slice_t **slices = (fdb_slice_t**)fdb_malloc_in(fdb_arena_current(), (length + 1) * sizeof(fdb_slice_t*));
+    for(size_t i=0; i<length; ++i){
+        slices[i] = fdb_slice_create(keys[i].data_, keys[i].data_len_);
+    }
+    return slices;
+}
+
+static void destroy_key_slices(fdb_slice_t** slices, size_t length){
+    for(size_t i=0; i<length; ++i){
+        fdb_slice_destroy(slices[i]);
+    }
+    fdb_free_in(fdb_arena_current(), slices);
+}
+
+static int scombine(fdb_context_t* context,
+                    uint64_t id,
+                    int op,
+                    size_t length,
+                    fdb_item_t* keys,
+                    fdb_item_t** pmembers,
+                    int64_t* mlength){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t **slices = create_key_slices(length, keys);
+
+    fdb_array_t *mbr_array = NULL;
+    int retval = set_combine(context, slot, op, length, slices, &mbr_array);
+    if(retval == FDB_OK){
+        fill_scan_items(mbr_array, pmembers, mlength);
+    }
+    destroy_key_slices(slices, length);
+    fdb_array_destroy(mbr_array);
+    fdb_arena_leave();
+    return retval;
+}
+
+static int scombine_store(fdb_context_t* context,
+                          uint64_t id,
+                          int op,
+                          fdb_item_t* dest,
+                          size_t length,
+                          fdb_item_t* keys,
+                          int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_dest = fdb_slice_create(dest->data_, dest->data_len_);
+    fdb_slice_t **slices = create_key_slices(length, keys);
+
+    int64_t _count = 0;
+    int retval = set_combine_store(context, slot, op, slice_dest, length, slices, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    destroy_key_slices(slices, length);
+    fdb_slice_destroy(slice_dest);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_sinter(fdb_context_t* context,
+               uint64_t id,
+               size_t length,
+               fdb_item_t* keys,
+               fdb_item_t** pmembers,
+               int64_t* mlength){
+    return scombine(context, id, SET_INTER, length, keys, pmembers, mlength);
+}
+
+int fdb_sunion(fdb_context_t* context,
+               uint64_t id,
+               size_t length,
+               fdb_item_t* keys,
+               fdb_item_t** pmembers,
+               int64_t* mlength){
+    return scombine(context, id, SET_UNION, length, keys, pmembers, mlength);
+}
+
+int fdb_sdiff(fdb_context_t* context,
+              uint64_t id,
+              size_t length,
+              fdb_item_t* keys,
+              fdb_item_t** pmembers,
+              int64_t* mlength){
+    return scombine(context, id, SET_DIFF, length, keys, pmembers, mlength);
+}
+
+int fdb_sinterstore(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* dest,
+                    size_t length,
+                    fdb_item_t* keys,
+                    int64_t* count){
+    return scombine_store(context, id, SET_INTER, dest, length, keys, count);
+}
+
+int fdb_sunionstore(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* dest,
+                    size_t length,
+                    fdb_item_t* keys,
+                    int64_t* count){
+    return scombine_store(context, id, SET_UNION, dest, length, keys, count);
+}
+
+int fdb_sdiffstore(fdb_context_t* context,
+                   uint64_t id,
+                   fdb_item_t* dest,
+                   size_t length,
+                   fdb_item_t* keys,
+                   int64_t* count){
+    return scombine_store(context, id, SET_DIFF, dest, length, keys, count);
+}
+
+int fdb_sintercard(fdb_context_t* context,
+                   uint64_t id,
+                   size_t length,
+                   fdb_item_t* keys,
+                   uint64_t limit,
+                   int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t **slices = create_key_slices(length, keys);
+
+    int64_t _count = 0;
+    int retval = set_inter_card(context, slot, length, slices, limit, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    destroy_key_slices(slices, length);
+    fdb_arena_leave();
     return retval;
 }
 
+static int zcombine_store(fdb_context_t* context,
+                          uint64_t id,
+                          int op,
+                          fdb_item_t* dest,
+                          size_t length,
+                          fdb_item_t* keys,
+                          const double* weights,
+                          int aggregate,
+                          int64_t* count){
+    fdb_arena_enter();
+    fdb_slot_t *slot = get_slot(context, id);
+    fdb_slice_t *slice_dest = fdb_slice_create(dest->data_, dest->data_len_);
+    fdb_slice_t **slices = create_key_slices(length, keys);
+
+    int64_t _count = 0;
+    int retval = zset_combine_store(context, slot, op, slice_dest, length, slices, weights, aggregate, &_count);
+    if(retval == FDB_OK){
+        *count = _count;
+    }
+    destroy_key_slices(slices, length);
+    fdb_slice_destroy(slice_dest);
+    fdb_arena_leave();
+    return retval;
+}
+
+int fdb_zunionstore(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* dest,
+                    size_t length,
+                    fdb_item_t* keys,
+                    const double* weights,
+                    int aggregate,
+                    int64_t* count){
+    return zcombine_store(context, id, ZSET_UNION, dest, length, keys, weights, aggregate, count);
+}
+
+int fdb_zinterstore(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* dest,
+                    size_t length,
+                    fdb_item_t* keys,
+                    const double* weights,
+                    int aggregate,
+                    int64_t* count){
+    return zcombine_store(context, id, ZSET_INTER, dest, length, keys, weights, aggregate, count);
+}
+
+int fdb_zdiffstore(fdb_context_t* context,
+                   uint64_t id,
+                   fdb_item_t* dest,
+                   size_t length,
+                   fdb_item_t* keys,
+                   int64_t* count){
+    return zcombine_store(context, id, ZSET_DIFF, dest, length, keys, NULL, FDB_ZSET_AGGREGATE_SUM, count);
+}
+
 int fdb_pexpire_at(fdb_context_t* context,
                    uint64_t id,
                    fdb_item_t* key,
                    int64_t ts,
                    int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -1014,6 +1780,7 @@ int fdb_pexpire_at(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -1021,6 +1788,7 @@ int fdb_pexpire_left(fdb_context_t* context,
                      uint64_t id,
                      fdb_item_t* key,
                      int64_t* pttl){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
     
@@ -1030,6 +1798,7 @@ int fdb_pexpire_left(fdb_context_t* context,
         *pttl = _left;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -1037,6 +1806,7 @@ int fdb_pexpire_persist(fdb_context_t* context,
                         uint64_t id,
                         fdb_item_t* key,
                         int64_t* count){
+    fdb_arena_enter();
     fdb_slot_t *slot = get_slot(context, id);
     fdb_slice_t *slice_key = fdb_slice_create(key->data_, key->data_len_);
 
@@ -1046,6 +1816,7 @@ int fdb_pexpire_persist(fdb_context_t* context,
         *count = _count;
     }
     fdb_slice_destroy(slice_key);
+    fdb_arena_leave();
     return retval;
 }
 
@@ -17,10 +17,6 @@ typedef struct fdb_item_t{
     int64_t retval_;
 } fdb_item_t;
 
-typedef struct fdb_keys_t{
-    void* self_iter_;
-} fdb_keys_t;
-
 typedef struct fdb_dels_t{
     void* self_iter_;
     void* type_iter_;
@@ -42,16 +38,39 @@ extern void free_double_array(double* array);
 extern int set_fdb_signal_handler(const char* name);
 
 extern void fdb_drop_slot(fdb_context_t* context, uint64_t id);
+//fdb_drop_slot recreating the slot under profile, see FDB_PROFILE_*
+extern int fdb_drop_slot_profile(fdb_context_t* context, uint64_t id, int profile);
+extern int fdb_set_durability(fdb_context_t* context, uint64_t id, int durability, uint64_t sync_ms, uint64_t sync_bytes);
+extern int fdb_sync(fdb_context_t* context);
+extern void fdb_sync_stats(fdb_context_t* context, uint64_t* syncs, uint64_t* unsynced_bytes);
 
 
 
 //keys
-extern fdb_keys_t* create_fdb_keys(fdb_context_t* context, uint64_t id, uint64_t limit);
-extern void iterate_fdb_expired_keys(fdb_keys_t* keys, uint64_t max, fdb_item_t** pks, int64_t* length);
 extern void clean_fdb_expired_key(fdb_context_t* context, uint64_t id, fdb_item_t* key, int64_t* count);
-extern void destroy_fdb_keys(fdb_keys_t* keys);
+
+//cursor scans, a chunk of at most count entries past cursor, count 0 for a default one, those
+//matching pattern come back, *pcursor is the cursor of the next chunk or NULL once done
+extern int fdb_scan(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* cursor,
+                    fdb_item_t* pattern,
+                    uint64_t count,
+                    fdb_item_t** pkeys,
+                    int64_t* length,
+                    fdb_item_t** pcursor);
 
 //dels
+extern void fdb_dels_stats(fdb_context_t* context, uint64_t id, uint64_t* markers, uint64_t* subkeys, uint64_t* bytes);
+
+//keys cache
+extern void fdb_set_keys_cache_size(fdb_context_t* context, size_t size);
+extern void fdb_keys_cache_stats(fdb_context_t* context, uint64_t id, uint64_t* hits, uint64_t* misses, uint64_t* evictions);
+extern void fdb_keys_absent_stats(fdb_context_t* context, uint64_t id, uint64_t* hits, uint64_t* fills);
+
+//group commit
+extern void fdb_commit_stats(fdb_context_t* context, uint64_t* groups, uint64_t* batches, uint64_t* bytes,
+                             uint64_t* latency_us, uint64_t* depth, uint64_t* depth_max);
 
 //cmds
 extern int fdb_set(fdb_context_t* context,
@@ -159,6 +178,16 @@ extern int fdb_hgetall(fdb_context_t* context,
                        fdb_item_t** pfvs,
                        int64_t* length);
 
+extern int fdb_hscan(fdb_context_t* context,
+                     uint64_t id,
+                     fdb_item_t* key,
+                     fdb_item_t* cursor,
+                     fdb_item_t* pattern,
+                     uint64_t count,
+                     fdb_item_t** pfvs,
+                     int64_t* length,
+                     fdb_item_t** pcursor);
+
 extern int fdb_zadd(fdb_context_t* context,
                     uint64_t id,
                     fdb_item_t* key,
@@ -167,6 +196,29 @@ extern int fdb_zadd(fdb_context_t* context,
                     fdb_item_t* members,
                     int64_t* count);
 
+//fdb_zadd keeping at most cap members, the lowest scored trimmed, or the highest if trim_max
+extern int fdb_zadd_capped(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* key,
+                           size_t length,
+                           double* scores,
+                           fdb_item_t* members,
+                           uint64_t cap,
+                           int trim_max,
+                           int64_t* count,
+                           int64_t* trimmed);
+
+//a sliding window rate limit in one call, the members scored at or below now - window go,
+//member is added at now and the key expires ttl ms on, ttl 0 to leave it, count is what is left
+extern int fdb_zwindow_add(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* key,
+                           fdb_item_t* member,
+                           double now,
+                           double window,
+                           int64_t ttl,
+                           int64_t* count);
+
 extern int fdb_zrem(fdb_context_t* context,
                     uint64_t id,
                     fdb_item_t* key,
@@ -185,6 +237,15 @@ extern int fdb_zscore(fdb_context_t* context,
                       fdb_item_t* mbr,
                       double* score);
 
+//scores of members, prets holding FDB_OK or FDB_OK_NOT_EXIST for each
+extern int fdb_zmscore(fdb_context_t* context,
+                       uint64_t id,
+                       fdb_item_t* key,
+                       size_t length,
+                       fdb_item_t* members,
+                       double** pscores,
+                       int** prets);
+
 extern int fdb_zcount(fdb_context_t* context,
                       uint64_t id,
                       fdb_item_t* key,
@@ -208,6 +269,34 @@ extern int fdb_zrem_range_by_score(fdb_context_t* context,
                                    uint8_t type,
                                    int64_t *count);
 
+extern int fdb_zlexcount(fdb_context_t* context,
+                         uint64_t id,
+                         fdb_item_t* key,
+                         fdb_item_t* start,
+                         fdb_item_t* end,
+                         uint8_t type,
+                         int64_t* count);
+
+extern int fdb_zrem_range_by_lex(fdb_context_t* context,
+                                 uint64_t id,
+                                 fdb_item_t* key,
+                                 fdb_item_t* start,
+                                 fdb_item_t* end,
+                                 uint8_t type,
+                                 int64_t* count);
+
+extern int fdb_zrange_by_lex(fdb_context_t* context,
+                             uint64_t id,
+                             fdb_item_t* key,
+                             fdb_item_t* start,
+                             fdb_item_t* end,
+                             uint8_t type,
+                             int reverse,
+                             uint64_t offset,
+                             uint64_t count,
+                             fdb_item_t** pmembers,
+                             int64_t* length);
+
 extern int fdb_zrange(fdb_context_t* context,
                       uint64_t id,
                       fdb_item_t* key,
@@ -218,6 +307,58 @@ extern int fdb_zrange(fdb_context_t* context,
                       fdb_item_t** pmembers,
                       int64_t* length);
 
+extern int fdb_zrange_by_score(fdb_context_t* context,
+                               uint64_t id,
+                               fdb_item_t* key,
+                               double start,
+                               double end,
+                               uint8_t type,
+                               int reverse,
+                               uint64_t offset,
+                               uint64_t count,
+                               fdb_item_t* cursor,
+                               double** pscores,
+                               fdb_item_t** pmembers,
+                               int64_t* length,
+                               fdb_item_t** pcursor);
+
+//up to count members off the lowest scored end, or the highest if max, in the order popped
+extern int fdb_zpop(fdb_context_t* context,
+                    uint64_t id,
+                    fdb_item_t* key,
+                    int max,
+                    uint64_t count,
+                    double** pscores,
+                    fdb_item_t** pmembers,
+                    int64_t* length);
+
+//fdb_zpop of one member into score and *pmember, or if there is none FDB_OK_NOT_EXIST and *pwait
+//parked on key, called under the lock of key, which is let go of before fdb_zpop_wait
+extern int fdb_zpop_park(fdb_context_t* context,
+                         uint64_t id,
+                         fdb_item_t* key,
+                         int max,
+                         double* score,
+                         fdb_item_t** pmember,
+                         void** pwait);
+
+//blocking until a zadd into the key of wait or timeout_ms, 0 for no timeout, wait is freed,
+//returns 1 if woken, 0 on timeout, -1 once the context is being destroyed
+extern int fdb_zpop_wait(fdb_context_t* context,
+                         void* wait,
+                         uint64_t timeout_ms);
+
+extern int fdb_zscan(fdb_context_t* context,
+                     uint64_t id,
+                     fdb_item_t* key,
+                     fdb_item_t* cursor,
+                     fdb_item_t* pattern,
+                     uint64_t count,
+                     double** pscores,
+                     fdb_item_t** pmembers,
+                     int64_t* length,
+                     fdb_item_t** pcursor);
+
 extern int fdb_zrank(fdb_context_t* context,
                      uint64_t id,
                      fdb_item_t* key,
@@ -238,12 +379,30 @@ extern int fdb_smembers(fdb_context_t* context,
                         fdb_item_t** pmembers,
                         int64_t* length);
 
+extern int fdb_sscan(fdb_context_t* context,
+                     uint64_t id,
+                     fdb_item_t* key,
+                     fdb_item_t* cursor,
+                     fdb_item_t* pattern,
+                     uint64_t count,
+                     fdb_item_t** pmembers,
+                     int64_t* length,
+                     fdb_item_t** pcursor);
+
 extern int fdb_sismember(fdb_context_t* context,
                          uint64_t id,
                          fdb_item_t* key,
                          fdb_item_t* mbr,
                          int64_t* count);
 
+//1 or 0 for each of members
+extern int fdb_smismember(fdb_context_t* context,
+                          uint64_t id,
+                          fdb_item_t* key,
+                          size_t length,
+                          fdb_item_t* members,
+                          int** pexists);
+
 extern int fdb_scard(fdb_context_t* context,
                      uint64_t id,
                      fdb_item_t* key,
@@ -263,6 +422,86 @@ extern int fdb_sadd(fdb_context_t* context,
                     fdb_item_t* members,
                     int64_t* count);
 
+//the members in all, any, or the first and none of the other sets of keys
+extern int fdb_sinter(fdb_context_t* context,
+                      uint64_t id,
+                      size_t length,
+                      fdb_item_t* keys,
+                      fdb_item_t** pmembers,
+                      int64_t* mlength);
+
+extern int fdb_sunion(fdb_context_t* context,
+                      uint64_t id,
+                      size_t length,
+                      fdb_item_t* keys,
+                      fdb_item_t** pmembers,
+                      int64_t* mlength);
+
+extern int fdb_sdiff(fdb_context_t* context,
+                     uint64_t id,
+                     size_t length,
+                     fdb_item_t* keys,
+                     fdb_item_t** pmembers,
+                     int64_t* mlength);
+
+//the same written to the set dest, count is its new size
+extern int fdb_sinterstore(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* dest,
+                           size_t length,
+                           fdb_item_t* keys,
+                           int64_t* count);
+
+extern int fdb_sunionstore(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* dest,
+                           size_t length,
+                           fdb_item_t* keys,
+                           int64_t* count);
+
+extern int fdb_sdiffstore(fdb_context_t* context,
+                          uint64_t id,
+                          fdb_item_t* dest,
+                          size_t length,
+                          fdb_item_t* keys,
+                          int64_t* count);
+
+//the size of the intersection, counting stops at limit, 0 for none
+extern int fdb_sintercard(fdb_context_t* context,
+                          uint64_t id,
+                          size_t length,
+                          fdb_item_t* keys,
+                          uint64_t limit,
+                          int64_t* count);
+
+//the zsets of keys combined into dest, scores times weights, NULL for all 1, and combined by
+//one of FDB_ZSET_AGGREGATE_*, count is the size of dest
+extern int fdb_zunionstore(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* dest,
+                           size_t length,
+                           fdb_item_t* keys,
+                           const double* weights,
+                           int aggregate,
+                           int64_t* count);
+
+extern int fdb_zinterstore(fdb_context_t* context,
+                           uint64_t id,
+                           fdb_item_t* dest,
+                           size_t length,
+                           fdb_item_t* keys,
+                           const double* weights,
+                           int aggregate,
+                           int64_t* count);
+
+//the members of the first zset in none of the others, with their scores
+extern int fdb_zdiffstore(fdb_context_t* context,
+                          uint64_t id,
+                          fdb_item_t* dest,
+                          size_t length,
+                          fdb_item_t* keys,
+                          int64_t* count);
+
 extern int fdb_pexpire_at(fdb_context_t* context,
                    uint64_t id,
                    fdb_item_t* key,
@@ -13,20 +13,26 @@ struct fdb_slice_t {
     size_t start_;
     size_t length_;
     char *data_;
+    fdb_arena_t *arena_;
 };
 
 
 fdb_slice_t* fdb_slice_create(const char* data, size_t len){
-    fdb_slice_t *slice = (fdb_slice_t*)fdb_malloc(sizeof(fdb_slice_t));
+    return fdb_slice_create_in(NULL, data, len);
+}
+
+fdb_slice_t* fdb_slice_create_in(fdb_arena_t* arena, const char* data, size_t len){
+    fdb_slice_t *slice = (fdb_slice_t*)fdb_malloc_in(arena, sizeof(fdb_slice_t));
+    slice->arena_ = arena;
     if(len==0 || data == NULL){
         slice->length_ = 0;
         slice->capacity_ = 8 + slice->length_ + 1;
         slice->start_ = 8;
-        slice->data_ = (char*)fdb_malloc(slice->capacity_);
+        slice->data_ = (char*)fdb_malloc_in(arena, slice->capacity_);
     }else{
         slice->length_ = len;
         slice->capacity_ = 8 + slice->length_ + 1;
-        slice->data_ = (char*)fdb_malloc(slice->capacity_);
+        slice->data_ = (char*)fdb_malloc_in(arena, slice->capacity_);
         slice->start_ = 8;
         memcpy(slice->data_ + slice->start_, data, len);
     }
@@ -40,10 +46,9 @@ fdb_slice_t* fdb_slice_create(const char* data, size_t len){
 void fdb_slice_destroy(void* slice){
   if(slice!=NULL){
     fdb_slice_t *sl = (fdb_slice_t*)slice;
-    sl->ref_.refcnt_ -= 1;
-    if(sl->ref_.refcnt_ == 0){
-      fdb_free(sl->data_);
-      fdb_free(sl);     
+    if(__sync_sub_and_fetch(&sl->ref_.refcnt_, 1) == 0){
+      fdb_free_in(sl->arena_, sl->data_);
+      fdb_free_in(sl->arena_, sl);     
     }
   }
 }
@@ -60,11 +65,22 @@ static size_t ensure_slice_capacity(size_t len){
   return capacity;
 }
 
+//arena memory is not given back one by one, so growing there is a fresh copy
+static void grow_slice_data(fdb_slice_t* slice, size_t capacity){
+  if(slice->arena_ == NULL){
+    slice->data_ = (char*)fdb_realloc(slice->data_, capacity);
+  }else{
+    char *data = (char*)fdb_arena_alloc(slice->arena_, capacity);
+    memcpy(data, slice->data_, slice->capacity_ < capacity ? slice->capacity_ : capacity);
+    slice->data_ = data;
+  }
+  slice->capacity_ = capacity;
+}
+
 void fdb_slice_string_push_back(fdb_slice_t* slice, const char* str, size_t len){
   if(len > 0){
     if(slice->capacity_ < (slice->start_ + slice->length_ + len + 1)){
-      slice->capacity_ = ensure_slice_capacity(slice->start_ + slice->length_ + len + 1);
-      slice->data_ = (char*)fdb_realloc(slice->data_, slice->capacity_);
+      grow_slice_data(slice, ensure_slice_capacity(slice->start_ + slice->length_ + len + 1));
     }
     memcpy(slice->data_ + slice->start_ + slice->length_, str, len);
     slice->length_ += len;
@@ -99,11 +115,10 @@ void fdb_slice_uint64_push_back(fdb_slice_t* slice, uint64_t val){
 void fdb_slice_string_push_front(fdb_slice_t* slice, const char* str, size_t len){
     if(len > 0){
         if(slice->start_ < len){
-            slice->capacity_ = ensure_slice_capacity(8 + slice->length_ + len + 1);
             size_t old_start = slice->start_;
             size_t old_length = slice->length_;
             slice->start_ = 8;
-            slice->data_ = (char*)fdb_realloc(slice->data_, slice->capacity_);
+            grow_slice_data(slice, ensure_slice_capacity(8 + slice->length_ + len + 1));
             memmove(slice->data_ + slice->start_ + len, slice->data_ + old_start, old_length);
             memcpy(slice->data_ + slice->start_, str, len);
             slice->length_ += len;
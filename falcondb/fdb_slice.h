@@ -8,8 +8,11 @@
 
 
 typedef struct fdb_slice_t  fdb_slice_t;
+typedef struct fdb_arena_t  fdb_arena_t;
 
 fdb_slice_t* fdb_slice_create(const char* data, size_t len);
+//living in arena, NULL for the heap, such a slice must not outlive the arena's command
+fdb_slice_t* fdb_slice_create_in(fdb_arena_t* arena, const char* data, size_t len);
 void fdb_slice_destroy(void* slice);
 
 
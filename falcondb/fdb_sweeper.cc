@@ -0,0 +1,101 @@
+#include "fdb_sweeper.h"
+#include "fdb_types.h"
+#include "fdb_malloc.h"
+#include "t_keys.h"
+#include "t_dels.h"
+#include "fdb_committer.h"
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <stdio.h>
+
+
+struct fdb_sweeper_t{
+    fdb_context_t*  context_;
+    uint64_t        interval_ms_;
+    uint64_t        budget_;
+    uint64_t        budget_ms_;
+    int             stop_;
+    pthread_t       thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t  cond_;
+};
+
+
+void fdb_sweeper_work(fdb_context_t* context, uint64_t budget, uint64_t budget_ms){
+    fdb_slot_t **slots = (fdb_slot_t**)context->slots_;
+    for(size_t i=0; i<context->num_slots_; ++i){
+        //slots may be dropped and recreated underneath, see fdb_context_drop_slot
+        rocksdb_mutex_lock(context->mutex_);
+        if(slots[i]->handle_ != NULL){
+            //keys from before the ttl index get their entries first, see keys_ttl_backfill
+            if(!slots[i]->ttl_indexed_){
+                keys_ttl_backfill(context, slots[i], budget, budget_ms);
+            }
+            //expired collections become markers first, so they are reclaimed in the same round
+            keys_ttl_reclaim(context, slots[i], budget, budget_ms);
+            dels_self_reclaim(context, slots[i], budget);
+        }
+        rocksdb_mutex_unlock(context->mutex_);
+    }
+    //periodic slots left idle after their last write are synced here
+    fdb_committer_sync((fdb_committer_t*)context->committer_, 1);
+}
+
+static void* fdb_sweeper_main(void* arg){
+    fdb_sweeper_t *sweeper = (fdb_sweeper_t*)arg;
+
+    pthread_mutex_lock(&sweeper->mutex_);
+    while(!sweeper->stop_){
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        uint64_t usec = (uint64_t)now.tv_usec + sweeper->interval_ms_ * 1000;
+        struct timespec deadline;
+        deadline.tv_sec = now.tv_sec + usec/1000000;
+        deadline.tv_nsec = (usec%1000000)*1000;
+        int ret = pthread_cond_timedwait(&sweeper->cond_, &sweeper->mutex_, &deadline);
+        if(sweeper->stop_){
+            break;
+        }
+        if(ret == ETIMEDOUT){
+            pthread_mutex_unlock(&sweeper->mutex_);
+            fdb_sweeper_work(sweeper->context_, sweeper->budget_, sweeper->budget_ms_);
+            pthread_mutex_lock(&sweeper->mutex_);
+        }
+    }
+    pthread_mutex_unlock(&sweeper->mutex_);
+    return NULL;
+}
+
+fdb_sweeper_t* fdb_sweeper_create(fdb_context_t* context, uint64_t interval_ms, uint64_t budget, uint64_t budget_ms){
+    fdb_sweeper_t *sweeper = (fdb_sweeper_t*)fdb_malloc(sizeof(fdb_sweeper_t));
+    sweeper->context_ = context;
+    sweeper->interval_ms_ = interval_ms;
+    sweeper->budget_ = budget;
+    sweeper->budget_ms_ = budget_ms;
+    sweeper->stop_ = 0;
+    pthread_mutex_init(&sweeper->mutex_, NULL);
+    pthread_cond_init(&sweeper->cond_, NULL);
+    if(pthread_create(&sweeper->thread_, NULL, fdb_sweeper_main, sweeper)!=0){
+        fprintf(stderr, "%s pthread_create fail.\n", __func__);
+        pthread_cond_destroy(&sweeper->cond_);
+        pthread_mutex_destroy(&sweeper->mutex_);
+        fdb_free(sweeper);
+        return NULL;
+    }
+    return sweeper;
+}
+
+void fdb_sweeper_destroy(fdb_sweeper_t* sweeper){
+    if(sweeper!=NULL){
+        pthread_mutex_lock(&sweeper->mutex_);
+        sweeper->stop_ = 1;
+        pthread_cond_signal(&sweeper->cond_);
+        pthread_mutex_unlock(&sweeper->mutex_);
+        pthread_join(sweeper->thread_, NULL);
+        pthread_cond_destroy(&sweeper->cond_);
+        pthread_mutex_destroy(&sweeper->mutex_);
+    }
+    fdb_free(sweeper);
+}
@@ -0,0 +1,20 @@
+#ifndef FDB_SWEEPER_H
+#define FDB_SWEEPER_H
+
+#include "fdb_context.h"
+#include <stdint.h>
+
+typedef struct fdb_sweeper_t                fdb_sweeper_t;
+
+//background thread reclaiming deleted and expired keys, every interval_ms it visits each slot,
+//expires at most budget due keys within budget_ms there and drops at most budget subkeys,
+//so the I/O it adds stays bounded
+fdb_sweeper_t* fdb_sweeper_create(fdb_context_t* context, uint64_t interval_ms, uint64_t budget, uint64_t budget_ms);
+
+void fdb_sweeper_destroy(fdb_sweeper_t* sweeper);
+
+//one round over all slots in the calling thread
+void fdb_sweeper_work(fdb_context_t* context, uint64_t budget, uint64_t budget_ms);
+
+
+#endif //FDB_SWEEPER_H
@@ -11,19 +11,68 @@ struct fdb_context_t{
     void*                                   slots_;
     size_t                                  num_slots_;
     rocksdb_cache_t*                        block_cache_;
-    rocksdb_options_t*                      options_;
-    rocksdb_block_based_table_options_t*    table_options_;
+    rocksdb_options_t**                     options_;
+    rocksdb_block_based_table_options_t**   table_options_;
+    rocksdb_mutex_t*                        mutex_;
+    void*                                   sweeper_;
+    void*                                   committer_;
+    rocksdb_readoptions_t*                  readoptions_;
+    rocksdb_readoptions_t*                  scanoptions_;
+    rocksdb_writeoptions_t**                writeoptions_;
+    void*                                   keys_cache_;
+    void*                                   waiter_;
+    size_t                                  packed_entries_;
+    size_t                                  packed_bytes_;
 };
 
 struct fdb_slot_t{
     uint64_t                                id_;
     rocksdb_column_family_handle_t*         handle_; 
-    rocksdb_cache_t*                        keys_cache_;
-    rocksdb_writebatch_t*                   batch_;
-    rocksdb_mutex_t*                        mutex_; 
+    uint32_t                                cf_id_;
+    rocksdb_mutex_t*                        handle_mutex_;
+    rocksdb_mutex_t*                        dels_mutex_;
+    rocksdb_mutex_t**                       keys_mutex_;
+    uint64_t*                               keys_pins_;
+    uint64_t                                dels_markers_;
+    uint64_t                                dels_subkeys_;
+    uint64_t                                dels_bytes_;
+    rocksdb_mutex_t*                        durability_mutex_;
+    int                                     durability_;
+    uint64_t                                sync_ms_;
+    uint64_t                                sync_bytes_;
+    int                                     profile_;
+    int                                     ttl_indexed_;
+    void*                                   ttl_cursor_;
+    uint64_t                                keys_absent_hits_;
+    uint64_t                                keys_absent_fills_;
 };
 
 
+#define FDB_SLOT_KEYS_MUTEX_NUM 64
+#define FDB_SLOT_CF_ID_NONE     0xFFFFFFFF
+#define FDB_COMMIT_GROUP_BYTES  (4*1024*1024)
+#define FDB_KEYS_CACHE_SIZE     (64*1024*1024)
+#define FDB_KEYS_CACHE_SHARDS   64
+#define FDB_WAITER_BUCKETS      256
+//deletes in a window of entries that get a table compacted, see fdb_context_create
+#define FDB_COMPACT_DELETES_WINDOW  (128*1024)
+#define FDB_COMPACT_DELETES_TRIGGER (32*1024)
+//limits of a collection packed in its main key, see t_packed.h
+#define FDB_PACKED_ENTRIES      128
+#define FDB_PACKED_BYTES        2048
+//entries a cursor scan looks at per call, when the caller gives no count, and at most
+#define FDB_SCAN_COUNT          10
+#define FDB_SCAN_COUNT_MAX      10000
+//key of the default slot telling that every table of the db was written with subkey prefixes
+#define FDB_PREFIX_MARKER       "falcondb.subkey_prefix"
+//profile of slot n is kept in the default slot under the marker followed by n
+#define FDB_PROFILE_MARKER      "falcondb.slot_profile-"
+//key of the default slot telling that the main keys of slot n, then the marker followed by n,
+//all have their entries in the ttl index, see keys_ttl_backfill
+#define FDB_TTL_MARKER          "falcondb.ttl_index-"
+//levels a profile gives a compression of its own, as many as rocksdb has by default
+#define FDB_PROFILE_LEVELS      7
+
 struct fdb_val_node_t {
     struct fdb_val_node_t* next_;
     struct fdb_val_node_t* prev_;
@@ -33,6 +82,7 @@ struct fdb_val_node_t {
         void*       vval_;
     } val_;
     int retval_;
+    struct fdb_arena_t* arena_;
 };
 
 struct fdb_list_t {
@@ -57,6 +107,7 @@ struct fdb_iterator_t {
     struct fdb_slice_t *end_;
     int direction_;
     uint64_t limit_;
+    rocksdb_readoptions_t *options_;     //NULL when reading with the shared scanoptions_
     rocksdb_iterator_t *iterator_;
 };
 
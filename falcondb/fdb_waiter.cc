@@ -0,0 +1,194 @@
+#include "fdb_waiter.h"
+#include "fdb_malloc.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <string.h>
+
+
+struct fdb_wait_t{
+    uint64_t                    id_;
+    char*                       key_;
+    size_t                      klen_;
+    uint64_t                    hash_;
+    int                         woken_;
+    struct fdb_wait_t*          prev_;
+    struct fdb_wait_t*          next_;
+};
+
+struct fdb_waiter_bucket_t{
+    pthread_mutex_t             mutex_;
+    pthread_cond_t              cond_;
+    struct fdb_wait_t*          head_;         //oldest first
+    struct fdb_wait_t*          tail_;
+};
+
+struct fdb_waiter_t{
+    size_t                      num_buckets_;
+    struct fdb_waiter_bucket_t* buckets_;
+    uint64_t                    parked_;
+    int                         shutdown_;
+    pthread_mutex_t             mutex_;         //for parked_ to drain on shutdown
+    pthread_cond_t              drained_;
+};
+
+
+static uint64_t fdb_waiter_hash(uint64_t id, const char* key, size_t klen){
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i=0; i<sizeof(uint64_t); ++i){
+        hash ^= (uint8_t)(id >> (i*8));
+        hash *= 1099511628211ull;
+    }
+    for(size_t i=0; i<klen; ++i){
+        hash ^= (uint8_t)key[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static struct fdb_waiter_bucket_t* fdb_waiter_bucket(fdb_waiter_t* waiter, uint64_t hash){
+    return &waiter->buckets_[hash % waiter->num_buckets_];
+}
+
+fdb_waiter_t* fdb_waiter_create(size_t num_buckets){
+    fdb_waiter_t *waiter = (fdb_waiter_t*)fdb_malloc(sizeof(fdb_waiter_t));
+    waiter->num_buckets_ = (num_buckets > 0) ? num_buckets : 1;
+    waiter->buckets_ = (struct fdb_waiter_bucket_t*)fdb_malloc(waiter->num_buckets_ * sizeof(struct fdb_waiter_bucket_t));
+    for(size_t i=0; i<waiter->num_buckets_; ++i){
+        pthread_mutex_init(&waiter->buckets_[i].mutex_, NULL);
+        pthread_cond_init(&waiter->buckets_[i].cond_, NULL);
+        waiter->buckets_[i].head_ = NULL;
+        waiter->buckets_[i].tail_ = NULL;
+    }
+    waiter->parked_ = 0;
+    waiter->shutdown_ = 0;
+    pthread_mutex_init(&waiter->mutex_, NULL);
+    pthread_cond_init(&waiter->drained_, NULL);
+    return waiter;
+}
+
+void fdb_waiter_shutdown(fdb_waiter_t* waiter){
+    if(waiter == NULL){
+        return;
+    }
+    for(size_t i=0; i<waiter->num_buckets_; ++i){
+        pthread_mutex_lock(&waiter->buckets_[i].mutex_);
+        waiter->shutdown_ = 1;
+        pthread_cond_broadcast(&waiter->buckets_[i].cond_);
+        pthread_mutex_unlock(&waiter->buckets_[i].mutex_);
+    }
+    pthread_mutex_lock(&waiter->mutex_);
+    while(__sync_add_and_fetch(&waiter->parked_, 0) > 0){
+        pthread_cond_wait(&waiter->drained_, &waiter->mutex_);
+    }
+    pthread_mutex_unlock(&waiter->mutex_);
+}
+
+void fdb_waiter_destroy(fdb_waiter_t* waiter){
+    if(waiter == NULL){
+        return;
+    }
+    fdb_waiter_shutdown(waiter);
+    pthread_cond_destroy(&waiter->drained_);
+    pthread_mutex_destroy(&waiter->mutex_);
+    for(size_t i=0; i<waiter->num_buckets_; ++i){
+        pthread_cond_destroy(&waiter->buckets_[i].cond_);
+        pthread_mutex_destroy(&waiter->buckets_[i].mutex_);
+    }
+    fdb_free(waiter->buckets_);
+    fdb_free(waiter);
+}
+
+int fdb_waiter_parked(fdb_waiter_t* waiter){
+    return __sync_add_and_fetch(&waiter->parked_, 0) > 0;
+}
+
+fdb_wait_t* fdb_waiter_park(fdb_waiter_t* waiter, uint64_t id, const char* key, size_t klen){
+    fdb_wait_t *wait = (fdb_wait_t*)fdb_malloc(sizeof(fdb_wait_t));
+    wait->id_ = id;
+    wait->key_ = (char*)fdb_malloc(klen + 1);
+    if(klen > 0) memcpy(wait->key_, key, klen);
+    wait->klen_ = klen;
+    wait->hash_ = fdb_waiter_hash(id, key, klen);
+    wait->woken_ = 0;
+    wait->next_ = NULL;
+
+    struct fdb_waiter_bucket_t *bucket = fdb_waiter_bucket(waiter, wait->hash_);
+    pthread_mutex_lock(&bucket->mutex_);
+    wait->prev_ = bucket->tail_;
+    if(bucket->tail_ != NULL){
+        bucket->tail_->next_ = wait;
+    }else{
+        bucket->head_ = wait;
+    }
+    bucket->tail_ = wait;
+    __sync_add_and_fetch(&waiter->parked_, 1);
+    pthread_mutex_unlock(&bucket->mutex_);
+    return wait;
+}
+
+int fdb_waiter_wait(fdb_waiter_t* waiter, fdb_wait_t* wait, uint64_t timeout_ms){
+    struct timespec deadline;
+    if(timeout_ms > 0){
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        uint64_t ns = (uint64_t)now.tv_usec * 1000 + (timeout_ms % 1000) * 1000000;
+        deadline.tv_sec = now.tv_sec + (time_t)(timeout_ms / 1000) + (time_t)(ns / 1000000000);
+        deadline.tv_nsec = (long)(ns % 1000000000);
+    }
+
+    struct fdb_waiter_bucket_t *bucket = fdb_waiter_bucket(waiter, wait->hash_);
+    pthread_mutex_lock(&bucket->mutex_);
+    //the bucket is shared, a wake of another key in it is slept through again
+    while(!wait->woken_ && !waiter->shutdown_){
+        if(timeout_ms == 0){
+            pthread_cond_wait(&bucket->cond_, &bucket->mutex_);
+        }else if(pthread_cond_timedwait(&bucket->cond_, &bucket->mutex_, &deadline) == ETIMEDOUT){
+            break;
+        }
+    }
+    int woken = wait->woken_ ? 1 : (waiter->shutdown_ ? -1 : 0);
+    if(wait->prev_ != NULL){
+        wait->prev_->next_ = wait->next_;
+    }else{
+        bucket->head_ = wait->next_;
+    }
+    if(wait->next_ != NULL){
+        wait->next_->prev_ = wait->prev_;
+    }else{
+        bucket->tail_ = wait->prev_;
+    }
+    pthread_mutex_unlock(&bucket->mutex_);
+
+    //the last one out lets a shutdown go on, the bucket is let go of by then
+    pthread_mutex_lock(&waiter->mutex_);
+    if(__sync_sub_and_fetch(&waiter->parked_, 1) == 0 && waiter->shutdown_){
+        pthread_cond_broadcast(&waiter->drained_);
+    }
+    pthread_mutex_unlock(&waiter->mutex_);
+
+    fdb_free(wait->key_);
+    fdb_free(wait);
+    return woken;
+}
+
+size_t fdb_waiter_wake(fdb_waiter_t* waiter, uint64_t id, const char* key, size_t klen, size_t max){
+    uint64_t hash = fdb_waiter_hash(id, key, klen);
+    struct fdb_waiter_bucket_t *bucket = fdb_waiter_bucket(waiter, hash);
+    size_t woken = 0;
+    pthread_mutex_lock(&bucket->mutex_);
+    for(struct fdb_wait_t *wait = bucket->head_; wait != NULL && woken < max; wait = wait->next_){
+        if(!wait->woken_ && wait->hash_ == hash && wait->id_ == id &&
+           compare_with_length(wait->key_, wait->klen_, key, klen) == 0){
+            wait->woken_ = 1;
+            ++woken;
+        }
+    }
+    if(woken > 0){
+        pthread_cond_broadcast(&bucket->cond_);
+    }
+    pthread_mutex_unlock(&bucket->mutex_);
+    return woken;
+}
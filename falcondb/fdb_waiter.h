@@ -0,0 +1,35 @@
+#ifndef FDB_WAITER_H
+#define FDB_WAITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct fdb_waiter_t                 fdb_waiter_t;
+typedef struct fdb_wait_t                   fdb_wait_t;
+
+//callers parked on a key of a slot until a write to it wakes them, the keys hash into buckets
+//of wait lists, a caller parks under the lock of the command that found the key empty and waits
+//once it let go of it, so a write that comes in between still wakes it
+fdb_waiter_t* fdb_waiter_create(size_t num_buckets);
+
+//waking everyone parked to return -1 from fdb_waiter_wait, and so any that waits from now on,
+//returns once all of them are out, fdb_waiter_destroy shuts the waiter down first
+void fdb_waiter_shutdown(fdb_waiter_t* waiter);
+
+void fdb_waiter_destroy(fdb_waiter_t* waiter);
+
+//whether anyone is parked, for a writer to skip the wake cheaply
+int fdb_waiter_parked(fdb_waiter_t* waiter);
+
+//putting the caller on the wait list of key, to be waited on by fdb_waiter_wait
+fdb_wait_t* fdb_waiter_park(fdb_waiter_t* waiter, uint64_t id, const char* key, size_t klen);
+
+//blocking until key is woken or timeout_ms passes, 0 for no timeout, the wait is taken off the
+//list and freed, returns 1 if woken, 0 on timeout, -1 once the waiter is shut down
+int fdb_waiter_wait(fdb_waiter_t* waiter, fdb_wait_t* wait, uint64_t timeout_ms);
+
+//waking up to max of those parked on key, the longest parked first, returns how many
+size_t fdb_waiter_wake(fdb_waiter_t* waiter, uint64_t id, const char* key, size_t klen, size_t max);
+
+
+#endif //FDB_WAITER_H
@@ -0,0 +1,337 @@
+#include "t_dels.h"
+#include "t_keys.h"
+#include "t_hash.h"
+#include "t_set.h"
+#include "t_zset.h"
+
+#include "fdb_types.h"
+#include "fdb_define.h"
+#include "fdb_malloc.h"
+
+#include <rocksdb/c.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+//the value of a deletion marker is a list of fixed32 seqs, one for each retired generation,
+//batched reads also see the markers of commands not yet committed
+static int dels_get(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* slice_key, int batched, char** pval, size_t* pvallen){
+    char *val = NULL, *errptr = NULL;
+    size_t vallen = 0;
+    if(batched){
+        val = fdb_slot_writebatch_get(context, slot, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
+    }else{
+        val = rocksdb_get_cf(context->db_, context->readoptions_, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
+    }
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    if(val == NULL){
+        return 0;
+    }
+    *pval = val;
+    *pvallen = vallen;
+    return 1;
+}
+
+static int dels_has_seq(const char* val, size_t vallen, uint32_t seq){
+    for(size_t i=0; i+sizeof(uint32_t)<=vallen; i+=sizeof(uint32_t)){
+        if(rocksdb_decode_fixed32(val + i) == seq){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int dels_mark(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq){
+    int ret = 0;
+    char *val = NULL;
+    size_t vallen = 0;
+
+    fdb_slice_t *slice_key = NULL, *slice_val = NULL;
+    encode_dels_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
+
+    rocksdb_mutex_lock(slot->dels_mutex_);
+    ret = dels_get(context, slot, slice_key, 1, &val, &vallen);
+    if(ret == -1){
+        goto end;
+    }
+    if(ret == 1 && dels_has_seq(val, vallen, seq)){
+        ret = 1;
+        goto end;
+    }
+    slice_val = fdb_slice_create(val, vallen);
+    fdb_slice_uint32_push_back(slice_val, seq);
+
+    //committed along with the main key by the caller
+    fdb_slot_writebatch_put(slot,
+                            fdb_slice_data(slice_key),
+                            fdb_slice_length(slice_key),
+                            fdb_slice_data(slice_val),
+                            fdb_slice_length(slice_val));
+    ret = 1;
+
+end:
+    rocksdb_mutex_unlock(slot->dels_mutex_);
+    if(val != NULL) rocksdb_free(val);
+    fdb_slice_destroy(slice_key);
+    fdb_slice_destroy(slice_val);
+    return ret;
+}
+
+int dels_is_marked(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq){
+    char *val = NULL;
+    size_t vallen = 0;
+
+    fdb_slice_t *slice_key = NULL;
+    encode_dels_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
+    //called from the compaction filter, which must not wait on the slot batch
+    int ret = dels_get(context, slot, slice_key, 0, &val, &vallen);
+    fdb_slice_destroy(slice_key);
+    if(ret == 1){
+        ret = dels_has_seq(val, vallen, seq);
+        rocksdb_free(val);
+    }
+    return ret;
+}
+
+int dels_next_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* seq){
+    char *val = NULL;
+    size_t vallen = 0;
+
+    fdb_slice_t *slice_key = NULL;
+    encode_dels_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
+    int ret = dels_get(context, slot, slice_key, 1, &val, &vallen);
+    fdb_slice_destroy(slice_key);
+    if(ret == -1){
+        return -1;
+    }
+
+    uint32_t next = FDB_KEY_INIT_SEQ;
+    if(ret == 1){
+        for(size_t i=0; i+sizeof(uint32_t)<=vallen; i+=sizeof(uint32_t)){
+            uint32_t _seq = rocksdb_decode_fixed32(val + i);
+            if(_seq >= next){
+                next = _seq + 1;
+            }
+        }
+        rocksdb_free(val);
+    }
+    *seq = next;
+    return 1;
+}
+
+//deleting every key starting with prefix, returns the number deleted or -1
+static int64_t dels_drop_prefix(fdb_context_t* context, fdb_slot_t* slot, rocksdb_writebatch_t* batch,
+                                fdb_slice_t* prefix, uint64_t max, uint64_t* bytes, int* done){
+    int64_t count = 0;
+    *done = 0;
+
+    rocksdb_iterator_t *iterator = rocksdb_create_iterator_cf(context->db_, context->scanoptions_, slot->handle_);
+    rocksdb_iter_seek(iterator, fdb_slice_data(prefix), fdb_slice_length(prefix));
+    while(1){
+        if(!rocksdb_iter_valid(iterator)){
+            *done = 1;
+            break;
+        }
+        size_t klen = 0, vlen = 0;
+        const char *rkey = rocksdb_iter_key(iterator, &klen);
+        if(klen < fdb_slice_length(prefix) || memcmp(rkey, fdb_slice_data(prefix), fdb_slice_length(prefix))!=0){
+            *done = 1;
+            break;
+        }
+        if((uint64_t)count >= max){
+            break;
+        }
+        rocksdb_iter_value(iterator, &vlen);
+        rocksdb_writebatch_delete_cf(batch, slot->handle_, rkey, klen);
+        *bytes += (klen + vlen);
+        ++count;
+        rocksdb_iter_next(iterator);
+    }
+    char *errptr = NULL;
+    rocksdb_iter_get_error(iterator, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_iter_get_error fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        count = -1;
+    }
+    rocksdb_iter_destroy(iterator);
+    return count;
+}
+
+//dropping subkeys and size counters of one retired generation of key
+static int64_t dels_drop_seq(fdb_context_t* context, fdb_slot_t* slot, rocksdb_writebatch_t* batch,
+                             const char* key, size_t keylen, uint32_t seq, uint64_t max, uint64_t* bytes, int* done){
+    int64_t count = 0;
+    *done = 0;
+
+    fdb_slice_t *seqkey = fdb_slice_create(key, keylen);
+    fdb_slice_uint32_push_front(seqkey, seq);
+    const char *skey = fdb_slice_data(seqkey);
+    size_t skeylen = fdb_slice_length(seqkey);
+
+    fdb_slice_t *prefixes[5] = {NULL};
+    fdb_slice_t *slice_size = NULL;
+    encode_hash_key(skey, skeylen, NULL, 0, &prefixes[0]);
+    encode_set_key(skey, skeylen, NULL, 0, &prefixes[1]);
+    encode_zset_key(skey, skeylen, NULL, 0, &prefixes[2]);
+    prefixes[3] = fdb_slice_create(skey, skeylen);
+    fdb_slice_uint8_push_front(prefixes[3], (uint8_t)skeylen);
+    fdb_slice_uint8_push_front(prefixes[3], FDB_DATA_TYPE_ZSCORE);
+    prefixes[4] = fdb_slice_create(skey, skeylen);
+    fdb_slice_uint8_push_front(prefixes[4], (uint8_t)skeylen);
+    fdb_slice_uint8_push_front(prefixes[4], FDB_DATA_TYPE_ZRANK);
+
+    for(int i=0; i<5; ++i){
+        int _done = 0;
+        int64_t _count = dels_drop_prefix(context, slot, batch, prefixes[i], max - count, bytes, &_done);
+        if(_count < 0){
+            count = -1;
+            goto end;
+        }
+        count += _count;
+        if(!_done){
+            goto end;
+        }
+    }
+
+    encode_hsize_key(skey, skeylen, &slice_size);
+    rocksdb_writebatch_delete_cf(batch, slot->handle_, fdb_slice_data(slice_size), fdb_slice_length(slice_size));
+    fdb_slice_destroy(slice_size);
+    encode_ssize_key(skey, skeylen, &slice_size);
+    rocksdb_writebatch_delete_cf(batch, slot->handle_, fdb_slice_data(slice_size), fdb_slice_length(slice_size));
+    fdb_slice_destroy(slice_size);
+    encode_zsize_key(skey, skeylen, &slice_size);
+    rocksdb_writebatch_delete_cf(batch, slot->handle_, fdb_slice_data(slice_size), fdb_slice_length(slice_size));
+    fdb_slice_destroy(slice_size);
+    *done = 1;
+
+end:
+    for(int i=0; i<5; ++i){
+        fdb_slice_destroy(prefixes[i]);
+    }
+    fdb_slice_destroy(seqkey);
+    return count;
+}
+
+//clearing the marker once all of its seqs are reclaimed, keeping the seqs appended meanwhile, into
+//batch, under dels_mutex_ until batch is written
+static int dels_unmark(fdb_context_t* context, fdb_slot_t* slot, rocksdb_writebatch_t* batch, fdb_slice_t* slice_key,
+                       fdb_slice_t* reclaimed){
+    char *val = NULL;
+    size_t vallen = 0;
+    int ret = dels_get(context, slot, slice_key, 1, &val, &vallen);
+    if(ret != 1){
+        return ret;
+    }
+    fdb_slice_t *slice_val = fdb_slice_create(NULL, 0);
+    for(size_t i=0; i+sizeof(uint32_t)<=vallen; i+=sizeof(uint32_t)){
+        uint32_t seq = rocksdb_decode_fixed32(val + i);
+        if(!dels_has_seq(fdb_slice_data(reclaimed), fdb_slice_length(reclaimed), seq)){
+            fdb_slice_uint32_push_back(slice_val, seq);
+        }
+    }
+    if(fdb_slice_length(slice_val) == 0){
+        rocksdb_writebatch_delete_cf(batch, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key));
+    }else{
+        rocksdb_writebatch_put_cf(batch, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key),
+                                  fdb_slice_data(slice_val), fdb_slice_length(slice_val));
+    }
+    rocksdb_free(val);
+    fdb_slice_destroy(slice_val);
+    return 1;
+}
+
+int dels_self_reclaim(fdb_context_t* context, fdb_slot_t* slot, uint64_t max){
+    int64_t count = 0;
+    uint64_t bytes = 0, markers = 0, visited = 0;
+    char *errptr = NULL;
+    //the markers fully reclaimed, a key and its value each, cleared along with the subkeys in one write
+    fdb_slice_t **done_markers = NULL;
+    size_t num_done = 0;
+
+    fdb_slice_t *slice_start = NULL;
+    encode_dels_key(NULL, 0, &slice_start);
+
+    rocksdb_writebatch_t *batch = rocksdb_writebatch_create();
+    rocksdb_iterator_t *iterator = rocksdb_create_iterator_cf(context->db_, context->scanoptions_, slot->handle_);
+    rocksdb_iter_seek(iterator, fdb_slice_data(slice_start), fdb_slice_length(slice_start));
+
+    //every marker takes one off the budget, one with nothing left to drop as well
+    while(rocksdb_iter_valid(iterator) && (uint64_t)count + visited < max){
+        size_t rklen = 0, rvlen = 0;
+        const char *rkey = rocksdb_iter_key(iterator, &rklen);
+        if(rklen < fdb_slice_length(slice_start) || memcmp(rkey, fdb_slice_data(slice_start), fdb_slice_length(slice_start))!=0){
+            break;
+        }
+        const char *rval = rocksdb_iter_value(iterator, &rvlen);
+        const char *key = rkey + fdb_slice_length(slice_start);
+        size_t keylen = rklen - fdb_slice_length(slice_start);
+        ++visited;
+
+        int done = 1;
+        for(size_t i=0; i+sizeof(uint32_t)<=rvlen; i+=sizeof(uint32_t)){
+            int64_t _count = dels_drop_seq(context, slot, batch, key, keylen, rocksdb_decode_fixed32(rval + i),
+                                           max - count - visited, &bytes, &done);
+            if(_count < 0){
+                count = -1;
+                goto end;
+            }
+            count += _count;
+            if(!done){
+                break;
+            }
+        }
+        if(!done){
+            break;
+        }
+        done_markers = (fdb_slice_t**)fdb_realloc(done_markers, 2 * (num_done + 1) * sizeof(fdb_slice_t*));
+        done_markers[2*num_done] = fdb_slice_create(rkey, rklen);
+        done_markers[2*num_done + 1] = fdb_slice_create(rval, rvlen);
+        ++num_done;
+        rocksdb_iter_next(iterator);
+    }
+
+    if(rocksdb_writebatch_count(batch) > 0 || num_done > 0){
+        rocksdb_mutex_lock(slot->dels_mutex_);
+        for(size_t i=0; i<num_done; ++i){
+            if(dels_unmark(context, slot, batch, done_markers[2*i], done_markers[2*i + 1]) == -1){
+                count = -1;
+                break;
+            }
+        }
+        if(count >= 0){
+            rocksdb_write(context->db_, fdb_slot_writeoptions(context, slot), batch, &errptr);
+        }
+        rocksdb_mutex_unlock(slot->dels_mutex_);
+        if(errptr != NULL){
+            fprintf(stderr, "%s rocksdb_write fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            count = -1;
+        }
+        if(count >= 0){
+            markers = num_done;
+        }
+    }
+
+end:
+    if(count > 0){
+        __sync_add_and_fetch(&slot->dels_subkeys_, (uint64_t)count);
+        __sync_add_and_fetch(&slot->dels_bytes_, bytes);
+    }
+    if(markers > 0){
+        __sync_add_and_fetch(&slot->dels_markers_, markers);
+    }
+    for(size_t i=0; i<2*num_done; ++i){
+        fdb_slice_destroy(done_markers[i]);
+    }
+    fdb_free(done_markers);
+    rocksdb_iter_destroy(iterator);
+    rocksdb_writebatch_destroy(batch);
+    fdb_slice_destroy(slice_start);
+    return (int)count;
+}
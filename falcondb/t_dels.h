@@ -0,0 +1,22 @@
+#ifndef FDB_T_DELS_H
+#define FDB_T_DELS_H
+
+#include "fdb_context.h"
+#include "fdb_slice.h"
+
+
+//appending seq to the deletion marker of the main key, through the slot batch
+int dels_mark(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq);
+
+//whether the subkeys of seq are still waiting to be reclaimed
+int dels_is_marked(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq);
+
+//the seq a newly created main key should start from, so that it never reuses an unreclaimed one
+int dels_next_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* seq);
+
+//dropping orphaned subkeys of deleted main keys, at most max subkeys and markers each call, the
+//markers cleared and the subkeys dropped in one write, returns the subkeys dropped
+int dels_self_reclaim(fdb_context_t* context, fdb_slot_t* slot, uint64_t max);
+
+
+#endif //FDB_T_DELS_H
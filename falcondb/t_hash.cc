@@ -1,12 +1,13 @@
 #include "t_hash.h"
 #include "t_keys.h"
+#include "t_packed.h"
 
 #include "fdb_types.h"
 #include "fdb_iterator.h"
 #include "fdb_define.h"
 #include "fdb_slice.h"
 #include "fdb_context.h"
-#include "fdb_bytes.h"
+#include "fdb_codec.h"
 #include "fdb_malloc.h"
 #include "util.h"
 
@@ -16,124 +17,91 @@
 #include <stdio.h>
 #include <assert.h>
 
-static int hget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t** value); 
+static int hget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field,
+                    fdb_slice_t** value); 
 
-static int hget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length);
+static int hget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length);
 
-static int hset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value); 
+static int hset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field,
+                    fdb_slice_t* value); 
 
-static int hdel_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field);
+static void hput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* field, size_t fieldlen, const char* value, size_t valuelen);
+
+static int hdel_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field);
 
 static int hash_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by);
 
+static int hash_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by);
+
 static int hget_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* fstart, fdb_slice_t* fend, 
                      uint64_t limit, int reverse, fdb_iterator_t** piterator);
 
 
 void encode_hsize_key(const char* key, size_t keylen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_HSIZE);
-    *pslice = slice; 
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_size_key_size(keylen));
+    size_t len = fdb_codec_encode_size_key(buf, FDB_DATA_TYPE_HSIZE, key, keylen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 
-int decode_hsize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){ 
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen);
-
-    uint8_t type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_HSIZE){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_key)==-1){
-        ret = -1;
-        goto end; 
+int decode_hsize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
+    fdb_view_t key;
+    if(fdb_codec_decode_size_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_HSIZE, &key)!=0){
+        return -1;
     }
-    *pslice = slice_key;
-    fdb_incr_ref_count(slice_key);
-    ret = 0;
-
-
-end:
-    fdb_bytes_destroy(bytes);
-    fdb_slice_destroy(slice_key);
-    return ret;
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
 }
 
-void encode_hash_key(const char* key, size_t keylen, const char* field, size_t fieldlen, fdb_slice_t** pslice){ 
-    fdb_slice_t *slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_HASH);
-    fdb_slice_uint8_push_back(slice, '=');
-    fdb_slice_string_push_back(slice, field, fieldlen);
-    *pslice = slice;
+void encode_hash_key(const char* key, size_t keylen, const char* field, size_t fieldlen, fdb_slice_t** pslice){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_member_key_size(keylen, fieldlen));
+    size_t len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_HASH, key, keylen, field, fieldlen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
-int decode_hash_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t **pkey, fdb_slice_t **pfield){
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL, *slice_field = NULL;
-    fdb_bytes_t *bytes = fdb_bytes_create(fdbkey, fdbkeylen);
-
-
-    uint8_t  type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_HASH){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_uint8(bytes, &slice_key)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_field)==-1){
-        ret = -1;
-        goto end;
+int decode_hash_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pfield){
+    fdb_view_t key, field;
+    if(fdb_codec_decode_member_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_HASH, &key, &field)!=0){
+        return -1;
     }
     if(pkey!=NULL){
-        *pkey = slice_key; 
-        fdb_incr_ref_count(slice_key);
+        *pkey = fdb_slice_create(key.data_, key.length_);
     }
     if(pfield!=NULL){
-        *pfield = slice_field;
-        fdb_incr_ref_count(slice_field);
+        *pfield = fdb_slice_create(field.data_, field.length_);
     }
-    ret = 0;
-
-end:
-    fdb_slice_destroy(slice_key);
-    fdb_slice_destroy(slice_field);
-    fdb_bytes_destroy(bytes);
-    return ret;
+    return 0;
 }
 
-static int hget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t** pslice){
+static int hget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field,
+                    fdb_slice_t** pslice){
+    if(packed != NULL){
+        long pos = packed_find(packed, fdb_slice_data(field), fdb_slice_length(field));
+        if(pos < 0){
+            return 0;
+        }
+        const packed_entry_t *entry = packed_at(packed, (size_t)pos);
+        *pslice = fdb_slice_create(entry->value_.data_, entry->value_.length_);
+        return 1;
+    }
     char *val = NULL, *errptr = NULL;
     size_t vallen = 0;
 
-    fdb_slice_t* slice_key = NULL;
-    encode_hash_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(field), fdb_slice_length(field), &slice_key);
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(field)));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_HASH, fdb_slice_data(key), fdb_slice_length(key),
+                                                   fdb_slice_data(field), fdb_slice_length(field));
 
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
+    val = fdb_slot_writebatch_get(context, slot, fdbkey, fdbkeylen, &vallen, &errptr);
+    fdb_codec_buf_free(stack, fdbkey);
 
     int ret = 0;
     if(errptr!=NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
         rocksdb_free(errptr);
         ret = -1;
         goto end;
@@ -152,43 +120,16 @@ end:
     return ret;
 }
 
-static int hget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length){ 
-    char *val = NULL, *errptr = NULL;
-    size_t vallen = 0;
-
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    fdb_slice_t* slice_key = NULL;
-    encode_hsize_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-    val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
-
-    int ret = 0;
-    if(errptr!=NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
-        rocksdb_free(errptr);
-        ret = -1;
-        goto end;
-    }
-    if(val!=NULL){
-        if(vallen < sizeof(uint64_t)){
-            ret = -1;
-            goto end;
-        }
-        *length = rocksdb_decode_fixed64(val);
-        ret = 1;
-    }else{
-        ret = 0;
+static int hget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length){
+    if(packed != NULL){
+        *length = packed_length(packed);
+        return 1;
     }
-
-end:
-    if(val != NULL){
-        rocksdb_free(val); 
-    }
-    return ret;
+    return (keys_get_count(context, slot, key, FDB_DATA_TYPE_HSIZE, length) == FDB_OK) ? 1 : -1;
 }
 
-static int hset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value){
+static int hset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field,
+                    fdb_slice_t* value){
 
     if(fdb_slice_length(key)==0 || fdb_slice_length(field)==0){
         fprintf(stderr, "%s empty key or field!\n", __func__);
@@ -202,46 +143,38 @@ static int hset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         fprintf(stderr, "%s field too long!\n", __func__);
         return -1;
     }
-    fdb_slice_t *slice_key = NULL;
+    if(packed != NULL){
+        return packed_put(packed, fdb_slice_data(field), fdb_slice_length(field), fdb_slice_data(value),
+                          fdb_slice_length(value), 0.0);
+    }
     fdb_slice_t *slice_val = NULL;
-    int ret = hget_one(context, slot, key, field, &slice_val);
-    if(ret == 0){
-        encode_hash_key(fdb_slice_data(key),
-                        fdb_slice_length(key),
-                        fdb_slice_data(field),
-                        fdb_slice_length(field),
-                        &slice_key);
-
-        fdb_slot_writebatch_put(slot,
-                                fdb_slice_data(slice_key),
-                                fdb_slice_length(slice_key),
-                                fdb_slice_data(value),
-                                fdb_slice_length(value));
-        ret = 1;
-    }else if(ret == 1){
-        encode_hash_key(fdb_slice_data(key),
-                        fdb_slice_length(key),
-                        fdb_slice_data(field),
-                        fdb_slice_length(field),
-                        &slice_key);
-
-        fdb_slot_writebatch_put(slot,
-                                fdb_slice_data(slice_key),
-                                fdb_slice_length(slice_key),
-                                fdb_slice_data(value),
-                                fdb_slice_length(value)); 
-        ret = 0;
+    int ret = hget_one(context, slot, key, NULL, field, &slice_val);
+    if(ret == 0 || ret == 1){
+        hput_one(slot, key, fdb_slice_data(field), fdb_slice_length(field), fdb_slice_data(value), fdb_slice_length(value));
+        ret = (ret == 0) ? 1 : 0;
     }else{
         ret = -1;
     }
 
-    fdb_slice_destroy(slice_key);
     fdb_slice_destroy(slice_val);
     return ret;
 }
 
+static void hput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* field, size_t fieldlen, const char* value, size_t valuelen){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fieldlen));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_HASH, fdb_slice_data(key), fdb_slice_length(key),
+                                                   field, fieldlen);
+    fdb_slot_writebatch_put(slot,
+                            fdbkey,
+                            fdbkeylen,
+                            value,
+                            valuelen);
+    fdb_codec_buf_free(stack, fdbkey);
+}
 
-static int hdel_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field){
+
+static int hdel_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* field){
     if(fdb_slice_length(key) > FDB_DATA_TYPE_KEY_LEN_MAX){
         fprintf(stderr, "%s key too long!\n", __func__);
         return -1;
@@ -251,62 +184,108 @@ static int hdel_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         return -1;
     }
 
+    if(packed != NULL){
+        return packed_del(packed, fdb_slice_data(field), fdb_slice_length(field));
+    }
     fdb_slice_t *slice_val = NULL;
-    if(hget_one(context, slot, key, field, &slice_val) <=0){
+    if(hget_one(context, slot, key, NULL, field, &slice_val) <=0){
         return 0;
     }
+    fdb_slice_destroy(slice_val);
 
-    fdb_slice_t *slice_key = NULL;
-    encode_hash_key(fdb_slice_data(key),
-                    fdb_slice_length(key),
-                    fdb_slice_data(field),
-                    fdb_slice_length(field),
-                    &slice_key);
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(field)));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_HASH, fdb_slice_data(key), fdb_slice_length(key),
+                                                   fdb_slice_data(field), fdb_slice_length(field));
+    fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
+    fdb_codec_buf_free(stack, fdbkey);
+    return 1;
+}
 
-    fdb_slot_writebatch_delete(slot,
-                               fdb_slice_data(slice_key),
-                               fdb_slice_length(slice_key));
+static int hash_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by){
+    if(by == 0){
+        return 0;
+    }
+    return (keys_incr_count(context, slot, key, FDB_DATA_TYPE_HSIZE, by) == FDB_OK) ? 0 : -1;
+}
 
-    fdb_slice_destroy(slice_key);
-    return 1;
+//a hash in subkeys has its size moved by by, a packed one is written back whole, or moved to
+//subkeys for good once past the packed limits
+static int hash_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by){
+    if(packed == NULL){
+        return hash_incr_size(context, slot, key, by);
+    }
+    if(packed_fits(context, packed)){
+        return (packed_store(context, slot, key, packed) == FDB_OK) ? 0 : -1;
+    }
+    for(size_t i=0; i<packed_length(packed); ++i){
+        const packed_entry_t *entry = packed_at(packed, i);
+        hput_one(slot, key, entry->member_.data_, entry->member_.length_, entry->value_.data_, entry->value_.length_);
+    }
+    if(keys_set_packed(context, slot, key, NULL) != FDB_OK){
+        return -1;
+    }
+    return hash_incr_size(context, slot, key, (int64_t)packed_length(packed));
 }
 
-static int hash_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by){  
-    uint64_t length = 0;
-    int ret = hget_len(context, slot, key, &length);
-    if(ret!=0 && ret != 1){
+//fields and or values of the whole hash pushed to array
+static int hget_all(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int fields, int values,
+                    fdb_array_t* array){
+    if(packed != NULL){
+        for(size_t i=0; i<packed_length(packed); ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(fields){
+                fdb_val_node_t* fnode = fdb_val_node_create_in(fdb_arena_current());
+                fnode->retval_ = FDB_OK;
+                fnode->val_.vval_ = fdb_slice_create(entry->member_.data_, entry->member_.length_);
+                fdb_array_push_back(array, fnode);
+            }
+            if(values){
+                fdb_val_node_t* vnode = fdb_val_node_create_in(fdb_arena_current());
+                vnode->retval_ = FDB_OK;
+                vnode->val_.vval_ = fdb_slice_create(entry->value_.data_, entry->value_.length_);
+                fdb_array_push_back(array, vnode);
+            }
+        }
+        return 0;
+    }
+    fdb_iterator_t *iterator = NULL;
+    if(hget_scan(context, slot, key, NULL, NULL, 20000000, 0, &iterator)!=0){
         return -1;
     }
-    int64_t size = (int64_t)length;
-    size += by;
-
-    fdb_slice_t* slice_key = NULL;
-    encode_hsize_key(fdb_slice_data(key),
-            fdb_slice_length(key),
-            &slice_key);
-    if(size <= 0){
-        fdb_slot_writebatch_delete(slot,
-                fdb_slice_data(slice_key),
-                fdb_slice_length(slice_key));
-    }else{
-        char buff[sizeof(uint64_t)] = {0};
-        length = size;
-        rocksdb_encode_fixed64(buff, length);
-        fdb_slot_writebatch_put(slot,
-                fdb_slice_data(slice_key),
-                fdb_slice_length(slice_key),
-                buff,
-                sizeof(buff));
-    }
-    fdb_slice_destroy(slice_key);
+    while(fdb_iterator_valid(iterator)){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
+        fdb_slice_t* field = NULL;
+        if(decode_hash_key(rkey, rklen, NULL, fields ? &field : NULL)==0){
+            if(fields){
+                fdb_val_node_t* fnode = fdb_val_node_create_in(fdb_arena_current());
+                fnode->retval_ = FDB_OK;
+                fnode->val_.vval_ = field;
+                fdb_array_push_back(array, fnode);
+            }
+            if(values){
+                fdb_val_node_t* vnode = fdb_val_node_create_in(fdb_arena_current());
+                vnode->retval_ = FDB_OK;
+                vnode->val_.vval_ = fdb_slice_create(rval, rvlen);
+                fdb_array_push_back(array, vnode);
+            }
+        } 
+        if(fdb_iterator_next(iterator)){
+            break;
+        }
+    }
+    fdb_iterator_destroy(iterator);
     return 0;
 }
 
 
 int hash_get(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t** pslice){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
-        int ret = hget_one(context, slot, key, field, pslice);
+        int ret = hget_one(context, slot, key, packed, field, pslice);
         if(ret == 1){
             retval = FDB_OK;
         }else if(ret == 0){
@@ -315,203 +294,269 @@ int hash_get(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_sli
             retval = FDB_ERR;
         }
     }
+    packed_destroy(packed);
     return  retval;
 }
 
 
 int hash_getall(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
-        fdb_iterator_t *iterator = NULL;
-        if(hget_scan(context, slot, key, NULL, NULL, 20000000, 0, &iterator)!=0){
-            return FDB_OK_RANGE_HAVE_NONE;
-        }
         fdb_array_t *array = fdb_array_create(128);
-        do{
-            size_t rklen = 0, rvlen = 0;
-            const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
-            const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
-            fdb_slice_t* field = NULL;
-            if(decode_hash_key(rkey, rklen, NULL, &field)==0){
-                fdb_val_node_t* fnode = fdb_val_node_create();
-                fnode->retval_ = FDB_OK;
-                fnode->val_.vval_ = field;
-                fdb_array_push_back(array, fnode);
-
-                fdb_val_node_t* vnode = fdb_val_node_create();
-                vnode->retval_ = FDB_OK;
-                vnode->val_.vval_ = fdb_slice_create(rval, rvlen);
-                fdb_array_push_back(array, vnode);
-            } 
-        }while(!fdb_iterator_next(iterator));
-        fdb_iterator_destroy(iterator);
-        *rets = array;
-        retval = FDB_OK; 
+        if(hget_all(context, slot, key, packed, 1, 1, array)!=0){
+            fdb_array_destroy(array);
+            retval = FDB_OK_RANGE_HAVE_NONE;
+        }else{
+            *rets = array;
+            retval = FDB_OK; 
+        }
     }
+    packed_destroy(packed);
     return retval;
 }
 
 int hash_keys(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
-        fdb_iterator_t *iterator = NULL;
-        if(hget_scan(context, slot, key, NULL, NULL, 20000000, 0, &iterator)!=0){
-            return FDB_OK_RANGE_HAVE_NONE;
-        }
         fdb_array_t *array = fdb_array_create(128);
-        do{
-            size_t rklen = 0;
-            const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
-            fdb_slice_t* field = NULL;
-            if(decode_hash_key(rkey, rklen, NULL, &field)==0){
-                fdb_val_node_t* node = fdb_val_node_create();
-                node->retval_ = FDB_OK;
-                node->val_.vval_ = field;
-                fdb_array_push_back(array, node);
-            } 
-        }while(!fdb_iterator_next(iterator));
-        fdb_iterator_destroy(iterator);
-        *rets = array;
-        retval = FDB_OK; 
+        if(hget_all(context, slot, key, packed, 1, 0, array)!=0){
+            fdb_array_destroy(array);
+            retval = FDB_OK_RANGE_HAVE_NONE;
+        }else{
+            *rets = array;
+            retval = FDB_OK; 
+        }
     } 
+    packed_destroy(packed);
     return retval;
 }
 
 int hash_vals(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t** rets){ 
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
-        fdb_iterator_t *iterator = NULL;
-        if(hget_scan(context, slot, key, NULL, NULL, 20000000, 0, &iterator)!=0){
-            return FDB_OK_RANGE_HAVE_NONE;
-        }
         fdb_array_t *array = fdb_array_create(128);
-        do{
-            size_t rklen = 0, rvlen = 0;
-            const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
-            const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
-            if(decode_hash_key(rkey, rklen, NULL, NULL)==0){
-                fdb_val_node_t* vnode = fdb_val_node_create();
-                vnode->retval_ = FDB_OK;
-                vnode->val_.vval_ = fdb_slice_create(rval, rvlen);
-                fdb_array_push_back(array, vnode);
-            } 
-        }while(!fdb_iterator_next(iterator));
-        fdb_iterator_destroy(iterator);
-        *rets = array;
-        retval = FDB_OK; 
+        if(hget_all(context, slot, key, packed, 0, 1, array)!=0){
+            fdb_array_destroy(array);
+            retval = FDB_OK_RANGE_HAVE_NONE;
+        }else{
+            *rets = array;
+            retval = FDB_OK; 
+        }
     }
-
+    packed_destroy(packed);
     return retval;
 }
 
 int hash_mget(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* fields, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
-    if(retval == FDB_OK){
-        int len = fields->length_;
-        fdb_array_t *array = fdb_array_create(len);
-        for(size_t i=0; i<fields->length_; ++i){ 
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    size_t len = fields->length_;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_array_t *array = fdb_array_create(len);
+    if(packed != NULL){
+        for(size_t i=0; i<len; ++i){ 
             fdb_slice_t *fld = (fdb_slice_t*)(fdb_array_at(fields, i)->val_.vval_);
             fdb_slice_t *val = NULL;
-            fdb_val_node_t *node = fdb_val_node_create(); 
-            int ret = hget_one(context, slot, key, fld, &val);
-            if(ret == 1){
-                node->retval_ = FDB_OK;
-                node->val_.vval_ = val;
-            }else if(ret == 0){
-                node->retval_ = FDB_OK_NOT_EXIST;
-            }else{
-                node->retval_ = FDB_ERR;
-            }
+            fdb_val_node_t *node = fdb_val_node_create_in(arena); 
+            int ret = hget_one(context, slot, key, packed, fld, &val);
+            node->retval_ = (ret == 1) ? FDB_OK : FDB_OK_NOT_EXIST;
+            node->val_.vval_ = val;
             fdb_array_push_back(array, node);
         }
-        retval = FDB_OK;
-        *rets = array; 
+        packed_destroy(packed);
+        *rets = array;
+        return FDB_OK;
+    }
+
+    //the fields of a hash in subkeys are read together
+    fdb_slice_t **flds = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    char **vals = (char**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(char*));
+    size_t *vallens = (size_t*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(size_t));
+    for(size_t i=0; i<len; ++i){
+        flds[i] = (fdb_slice_t*)(fdb_array_at(fields, i)->val_.vval_);
+    }
+    int ret = keys_get_members(context, slot, key, FDB_DATA_TYPE_HASH, len, flds, vals, vallens, NULL);
+    for(size_t i=0; i<len; ++i){ 
+        fdb_val_node_t *node = fdb_val_node_create_in(arena); 
+        if(ret != 0){
+            node->retval_ = FDB_ERR;
+        }else if(vals[i] != NULL){
+            node->retval_ = FDB_OK;
+            node->val_.vval_ = fdb_slice_create(vals[i], vallens[i]);
+            rocksdb_free(vals[i]);
+        }else{
+            node->retval_ = FDB_OK_NOT_EXIST;
+        }
+        fdb_array_push_back(array, node);
     }
-
-    return retval;
+    fdb_free_in(arena, flds);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, vallens);
+    *rets = array; 
+    return FDB_OK;
 }
 
 
 int hash_mset(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* fvs, int64_t* count){ 
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_HASH);
-    if(retval != FDB_OK){
-        return retval;
-    }
     if((fvs->length_%2)==1){
         return FDB_ERR_WRONG_NUMBER_ARGUMENTS;
     }
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 1, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    //a field repeated in fvs is read back from the batch and counted once
     int64_t _count = 0;
     for(size_t i=0; i<fvs->length_;){
         fdb_slice_t *field = (fdb_slice_t*)(fdb_array_at(fvs, i++)->val_.vval_);
         fdb_slice_t *value = (fdb_slice_t*)(fdb_array_at(fvs, i++)->val_.vval_);
-        int ret = hset_one(context, slot, key, field, value);
-        if(ret >=0){
-            if(ret > 0){
-                if(hash_incr_size(context, slot, key, 1) == 0){
-                    ++_count; 
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
-            } 
+        int ret = hset_one(context, slot, key, packed, field, value);
+        if(ret > 0){
+            ++_count; 
         }
     }
+    int ret = hash_update(context, slot, key, packed, _count);
+    packed_destroy(packed);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    } 
     *count = _count;
     return FDB_OK;
 }
 
 
+int hash_hscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+               uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    fdb_array_t *array = fdb_array_create(32);
+    fdb_slice_t *next = NULL;
+    if(packed != NULL){
+        for(size_t i=0; i<packed_length(packed); ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(keys_match(pattern, entry->member_.data_, entry->member_.length_)){
+                fdb_val_node_t* fnode = fdb_val_node_create_in(fdb_arena_current());
+                fnode->retval_ = FDB_OK;
+                fnode->val_.vval_ = fdb_slice_create(entry->member_.data_, entry->member_.length_);
+                fdb_array_push_back(array, fnode);
+                fdb_val_node_t* vnode = fdb_val_node_create_in(fdb_arena_current());
+                vnode->retval_ = FDB_OK;
+                vnode->val_.vval_ = fdb_slice_create(entry->value_.data_, entry->value_.length_);
+                fdb_array_push_back(array, vnode);
+            }
+        }
+        packed_destroy(packed);
+        *rets = array;
+        *pcursor = NULL;
+        return FDB_OK;
+    }
+
+    fdb_iterator_t *iterator = NULL;
+    hget_scan(context, slot, key, cursor, NULL, count, 0, &iterator);
+    uint64_t seen = 0;
+    int more = fdb_iterator_valid(iterator);
+    while(more && seen < count){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
+        fdb_view_t field;
+        if(fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_HASH, NULL, &field)==0){
+            if(keys_match(pattern, field.data_, field.length_)){
+                fdb_val_node_t* fnode = fdb_val_node_create_in(fdb_arena_current());
+                fnode->retval_ = FDB_OK;
+                fnode->val_.vval_ = fdb_slice_create(field.data_, field.length_);
+                fdb_array_push_back(array, fnode);
+                fdb_val_node_t* vnode = fdb_val_node_create_in(fdb_arena_current());
+                vnode->retval_ = FDB_OK;
+                vnode->val_.vval_ = fdb_slice_create(rval, rvlen);
+                fdb_array_push_back(array, vnode);
+            }
+            if(++seen == count){
+                next = fdb_slice_create(field.data_, field.length_);
+            }
+        }
+        more = (fdb_iterator_next(iterator) == 0);
+    }
+    fdb_iterator_destroy(iterator);
+    if(!more){
+        fdb_slice_destroy(next);
+        next = NULL;
+    }
+    *rets = array;
+    *pcursor = next;
+    return FDB_OK;
+}
+
 int hash_set(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value, int64_t* count){ 
 
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 1, &packed);
     if(retval != FDB_OK){
         return retval;
     }
 
-    int ret = hset_one(context, slot, key, field, value); 
+    int ret = hset_one(context, slot, key, packed, field, value); 
     int64_t _count = 0;
     if(ret >=0){
-        if(ret > 0){
-            if(hash_incr_size(context, slot, key, 1) == 0){
-                _count = 1;
-            }else{
-                return FDB_ERR;
-            }
+        if(hash_update(context, slot, key, packed, ret) == 0){
+            _count = ret;
+        }else{
+            fdb_slot_writebatch_discard(context, slot);
+            packed_destroy(packed);
+            return FDB_ERR;
         }
         char *errptr = NULL;
         fdb_slot_writebatch_commit(context, slot, &errptr);
         if(errptr != NULL){
             fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
             rocksdb_free(errptr);
-            return FDB_ERR;
+            retval = FDB_ERR;
         }else{
             *count = _count;
+            retval = FDB_OK;
         } 
-        retval = FDB_OK;
     }else{
+        fdb_slot_writebatch_discard(context, slot);
         retval = FDB_ERR;
     }
 
+    packed_destroy(packed);
     return retval;
 }
 
 
 int hash_setnx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value, int64_t* count){ 
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 1, &packed);
     if(retval == FDB_OK){
         fdb_slice_t* slice_val = NULL;
-        int ret = hget_one(context, slot, key, field, &slice_val);
+        int ret = hget_one(context, slot, key, packed, field, &slice_val);
         if(ret == 1){
             retval = FDB_OK_BUT_ALREADY_EXIST;
         }else if(ret == 0){
-            ret = hset_one(context, slot, key, field, value);
+            ret = hset_one(context, slot, key, packed, field, value);
             int64_t _count = 0;
-            if(ret > 0){
-                if(hash_incr_size(context, slot, key, 1) == 0){
-                    _count = 1;
+            if(ret >= 0){
+                if(hash_update(context, slot, key, packed, ret) == 0){
+                    _count = ret;
                 }else{
                     retval = FDB_ERR;
                     goto end;
@@ -535,15 +580,18 @@ int hash_setnx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_s
     }
 
 end:
+    if(retval != FDB_OK) fdb_slot_writebatch_discard(context, slot);
+    packed_destroy(packed);
     return retval;
 }
 
 
 int hash_length(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* length){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
         uint64_t len = 0;
-        int ret =  hget_len(context, slot, key, &len);
+        int ret =  hget_len(context, slot, key, packed, &len);
         if(ret == 1){
             *length = (int64_t)len;
             retval = FDB_OK;
@@ -554,12 +602,14 @@ int hash_length(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int6
             retval = FDB_ERR;
         }
     }
+    packed_destroy(packed);
     return retval;
 }
 
 
 int hash_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* fields, int64_t* count){ 
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
@@ -567,30 +617,34 @@ int hash_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_arr
     int64_t _count = 0;
     for(size_t i=0; i<fields->length_; ++i){ 
         fdb_slice_t *field = (fdb_slice_t*)(fdb_array_at(fields, i)->val_.vval_);
-        int ret = hdel_one(context, slot, key, field);
-        if(ret >=0){
-            if(ret > 0){
-                if(hash_incr_size(context, slot, key, -1)==0){
-                    ++_count;
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", errptr, __func__);
-                rocksdb_free(errptr);
-            }
+        int ret = hdel_one(context, slot, key, packed, field);
+        if(ret > 0){
+            ++_count;
         }
     }
+    int ret = (_count > 0) ? hash_update(context, slot, key, packed, -_count) : 0;
+    packed_destroy(packed);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
     *count = _count;
     return FDB_OK;
 }
 
 int hash_exists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, int64_t* count){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_HASH);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 0, &packed);
     if(retval == FDB_OK){
         fdb_slice_t *slice_val = NULL;
-        int ret = hget_one(context, slot, key, field, &slice_val);
+        int ret = hget_one(context, slot, key, packed, field, &slice_val);
         if(ret >= 0){
             retval = FDB_OK;
             *count = (ret==0 ? 0 : 1);
@@ -599,67 +653,68 @@ int hash_exists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_
         }
         fdb_slice_destroy(slice_val);
     }
+    packed_destroy(packed);
     return retval;
 }
 
 int hash_incr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, int64_t init, int64_t by, int64_t* val){
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_HASH);
+    if(fdb_slice_length(key)==0 || fdb_slice_length(field)==0){
+        fprintf(stderr, "%s empty key or field!\n", __func__);
+        return FDB_ERR;
+    }
+    if(fdb_slice_length(key) > FDB_DATA_TYPE_KEY_LEN_MAX || fdb_slice_length(field) > FDB_DATA_TYPE_KEY_LEN_MAX){
+        fprintf(stderr, "%s name or field too long!\n", __func__);
+        return FDB_ERR;
+    }
+    packed_t *packed = NULL;
+    fdb_slice_t *slice_value = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_HASH, 1, &packed);
     if(retval == FDB_OK){
-        fdb_slice_t *slice_value = NULL;
-        int ret = hget_one(context, slot, key, field, &slice_value);
+        //the one read of the field tells both its value and whether the hash grows
+        int ret = hget_one(context, slot, key, packed, field, &slice_value);
+        int64_t old = init;
         if(ret == 1){ 
             if(fdb_slice_length(slice_value) == 0){
                 retval = FDB_ERR_IS_NOT_INTEGER;
                 goto end;
             }
-            long long old = atoll(fdb_slice_data(slice_value));
-            if(is_int64_overflow(old, by)){
-                retval = FDB_ERR_INCDECR_OVERFLOW;
-                goto end;
-            }
-            char buff[128] = {0};
-            sprintf(buff, "%lld", (long long)(old + by));
-            *val = old + by;
-            fdb_slice_destroy(slice_value);
-            slice_value = fdb_slice_create(buff, strlen(buff));
-        }else if(ret == 0){
-            if(is_int64_overflow(init, by)){
-                retval = FDB_ERR_INCDECR_OVERFLOW;
-                goto end;
-            } 
-            char buff[128] = {0};
-            sprintf(buff, "%lld", (long long)(init + by));
-            *val = init + by;
-            fdb_slice_destroy(slice_value);
-            slice_value = fdb_slice_create(buff, strlen(buff));
-        }else{
+            old = (int64_t)atoll(fdb_slice_data(slice_value));
+        }else if(ret != 0){
             retval = FDB_ERR;
             goto end;
         }
-        ret = hset_one(context, slot, key, field, slice_value);
-        fdb_slice_destroy(slice_value);
-        if(ret >=0){
-            if(ret > 0){
-                if(hash_incr_size(context, slot, key, 1) != 0){
-                    retval = FDB_ERR;
-                    goto end;
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
-                retval = FDB_ERR;
-                goto  end;
-            }
-            retval = FDB_OK;
+        if(is_int64_overflow(old, by)){
+            retval = FDB_ERR_INCDECR_OVERFLOW;
+            goto end;
+        }
+        char buff[32];
+        int len = snprintf(buff, sizeof(buff), "%lld", (long long)(old + by));
+        int added = (ret == 0) ? 1 : 0;
+        if(packed != NULL){
+            added = packed_put(packed, fdb_slice_data(field), fdb_slice_length(field), buff, len, 0.0);
         }else{
+            hput_one(slot, key, fdb_slice_data(field), fdb_slice_length(field), buff, len);
+        }
+        if(hash_update(context, slot, key, packed, added) != 0){
+            retval = FDB_ERR;
+            goto end;
+        }
+        char *errptr = NULL;
+        fdb_slot_writebatch_commit(context, slot, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
             retval = FDB_ERR;
+            goto  end;
         }
+        *val = old + by;
+        retval = FDB_OK;
     } 
 
 end:
+    if(retval != FDB_OK) fdb_slot_writebatch_discard(context, slot);
+    fdb_slice_destroy(slice_value);
+    packed_destroy(packed);
     return retval;
 }
 
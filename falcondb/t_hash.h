@@ -9,7 +9,7 @@
 
 
 void encode_hsize_key(const char* key, size_t keylen, fdb_slice_t** pslice);
-int decode_hsize_key(const char* fdbkey, size_t fdbkeylen, uint64_t* size);
+int decode_hsize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice);
 
 
 void encode_hash_key(const char* key, size_t keylen, const char* field, size_t fieldlen, fdb_slice_t** pslice);
@@ -29,6 +29,12 @@ int hash_keys(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_ar
 
 int hash_vals(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t** rets);
 
+//a chunk of the hash past the field cursor, in field order, at most count fields looked at, field
+//and value nodes for those matching pattern, *pcursor is the cursor of the next chunk or NULL
+//once done, a packed hash is small enough to come back in one chunk
+int hash_hscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+               uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor);
+
 int hash_set(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value, int64_t* count);
 
 int hash_setnx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* field, fdb_slice_t* value, int64_t* count);
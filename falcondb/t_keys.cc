@@ -1,12 +1,15 @@
 #include "t_keys.h"
+#include "t_dels.h"
+#include "t_packed.h"
 
 #include "util.h"
 #include "fdb_types.h"
 #include "fdb_define.h"
 #include "fdb_slice.h"
 #include "fdb_context.h"
-#include "fdb_bytes.h"
+#include "fdb_codec.h"
 #include "fdb_malloc.h"
+#include "fdb_cache.h"
 
 #include <rocksdb/c.h>
 #include <string.h>
@@ -16,85 +19,54 @@
 
 
 void encode_keys_key(const char* key, size_t keylen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, '+');
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_KEYS);
-    *pslice =  slice;
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_keys_key_size(keylen));
+    size_t len = fdb_codec_encode_keys_key(buf, key, keylen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 void encode_dels_key(const char* key, size_t keylen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, '-');
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_DELS);
-    *pslice =  slice;
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_dels_key_size(keylen));
+    size_t len = fdb_codec_encode_dels_key(buf, key, keylen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
-int decode_keys_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen);
+void encode_ttl_key(const char* key, size_t keylen, int64_t ts, fdb_slice_t** pslice){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_ttl_key_size(keylen));
+    size_t len = fdb_codec_encode_ttl_key(buf, key, keylen, ts);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
+}
 
-    uint8_t type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto err;
-    }
-    if(type != FDB_DATA_TYPE_KEYS){
-        ret = -1;
-        goto err;
-    }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto err;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_key) == -1){
-        ret = -1;
-        goto err;
+int decode_keys_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
+    fdb_view_t key;
+    if(fdb_codec_decode_keys_key(fdbkey, fdbkeylen, &key)!=0){
+        return -1;
     }
-    *pslice = slice_key;
-    ret = 0;
-    goto end;
-
-err:
-    fdb_slice_destroy(slice_key);
-    ret = -1;
-end: 
-    fdb_bytes_destroy(bytes);
-    return ret;
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
 }
 
 int decode_dels_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen);
-
-    uint8_t type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_DELS){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto err;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_key) == -1){
-        ret = -1;
-        goto err;
+    fdb_view_t key;
+    if(fdb_codec_decode_dels_key(fdbkey, fdbkeylen, &key)!=0){
+        return -1;
     }
-    *pslice = slice_key;
-    ret = 0;
-    goto end;
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
+}
 
-err:
-    fdb_slice_destroy(slice_key);
-    ret = -1;
-end: 
-    fdb_bytes_destroy(bytes);
-    return ret;
+int decode_ttl_key(const char* fdbkey, size_t fdbkeylen, int64_t* ts, fdb_slice_t** pslice){
+    fdb_view_t key;
+    if(fdb_codec_decode_ttl_key(fdbkey, fdbkeylen, ts, &key)!=0){
+        return -1;
+    }
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
 }
 
 
@@ -104,7 +76,9 @@ struct keys_val_t{
     uint8_t     stat_;
     uint32_t    seq_;
     int64_t     ts_;
-    void*       slice_;
+    int64_t     count_;     //members of a collection in subkeys, -1 if in its legacy size key
+    void*       slice_;     //the string, or the payload of a packed collection
+    uint8_t     int64_;     //the string is slice_ as a fixed64, see keys_incr_string
 };
 
 typedef struct keys_val_t  keys_val_t;
@@ -113,15 +87,15 @@ static keys_val_t* create_keys_val(){
     keys_val_t *val = (keys_val_t*)fdb_malloc(sizeof(keys_val_t));
     memset(val, 0, sizeof(keys_val_t));
     val->ts_ = 0;
+    val->count_ = -1;
     val->ref_.refcnt_ = 1;
     return val;
 }
 
 static void destroy_keys_val(keys_val_t* kval){
     if(kval!=NULL){
-        kval->ref_.refcnt_ -= 1;
-        if(kval->ref_.refcnt_ == 0){
-            if(kval->type_ == FDB_DATA_TYPE_STRING){
+        if(__sync_sub_and_fetch(&kval->ref_.refcnt_, 1) == 0){
+            if(kval->slice_ != NULL){
                 fdb_slice_destroy(kval->slice_);
             }
             fdb_free(kval);
@@ -130,118 +104,80 @@ static void destroy_keys_val(keys_val_t* kval){
 }
 
 
-static void deleter_for_keys_val(const char* key, size_t keylen, void* val){
+static void deleter_for_keys_val(void* val){
     destroy_keys_val((keys_val_t*)val);
 }
 
 static size_t charge_keys_val(fdb_slice_t* key, const keys_val_t* kval){
     size_t result = fdb_slice_length(key);
-    if(kval->type_ == FDB_DATA_TYPE_STRING){
-        if(kval->slice_!=NULL){
-            result += fdb_slice_length((fdb_slice_t*)(kval->slice_));
-        }
+    if(kval->slice_!=NULL){
+        result += fdb_slice_length((fdb_slice_t*)(kval->slice_));
     }
     return result;
 }
 
 static int decode_keys_val(const char* val, size_t vallen, keys_val_t** pkval){
-    int ret = 0;
+    fdb_view_t payload;
     keys_val_t *kval = create_keys_val();
-    fdb_bytes_t* bytes = fdb_bytes_create(val, vallen);
-
-    size_t left = 0;
-    if(fdb_bytes_read_uint8(bytes, &(kval->type_))==-1){
-        ret = -1;
-        goto err;
-    }
-    if(fdb_bytes_read_uint8(bytes, &(kval->stat_))==-1){
-        ret = -1;
-        goto err;
-    }
-    if(fdb_bytes_read_uint32(bytes, &(kval->seq_))==-1){
-        ret = -1;
-        goto err;
+    if(fdb_codec_decode_keys_val(val, vallen, &(kval->type_), &(kval->stat_), &(kval->seq_), &(kval->ts_), &payload)!=0){
+        destroy_keys_val(kval);
+        return -1;
     }
-    if(fdb_bytes_read_int64(bytes, &(kval->ts_))==-1){
-        ret = -1;
-        goto err;
-    }
-    left = vallen - sizeof(uint8_t)*2 - sizeof(uint32_t) - sizeof(int64_t);
-    if(left>=0){
-        if(kval->type_ == FDB_DATA_TYPE_STRING && left>0){
-            fdb_slice_t *_val = NULL;
-            if(fdb_bytes_read_slice_len_left(bytes, &_val) == -1){
-                ret = -1;
-                goto err;
-            } 
-            kval->slice_ = _val; 
-        }else{
-            kval->slice_ = NULL;
+    if(kval->type_ == FDB_DATA_TYPE_INT64){
+        if(payload.length_ != sizeof(uint64_t)){
+            destroy_keys_val(kval);
+            return -1;
         }
+        kval->type_ = FDB_DATA_TYPE_STRING;
+        kval->int64_ = 1;
+    }
+    //the payload outlives val in the keys cache, so it is the one copy made, a collection
+    //without one keeps its members in subkeys and their count in its size key
+    uint64_t count = 0;
+    if(kval->type_ != FDB_DATA_TYPE_STRING &&
+       fdb_codec_decode_subkeys_payload(payload.data_, payload.length_, &count) == 0){
+        kval->count_ = (int64_t)count;
+        kval->slice_ = NULL;
+    }else if(payload.length_ > 0){
+        kval->slice_ = fdb_slice_create(payload.data_, payload.length_);
+    }else{
+        kval->slice_ = NULL;
     }
     *pkval = kval;
-    ret = 0;
-    goto end;
-    
-err:
-    destroy_keys_val(kval);
-    ret = -1;
-    
-end:
-    fdb_bytes_destroy(bytes);
-    return ret;
+    return 0;
 }
 
-static void encode_keys_val(keys_val_t* kval, fdb_slice_t** pslice){ 
-    char buf[sizeof(uint8_t)] = {0};
-    rocksdb_encode_fixed8(buf, kval->type_);
-    fdb_slice_t *slice_val = fdb_slice_create(buf, sizeof(uint8_t));
-
-    fdb_slice_uint8_push_back(slice_val, kval->stat_);
-    fdb_slice_uint32_push_back(slice_val, kval->seq_);
-    fdb_slice_uint64_push_back(slice_val, kval->ts_);
-    if(kval->type_ == FDB_DATA_TYPE_STRING){
-        if(kval->slice_!=NULL){
-            fdb_slice_string_push_back(slice_val, 
-                                       fdb_slice_data((fdb_slice_t*)(kval->slice_)), 
-                                       fdb_slice_length((fdb_slice_t*)(kval->slice_)));
-        } 
+//cached for main keys known not to exist, it is never freed as its count starts at 1
+static keys_val_t keys_val_absent = {{1}, 0, 0, 0, 0, -1, NULL, 0};
+
+//1 or 0 as the keys cache knows key, 2 if it does not
+static int lookup_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t** pkval){
+    //what the command changed so far, then the keys cache, the value is shared with other readers
+    //and never changed
+    *pkval = (keys_val_t*)fdb_slot_writebatch_cached(slot, fdb_slice_data(key), fdb_slice_length(key));
+    if(*pkval == NULL){
+        fdb_cache_t *cache = (fdb_cache_t*)context->keys_cache_;
+        *pkval = (keys_val_t*)fdb_cache_lookup(cache, slot->id_, fdb_slice_data(key), fdb_slice_length(key));
+    }
+    if(*pkval == &keys_val_absent){
+        destroy_keys_val(*pkval);
+        *pkval = NULL;
+        __sync_add_and_fetch(&slot->keys_absent_hits_, 1);
+        return 0;
     }
-    *pslice = slice_val;
+    return (*pkval != NULL) ? 1 : 2;
 }
 
-
-
-static int get_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t** pkval){
-    //getting from lru cache
-    rocksdb_cache_handle_t *handle = rocksdb_cache_lookup(slot->keys_cache_, fdb_slice_data(key), fdb_slice_length(key));
-    if(handle != NULL){
-        *pkval = (keys_val_t*)rocksdb_cache_value(slot->keys_cache_, handle);
-        fdb_incr_ref_count(*pkval);
-        rocksdb_cache_release(slot->keys_cache_, handle);
-        return 1;
-    }
-  
+//caching the main key record val read from rocksdb, NULL if there is none, val is freed
+static int fill_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, char* val, size_t vallen,
+                         keys_val_t** pkval){
     int ret = 0;
-    char *val = NULL, *errptr = NULL;
-    size_t vallen = 0;
-    //getting from rocksdb
-    fdb_slice_t *slice_key = NULL;
-    encode_keys_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-    rocksdb_readoptions_t* readoptions = rocksdb_readoptions_create();
-    val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
-    if(errptr != NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
-        rocksdb_free(errptr);
-        return -1;
-    }
+    fdb_cache_t *cache = (fdb_cache_t*)context->keys_cache_;
+    //a write racing this read has cached its own value already, which is kept
     if(val != NULL){
         if(decode_keys_val(val, vallen, pkval)==0){
             size_t charge = charge_keys_val(key, *pkval);
-            handle = rocksdb_cache_insert(slot->keys_cache_, fdb_slice_data(key), fdb_slice_length(key), *pkval, charge, deleter_for_keys_val);
-            fdb_incr_ref_count(*pkval);
+            fdb_cache_add(cache, slot->id_, fdb_slice_data(key), fdb_slice_length(key), *pkval, charge, deleter_for_keys_val);
             ret = 1;
         }else{
             fprintf(stderr, "%s main key, value len %lu error.\n", __func__, vallen); 
@@ -249,261 +185,541 @@ static int get_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* k
         }
         rocksdb_free(val);
     }else{
+        if(fdb_cache_add(cache, slot->id_, fdb_slice_data(key), fdb_slice_length(key), &keys_val_absent,
+                         fdb_slice_length(key), deleter_for_keys_val)==1){
+            __sync_add_and_fetch(&slot->keys_absent_fills_, 1);
+        }
         ret = 0;
     }
-
-    if(handle!=NULL)rocksdb_cache_release(slot->keys_cache_, handle);
     return ret;
 }
 
-static int set_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t* kval){
-    int ret = 0;
-    char *errptr = NULL;
-
-    size_t charge = charge_keys_val(key, kval);
-
-    rocksdb_cache_handle_t *handle = rocksdb_cache_insert(slot->keys_cache_, 
-                                                          fdb_slice_data(key), 
-                                                          fdb_slice_length(key),
-                                                          kval,
-                                                          charge,
-                                                          deleter_for_keys_val);
-    if(handle!=NULL){
-        fdb_incr_ref_count(kval);
+static int get_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t** pkval){
+    int ret = lookup_keys_val(context, slot, key, pkval);
+    if(ret != 2){
+        return ret;
     }
-
-
-    fdb_slice_t *slice_key = NULL;
-    encode_keys_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-
-    fdb_slice_t *slice_val = NULL;
-    encode_keys_val(kval, &slice_val);
-
-
-    rocksdb_writeoptions_t* writeoptions = rocksdb_writeoptions_create();
-    rocksdb_put_cf(context->db_,
-                   writeoptions,
-                   slot->handle_,
-                   fdb_slice_data(slice_key),
-                   fdb_slice_length(slice_key),
-                   fdb_slice_data(slice_val),
-                   fdb_slice_length(slice_val),
-                   &errptr);
-    rocksdb_writeoptions_destroy(writeoptions);
-    fdb_slice_destroy(slice_key);
-    fdb_slice_destroy(slice_val);
+  
+    char *val = NULL, *errptr = NULL;
+    size_t vallen = 0;
+    //getting from rocksdb
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_keys_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = fdb_codec_encode_keys_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key));
+    val = fdb_slot_writebatch_get(context, slot, fdbkey, fdbkeylen, &vallen, &errptr);
+    fdb_codec_buf_free(stack, fdbkey);
     if(errptr != NULL){
-        fprintf(stderr, "%s rocksdb_put_cf fail %s.\n", __func__, errptr);
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
         rocksdb_free(errptr);
-        rocksdb_cache_erase(slot->keys_cache_, fdb_slice_data(key), fdb_slice_length(key));
-        ret = -1;
-        goto end;
+        return -1;
     }
-    ret = 1;
+    return fill_keys_val(context, slot, key, val, vallen, pkval);
+}
 
-end:
-    if(handle!=NULL) rocksdb_cache_release(slot->keys_cache_, handle);
+//get_keys_val of num keys, the ones the keys cache misses are read with one multi get
+static void get_keys_vals(fdb_context_t* context, fdb_slot_t* slot, size_t num, fdb_slice_t* const* keys,
+                          keys_val_t** kvals, int* rets){
+    fdb_arena_t *arena = fdb_arena_current();
+    size_t *pos = (size_t*)fdb_malloc_in(arena, num * sizeof(size_t));
+    size_t m = 0, size = 0;
+    for(size_t i=0; i<num; ++i){
+        rets[i] = lookup_keys_val(context, slot, keys[i], &kvals[i]);
+        if(rets[i] == 2){
+            pos[m++] = i;
+            size += fdb_codec_keys_key_size(fdb_slice_length(keys[i]));
+        }
+    }
+    if(m > 0){
+        char *buf = (char*)fdb_malloc_in(arena, size);
+        const char **fdbkeys = (const char**)fdb_malloc_in(arena, m * sizeof(char*));
+        size_t *fdbkeylens = (size_t*)fdb_malloc_in(arena, m * sizeof(size_t));
+        char **vals = (char**)fdb_malloc_in(arena, m * sizeof(char*));
+        size_t *vallens = (size_t*)fdb_malloc_in(arena, m * sizeof(size_t));
+        char *p = buf, *errptr = NULL;
+        for(size_t j=0; j<m; ++j){
+            fdb_slice_t *key = keys[pos[j]];
+            fdbkeys[j] = p;
+            fdbkeylens[j] = fdb_codec_encode_keys_key(p, fdb_slice_data(key), fdb_slice_length(key));
+            p += fdbkeylens[j];
+        }
+        if(fdb_slot_writebatch_multi_get(context, slot, m, fdbkeys, fdbkeylens, vals, vallens, &errptr) != 0){
+            fprintf(stderr, "%s fdb_slot_writebatch_multi_get fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            for(size_t j=0; j<m; ++j){
+                rets[pos[j]] = -1;
+                if(vals[j] != NULL) rocksdb_free(vals[j]);
+            }
+        }else{
+            for(size_t j=0; j<m; ++j){
+                rets[pos[j]] = fill_keys_val(context, slot, keys[pos[j]], vals[j], vallens[j], &kvals[pos[j]]);
+            }
+        }
+        fdb_free_in(arena, buf);
+        fdb_free_in(arena, fdbkeys);
+        fdb_free_in(arena, fdbkeylens);
+        fdb_free_in(arena, vals);
+        fdb_free_in(arena, vallens);
+    }
+    fdb_free_in(arena, pos);
+}
+
+//a private copy in place of the shared one, set_keys_val publishes it once changed
+static keys_val_t* copy_keys_val(keys_val_t* shared){
+    keys_val_t *kval = create_keys_val();
+    kval->type_ = shared->type_;
+    kval->stat_ = shared->stat_;
+    kval->seq_ = shared->seq_;
+    kval->ts_ = shared->ts_;
+    kval->count_ = shared->count_;
+    kval->slice_ = shared->slice_;
+    kval->int64_ = shared->int64_;
+    if(kval->slice_ != NULL){
+        fdb_incr_ref_count(kval->slice_);
+    }
+    destroy_keys_val(shared);
+    return kval;
+}
+
+static int get_keys_val_for_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t** pkval){
+    int ret = get_keys_val(context, slot, key, pkval);
+    if(ret == 1){
+        *pkval = copy_keys_val(*pkval);
+    }
     return ret;
 }
 
-static int rem_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key){
-    int ret = 0;
-    char *errptr = NULL;
+//moving the ttl index entry of key from ots to ts
+static void write_keys_ttl(fdb_slot_t* slot, fdb_slice_t* key, int64_t ots, int64_t ts){
+    if(ots == ts){
+        return;
+    }
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_ttl_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = 0;
+    if(ots > 0){
+        fdbkeylen = fdb_codec_encode_ttl_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key), ots);
+        fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
+    }
+    if(ts > 0){
+        fdbkeylen = fdb_codec_encode_ttl_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key), ts);
+        fdb_slot_writebatch_put(slot, fdbkey, fdbkeylen, NULL, 0);
+    }
+    fdb_codec_buf_free(stack, fdbkey);
+}
 
-    //deling from lru cache
-    rocksdb_cache_erase(slot->keys_cache_, fdb_slice_data(key), fdb_slice_length(key));
-  
-    //deling from rocksdb
-    fdb_slice_t *slice_key = NULL;
-    encode_keys_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-    rocksdb_writeoptions_t* writeoptions = rocksdb_writeoptions_create();
-    rocksdb_delete_cf(context->db_, 
-                      writeoptions, 
-                      slot->handle_, 
-                      fdb_slice_data(slice_key), 
-                      fdb_slice_length(slice_key), 
-                      &errptr);
-    rocksdb_writeoptions_destroy(writeoptions);
-    fdb_slice_destroy(slice_key);
-    if(errptr != NULL){
-        fprintf(stderr, "%s rocksdb_delete_cf fail %s.\n", __func__, errptr);
-        rocksdb_free(errptr);
-        ret = -1;
-        goto end;
+//ots is the ts_ the main key had before this change, the write goes into the slot batch, the
+//rest of the command reads it back from there and the keys cache gets it with the commit
+static int set_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t* kval, int64_t ots){
+    size_t charge = charge_keys_val(key, kval);
+    fdb_slot_writebatch_cache(slot, fdb_slice_data(key), fdb_slice_length(key), kval, charge, deleter_for_keys_val);
+
+
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_keys_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = fdb_codec_encode_keys_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key));
+
+    const char *payload = NULL;
+    size_t payloadlen = 0;
+    char cbuf[1 + sizeof(uint64_t)];
+    if(kval->slice_ != NULL){
+        payload = fdb_slice_data((fdb_slice_t*)(kval->slice_));
+        payloadlen = fdb_slice_length((fdb_slice_t*)(kval->slice_));
+    }else if(kval->type_ != FDB_DATA_TYPE_STRING && kval->count_ >= 0){
+        payload = cbuf;
+        payloadlen = fdb_codec_encode_subkeys_payload(cbuf, (uint64_t)kval->count_);
     }
-    ret = 1;
+    char vstack[FDB_CODEC_STACK_SIZE];
+    char *fdbval = fdb_codec_buf(vstack, fdb_codec_keys_val_size(payloadlen));
+    uint8_t type = kval->int64_ ? FDB_DATA_TYPE_INT64 : kval->type_;
+    size_t fdbvallen = fdb_codec_encode_keys_val(fdbval, type, kval->stat_, kval->seq_, kval->ts_,
+                                                 payload, payloadlen);
+
+    fdb_slot_writebatch_put(slot,
+                            fdbkey,
+                            fdbkeylen,
+                            fdbval,
+                            fdbvallen);
+    write_keys_ttl(slot, key, ots, kval->ts_);
+    fdb_codec_buf_free(stack, fdbkey);
+    fdb_codec_buf_free(vstack, fdbval);
+    return 1;
+}
 
-end:
-    return ret;
+static int rem_keys_val(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t ots){
+    //known absent once committed
+    fdb_slot_writebatch_cache(slot, fdb_slice_data(key), fdb_slice_length(key), &keys_val_absent,
+                              fdb_slice_length(key), deleter_for_keys_val);
+  
+    //deling from rocksdb
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_keys_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = fdb_codec_encode_keys_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key));
+    fdb_slot_writebatch_delete(slot, 
+                               fdbkey, 
+                               fdbkeylen);
+    write_keys_ttl(slot, key, ots, 0);
+    fdb_codec_buf_free(stack, fdbkey);
+    return 1;
 }
 
-static int mark_key_deleted(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq){
+static int commit_keys_val(fdb_context_t* context, fdb_slot_t* slot){
     char *errptr = NULL;
-
-    fdb_slice_t *slice_key = NULL;
-    encode_dels_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-
-    char buf_seq[sizeof(uint32_t)] = {0};
-    rocksdb_encode_fixed32(buf_seq, seq);
-    fdb_slice_t *slice_val = fdb_slice_create(buf_seq, sizeof(uint32_t));
-
-    rocksdb_writeoptions_t* writeoptions = rocksdb_writeoptions_create();
-    rocksdb_put_cf(context->db_,
-                   writeoptions,
-                   slot->handle_,
-                   fdb_slice_data(slice_key),
-                   fdb_slice_length(slice_key),
-                   fdb_slice_data(slice_val),
-                   fdb_slice_length(slice_val),
-                   &errptr);
-    rocksdb_writeoptions_destroy(writeoptions);
-    fdb_slice_destroy(slice_key);
-    fdb_slice_destroy(slice_val);
+    fdb_slot_writebatch_commit(context, slot, &errptr);
     if(errptr != NULL){
-        fprintf(stderr, "%s rocksdb_put_cf fail %s.\n", __func__, errptr);
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
         rocksdb_free(errptr);
         return -1;
     }
     return 1;
 }
 
+//a packed collection takes its members along when it goes
+static void drop_keys_payload(keys_val_t* kval){
+    if(kval->slice_ != NULL){
+        fdb_slice_destroy(kval->slice_);
+        kval->slice_ = NULL;
+    }
+    kval->int64_ = 0;
+}
+
+static int mark_key_deleted(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t seq){
+    //the subkeys of seq are dropped later by dels_self_reclaim
+    return dels_mark(context, slot, key, seq);
+}
 
-int keys_set_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* val){
-    int retval = 0;
 
-    keys_val_t *kval = NULL;
-    int ret = get_keys_val(context, slot, key, &kval);
-    if(ret == 1){
-        fdb_incr_ref_count(val);
-        if(kval->type_==FDB_DATA_TYPE_STRING){
-            fdb_slice_destroy(kval->slice_);
-        }else{
-            if(kval->stat_ == FDB_KEY_STAT_NORMAL){
-                if(mark_key_deleted(context, slot, key, kval->seq_)!=1){
-                    retval = FDB_ERR;
-                    goto  end;
-                }
+//replacing whatever key holds by the string val, kval and found as get_keys_val_for_update
+//left them, int64 if val is a fixed64
+static int put_keys_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, keys_val_t** pkval, int found,
+                           fdb_slice_t* val, uint8_t int64, int64_t ts){
+    keys_val_t *kval = *pkval;
+    int64_t ots = 0;
+    if(found == 1){
+        ots = kval->ts_;
+        drop_keys_payload(kval);
+        if(kval->type_!=FDB_DATA_TYPE_STRING && kval->stat_ == FDB_KEY_STAT_NORMAL){
+            if(mark_key_deleted(context, slot, key, kval->seq_)!=1){
+                return FDB_ERR;
             }
         }
         kval->seq_ += 1;
-        kval->stat_ = FDB_KEY_STAT_NORMAL;
-        kval->type_ = FDB_DATA_TYPE_STRING;
-        kval->ts_ = 0;
-        kval->slice_ = val;
-    }else if(ret == 0){
-        fdb_incr_ref_count(val);
+    }else{
+        //a string has no subkeys to clash with retired seqs, enc_keys_packed looks them up
+        //once the key turns into a collection
         kval = create_keys_val();
-        kval->type_ = FDB_DATA_TYPE_STRING;
-        kval->stat_ = FDB_KEY_STAT_NORMAL;
+        *pkval = kval;
         kval->seq_ = FDB_KEY_INIT_SEQ;
-        kval->ts_ = 0;
-        kval->slice_ = val; 
+    }
+    fdb_incr_ref_count(val);
+    kval->type_ = FDB_DATA_TYPE_STRING;
+    kval->stat_ = FDB_KEY_STAT_NORMAL;
+    kval->ts_ = ts;
+    kval->slice_ = val;
+    kval->int64_ = int64;
+    //the marker of the old seq, the main key and its ttl entry land in one write
+    if(set_keys_val(context, slot, key, kval, ots)!=1 || commit_keys_val(context, slot)!=1){
+        return FDB_ERR;
+    }
+    return FDB_OK;
+}
+
+int keys_set_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* val, int64_t ts){
+    int retval = 0;
+
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
+    if(ret == 1 || ret == 0){
+        retval = put_keys_string(context, slot, key, &kval, ret, val, 0, ts);
     }else{
         retval = FDB_ERR; 
+    }
+
+    rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
+    return retval; 
+}
+
+int keys_incr_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t init, int64_t by, int64_t* val){
+    int retval = 0;
+    int64_t old = init;
+
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
+    if(ret < 0){
+        retval = FDB_ERR;
         goto end;
     }
-    if(kval!=NULL){
-        if(set_keys_val(context, slot, key, kval)!=1){
-            retval = FDB_ERR;
-        }else{
-            retval = FDB_OK;
+    if(ret == 1){
+        int64_t now = (int64_t)time_ms();
+        if(kval->stat_ == FDB_KEY_STAT_NORMAL && (kval->ts_ == 0 || kval->ts_ > now)){
+            fdb_slice_t *sl = (fdb_slice_t*)(kval->slice_);
+            if(kval->type_ != FDB_DATA_TYPE_STRING){
+                retval = FDB_ERR_WRONG_TYPE_ERROR;
+                goto end;
+            }else if(kval->int64_){
+                old = (int64_t)rocksdb_decode_fixed64(fdb_slice_data(sl));
+            }else if(sl == NULL || fdb_slice_length(sl) == 0){
+                retval = FDB_ERR_IS_NOT_INTEGER;
+                goto end;
+            }else{
+                //a string set by a client, parsed once and binary from then on
+                old = (int64_t)atoll(fdb_slice_data(sl));
+            }
         }
+    }
+    if(is_int64_overflow(old, by)){
+        retval = FDB_ERR_INCDECR_OVERFLOW;
         goto end;
     }
-    retval = FDB_OK;
+    {
+        char buf[sizeof(uint64_t)];
+        rocksdb_encode_fixed64(buf, (uint64_t)(old + by));
+        fdb_slice_t *slice = fdb_slice_create(buf, sizeof(buf));
+        retval = put_keys_string(context, slot, key, &kval, ret, slice, 1, 0);
+        fdb_slice_destroy(slice);
+    }
+    if(retval == FDB_OK){
+        *val = old + by;
+    }
 
 end:
+    rocksdb_mutex_unlock(mutex);
     if(kval!=NULL) destroy_keys_val(kval);
-    return retval; 
+    return retval;
+}
+
+//the string of a shared main key record, FDB_OK_NOT_EXIST if expired or deleted
+static int get_keys_string(const keys_val_t* kval, int64_t now, fdb_slice_t** pval){
+    if((kval->ts_>0 && kval->ts_ <= now) || kval->stat_ != FDB_KEY_STAT_NORMAL){
+        return FDB_OK_NOT_EXIST;
+    }
+    if(kval->type_ != FDB_DATA_TYPE_STRING){
+        return FDB_ERR_WRONG_TYPE_ERROR;
+    }
+    fdb_slice_t *sl = (fdb_slice_t*)(kval->slice_);
+    if(kval->int64_){
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%lld", (long long)(int64_t)rocksdb_decode_fixed64(fdb_slice_data(sl)));
+        *pval = fdb_slice_create(buf, len);
+    }else{
+        fdb_incr_ref_count(sl);
+        *pval = sl;
+    }
+    return FDB_OK;
 }
 
 int keys_get_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t** pval){
-    int retval = 0;
-    
     keys_val_t *kval = NULL;
     if(get_keys_val(context, slot, key, &kval)!=1){
        return FDB_OK_NOT_EXIST; 
-    }else{
-        int64_t now = (int64_t)time_ms();
-        if(kval->ts_>0 && kval->ts_ <= now){
-            retval = FDB_OK_NOT_EXIST;
-        }else if(kval->stat_ == FDB_KEY_STAT_NORMAL){
-            if(kval->type_ == FDB_DATA_TYPE_STRING){
-                fdb_slice_t *sl = (fdb_slice_t*)(kval->slice_);
-                fdb_incr_ref_count(sl);
-                *pval = sl;
-                retval = FDB_OK;
-            }else{ 
-                retval = FDB_ERR_WRONG_TYPE_ERROR;
-            }
+    }
+    int retval = get_keys_string(kval, (int64_t)time_ms(), pval);
+    destroy_keys_val(kval);
+    return retval; 
+}
+
+void keys_mget_string(fdb_context_t* context, fdb_slot_t* slot, size_t num, fdb_slice_t* const* keys, fdb_slice_t** vals,
+                      int* rets){
+    fdb_arena_t *arena = fdb_arena_current();
+    keys_val_t **kvals = (keys_val_t**)fdb_malloc_in(arena, num * sizeof(keys_val_t*));
+    get_keys_vals(context, slot, num, keys, kvals, rets);
+    int64_t now = (int64_t)time_ms();
+    for(size_t i=0; i<num; ++i){
+        vals[i] = NULL;
+        if(rets[i] == 1){
+            rets[i] = get_keys_string(kvals[i], now, &vals[i]);
+            destroy_keys_val(kvals[i]);
         }else{
-            retval = FDB_OK_NOT_EXIST;
+            rets[i] = FDB_OK_NOT_EXIST;
         }
     }
+    fdb_free_in(arena, kvals);
+}
 
 
-    if(kval != NULL)destroy_keys_val(kval);
-    return retval; 
+
+int keys_enc(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type){
+    return keys_enc_packed(context, slot, key, type, NULL);
 }
 
+//a collection made here starts packed when the caller reads payloads and packing is on,
+//otherwise with no members in subkeys
+static void new_keys_payload(fdb_context_t* context, keys_val_t* kval, fdb_slice_t** ppacked){
+    if(ppacked != NULL && context->packed_entries_ > 0){
+        packed_empty_payload((fdb_slice_t**)&kval->slice_);
+    }else{
+        kval->count_ = 0;
+    }
+}
 
+static void ref_keys_payload(keys_val_t* kval, fdb_slice_t** ppacked){
+    if(ppacked != NULL && kval->slice_ != NULL){
+        fdb_incr_ref_count(kval->slice_);
+        *ppacked = (fdb_slice_t*)kval->slice_;
+    }
+}
 
-int keys_enc(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type){
+//a live key of type is kept unless renew, which makes it anew whatever it held, under fresh
+//if not 0, as keys_renew_seq picked it
+static int enc_keys_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, int renew,
+                           uint32_t fresh, fdb_slice_t** ppacked){
 
+    if(ppacked != NULL){
+        *ppacked = NULL;
+    }
     if(type == FDB_DATA_TYPE_STRING){
         return FDB_ERR_WRONG_TYPE_ERROR;
     }
 
     int retval = 0;
     keys_val_t *kval = NULL;
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
     int ret = get_keys_val(context, slot, key, &kval);
     if(ret == 1){
-        if(kval->stat_ == FDB_KEY_STAT_NORMAL){
+        int64_t now = (int64_t)time_ms();
+        int expired = (kval->ts_>0 && kval->ts_<=now);
+        if(kval->stat_ == FDB_KEY_STAT_NORMAL && !expired && !renew){
             if(kval->type_ != type){
-                destroy_keys_val(kval);
-                return FDB_ERR_WRONG_TYPE_ERROR;
+                retval = FDB_ERR_WRONG_TYPE_ERROR;
+                goto end;
             }
         }else{
+            kval = copy_keys_val(kval);
+            if(fresh > 0 && kval->seq_ >= fresh){
+                fprintf(stderr, "%s main key changed under the command.\n", __func__);
+                retval = FDB_ERR;
+                goto end;
+            }
+            int64_t ots = kval->ts_;
+            drop_keys_payload(kval);
+            if(kval->type_ != FDB_DATA_TYPE_STRING && kval->stat_ == FDB_KEY_STAT_NORMAL){
+                if(mark_key_deleted(context, slot, key, kval->seq_)!=1){
+                    retval = FDB_ERR;
+                    goto end;
+                }
+            }
+            //past the retired seqs as well, a string never marks its own and a failed rewrite
+            //marks the one it wrote to, see keys_fresh_seq
+            uint32_t seq = kval->seq_ + 1, next = FDB_KEY_INIT_SEQ;
+            if(dels_next_seq(context, slot, key, &next)!=1){
+                retval = FDB_ERR;
+                goto end;
+            }
+            seq = (next > seq) ? next : seq;
+            if(fresh > 0){
+                seq = fresh;
+            }
             kval->stat_ = FDB_KEY_STAT_NORMAL;
             kval->type_ = type; 
-            kval->seq_ += 1;
+            kval->seq_ = seq;
             kval->ts_ = 0;
-            if(set_keys_val(context, slot, key, kval)!=1){
-                destroy_keys_val(kval);
-                return FDB_ERR;
+            new_keys_payload(context, kval, ppacked);
+            if(set_keys_val(context, slot, key, kval, ots)!=1){
+                retval = FDB_ERR;
+                goto end;
             }
+            //the sweeper still sees the old key, and the ts it had, until the batch is committed
+            fdb_slot_key_pin(slot, fdb_slice_data(key), fdb_slice_length(key));
         }
+        if(kval->ts_ > 0){
+            fdb_slot_key_pin(slot, fdb_slice_data(key), fdb_slice_length(key));
+        }
+        ref_keys_payload(kval, ppacked);
+        rocksdb_mutex_unlock(mutex);
+        mutex = NULL;
         fdb_slice_uint32_push_front(key, kval->seq_); 
         retval = FDB_OK;
     }else if(ret == 0){
+        uint32_t seq = fresh;
+        if(fresh == 0 && dels_next_seq(context, slot, key, &seq)!=1){
+            retval = FDB_ERR;
+            goto end;
+        }
         kval = create_keys_val();
         kval->type_ = type;
-        kval->seq_ = FDB_KEY_INIT_SEQ;
+        kval->seq_ = seq;
         kval->stat_ = FDB_KEY_STAT_NORMAL;
         kval->ts_ = 0;
         kval->slice_ = NULL;
-        if(set_keys_val(context, slot, key, kval)!=1){
+        new_keys_payload(context, kval, ppacked);
+        if(set_keys_val(context, slot, key, kval, 0)!=1){
             retval = FDB_ERR;
         }else{
+            ref_keys_payload(kval, ppacked);
+            rocksdb_mutex_unlock(mutex);
+            mutex = NULL;
             fdb_slice_uint32_push_front(key, kval->seq_); 
             retval = FDB_OK;
         } 
-        destroy_keys_val(kval);
     }else{
         retval = FDB_ERR;
     }
 
+end:
+    if(mutex!=NULL) rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
     return retval;
 }
 
+int keys_enc_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked){
+    return enc_keys_packed(context, slot, key, type, 0, 0, ppacked);
+}
+
+int keys_renew_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked){
+    return enc_keys_packed(context, slot, key, type, 1, 0, ppacked);
+}
+
+int keys_renew_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* fresh){
+    uint32_t next = FDB_KEY_INIT_SEQ;
+    if(dels_next_seq(context, slot, key, &next)!=1){
+        return FDB_ERR;
+    }
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val(context, slot, key, &kval);
+    if(ret < 0){
+        return FDB_ERR;
+    }
+    if(ret == 1){
+        next = (kval->seq_ + 1 > next) ? kval->seq_ + 1 : next;
+        destroy_keys_val(kval);
+    }
+    *fresh = next;
+    return FDB_OK;
+}
+
+int keys_renew_at(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, uint32_t fresh){
+    return enc_keys_packed(context, slot, key, type, 1, fresh, NULL);
+}
+
 int keys_exs(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type){ 
+    return keys_exs_packed(context, slot, key, type, NULL);
+}
+
+int keys_exs_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked){
     int retval = 0;
     keys_val_t *kval = NULL;
+    rocksdb_mutex_t *mutex = NULL;
 
+    if(ppacked != NULL){
+        *ppacked = NULL;
+    }
     if(type == FDB_DATA_TYPE_STRING){
         return  FDB_ERR_WRONG_TYPE_ERROR;
     }
     int ret = get_keys_val(context, slot, key, &kval);
+    if(ret == 1 && kval->ts_ > 0){
+        //an expiring key is found again under its stripe lock, to be pinned against the sweeper
+        destroy_keys_val(kval);
+        kval = NULL;
+        mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+        rocksdb_mutex_lock(mutex);
+        ret = get_keys_val(context, slot, key, &kval);
+    }
     if(ret == 1){
         int64_t now = (int64_t)time_ms();
         if(kval->ts_>0 && kval->ts_ <= now){
@@ -512,7 +728,11 @@ int keys_exs(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t
             if(kval->type_ != type){
                 retval = FDB_ERR_WRONG_TYPE_ERROR;
             }else{
+                if(mutex != NULL && kval->ts_ > 0){
+                    fdb_slot_key_pin(slot, fdb_slice_data(key), fdb_slice_length(key));
+                }
                 fdb_slice_uint32_push_front(key, kval->seq_); 
+                ref_keys_payload(kval, ppacked);
                 retval = FDB_OK;
             }
         }else{
@@ -524,15 +744,389 @@ int keys_exs(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t
         retval = FDB_ERR;
     }
 
+    if(mutex != NULL) rocksdb_mutex_unlock(mutex);
     if(kval != NULL)destroy_keys_val(kval);
     return retval;
 }
 
+//the name of a key prefixed by its seq, as keys_enc and keys_exs leave it
+static fdb_slice_t* split_keys_seq(fdb_slice_t* key, uint32_t* seq){
+    if(fdb_slice_length(key) < sizeof(uint32_t)){
+        return NULL;
+    }
+    *seq = rocksdb_decode_fixed32(fdb_slice_data(key));
+    return fdb_slice_create_in(fdb_arena_current(), fdb_slice_data(key) + sizeof(uint32_t),
+                               fdb_slice_length(key) - sizeof(uint32_t));
+}
+
+//whether kval is still the collection the command found under seq
+static int is_keys_val_of(const keys_val_t* kval, uint32_t seq){
+    return kval->seq_ == seq && kval->stat_ == FDB_KEY_STAT_NORMAL && kval->type_ != FDB_DATA_TYPE_STRING;
+}
+
+//the count of a collection written before its main key carried it, from its size key,
+//returns 1 if found, 0 if not, -1 on error
+static int get_legacy_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype, uint64_t* count){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_size_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = fdb_codec_encode_size_key(fdbkey, sizetype, fdb_slice_data(key), fdb_slice_length(key));
+    char *errptr = NULL;
+    size_t vallen = 0;
+    char *val = fdb_slot_writebatch_get(context, slot, fdbkey, fdbkeylen, &vallen, &errptr);
+    fdb_codec_buf_free(stack, fdbkey);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    if(val == NULL){
+        *count = 0;
+        return 0;
+    }
+    int ret = 1;
+    if(vallen == sizeof(uint64_t)){
+        *count = rocksdb_decode_fixed64(val);
+    }else{
+        fprintf(stderr, "%s size key, value len %lu error.\n", __func__, vallen);
+        ret = -1;
+    }
+    rocksdb_free(val);
+    return ret;
+}
+
+static void del_legacy_count(fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_size_key_size(fdb_slice_length(key)));
+    size_t fdbkeylen = fdb_codec_encode_size_key(fdbkey, sizetype, fdb_slice_data(key), fdb_slice_length(key));
+    fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
+    fdb_codec_buf_free(stack, fdbkey);
+}
+
+int keys_set_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* packed){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    int retval = 0;
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(name), fdb_slice_length(name));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, name, &kval);
+    if(ret != 1 || !is_keys_val_of(kval, seq)){
+        //dropped or replaced since the command found it
+        fprintf(stderr, "%s main key changed under the command.\n", __func__);
+        retval = FDB_ERR;
+        goto end;
+    }
+    drop_keys_payload(kval);
+    if(packed != NULL){
+        fdb_incr_ref_count(packed);
+        kval->slice_ = packed;
+    }else{
+        //the caller counts the members it moves to subkeys
+        kval->count_ = 0;
+    }
+    if(set_keys_val(context, slot, name, kval, kval->ts_)!=1){
+        retval = FDB_ERR;
+        goto end;
+    }
+    retval = FDB_OK;
+
+end:
+    rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+int keys_fresh_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* fresh){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    uint32_t next = FDB_KEY_INIT_SEQ;
+    int retval = FDB_OK;
+    if(dels_next_seq(context, slot, name, &next)!=1){
+        retval = FDB_ERR;
+    }else{
+        *fresh = (next > seq + 1) ? next : seq + 1;
+    }
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+int keys_move_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t fresh){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    int retval = 0;
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(name), fdb_slice_length(name));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, name, &kval);
+    if(ret != 1 || !is_keys_val_of(kval, seq)){
+        fprintf(stderr, "%s main key changed under the command.\n", __func__);
+        retval = FDB_ERR;
+        goto end;
+    }
+    if(mark_key_deleted(context, slot, name, seq)!=1){
+        retval = FDB_ERR;
+        goto end;
+    }
+    drop_keys_payload(kval);
+    kval->seq_ = fresh;
+    kval->count_ = 0;
+    if(set_keys_val(context, slot, name, kval, kval->ts_)!=1){
+        retval = FDB_ERR;
+        goto end;
+    }
+    retval = FDB_OK;
+
+end:
+    rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+int keys_set_pexpire(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t ts){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    int retval = 0;
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(name), fdb_slice_length(name));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, name, &kval);
+    if(ret != 1 || !is_keys_val_of(kval, seq)){
+        fprintf(stderr, "%s main key changed under the command.\n", __func__);
+        retval = FDB_ERR;
+        goto end;
+    }
+    if(kval->ts_ != ts){
+        int64_t ots = kval->ts_;
+        kval->ts_ = ts;
+        if(set_keys_val(context, slot, name, kval, ots)!=1){
+            retval = FDB_ERR;
+            goto end;
+        }
+    }
+    retval = FDB_OK;
+
+end:
+    rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+int keys_get_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype, uint64_t* count){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    int retval = FDB_OK;
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val(context, slot, name, &kval);
+    if(ret == 1 && is_keys_val_of(kval, seq) && kval->count_ >= 0){
+        *count = (uint64_t)kval->count_;
+    }else if(ret < 0 || get_legacy_count(context, slot, key, sizetype, count) < 0){
+        retval = FDB_ERR;
+    }
+    if(kval != NULL) destroy_keys_val(kval);
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+int keys_incr_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype, int64_t by){
+    uint32_t seq = 0;
+    fdb_slice_t *name = split_keys_seq(key, &seq);
+    if(name == NULL){
+        return FDB_ERR;
+    }
+    int retval = 0;
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(name), fdb_slice_length(name));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val_for_update(context, slot, name, &kval);
+    if(ret != 1 || !is_keys_val_of(kval, seq) || kval->slice_ != NULL){
+        fprintf(stderr, "%s main key changed under the command.\n", __func__);
+        retval = FDB_ERR;
+        goto end;
+    }
+    if(kval->count_ < 0){
+        //the size key goes, the count moves to the main key
+        uint64_t count = 0;
+        if(get_legacy_count(context, slot, key, sizetype, &count) < 0){
+            retval = FDB_ERR;
+            goto end;
+        }
+        del_legacy_count(slot, key, sizetype);
+        kval->count_ = (int64_t)count;
+    }
+    kval->count_ += by;
+    if(kval->count_ < 0){
+        kval->count_ = 0;
+    }
+    if(set_keys_val(context, slot, name, kval, kval->ts_)!=1){
+        retval = FDB_ERR;
+        goto end;
+    }
+    retval = FDB_OK;
+
+end:
+    rocksdb_mutex_unlock(mutex);
+    if(kval!=NULL) destroy_keys_val(kval);
+    fdb_slice_destroy(name);
+    return retval;
+}
+
+struct keys_member_t {
+    const char* data_;
+    size_t      length_;
+    size_t      pos_;
+};
+
+//by member, then by position, so the first of equal members leads
+static int compare_keys_member(const void* a, const void* b){
+    const struct keys_member_t *ma = (const struct keys_member_t*)a;
+    const struct keys_member_t *mb = (const struct keys_member_t*)b;
+    int ret = compare_with_length(ma->data_, ma->length_, mb->data_, mb->length_);
+    if(ret != 0){
+        return ret;
+    }
+    return (ma->pos_ < mb->pos_) ? -1 : (ma->pos_ > mb->pos_ ? 1 : 0);
+}
+
+static void mark_repeated_members(size_t num, fdb_slice_t* const* members, uint8_t* repeats){
+    fdb_arena_t *arena = fdb_arena_current();
+    struct keys_member_t *sorted = (struct keys_member_t*)fdb_malloc_in(arena, num * sizeof(struct keys_member_t));
+    for(size_t i=0; i<num; ++i){
+        sorted[i].data_ = fdb_slice_data(members[i]);
+        sorted[i].length_ = fdb_slice_length(members[i]);
+        sorted[i].pos_ = i;
+        repeats[i] = 0;
+    }
+    qsort(sorted, num, sizeof(struct keys_member_t), compare_keys_member);
+    for(size_t i=1; i<num; ++i){
+        if(compare_with_length(sorted[i-1].data_, sorted[i-1].length_, sorted[i].data_, sorted[i].length_) == 0){
+            repeats[sorted[i].pos_] = 1;
+        }
+    }
+    fdb_free_in(arena, sorted);
+}
+
+int keys_get_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, size_t num,
+                     fdb_slice_t* const* members, char** vals, size_t* vlens, uint8_t* repeats){
+    fdb_arena_t *arena = fdb_arena_current();
+    size_t size = 0;
+    for(size_t i=0; i<num; ++i){
+        size += fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(members[i]));
+    }
+    char *buf = (char*)fdb_malloc_in(arena, size > 0 ? size : 1);
+    const char **fdbkeys = (const char**)fdb_malloc_in(arena, num * sizeof(char*));
+    size_t *fdbkeylens = (size_t*)fdb_malloc_in(arena, num * sizeof(size_t));
+    char *p = buf;
+    for(size_t i=0; i<num; ++i){
+        fdbkeys[i] = p;
+        fdbkeylens[i] = fdb_codec_encode_member_key(p, type, fdb_slice_data(key), fdb_slice_length(key),
+                                                    fdb_slice_data(members[i]), fdb_slice_length(members[i]));
+        p += fdbkeylens[i];
+    }
+    char *errptr = NULL;
+    int ret = fdb_slot_writebatch_multi_get(context, slot, num, fdbkeys, fdbkeylens, vals, vlens, &errptr);
+    if(ret != 0){
+        fprintf(stderr, "%s fdb_slot_writebatch_multi_get fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        for(size_t i=0; i<num; ++i){
+            if(vals[i] != NULL) rocksdb_free(vals[i]);
+            vals[i] = NULL;
+        }
+    }else if(repeats != NULL){
+        mark_repeated_members(num, members, repeats);
+    }
+    fdb_free_in(arena, buf);
+    fdb_free_in(arena, fdbkeys);
+    fdb_free_in(arena, fdbkeylens);
+    return (ret == 0) ? 0 : -1;
+}
+
+int keys_match(fdb_slice_t* pattern, const char* name, size_t namelen){
+    if(pattern == NULL || fdb_slice_length(pattern) == 0){
+        return 1;
+    }
+    return string_match_len(fdb_slice_data(pattern), fdb_slice_length(pattern), name, namelen, 0);
+}
+
+int keys_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* cursor, fdb_slice_t* pattern, uint64_t count,
+              fdb_array_t** rets, fdb_slice_t** pcursor){
+    fdb_slice_t *slice_start = NULL, *slice_end = NULL;
+    encode_keys_key(fdb_slice_data(cursor), fdb_slice_length(cursor), &slice_start);
+    //the successor of the prefix bounds every main key, whatever bytes the name holds
+    fdb_slice_t *slice_prefix = NULL;
+    encode_keys_key(NULL, 0, &slice_prefix);
+    char end[2] = {0};
+    size_t endlen = fdb_slice_length(slice_prefix);
+    memcpy(end, fdb_slice_data(slice_prefix), endlen);
+    end[endlen - 1] += 1;
+    slice_end = fdb_slice_create(end, endlen);
+    fdb_iterator_t *iterator = fdb_iterator_create(context, slot, slice_start, slice_end, count, FORWARD);
+    fdb_slice_destroy(slice_start);
+    fdb_slice_destroy(slice_end);
+    fdb_slice_destroy(slice_prefix);
+
+    fdb_array_t *array = fdb_array_create(16);
+    fdb_slice_t *next = NULL;
+    int64_t now = (int64_t)time_ms();
+    uint64_t seen = 0;
+    int more = fdb_iterator_valid(iterator);
+    while(more && seen < count){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
+        fdb_view_t name;
+        uint8_t type = 0, stat = 0;
+        uint32_t seq = 0;
+        int64_t ts = 0;
+        if(fdb_codec_decode_keys_key(rkey, rklen, &name)==0){
+            //expired keys and deleted collections waiting to be reclaimed are left out
+            if(fdb_codec_decode_keys_val(rval, rvlen, &type, &stat, &seq, &ts, NULL)==0 &&
+               stat == FDB_KEY_STAT_NORMAL && (ts == 0 || ts > now) && keys_match(pattern, name.data_, name.length_)){
+                fdb_val_node_t *knode = fdb_val_node_create_in(fdb_arena_current());
+                knode->retval_ = FDB_OK;
+                knode->val_.vval_ = fdb_slice_create(name.data_, name.length_);
+                fdb_array_push_back(array, knode);
+            }
+            if(++seen == count){
+                next = fdb_slice_create(name.data_, name.length_);
+            }
+        }
+        more = (fdb_iterator_next(iterator) == 0);
+    }
+    fdb_iterator_destroy(iterator);
+    if(!more){
+        fdb_slice_destroy(next);
+        next = NULL;
+    }
+    *rets = array;
+    *pcursor = next;
+    return FDB_OK;
+}
+
 int keys_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* count){
     int retval = 0;
 
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
     keys_val_t *kval = NULL;
-    int ret = get_keys_val(context, slot, key, &kval);
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
     if(ret == 1){ 
         int64_t now = (int64_t)time_ms();
         if((kval->ts_>0 && kval->ts_ <= now) || kval->stat_==FDB_KEY_STAT_PENDING){
@@ -541,12 +1135,13 @@ int keys_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t
             *count = 1;
         }
         if((kval->ts_>now || kval->ts_==0)&& kval->stat_ == FDB_KEY_STAT_NORMAL){
-            if(kval->type_ == FDB_DATA_TYPE_STRING){
+            //a packed collection has no subkeys to reclaim and goes like a string
+            if(kval->type_ == FDB_DATA_TYPE_STRING || kval->slice_ != NULL){
                 if(kval->slice_!=NULL){
                     fdb_slice_destroy(kval->slice_);
                     kval->slice_ = NULL;
                 }
-                if(rem_keys_val(context, slot, key)!=1){
+                if(rem_keys_val(context, slot, key, kval->ts_)!=1){
                     retval = FDB_ERR;
                     goto end;
                 }
@@ -555,13 +1150,19 @@ int keys_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t
                     retval = FDB_ERR;
                     goto end;
                 }
+                int64_t ots = kval->ts_;
                 kval->stat_ = FDB_KEY_STAT_PENDING;
                 kval->ts_ = 0;
-                if(set_keys_val(context, slot, key, kval)!=1){
+                drop_keys_payload(kval);
+                if(set_keys_val(context, slot, key, kval, ots)!=1){
                     retval = FDB_ERR;
                     goto end;
                 }    
             }
+            if(commit_keys_val(context, slot)!=1){
+                retval = FDB_ERR;
+                goto end;
+            }
         }
         retval = FDB_OK;
     }else if(ret == 0){
@@ -572,6 +1173,7 @@ int keys_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t
     }
 
 end:
+    rocksdb_mutex_unlock(mutex);
     if(kval!=NULL) destroy_keys_val(kval);
     return retval;
 }
@@ -580,26 +1182,52 @@ end:
 int keys_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key){
     int retval = 0;
 
-    int ret = rem_keys_val(context, slot, key);
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
+    keys_val_t *kval = NULL;
+    int ret = get_keys_val(context, slot, key, &kval);
+    if(ret == 1){
+        ret = rem_keys_val(context, slot, key, kval->ts_);
+        if(ret == 1){
+            ret = commit_keys_val(context, slot);
+        }
+    }
     if(ret>=0){
         retval = FDB_OK;
+    }else{
+        retval = FDB_ERR; 
     }
-    retval = FDB_ERR; 
+    rocksdb_mutex_unlock(mutex);
 
+    if(kval!=NULL) destroy_keys_val(kval);
     return retval;  
 }
 
 int keys_clr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* count){ 
     int retval = 0;
 
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
     keys_val_t *kval = NULL;
-    int ret = get_keys_val(context, slot, key, &kval);
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
     if(ret == 1){ 
         int64_t now = (int64_t)time_ms();
         if(kval->ts_> 0 && kval->ts_<=now && kval->stat_==FDB_KEY_STAT_NORMAL){
-            kval->ts_ = 0;
-            kval->stat_ = FDB_KEY_STAT_PENDING;
-            if(set_keys_val(context, slot, key, kval)!=1){
+            //a packed collection has no subkeys to reclaim and goes like a string, as in keys_del
+            if(kval->type_ == FDB_DATA_TYPE_STRING || kval->slice_ != NULL){
+                drop_keys_payload(kval);
+                ret = rem_keys_val(context, slot, key, kval->ts_);
+            }else{
+                ret = mark_key_deleted(context, slot, key, kval->seq_);
+                if(ret == 1){
+                    int64_t ots = kval->ts_;
+                    kval->ts_ = 0;
+                    kval->stat_ = FDB_KEY_STAT_PENDING;
+                    drop_keys_payload(kval);
+                    ret = set_keys_val(context, slot, key, kval, ots);
+                }
+            }
+            if(ret!=1 || commit_keys_val(context, slot)!=1){
                 retval = FDB_ERR;
                 goto end;
             }
@@ -614,6 +1242,7 @@ int keys_clr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t
     }
 
 end:
+    rocksdb_mutex_unlock(mutex);
     if(kval!=NULL) destroy_keys_val(kval);
     return retval;
 }
@@ -648,7 +1277,9 @@ int keys_pexpire_at(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
     int retval = 0;
     keys_val_t *kval = NULL;
 
-    int ret = get_keys_val(context, slot, key, &kval);
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
     if(ret == 1){
         int64_t now = (int64_t)time_ms();
         if(kval->ts_>0 && kval->ts_<= now){
@@ -657,8 +1288,9 @@ int keys_pexpire_at(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         }else if(kval->stat_ == FDB_KEY_STAT_NORMAL){
             *count = 1;
             retval = FDB_OK;
+            int64_t ots = kval->ts_;
             kval->ts_ = ts;
-            if(set_keys_val(context, slot, key, kval)!=1){
+            if(set_keys_val(context, slot, key, kval, ots)!=1 || commit_keys_val(context, slot)!=1){
                 retval = FDB_ERR;
             } 
         }else{
@@ -671,6 +1303,7 @@ int keys_pexpire_at(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
     }else{
         retval = FDB_ERR;
     }
+    rocksdb_mutex_unlock(mutex);
 
     if(kval!=NULL) destroy_keys_val(kval);
     return retval; 
@@ -714,7 +1347,9 @@ int keys_pexpire_persist(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t*
     int retval = 0;
     keys_val_t *kval = NULL;
 
-    int ret = get_keys_val(context, slot, key, &kval);
+    rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+    rocksdb_mutex_lock(mutex);
+    int ret = get_keys_val_for_update(context, slot, key, &kval);
     if(ret == 1){
         int64_t now = (int64_t)time_ms();
         if(kval->ts_>0 && kval->ts_<= now){
@@ -727,8 +1362,9 @@ int keys_pexpire_persist(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t*
             }else{
                 *count = 1;
             }
+            int64_t ots = kval->ts_;
             kval->ts_ = 0;
-            if(set_keys_val(context, slot, key, kval)!=1){
+            if(set_keys_val(context, slot, key, kval, ots)!=1 || commit_keys_val(context, slot)!=1){
                 retval = FDB_ERR;
             } 
         }else{
@@ -741,59 +1377,210 @@ int keys_pexpire_persist(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t*
     }else{
         retval = FDB_ERR;
     }
+    rocksdb_mutex_unlock(mutex);
 
     if(kval!=NULL) destroy_keys_val(kval);
     return retval; 
 }
 
 
-int keys_self_traversal_create(fdb_context_t* context, fdb_slot_t* slot, fdb_iterator_t** iter, uint64_t limit){
-    fdb_slice_t *slice_start, *slice_end = NULL;
+int keys_ttl_reclaim(fdb_context_t* context, fdb_slot_t* slot, uint64_t max, uint64_t max_ms){
+    int count = 0;
+    //stale entries and pinned keys are charged as well, so a sweep is bounded without max_ms
+    uint64_t visited = 0;
+    uint64_t start = time_ms();
+    int64_t now = (int64_t)start;
 
-    encode_keys_key(NULL, 0, &slice_start);
-    encode_keys_key(NULL, 0, &slice_end);
-    fdb_slice_string_push_back(slice_end, "\xff", strlen("\xff"));
-    *iter = fdb_iterator_create(context, slot, slice_start, slice_end, limit, FORWARD);
+    fdb_slice_t *slice_start = NULL;
+    encode_ttl_key(NULL, 0, 0, &slice_start);
+    size_t prefixlen = fdb_slice_length(slice_start) - sizeof(uint64_t);
+
+    rocksdb_iterator_t *iterator = rocksdb_create_iterator_cf(context->db_, context->scanoptions_, slot->handle_);
+    rocksdb_iter_seek(iterator, fdb_slice_data(slice_start), fdb_slice_length(slice_start));
+
+    while(rocksdb_iter_valid(iterator) && visited < max){
+        if(max_ms > 0 && time_ms() - start >= max_ms){
+            break;
+        }
+        size_t rklen = 0;
+        const char *rkey = rocksdb_iter_key(iterator, &rklen);
+        if(rklen < prefixlen || memcmp(rkey, fdb_slice_data(slice_start), prefixlen)!=0){
+            break;
+        }
+        ++visited;
+        int64_t ts = 0;
+        fdb_slice_t *key = NULL;
+        if(decode_ttl_key(rkey, rklen, &ts, &key)!=0){
+            rocksdb_iter_next(iterator);
+            continue;
+        }
+        //entries are ordered by ts, the rest are not due yet
+        if(ts > now){
+            fdb_slice_destroy(key);
+            break;
+        }
+
+        rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+        rocksdb_mutex_lock(mutex);
+        if(fdb_slot_key_pinned(slot, fdb_slice_data(key), fdb_slice_length(key))){
+            //a command is still writing under the seq it found, the entry waits for a later round
+            rocksdb_mutex_unlock(mutex);
+            fdb_slice_destroy(key);
+            rocksdb_iter_next(iterator);
+            continue;
+        }
+        keys_val_t *kval = NULL;
+        int ret = get_keys_val_for_update(context, slot, key, &kval);
+        if(ret == 1 && kval->ts_ == ts && kval->stat_ == FDB_KEY_STAT_NORMAL){
+            if(kval->type_ == FDB_DATA_TYPE_STRING || kval->slice_ != NULL){
+                ret = rem_keys_val(context, slot, key, ts);
+            }else{
+                ret = mark_key_deleted(context, slot, key, kval->seq_);
+                if(ret == 1){
+                    kval->stat_ = FDB_KEY_STAT_PENDING;
+                    kval->ts_ = 0;
+                    drop_keys_payload(kval);
+                    ret = set_keys_val(context, slot, key, kval, ts);
+                }
+            }
+            if(ret == 1){
+                ret = commit_keys_val(context, slot);
+            }
+            if(ret == 1){
+                ++count;
+            }
+        }else if(ret >= 0){
+            //the key was removed or given another ts, the entry is stale
+            fdb_slot_writebatch_delete(slot, rkey, rklen);
+            ret = commit_keys_val(context, slot);
+        }
+        rocksdb_mutex_unlock(mutex);
+        if(kval!=NULL) destroy_keys_val(kval);
+        fdb_slice_destroy(key);
+        if(ret < 0){
+            count = -1;
+            break;
+        }
+        rocksdb_iter_next(iterator);
+    }
+
+    rocksdb_iter_destroy(iterator);
     fdb_slice_destroy(slice_start);
-    fdb_slice_destroy(slice_end);
-    return 0;
+    return count;
 }
 
-void keys_self_traversal_destroy(fdb_iterator_t* iter){
-    fdb_iterator_destroy(iter);
+int keys_filter(fdb_context_t* context, fdb_slot_t* slot, const char* fdbkey, size_t fdbkeylen, const char* val, size_t vallen, int64_t now){
+    if(fdbkeylen < 2 || fdbkey[0] != FDB_DATA_TYPE_KEYS || fdbkey[1] != '+'){
+        return 0;
+    }
+    //called for every main key compacted, so the value is read in place
+    uint8_t type = 0, stat = 0;
+    uint32_t seq = 0;
+    int64_t ts = 0;
+    if(fdb_codec_decode_keys_val(val, vallen, &type, &stat, &seq, &ts, NULL)!=0){
+        return 0;
+    }
+
+    int ret = 0;
+    if(type == FDB_DATA_TYPE_STRING || type == FDB_DATA_TYPE_INT64){
+        //nothing hangs off a string, the index entry goes stale and is dropped by keys_ttl_reclaim
+        ret = (ts>0 && ts<=now) ? 1 : 0;
+    }else if(stat == FDB_KEY_STAT_PENDING){
+        //the seq must stay known until its subkeys are gone, see dels_next_seq
+        fdb_slice_t *key = fdb_slice_create(fdbkey + 2, fdbkeylen - 2);
+        ret = (dels_is_marked(context, slot, key, seq) == 0) ? 1 : 0;
+        fdb_slice_destroy(key);
+    }
+    return ret;
 }
 
-int keys_self_traversal_work(fdb_iterator_t* iter, fdb_array_t **rets, uint64_t max){
-    fdb_array_t *array = fdb_array_create(32);
-    
-    int64_t now = (int64_t)time_ms();
-    uint64_t _count = 0;
-    do{ 
-        if(max==_count) break;
+int keys_ttl_backfill(fdb_context_t* context, fdb_slot_t* slot, uint64_t max, uint64_t max_ms){
+    if(slot->ttl_indexed_){
+        return 0;
+    }
+    int count = 0, done = 0;
+    uint64_t seen = 0;
+    uint64_t start = time_ms();
+
+    fdb_slice_t *prefix = NULL;
+    encode_keys_key(NULL, 0, &prefix);
+    fdb_slice_t *cursor = (fdb_slice_t*)slot->ttl_cursor_;
+    slot->ttl_cursor_ = NULL;
+    if(cursor == NULL){
+        cursor = fdb_slice_create(fdb_slice_data(prefix), fdb_slice_length(prefix));
+    }
+
+    rocksdb_iterator_t *iterator = rocksdb_create_iterator_cf(context->db_, context->scanoptions_, slot->handle_);
+    rocksdb_iter_seek(iterator, fdb_slice_data(cursor), fdb_slice_length(cursor));
+    fdb_slice_destroy(cursor);
+    cursor = NULL;
+    while(1){
+        if(!rocksdb_iter_valid(iterator)){
+            done = 1;
+            break;
+        }
         size_t rklen = 0, rvlen = 0;
-        const char* rkey = fdb_iterator_key_raw(iter, &rklen);
-        const char* rval = fdb_iterator_val_raw(iter, &rvlen);
-        keys_val_t* kval = NULL;
-        if(decode_keys_val(rval, rvlen, &kval)==0){
-            if(kval->ts_>0 && kval->ts_<=now && kval->stat_ == FDB_KEY_STAT_NORMAL){
-                fdb_slice_t *_key = NULL;
-                if(decode_keys_key(rkey, rklen, &_key)==0){
-                    fdb_val_node_t* knode = fdb_val_node_create();            
-                    knode->retval_ = FDB_OK;
-                    knode->val_.vval_ = _key;
-                    fdb_array_push_back(array, knode); 
-                    ++_count;
-                }
+        const char *rkey = rocksdb_iter_key(iterator, &rklen);
+        if(rklen < fdb_slice_length(prefix) || memcmp(rkey, fdb_slice_data(prefix), fdb_slice_length(prefix))!=0){
+            done = 1;
+            break;
+        }
+        if(seen >= max || (max_ms > 0 && time_ms() - start >= max_ms)){
+            //picked up from here by the next call
+            cursor = fdb_slice_create(rkey, rklen);
+            break;
+        }
+        ++seen;
+        const char *rval = rocksdb_iter_value(iterator, &rvlen);
+        uint8_t type = 0, stat = 0;
+        uint32_t seq = 0;
+        int64_t ts = 0;
+        fdb_slice_t *key = NULL;
+        if(fdb_codec_decode_keys_val(rval, rvlen, &type, &stat, &seq, &ts, NULL)!=0 || ts == 0 ||
+           decode_keys_key(rkey, rklen, &key)!=0){
+            rocksdb_iter_next(iterator);
+            continue;
+        }
+        //read again under the stripe lock, the key may have changed since the iterator was made
+        rocksdb_mutex_t *mutex = fdb_slot_key_mutex(slot, fdb_slice_data(key), fdb_slice_length(key));
+        rocksdb_mutex_lock(mutex);
+        keys_val_t *kval = NULL;
+        int ret = get_keys_val_for_update(context, slot, key, &kval);
+        if(ret == 1 && kval->ts_ > 0 && kval->stat_ == FDB_KEY_STAT_NORMAL){
+            write_keys_ttl(slot, key, 0, kval->ts_);
+            ret = commit_keys_val(context, slot);
+            if(ret == 1){
+                ++count;
             }
-            destroy_keys_val(kval);
         }
-    }while(!fdb_iterator_next(iter));
-
-    if(array->length_ > 0){
-        *rets = array;
+        rocksdb_mutex_unlock(mutex);
+        if(kval!=NULL) destroy_keys_val(kval);
+        fdb_slice_destroy(key);
+        if(ret < 0){
+            count = -1;
+            break;
+        }
+        rocksdb_iter_next(iterator);
+    }
+    char *errptr = NULL;
+    rocksdb_iter_get_error(iterator, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_iter_get_error fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        count = -1;
+    }
+    rocksdb_iter_destroy(iterator);
+    fdb_slice_destroy(prefix);
+
+    if(count < 0){
+        //started over by the next call
+        fdb_slice_destroy(cursor);
+    }else if(done){
+        if(fdb_context_set_ttl_indexed(context, slot) != FDB_OK){
+            count = -1;
+        }
     }else{
-        fdb_array_destroy(array);
+        slot->ttl_cursor_ = cursor;
     }
-    return (int)_count;
+    return count;
 }
-
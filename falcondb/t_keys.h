@@ -14,24 +14,96 @@ int decode_keys_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice);
 
 int decode_dels_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice);
 
+//ttl index entry, ts is big endian so that the entries sort by expiry time
+void encode_ttl_key(const char* key, size_t keylen, int64_t ts, fdb_slice_t** pslice);
 
-int keys_set_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* val);
+int decode_ttl_key(const char* fdbkey, size_t fdbkeylen, int64_t* ts, fdb_slice_t** pslice);
+
+
+//ts is the absolute expiry in milliseconds, 0 for none
+int keys_set_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* val, int64_t ts);
 
 int keys_get_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t** pval);
 
-//get the main key if not exist then adding
+//keys_get_string of num keys, the main keys missing from the keys cache are read together
+void keys_mget_string(fdb_context_t* context, fdb_slot_t* slot, size_t num, fdb_slice_t* const* keys, fdb_slice_t** vals,
+                      int* rets);
+
+//adding by to the integer in key, or to init if key is not there, the result is kept as a binary
+//int64 and read back as decimal, FDB_ERR_INCDECR_OVERFLOW as is_int64_overflow has it
+int keys_incr_string(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t init, int64_t by, int64_t* val);
+
+//get the main key if not exist then adding, a new main key is left in the slot batch
+//for the caller to commit along with its subkeys, a new collection keeps its members in subkeys
 int keys_enc(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type);
 
 //get the main key if not exist just let go
 int keys_exs(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type);
 
+//keys_enc and keys_exs for the commands of packed collections, *ppacked is the payload of a
+//packed one, which the caller destroys, or NULL for one kept in subkeys, keys_enc makes new
+//collections packed if packing is on, see fdb_context_set_packed_limits
+int keys_enc_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked);
+
+int keys_exs_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked);
+
+//keys_enc_packed for a command that replaces key, whatever it held is dropped in the slot batch
+//and an empty collection of type made in its place
+int keys_renew_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, fdb_slice_t** ppacked);
+
+//keys_renew_packed in two steps for a command writing the collection anew over several commits,
+//keys_renew_seq picks a seq past the one key has and every retired one for the members to go
+//under, keys_renew_at makes key anew there in the slot batch, in subkeys with no count yet
+int keys_renew_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* fresh);
+
+int keys_renew_at(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, uint32_t fresh);
+
+//replacing the payload of a packed collection in the slot batch, key as keys_enc left it,
+//a NULL packed for one whose members went to subkeys
+int keys_set_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* packed);
+
+//a seq no subkeys of the collection key, as keys_exs left it, live or retired, are under, for a
+//command writing its members anew there before keys_move_seq, which marks it retired if it fails
+int keys_fresh_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t* fresh);
+
+//moving the collection key as keys_exs left it to fresh in the slot batch, its expiry kept and
+//its old subkeys left to the reclaim in the background, it is in subkeys with no count yet
+int keys_move_seq(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint32_t fresh);
+
+//keys_pexpire_at of a collection key as keys_enc left it, into the slot batch along with the
+//subkeys of the command rather than committed on its own
+int keys_set_pexpire(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t ts);
+
+//members of a collection kept in subkeys, key as keys_enc left it, from the cached main key,
+//or from the size key of type sizetype for one written before the main key carried it
+int keys_get_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype, uint64_t* count);
+
+//adding by to that count in the slot batch, along with the subkeys of the command, the size
+//key of an older collection is dropped on the way
+int keys_incr_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t sizetype, int64_t by);
+
+//the member subkeys of type for num members of key, key as keys_enc left it, read together,
+//vals[i] is NULL for a member not there and is freed by rocksdb_free, repeats, unless NULL, flags
+//the members an earlier one equals, for a command that must read those back from its batch,
+//returns 0, -1 if the read failed
+int keys_get_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, size_t num,
+                     fdb_slice_t* const* members, char** vals, size_t* vlens, uint8_t* repeats);
+
+//whether name matches the glob pattern of a cursor scan, a NULL or empty pattern matches all
+int keys_match(fdb_slice_t* pattern, const char* name, size_t namelen);
+
+//a chunk of the live main keys past cursor, in key order, at most count looked at, name nodes
+//for those matching pattern, *pcursor is the cursor of the next chunk or NULL once done
+int keys_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* cursor, fdb_slice_t* pattern, uint64_t count,
+              fdb_array_t** rets, fdb_slice_t** pcursor);
+
 //marking the main key as deleted 
 int keys_del(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* count);
 
 //removing the main key roughly
 int keys_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key);
 
-//marking expired main key as deleted 
+//marking expired main key as deleted, strings and packed collections are dropped outright
 int keys_clr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* count);
 
 int keys_get(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t* type);
@@ -42,12 +114,16 @@ int keys_pexpire_left(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key
 
 int keys_pexpire_persist(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* count);
 
-//keys traversal
-int keys_self_traversal_create(fdb_context_t* context, fdb_slot_t* slot, fdb_iterator_t** iter, uint64_t limit);
-
-int keys_self_traversal_work(fdb_iterator_t* iter, fdb_array_t** rets, uint64_t max);
+//expiring the due keys in the ttl index, at most max index entries and max_ms milliseconds each
+//call, whether expired, stale or skipped, returns the keys expired
+int keys_ttl_reclaim(fdb_context_t* context, fdb_slot_t* slot, uint64_t max, uint64_t max_ms);
 
-void keys_self_traversal_destroy(fdb_iterator_t* iter);
+//main keys given a ts before the ttl index existed have no entry in it, they are indexed once by
+//walking the main keys of the slot, at most max keys and max_ms milliseconds each call, the walk
+//resumes where the last call stopped and the slot is marked done, returns the entries written
+int keys_ttl_backfill(fdb_context_t* context, fdb_slot_t* slot, uint64_t max, uint64_t max_ms);
 
+//whether compaction may drop the main key record, expired strings and reclaimed collections
+int keys_filter(fdb_context_t* context, fdb_slot_t* slot, const char* fdbkey, size_t fdbkeylen, const char* val, size_t vallen, int64_t now);
 
 #endif //FDB_T_KEYS_H
@@ -0,0 +1,300 @@
+#include "t_packed.h"
+#include "t_keys.h"
+
+#include "fdb_types.h"
+#include "fdb_define.h"
+#include "fdb_codec.h"
+#include "fdb_malloc.h"
+#include "util.h"
+
+#include <rocksdb/c.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+struct packed_t {
+    uint8_t             type_;
+    size_t              length_;
+    size_t              cap_;
+    size_t              bytes_;         //encoded size of the entries
+    packed_entry_t*     entries_;
+    fdb_slice_t*        payload_;       //decoded from, the entries not put since point into it
+};
+
+
+static size_t packed_entry_size(uint8_t type, const packed_entry_t* entry){
+    size_t size = fdb_codec_varint32_size((uint32_t)entry->member_.length_) + entry->member_.length_;
+    if(type == FDB_DATA_TYPE_HASH){
+        size += fdb_codec_varint32_size((uint32_t)entry->value_.length_) + entry->value_.length_;
+    }else if(type == FDB_DATA_TYPE_ZSET){
+        size += sizeof(uint64_t);
+    }
+    return size;
+}
+
+//zset entries by score then member, the others by member
+static int packed_compare(const packed_t* packed, const packed_entry_t* entry, const char* lex,
+                          const char* member, size_t memberlen){
+    if(packed->type_ == FDB_DATA_TYPE_ZSET){
+        int ret = memcmp(entry->lex_, lex, sizeof(uint64_t));
+        if(ret != 0){
+            return ret;
+        }
+    }
+    return compare_with_length(entry->member_.data_, entry->member_.length_, member, memberlen);
+}
+
+static size_t packed_lower_bound(const packed_t* packed, const char* lex, const char* member, size_t memberlen){
+    size_t lo = 0, hi = packed->length_;
+    while(lo < hi){
+        size_t mid = lo + (hi - lo)/2;
+        if(packed_compare(packed, &packed->entries_[mid], lex, member, memberlen) < 0){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void packed_reserve(packed_t* packed, size_t cap){
+    if(cap <= packed->cap_){
+        return;
+    }
+    size_t newcap = packed->cap_ > 0 ? packed->cap_ * 2 : 8;
+    while(newcap < cap){
+        newcap *= 2;
+    }
+    packed->entries_ = (packed_entry_t*)fdb_realloc(packed->entries_, newcap * sizeof(packed_entry_t));
+    packed->cap_ = newcap;
+}
+
+
+void packed_empty_payload(fdb_slice_t** pslice){
+    char buf[1];
+    size_t len = fdb_codec_encode_varint32(buf, 0);
+    *pslice = fdb_slice_create(buf, len);
+}
+
+//the payload keys_enc_packed and the like left, decoded
+static int packed_opened(fdb_context_t* context, fdb_slot_t* slot, uint8_t type, int create, int retval,
+                         fdb_slice_t* payload, packed_t** ppacked){
+    if(retval == FDB_OK && payload != NULL && packed_decode(type, payload, ppacked) != 0){
+        if(create){
+            fdb_slot_writebatch_discard(context, slot);
+        }
+        retval = FDB_ERR;
+    }
+    fdb_slice_destroy(payload);
+    return retval;
+}
+
+int packed_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, int create, packed_t** ppacked){
+    fdb_slice_t *payload = NULL;
+    *ppacked = NULL;
+    int retval = create ? keys_enc_packed(context, slot, key, type, &payload) : keys_exs_packed(context, slot, key, type, &payload);
+    return packed_opened(context, slot, type, create, retval, payload, ppacked);
+}
+
+int packed_renew(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, packed_t** ppacked){
+    fdb_slice_t *payload = NULL;
+    *ppacked = NULL;
+    int retval = keys_renew_packed(context, slot, key, type, &payload);
+    return packed_opened(context, slot, type, 1, retval, payload, ppacked);
+}
+
+int packed_store(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed){
+    fdb_slice_t *payload = NULL;
+    packed_encode(packed, &payload);
+    int retval = keys_set_packed(context, slot, key, payload);
+    fdb_slice_destroy(payload);
+    return retval;
+}
+
+packed_t* packed_create(uint8_t type){
+    packed_t *packed = (packed_t*)fdb_malloc(sizeof(packed_t));
+    packed->type_ = type;
+    packed->length_ = 0;
+    packed->cap_ = 0;
+    packed->bytes_ = 0;
+    packed->entries_ = NULL;
+    packed->payload_ = NULL;
+    return packed;
+}
+
+int packed_decode(uint8_t type, fdb_slice_t* payload, packed_t** ppacked){
+    const char *p = fdb_slice_data(payload);
+    const char *limit = p + fdb_slice_length(payload);
+    uint32_t count = 0;
+    if(fdb_codec_decode_varint32(&p, limit, &count) != 0){
+        return -1;
+    }
+    packed_t *packed = packed_create(type);
+    fdb_incr_ref_count(payload);
+    packed->payload_ = payload;
+    packed_reserve(packed, count);
+    for(uint32_t i=0; i<count; ++i){
+        packed_entry_t *entry = &packed->entries_[i];
+        memset(entry, 0, sizeof(packed_entry_t));
+        uint32_t len = 0;
+        if(type == FDB_DATA_TYPE_ZSET){
+            if(limit - p < (long)sizeof(uint64_t)){
+                goto err;
+            }
+            memcpy(entry->lex_, p, sizeof(uint64_t));
+            entry->score_ = lex_to_double(rocksdb_decode_fixed64(p));
+            p += sizeof(uint64_t);
+        }
+        if(fdb_codec_decode_varint32(&p, limit, &len) != 0 || (size_t)(limit - p) < len){
+            goto err;
+        }
+        entry->member_.data_ = p;
+        entry->member_.length_ = len;
+        p += len;
+        if(type == FDB_DATA_TYPE_HASH){
+            if(fdb_codec_decode_varint32(&p, limit, &len) != 0 || (size_t)(limit - p) < len){
+                goto err;
+            }
+            entry->value_.data_ = p;
+            entry->value_.length_ = len;
+            p += len;
+        }
+        packed->length_ = i + 1;
+        packed->bytes_ += packed_entry_size(type, entry);
+    }
+    if(p != limit){
+        goto err;
+    }
+    *ppacked = packed;
+    return 0;
+
+err:
+    fprintf(stderr, "%s malformed payload of %lu bytes.\n", __func__, fdb_slice_length(payload));
+    packed_destroy(packed);
+    return -1;
+}
+
+void packed_encode(packed_t* packed, fdb_slice_t** pslice){
+    size_t size = fdb_codec_varint32_size((uint32_t)packed->length_) + packed->bytes_;
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, size);
+    char *p = buf;
+    p += fdb_codec_encode_varint32(p, (uint32_t)packed->length_);
+    for(size_t i=0; i<packed->length_; ++i){
+        const packed_entry_t *entry = &packed->entries_[i];
+        if(packed->type_ == FDB_DATA_TYPE_ZSET){
+            memcpy(p, entry->lex_, sizeof(uint64_t));
+            p += sizeof(uint64_t);
+        }
+        p += fdb_codec_encode_varint32(p, (uint32_t)entry->member_.length_);
+        if(entry->member_.length_ > 0) memcpy(p, entry->member_.data_, entry->member_.length_);
+        p += entry->member_.length_;
+        if(packed->type_ == FDB_DATA_TYPE_HASH){
+            p += fdb_codec_encode_varint32(p, (uint32_t)entry->value_.length_);
+            if(entry->value_.length_ > 0) memcpy(p, entry->value_.data_, entry->value_.length_);
+            p += entry->value_.length_;
+        }
+    }
+    *pslice = fdb_slice_create(buf, p - buf);
+    fdb_codec_buf_free(stack, buf);
+}
+
+void packed_destroy(packed_t* packed){
+    if(packed == NULL){
+        return;
+    }
+    for(size_t i=0; i<packed->length_; ++i){
+        fdb_free(packed->entries_[i].own_);
+    }
+    fdb_free(packed->entries_);
+    fdb_slice_destroy(packed->payload_);
+    fdb_free(packed);
+}
+
+size_t packed_length(const packed_t* packed){
+    return packed->length_;
+}
+
+int packed_fits(fdb_context_t* context, const packed_t* packed){
+    size_t size = fdb_codec_varint32_size((uint32_t)packed->length_) + packed->bytes_;
+    return packed->length_ <= context->packed_entries_ && size <= context->packed_bytes_;
+}
+
+const packed_entry_t* packed_at(const packed_t* packed, size_t pos){
+    return &packed->entries_[pos];
+}
+
+long packed_find(const packed_t* packed, const char* member, size_t memberlen){
+    if(packed->type_ == FDB_DATA_TYPE_ZSET){
+        //in score order, so looked for one by one
+        for(size_t i=0; i<packed->length_; ++i){
+            const packed_entry_t *entry = &packed->entries_[i];
+            if(compare_with_length(entry->member_.data_, entry->member_.length_, member, memberlen) == 0){
+                return (long)i;
+            }
+        }
+        return -1;
+    }
+    size_t pos = packed_lower_bound(packed, NULL, member, memberlen);
+    if(pos < packed->length_ &&
+       compare_with_length(packed->entries_[pos].member_.data_, packed->entries_[pos].member_.length_, member, memberlen) == 0){
+        return (long)pos;
+    }
+    return -1;
+}
+
+int packed_put(packed_t* packed, const char* member, size_t memberlen, const char* value, size_t valuelen, double score){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+    int added = 1;
+    long found = packed_find(packed, member, memberlen);
+    if(found >= 0){
+        if(packed->type_ == FDB_DATA_TYPE_SET){
+            return 0;
+        }
+        if(packed->type_ == FDB_DATA_TYPE_ZSET && memcmp(packed->entries_[found].lex_, lex, sizeof(uint64_t)) == 0){
+            return 0;
+        }
+        packed_del_at(packed, (size_t)found);
+        added = 0;
+    }
+    if(packed->type_ != FDB_DATA_TYPE_HASH){
+        valuelen = 0;
+    }
+
+    size_t pos = packed_lower_bound(packed, lex, member, memberlen);
+    packed_reserve(packed, packed->length_ + 1);
+    memmove(&packed->entries_[pos + 1], &packed->entries_[pos], (packed->length_ - pos) * sizeof(packed_entry_t));
+    packed_entry_t *entry = &packed->entries_[pos];
+    memset(entry, 0, sizeof(packed_entry_t));
+    entry->own_ = (char*)fdb_malloc(memberlen + valuelen + 1);
+    if(memberlen > 0) memcpy(entry->own_, member, memberlen);
+    if(valuelen > 0) memcpy(entry->own_ + memberlen, value, valuelen);
+    entry->member_.data_ = entry->own_;
+    entry->member_.length_ = memberlen;
+    entry->value_.data_ = entry->own_ + memberlen;
+    entry->value_.length_ = valuelen;
+    entry->score_ = score;
+    memcpy(entry->lex_, lex, sizeof(uint64_t));
+    packed->length_ += 1;
+    packed->bytes_ += packed_entry_size(packed->type_, entry);
+    return added;
+}
+
+int packed_del(packed_t* packed, const char* member, size_t memberlen){
+    long found = packed_find(packed, member, memberlen);
+    if(found < 0){
+        return 0;
+    }
+    packed_del_at(packed, (size_t)found);
+    return 1;
+}
+
+void packed_del_at(packed_t* packed, size_t pos){
+    packed_entry_t *entry = &packed->entries_[pos];
+    packed->bytes_ -= packed_entry_size(packed->type_, entry);
+    fdb_free(entry->own_);
+    memmove(entry, entry + 1, (packed->length_ - pos - 1) * sizeof(packed_entry_t));
+    packed->length_ -= 1;
+}
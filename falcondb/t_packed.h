@@ -0,0 +1,69 @@
+#ifndef FDB_T_PACKED_H
+#define FDB_T_PACKED_H
+
+#include "fdb_context.h"
+#include "fdb_slice.h"
+#include "fdb_codec.h"
+
+#include <stdint.h>
+
+//members of a small hash, set or zset kept in the payload of its main key rather than in
+//subkeys, a hash or set in member order and a zset in score order as their subkeys sort,
+//the payload is varint count and the entries, varint len field varint len value for a hash,
+//varint len member for a set, lex score(8) varint len member for a zset, a collection goes
+//to subkeys for good once over the packed limits of the context
+typedef struct packed_t                     packed_t;
+
+struct packed_entry_t {
+    fdb_view_t  member_;                    //field of a hash
+    fdb_view_t  value_;                     //hash only
+    double      score_;                     //zset only
+    char        lex_[sizeof(uint64_t)];     //score as encoded in the score index
+    char*       own_;                       //copy behind member_ and value_ once put
+};
+
+typedef struct packed_entry_t               packed_entry_t;
+
+//payload of a collection with no members yet
+void packed_empty_payload(fdb_slice_t** pslice);
+
+//keys_enc_packed, or keys_exs_packed unless create, for a command on a collection of type,
+//*ppacked is NULL if the collection keeps its members in subkeys
+int packed_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, int create, packed_t** ppacked);
+
+//packed_open through keys_renew_packed, for a command that replaces the collection
+int packed_renew(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint8_t type, packed_t** ppacked);
+
+//writing the packed back to the main key through the slot batch
+int packed_store(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed);
+
+packed_t* packed_create(uint8_t type);
+
+//the entries point into payload, which the packed holds on to, returns 0, -1 if malformed
+int packed_decode(uint8_t type, fdb_slice_t* payload, packed_t** ppacked);
+
+//a payload on the heap, as it goes on to the keys cache
+void packed_encode(packed_t* packed, fdb_slice_t** pslice);
+
+void packed_destroy(packed_t* packed);
+
+size_t packed_length(const packed_t* packed);
+
+//whether the packed is within the packed limits of the context
+int packed_fits(fdb_context_t* context, const packed_t* packed);
+
+const packed_entry_t* packed_at(const packed_t* packed, size_t pos);
+
+//position of member, -1 if not in it
+long packed_find(const packed_t* packed, const char* member, size_t memberlen);
+
+//adding member, or replacing its value or score, returns 1 if added, 0 if replaced
+int packed_put(packed_t* packed, const char* member, size_t memberlen, const char* value, size_t valuelen, double score);
+
+//returns 1 if removed, 0 if not in it
+int packed_del(packed_t* packed, const char* member, size_t memberlen);
+
+void packed_del_at(packed_t* packed, size_t pos);
+
+
+#endif //FDB_T_PACKED_H
@@ -1,12 +1,13 @@
 #include "t_set.h"
 #include "t_keys.h"
+#include "t_packed.h"
 
 #include "fdb_types.h"
 #include "fdb_iterator.h"
 #include "fdb_define.h"
 #include "fdb_slice.h"
 #include "fdb_context.h"
-#include "fdb_bytes.h"
+#include "fdb_codec.h"
 #include "fdb_malloc.h"
 #include "util.h"
 
@@ -16,111 +17,69 @@
 #include <stdio.h>
 #include <assert.h>
 
-static int sset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member);
+static int sset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    int found);
 
-static int sget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length);
+static void sput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen);
 
-static int sget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member);
+static int sget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length);
 
-static int srem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member);
+static int sget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member);
+
+static int srem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member);
 
 static int set_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by);
 
+static int set_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by);
+
 static int sget_scan(fdb_context_t* context, fdb_slot_t *slot, fdb_slice_t* key, fdb_slice_t* mstart, 
                      fdb_slice_t* mend, uint64_t limit, int reverse, fdb_iterator_t** piterator);
 
 
 void encode_ssize_key(const char* key, size_t keylen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_SSIZE);
-    *pslice = slice; 
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_size_key_size(keylen));
+    size_t len = fdb_codec_encode_size_key(buf, FDB_DATA_TYPE_SSIZE, key, keylen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 
-int decode_ssize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){ 
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen);
-
-    uint8_t type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_SSIZE){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_key)==-1){
-        ret = -1;
-        goto end; 
+int decode_ssize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
+    fdb_view_t key;
+    if(fdb_codec_decode_size_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_SSIZE, &key)!=0){
+        return -1;
     }
-    *pslice = slice_key;
-    fdb_incr_ref_count(slice_key);
-    ret = 0;
-
-
-end:
-    fdb_bytes_destroy(bytes);
-    fdb_slice_destroy(slice_key);
-    return ret;
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
 }
 
-void encode_set_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice){ 
-    fdb_slice_t *slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_SET);
-    fdb_slice_uint8_push_back(slice, '=');
-    fdb_slice_string_push_back(slice, member, memberlen);
-    *pslice = slice;
+void encode_set_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_member_key_size(keylen, memberlen));
+    size_t len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_SET, key, keylen, member, memberlen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
-int decode_set_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t **pkey, fdb_slice_t **pmember){
-    int ret = 0;
-    fdb_slice_t *slice_key = NULL, *slice_member = NULL;
-    fdb_bytes_t *bytes = fdb_bytes_create(fdbkey, fdbkeylen);
-
-
-    uint8_t  type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_SET){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_uint8(bytes, &slice_key)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &slice_member)==-1){
-        ret = -1;
-        goto end;
+int decode_set_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pmember){
+    fdb_view_t key, member;
+    if(fdb_codec_decode_member_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_SET, &key, &member)!=0){
+        return -1;
     }
     if(pkey!=NULL){
-        *pkey = slice_key; 
-        fdb_incr_ref_count(slice_key);
+        *pkey = fdb_slice_create(key.data_, key.length_);
     }
     if(pmember!=NULL){
-        *pmember = slice_member;
-        fdb_incr_ref_count(slice_member);
+        *pmember = fdb_slice_create(member.data_, member.length_);
     }
-    ret = 0;
-
-end:
-    fdb_slice_destroy(slice_key);
-    fdb_slice_destroy(slice_member);
-    fdb_bytes_destroy(bytes);
-    return ret;
+    return 0;
 }
 
 
-static int sset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member){
+//found is whether member is in a set in subkeys if the caller looked it up already, -1 if not
+static int sset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    int found){
     if(fdb_slice_length(key)==0 || fdb_slice_length(member)==0){
         fprintf(stderr, "%s empty name or key!\n", __func__); 
         return -1;
@@ -133,40 +92,48 @@ static int sset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         fprintf(stderr, "%s name too long!\n", __func__);
         return -1;
     }
-    int ret = sget_one(context, slot, key, member); 
+    if(packed != NULL){
+        return packed_put(packed, fdb_slice_data(member), fdb_slice_length(member), NULL, 0, 0.0);
+    }
+    int ret = (found >= 0) ? found : sget_one(context, slot, key, NULL, member); 
     if(ret < 0){
         return -1;
     }else{ 
-        fdb_slice_t *slice_key = NULL;
-        encode_set_key(fdb_slice_data(key),
-                       fdb_slice_length(key),
-                       fdb_slice_data(member),
-                       fdb_slice_length(member),
-                       &slice_key);
-        fdb_slot_writebatch_put(slot, 
-                                fdb_slice_data(slice_key),
-                                fdb_slice_length(slice_key),
-                                NULL,
-                                0);
-        fdb_slice_destroy(slice_key);
+        sput_one(slot, key, fdb_slice_data(member), fdb_slice_length(member));
         return ret==0?1:0;
     }
     return 0;
 }
 
-static int sget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member){  
-    fdb_slice_t *slice_key = NULL;
-    encode_set_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(member), fdb_slice_length(member), &slice_key);
+static void sput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), memberlen));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_SET, fdb_slice_data(key), fdb_slice_length(key),
+                                                   member, memberlen);
+    fdb_slot_writebatch_put(slot, 
+                            fdbkey,
+                            fdbkeylen,
+                            NULL,
+                            0);
+    fdb_codec_buf_free(stack, fdbkey);
+}
+
+static int sget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member){  
+    if(packed != NULL){
+        return (packed_find(packed, fdb_slice_data(member), fdb_slice_length(member)) >= 0) ? 1 : 0;
+    }
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(member)));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_SET, fdb_slice_data(key), fdb_slice_length(key),
+                                                   fdb_slice_data(member), fdb_slice_length(member));
 
     size_t vallen = 0;
     char *errptr = NULL;
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    char *val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr); 
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
+    char *val = fdb_slot_writebatch_get(context, slot, fdbkey, fdbkeylen, &vallen, &errptr); 
+    fdb_codec_buf_free(stack, fdbkey);
     int ret = 0;
     if(errptr!=NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
         rocksdb_free(errptr);
         ret = -1;
         goto end;
@@ -184,7 +151,7 @@ end:
     return ret;
 }
 
-static int srem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member){ 
+static int srem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member){ 
     if(fdb_slice_length(key) > FDB_DATA_TYPE_KEY_LEN_MAX){
         fprintf(stderr, "%s key too long!\n", __func__);
         return -1;
@@ -194,85 +161,57 @@ static int srem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         return -1;
     }
 
-    if(sget_one(context, slot, key, member) <=0){
+    if(packed != NULL){
+        return packed_del(packed, fdb_slice_data(member), fdb_slice_length(member));
+    }
+    if(sget_one(context, slot, key, NULL, member) <=0){
         return 0;
     }
-    fdb_slice_t *slice_key = NULL;
-    encode_set_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(member), fdb_slice_length(member), &slice_key);
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(member)));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_SET, fdb_slice_data(key), fdb_slice_length(key),
+                                                   fdb_slice_data(member), fdb_slice_length(member));
 
     fdb_slot_writebatch_delete(slot,
-                               fdb_slice_data(slice_key),
-                               fdb_slice_length(slice_key));
-    fdb_slice_destroy(slice_key);
+                               fdbkey,
+                               fdbkeylen);
+    fdb_codec_buf_free(stack, fdbkey);
     return 1;
 }
 
-static int sget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length){ 
-    char *val = NULL, *errptr = NULL;
-    size_t vallen = 0;
-
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
-    fdb_slice_t* slice_key = NULL;
-    encode_ssize_key(fdb_slice_data(key), fdb_slice_length(key), &slice_key);
-    val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
-
-    int ret = 0;
-    if(errptr!=NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
-        rocksdb_free(errptr);
-        ret = -1;
-        goto end;
-    }
-    if(val!=NULL){
-        if(vallen < sizeof(uint64_t)){
-            ret = -1;
-            goto end;
-        }
-        *length = rocksdb_decode_fixed64(val);
-        ret = 1;
-    }else{
-        ret = 0;
+static int sget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length){
+    if(packed != NULL){
+        *length = packed_length(packed);
+        return 1;
     }
+    return (keys_get_count(context, slot, key, FDB_DATA_TYPE_SSIZE, length) == FDB_OK) ? 1 : -1;
+}
 
-end:
-    if(val != NULL){
-        rocksdb_free(val); 
+
+static int set_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by){
+    if(by == 0){
+        return 0;
     }
-    return ret;
+    return (keys_incr_count(context, slot, key, FDB_DATA_TYPE_SSIZE, by) == FDB_OK) ? 0 : -1;
 }
 
-
-static int set_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by){ 
-    uint64_t length = 0;
-    int ret = sget_len(context, slot, key, &length);
-    if(ret!=0 && ret != 1){
+//a set in subkeys has its size moved by by, a packed one is written back whole, or moved to
+//subkeys for good once past the packed limits
+static int set_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by){
+    if(packed == NULL){
+        return set_incr_size(context, slot, key, by);
+    }
+    if(packed_fits(context, packed)){
+        return (packed_store(context, slot, key, packed) == FDB_OK) ? 0 : -1;
+    }
+    for(size_t i=0; i<packed_length(packed); ++i){
+        const packed_entry_t *entry = packed_at(packed, i);
+        sput_one(slot, key, entry->member_.data_, entry->member_.length_);
+    }
+    if(keys_set_packed(context, slot, key, NULL) != FDB_OK){
         return -1;
     }
-    int64_t size = (int64_t)length;
-    size += by;
-
-    fdb_slice_t* slice_key = NULL;
-    encode_ssize_key(fdb_slice_data(key),
-                     fdb_slice_length(key),
-                     &slice_key);
-    if(size <= 0){
-        fdb_slot_writebatch_delete(slot,
-                                   fdb_slice_data(slice_key),
-                                   fdb_slice_length(slice_key));
-    }else{
-        char buff[sizeof(uint64_t)] = {0};
-        length = size;
-        rocksdb_encode_fixed64(buff, length);
-        fdb_slot_writebatch_put(slot,
-                                fdb_slice_data(slice_key),
-                                fdb_slice_length(slice_key),
-                                buff,
-                                sizeof(buff));
-    }
-    fdb_slice_destroy(slice_key);
-    return 0;
+    return set_incr_size(context, slot, key, (int64_t)packed_length(packed));
 }
 
 static int sget_scan(fdb_context_t* context, fdb_slot_t *slot, fdb_slice_t* key, fdb_slice_t* mstart, 
@@ -321,24 +260,41 @@ static int sget_scan(fdb_context_t* context, fdb_slot_t *slot, fdb_slice_t* key,
 
 
 int set_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_SET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
     if(retval == FDB_OK){
+        fdb_array_t *array = fdb_array_create(128);
+        if(packed != NULL){
+            for(size_t i=0; i<packed_length(packed); ++i){
+                const packed_entry_t *entry = packed_at(packed, i);
+                fdb_val_node_t* mnode = fdb_val_node_create_in(fdb_arena_current());
+                mnode->retval_ = FDB_OK;
+                mnode->val_.vval_ = fdb_slice_create(entry->member_.data_, entry->member_.length_);
+                fdb_array_push_back(array, mnode);
+            }
+            packed_destroy(packed);
+            *rets = array;
+            return FDB_OK;
+        }
         fdb_iterator_t* iterator = NULL;
         if(sget_scan(context, slot, key, NULL, NULL, 2000000, 0, &iterator)!=0){
+            fdb_array_destroy(array);
             return FDB_OK_RANGE_HAVE_NONE;
         }
-        fdb_array_t *array = fdb_array_create(128);
-        do{
+        while(fdb_iterator_valid(iterator)){
             size_t rklen = 0;
             const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
             fdb_slice_t *member = NULL;
             if(decode_set_key(rkey, rklen, NULL, &member)==0){
-                fdb_val_node_t* mnode = fdb_val_node_create();
+                fdb_val_node_t* mnode = fdb_val_node_create_in(fdb_arena_current());
                 mnode->retval_ = FDB_OK;
                 mnode->val_.vval_ = member;
                 fdb_array_push_back(array, mnode);
             } 
-        }while(!fdb_iterator_next(iterator));
+            if(fdb_iterator_next(iterator)){
+                break;
+            }
+        }
         fdb_iterator_destroy(iterator);
         *rets = array;
         retval = FDB_OK; 
@@ -346,11 +302,68 @@ int set_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_
     return retval;
 }
 
+int set_sscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+              uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    fdb_array_t *array = fdb_array_create(16);
+    fdb_slice_t *next = NULL;
+    if(packed != NULL){
+        for(size_t i=0; i<packed_length(packed); ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(keys_match(pattern, entry->member_.data_, entry->member_.length_)){
+                fdb_val_node_t* mnode = fdb_val_node_create_in(fdb_arena_current());
+                mnode->retval_ = FDB_OK;
+                mnode->val_.vval_ = fdb_slice_create(entry->member_.data_, entry->member_.length_);
+                fdb_array_push_back(array, mnode);
+            }
+        }
+        packed_destroy(packed);
+        *rets = array;
+        *pcursor = NULL;
+        return FDB_OK;
+    }
+
+    fdb_iterator_t *iterator = NULL;
+    sget_scan(context, slot, key, cursor, NULL, count, 0, &iterator);
+    uint64_t seen = 0;
+    int more = fdb_iterator_valid(iterator);
+    while(more && seen < count){
+        size_t rklen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        fdb_view_t member;
+        if(fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_SET, NULL, &member)==0){
+            if(keys_match(pattern, member.data_, member.length_)){
+                fdb_val_node_t* mnode = fdb_val_node_create_in(fdb_arena_current());
+                mnode->retval_ = FDB_OK;
+                mnode->val_.vval_ = fdb_slice_create(member.data_, member.length_);
+                fdb_array_push_back(array, mnode);
+            }
+            if(++seen == count){
+                next = fdb_slice_create(member.data_, member.length_);
+            }
+        }
+        more = (fdb_iterator_next(iterator) == 0);
+    }
+    fdb_iterator_destroy(iterator);
+    if(!more){
+        fdb_slice_destroy(next);
+        next = NULL;
+    }
+    *rets = array;
+    *pcursor = next;
+    return FDB_OK;
+}
+
 int set_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* size){ 
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_SET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
     if(retval == FDB_OK){
         uint64_t len = 0;
-        int ret =  sget_len(context, slot, key, &len);
+        int ret =  sget_len(context, slot, key, packed, &len);
         if(ret == 1){
             *size = (int64_t)len;
             retval = FDB_OK;
@@ -361,13 +374,15 @@ int set_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t
             retval = FDB_ERR;
         }
     }
+    packed_destroy(packed);
     return retval;
 }
 
 int set_member_exists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, int64_t* count){ 
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_SET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
     if(retval == FDB_OK){
-        int ret = sget_one(context, slot, key, member);
+        int ret = sget_one(context, slot, key, packed, member);
         if(ret >= 0){
             retval = FDB_OK;
             *count = (ret==0 ? 0 : 1);
@@ -375,12 +390,14 @@ int set_member_exists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key
             retval = FDB_ERR;
         }
     }
+    packed_destroy(packed);
     return retval;
 }
 
 
 int set_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_SET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
@@ -388,52 +405,416 @@ int set_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_arra
     int64_t _count = 0;
     for(size_t i=0; i<members->length_; ++i){ 
         fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
-        int ret = srem_one(context, slot, key, member);
-        if(ret >= 0){
-            if(ret > 0){
-                if(set_incr_size(context, slot, key, -1)== 0){
-                    _count++;
-                }
-            }
-
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", errptr, __func__);
-                rocksdb_free(errptr);
-            }
+        int ret = srem_one(context, slot, key, packed, member);
+        if(ret > 0){
+            _count++;
         }
     }
+    int ret = (_count > 0) ? set_update(context, slot, key, packed, -_count) : 0;
+    packed_destroy(packed);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
 
     *count = _count;
     return FDB_OK;
 }
 
 int set_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count){
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_SET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 1, &packed);
     if(retval != FDB_OK){
         return retval;
     }
 
+    //the members of a set in subkeys are looked up together, one repeated in members is read
+    //back from the batch and counted once
+    size_t len = members->length_;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_slice_t **mbrs = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    char **vals = (char**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(char*));
+    size_t *vallens = (size_t*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(size_t));
+    uint8_t *repeats = (uint8_t*)fdb_malloc_in(arena, (len > 0 ? len : 1));
+    for(size_t i=0; i<len; ++i){
+        mbrs[i] = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
+    }
+    int ret = 0;
+    if(packed == NULL){
+        ret = keys_get_members(context, slot, key, FDB_DATA_TYPE_SET, len, mbrs, vals, vallens, repeats);
+    }
+
     int64_t _count = 0;
-    for(size_t i=0; i<members->length_; ++i){ 
-        fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
-        int ret = sset_one(context, slot, key, member);
-        if(ret >=0){
-            if(ret > 0){
-                if(set_incr_size(context, slot, key, 1) == 0){
-                    ++_count;
+    for(size_t i=0; ret == 0 && i<len; ++i){ 
+        int found = -1;
+        if(packed == NULL && !repeats[i]){
+            found = (vals[i] != NULL) ? 1 : 0;
+        }
+        if(packed == NULL && vals[i] != NULL){
+            rocksdb_free(vals[i]);
+        }
+        if(sset_one(context, slot, key, packed, mbrs[i], found) > 0){
+            ++_count;
+        }
+    }
+    if(ret == 0){
+        ret = set_update(context, slot, key, packed, _count);
+    }
+    packed_destroy(packed);
+    fdb_free_in(arena, mbrs);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, vallens);
+    fdb_free_in(arena, repeats);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+
+    *count = _count;
+    return FDB_OK;
+}
+
+int set_member_mexists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, fdb_array_t** rets){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_SET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    size_t len = members->length_;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_slice_t **mbrs = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    char **vals = (char**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(char*));
+    size_t *vallens = (size_t*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(size_t));
+    for(size_t i=0; i<len; ++i){
+        mbrs[i] = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
+    }
+    int ret = 0;
+    if(packed == NULL){
+        ret = keys_get_members(context, slot, key, FDB_DATA_TYPE_SET, len, mbrs, vals, vallens, NULL);
+    }
+    if(ret == 0){
+        fdb_array_t *array = fdb_array_create(len);
+        for(size_t i=0; i<len; ++i){
+            fdb_val_node_t *node = fdb_val_node_create_in(arena);
+            node->retval_ = FDB_OK;
+            if(packed != NULL){
+                node->val_.uval_ = (uint64_t)sget_one(context, slot, key, packed, mbrs[i]);
+            }else{
+                node->val_.uval_ = (vals[i] != NULL) ? 1 : 0;
+                if(vals[i] != NULL) rocksdb_free(vals[i]);
+            }
+            fdb_array_push_back(array, node);
+        }
+        *rets = array;
+        retval = FDB_OK;
+    }else{
+        retval = FDB_ERR;
+    }
+    packed_destroy(packed);
+    fdb_free_in(arena, mbrs);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, vallens);
+    return retval;
+}
+
+
+//one set of a multi-key command read in member order, a packed one from its payload
+struct sstream_t {
+    fdb_slice_t*        key_;           //seq prefixed once open
+    packed_t*           packed_;
+    int                 exists_;
+    uint64_t            size_;
+    size_t              pos_;
+    fdb_iterator_t*     iterator_;
+    int                 valid_;
+    fdb_view_t          member_;        //the current member, until the stream moves on
+};
+
+static int sstream_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* name, struct sstream_t* stream){
+    memset(stream, 0, sizeof(struct sstream_t));
+    stream->key_ = fdb_slice_create(fdb_slice_data(name), fdb_slice_length(name));
+    int retval = packed_open(context, slot, stream->key_, FDB_DATA_TYPE_SET, 0, &stream->packed_);
+    if(retval == FDB_OK_NOT_EXIST){
+        return FDB_OK;
+    }
+    if(retval != FDB_OK){
+        return retval;
+    }
+    stream->exists_ = 1;
+    return (sget_len(context, slot, stream->key_, stream->packed_, &stream->size_) == 1) ? FDB_OK : FDB_ERR;
+}
+
+static void sstream_close(struct sstream_t* stream){
+    fdb_iterator_destroy(stream->iterator_);
+    packed_destroy(stream->packed_);
+    fdb_slice_destroy(stream->key_);
+}
+
+static void sstream_load(struct sstream_t* stream){
+    stream->valid_ = 0;
+    if(stream->packed_ != NULL){
+        if(stream->pos_ < packed_length(stream->packed_)){
+            stream->member_ = packed_at(stream->packed_, stream->pos_)->member_;
+            stream->valid_ = 1;
+        }
+    }else if(stream->iterator_ != NULL && fdb_iterator_valid(stream->iterator_)){
+        size_t rklen = 0;
+        const char* rkey = fdb_iterator_key_raw(stream->iterator_, &rklen);
+        stream->valid_ = (fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_SET, NULL, &stream->member_) == 0);
+    }
+}
+
+static void sstream_start(fdb_context_t* context, fdb_slot_t* slot, struct sstream_t* stream){
+    if(stream->exists_ && stream->packed_ == NULL){
+        sget_scan(context, slot, stream->key_, NULL, NULL, INT32_MAX, 0, &stream->iterator_);
+    }
+    sstream_load(stream);
+}
+
+static void sstream_next(struct sstream_t* stream){
+    if(stream->packed_ != NULL){
+        stream->pos_ += 1;
+        sstream_load(stream);
+    }else if(fdb_iterator_next(stream->iterator_) == 0){
+        sstream_load(stream);
+    }else{
+        stream->valid_ = 0;
+    }
+}
+
+//whether member is in the set, returns 1 or 0, -1 on error
+static int sstream_has(fdb_context_t* context, fdb_slot_t* slot, struct sstream_t* stream, const fdb_view_t* member){
+    if(!stream->exists_){
+        return 0;
+    }
+    if(stream->packed_ != NULL){
+        return (packed_find(stream->packed_, member->data_, member->length_) >= 0) ? 1 : 0;
+    }
+    fdb_slice_t *slice = fdb_slice_create_in(fdb_arena_current(), member->data_, member->length_);
+    int ret = sget_one(context, slot, stream->key_, NULL, slice);
+    fdb_slice_destroy(slice);
+    return ret;
+}
+
+//where the members of a result go, member nodes of array, the count alone, or the new set dest,
+//kept packed while it fits
+struct ssink_t {
+    fdb_array_t*        array_;
+    fdb_slice_t*        dest_;
+    packed_t*           packed_;
+    uint64_t            limit_;
+    int64_t             count_;
+    int64_t             spilled_;       //members already counted in the size of dest
+};
+
+//returns 1 to go on, 0 once limit is reached, -1 on error
+static int ssink_push(fdb_context_t* context, fdb_slot_t* slot, struct ssink_t* sink, const fdb_view_t* member){
+    sink->count_ += 1;
+    if(sink->array_ != NULL){
+        fdb_val_node_t* mnode = fdb_val_node_create_in(fdb_arena_current());
+        mnode->retval_ = FDB_OK;
+        mnode->val_.vval_ = fdb_slice_create(member->data_, member->length_);
+        fdb_array_push_back(sink->array_, mnode);
+    }
+    if(sink->dest_ != NULL){
+        if(sink->packed_ != NULL){
+            packed_put(sink->packed_, member->data_, member->length_, NULL, 0, 0.0);
+            if(!packed_fits(context, sink->packed_)){
+                //the members so far go to subkeys, the ones after straight there
+                if(set_update(context, slot, sink->dest_, sink->packed_, 0) != 0){
+                    return -1;
                 }
+                packed_destroy(sink->packed_);
+                sink->packed_ = NULL;
+                sink->spilled_ = sink->count_;
             }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
+        }else{
+            sput_one(slot, sink->dest_, member->data_, member->length_);
+        }
+    }
+    return (sink->limit_ > 0 && (uint64_t)sink->count_ >= sink->limit_) ? 0 : 1;
+}
+
+//op of the sets streamed into sink, a union merges them all, an intersection walks the smallest
+//and a difference the first probing the others, memory stays the same whatever their sizes
+static int set_algebra(fdb_context_t* context, fdb_slot_t* slot, int op, size_t num, fdb_slice_t* const* keys,
+                       struct ssink_t* sink){
+    if(num == 0){
+        return FDB_ERR_WRONG_NUMBER_ARGUMENTS;
+    }
+    fdb_arena_t *arena = fdb_arena_current();
+    struct sstream_t *streams = (struct sstream_t*)fdb_malloc_in(arena, num * sizeof(struct sstream_t));
+    size_t opened = 0;
+    int retval = FDB_OK;
+    while(opened < num){
+        retval = sstream_open(context, slot, keys[opened], &streams[opened]);
+        ++opened;
+        if(retval != FDB_OK){
+            goto end;
+        }
+    }
+    //dest is made anew only now, the sources it may be among were opened under its old seq
+    if(sink->dest_ != NULL){
+        retval = packed_renew(context, slot, sink->dest_, FDB_DATA_TYPE_SET, &sink->packed_);
+        if(retval != FDB_OK){
+            goto end;
+        }
+    }
+
+    if(op == SET_UNION){
+        for(size_t i=0; i<num; ++i){
+            sstream_start(context, slot, &streams[i]);
+        }
+        while(1){
+            size_t min = num;
+            for(size_t i=0; i<num; ++i){
+                if(streams[i].valid_ && (min == num ||
+                   compare_with_length(streams[i].member_.data_, streams[i].member_.length_,
+                                       streams[min].member_.data_, streams[min].member_.length_) < 0)){
+                    min = i;
+                }
+            }
+            if(min == num){
+                break;
+            }
+            int ret = ssink_push(context, slot, sink, &streams[min].member_);
+            if(ret <= 0){
+                retval = (ret < 0) ? FDB_ERR : FDB_OK;
+                goto end;
+            }
+            for(size_t i=0; i<num; ++i){
+                if(i != min && streams[i].valid_ &&
+                   compare_with_length(streams[i].member_.data_, streams[i].member_.length_,
+                                       streams[min].member_.data_, streams[min].member_.length_) == 0){
+                    sstream_next(&streams[i]);
+                }
+            }
+            sstream_next(&streams[min]);
+        }
+    }else{
+        size_t lead = 0;
+        if(op == SET_INTER){
+            for(size_t i=0; i<num; ++i){
+                if(!streams[i].exists_){
+                    goto end;
+                }
+                if(streams[i].size_ < streams[lead].size_){
+                    lead = i;
+                }
+            }
+        }
+        for(sstream_start(context, slot, &streams[lead]); streams[lead].valid_; sstream_next(&streams[lead])){
+            int take = 1;
+            for(size_t i=0; i<num && take; ++i){
+                if(i == lead){
+                    continue;
+                }
+                int has = sstream_has(context, slot, &streams[i], &streams[lead].member_);
+                if(has < 0){
+                    retval = FDB_ERR;
+                    goto end;
+                }
+                take = (op == SET_INTER) ? has : !has;
+            }
+            if(take){
+                int ret = ssink_push(context, slot, sink, &streams[lead].member_);
+                if(ret <= 0){
+                    retval = (ret < 0) ? FDB_ERR : FDB_OK;
+                    goto end;
+                }
             }
         }
     }
 
-    *count = _count;
+end:
+    for(size_t i=0; i<opened; ++i){
+        sstream_close(&streams[i]);
+    }
+    fdb_free_in(arena, streams);
+    return retval;
+}
+
+int set_combine(fdb_context_t* context, fdb_slot_t* slot, int op, size_t num, fdb_slice_t* const* keys, fdb_array_t** rets){
+    struct ssink_t sink;
+    memset(&sink, 0, sizeof(struct ssink_t));
+    sink.array_ = fdb_array_create(16);
+    int retval = set_algebra(context, slot, op, num, keys, &sink);
+    if(retval != FDB_OK){
+        for(size_t i=0; i<sink.array_->length_; ++i){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(sink.array_, i)->val_.vval_));
+        }
+        fdb_array_destroy(sink.array_);
+        return retval;
+    }
+    *rets = sink.array_;
     return FDB_OK;
 }
+
+int set_combine_store(fdb_context_t* context, fdb_slot_t* slot, int op, fdb_slice_t* dest, size_t num,
+                      fdb_slice_t* const* keys, int64_t* count){
+    struct ssink_t sink;
+    memset(&sink, 0, sizeof(struct ssink_t));
+    sink.dest_ = fdb_slice_create(fdb_slice_data(dest), fdb_slice_length(dest));
+    int retval = set_algebra(context, slot, op, num, keys, &sink);
+    if(retval == FDB_OK && sink.count_ > 0){
+        int ret = 0;
+        if(sink.packed_ != NULL){
+            ret = (packed_store(context, slot, sink.dest_, sink.packed_) == FDB_OK) ? 0 : -1;
+        }else{
+            ret = set_incr_size(context, slot, sink.dest_, sink.count_ - sink.spilled_);
+        }
+        char *errptr = NULL;
+        if(ret != 0){
+            fdb_slot_writebatch_discard(context, slot);
+            retval = FDB_ERR;
+        }else{
+            fdb_slot_writebatch_commit(context, slot, &errptr);
+        }
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            retval = FDB_ERR;
+        }
+    }else{
+        fdb_slot_writebatch_discard(context, slot);
+        if(retval == FDB_OK){
+            //an empty result leaves no dest behind
+            int64_t deleted = 0;
+            retval = keys_del(context, slot, dest, &deleted);
+        }
+    }
+    packed_destroy(sink.packed_);
+    fdb_slice_destroy(sink.dest_);
+    if(retval == FDB_OK){
+        *count = sink.count_;
+    }
+    return retval;
+}
+
+int set_inter_card(fdb_context_t* context, fdb_slot_t* slot, size_t num, fdb_slice_t* const* keys, uint64_t limit,
+                   int64_t* count){
+    struct ssink_t sink;
+    memset(&sink, 0, sizeof(struct ssink_t));
+    sink.limit_ = limit;
+    int retval = set_algebra(context, slot, SET_INTER, num, keys, &sink);
+    if(retval == FDB_OK){
+        *count = sink.count_;
+    }
+    return retval;
+}
@@ -9,11 +9,11 @@
 
 
 void encode_ssize_key(const char* key, size_t keylen, fdb_slice_t** pslice);
-int decode_ssize_key(const char* fdbkey, size_t fdbkeylen, uint64_t* size);
+int decode_ssize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice);
 
 
-void encode_sset_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice);
-int decode_sset_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t **pkey, fdb_slice_t **pmember);
+void encode_set_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice);
+int decode_set_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t **pkey, fdb_slice_t **pmember);
 
 
 
@@ -21,11 +21,38 @@ int set_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_
 
 int set_member_exists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, int64_t* count);
 
+//set_member_exists of every member, one node each with uval_ 1 or 0, looked up together
+int set_member_mexists(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, fdb_array_t** rets);
+
+//a chunk of the set past the member cursor, as hash_hscan has it, member nodes
+int set_sscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+              uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor);
+
 int set_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* size);
 
 int set_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count);
 
 int set_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count);
 
+enum {
+    SET_INTER = 0,
+    SET_UNION = 1,
+    SET_DIFF = 2
+};
+
+//the members in all num sets for SET_INTER, in any for SET_UNION, in the first and none of the
+//others for SET_DIFF, member nodes in member order, the sets are read as ordered streams and
+//probed member by member, the smallest leading an intersection, rather than loaded whole
+int set_combine(fdb_context_t* context, fdb_slot_t* slot, int op, size_t num, fdb_slice_t* const* keys, fdb_array_t** rets);
+
+//set_combine written to the set dest through one slot batch, replacing whatever dest held, an
+//empty result removes dest, count is the members written
+int set_combine_store(fdb_context_t* context, fdb_slot_t* slot, int op, fdb_slice_t* dest, size_t num,
+                      fdb_slice_t* const* keys, int64_t* count);
+
+//the size of the intersection, counting stops at limit, 0 for none
+int set_inter_card(fdb_context_t* context, fdb_slot_t* slot, size_t num, fdb_slice_t* const* keys, uint64_t limit,
+                   int64_t* count);
+
 #endif //FDB_T_SET_H
 
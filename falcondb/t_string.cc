@@ -6,6 +6,7 @@
 #include "fdb_slice.h"
 #include "fdb_context.h"
 #include "fdb_bytes.h"
+#include "fdb_malloc.h"
 #include "util.h"
 
 #include <rocksdb/c.h>
@@ -22,7 +23,7 @@ int string_set(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_s
         retval = FDB_ERR;
         goto end;
     }
-    retval = keys_set_string(context, slot, key, value);
+    retval = keys_set_string(context, slot, key, value, 0);
 
 end:
     return retval;
@@ -40,11 +41,36 @@ int string_setnx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb
         fdb_slice_destroy(slice_value);
         return FDB_OK_BUT_ALREADY_EXIST;
     }
-    int retval = keys_set_string(context, slot, key, value);
+    int retval = keys_set_string(context, slot, key, value, 0);
     return retval;
 }
 
 
+int string_setex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value, int64_t ts){  
+    if(fdb_slice_length(key) == 0){
+        fprintf(stderr, "%s empty key!\n", __func__);
+        return FDB_ERR;
+    }
+    return keys_set_string(context, slot, key, value, ts);
+}
+
+
+int string_setnxex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value, int64_t ts){  
+    if(fdb_slice_length(key) == 0){
+        fprintf(stderr, "%s empty key!\n", __func__);
+        return FDB_ERR;
+    }
+    //get
+    fdb_slice_t *slice_value = NULL;
+    int found = keys_get_string(context, slot,  key, &slice_value);
+    if(found == FDB_OK){
+        fdb_slice_destroy(slice_value);
+        return FDB_OK_BUT_ALREADY_EXIST;
+    }
+    return keys_set_string(context, slot, key, value, ts);
+}
+
+
 int string_setxx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value){  
     if(fdb_slice_length(key) == 0){
         fprintf(stderr, "%s empty key!\n", __func__);
@@ -58,7 +84,7 @@ int string_setxx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb
         return found;
     } 
     //set
-    int retval = keys_set_string(context, slot, key, value);
+    int retval = keys_set_string(context, slot, key, value, 0);
 
     fdb_slice_destroy(slice_value);
     return retval;
@@ -76,7 +102,7 @@ int string_mset(fdb_context_t* context, fdb_slot_t* slot,  fdb_array_t* kvs, fdb
     for(size_t i=0; i<kvs->length_;){
         fdb_slice_t *key = (fdb_slice_t*)(fdb_array_at(kvs, i++)->val_.vval_);
         fdb_slice_t *val = (fdb_slice_t*)(fdb_array_at(kvs, i++)->val_.vval_);
-        fdb_val_node_t *ret = fdb_val_node_create();
+        fdb_val_node_t *ret = fdb_val_node_create_in(fdb_arena_current());
         ret->retval_ = string_set(context, slot, key, val);
         fdb_array_push_back(array, ret);
     }
@@ -96,7 +122,7 @@ int string_msetnx(fdb_context_t* context, fdb_slot_t* slot, fdb_array_t* kvs, fd
     for(size_t i=0; i<kvs->length_;){
         fdb_slice_t *key = (fdb_slice_t*)(fdb_array_at(kvs, i++)->val_.vval_);
         fdb_slice_t *val = (fdb_slice_t*)(fdb_array_at(kvs, i++)->val_.vval_);
-        fdb_val_node_t *ret = fdb_val_node_create();
+        fdb_val_node_t *ret = fdb_val_node_create_in(fdb_arena_current());
         ret->retval_ = string_setnx(context, slot, key, val);
         fdb_array_push_back(array, ret);
     }
@@ -112,64 +138,38 @@ int string_get(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_s
 
 
 int string_mget(fdb_context_t* context, fdb_slot_t* slot, fdb_array_t* keys, fdb_array_t** rets){
-    int retval = 0;
+    size_t len = keys->length_;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_slice_t **slices = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    fdb_slice_t **vals = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    int *codes = (int*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(int));
+    for(size_t i=0; i<len; ++i){
+        slices[i] = (fdb_slice_t*)(fdb_array_at(keys, i)->val_.vval_);
+    }
+    //the keys the keys cache misses cost one read together
+    keys_mget_string(context, slot, len, slices, vals, codes);
 
-    int len = keys->length_;
     fdb_array_t *array = fdb_array_create(len);
-    for(size_t i=0; i<keys->length_; ++i){
-        fdb_slice_t *key = (fdb_slice_t*)(fdb_array_at(keys, i)->val_.vval_);
-        fdb_slice_t *val = NULL;
-        fdb_val_node_t *ret = fdb_val_node_create(); 
-        ret->retval_ = string_get(context, slot, key, &val);
+    for(size_t i=0; i<len; ++i){
+        fdb_val_node_t *ret = fdb_val_node_create_in(arena); 
+        ret->retval_ = codes[i];
         if(ret->retval_==FDB_OK){
-            ret->val_.vval_ = val; 
+            ret->val_.vval_ = vals[i]; 
         }
         fdb_array_push_back(array, ret);
     }
+    fdb_free_in(arena, slices);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, codes);
     *rets = array;
-    retval = FDB_OK;
-
-    return retval;
+    return FDB_OK;
 }
 
 
 int string_incr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t init, int64_t by, int64_t* val){   
-    int retval = 0;
-
-    fdb_slice_t *slice_value = NULL;
-    int ret = keys_get_string(context, slot, key, &slice_value);
-    if(ret==FDB_OK){
-        if(fdb_slice_length(slice_value) == 0){
-            retval = FDB_ERR_IS_NOT_INTEGER;
-            goto end;
-        }
-        long long old = atoll(fdb_slice_data(slice_value));
-        if(is_int64_overflow(old, by)){
-            retval = FDB_ERR_INCDECR_OVERFLOW;
-            goto end;
-        }
-        char buff[128] = {0};
-        sprintf(buff, "%lld", (long long)(old + by));
-        *val = old + by;
-        fdb_slice_destroy(slice_value);
-        slice_value = fdb_slice_create(buff, strlen(buff));
-        retval = keys_set_string(context, slot, key, slice_value);
-    }else if(ret == FDB_OK_NOT_EXIST){
-        if(is_int64_overflow(init, by)){
-            retval = FDB_ERR_INCDECR_OVERFLOW;
-            goto end; 
-        }
-        char buff[128] = {0};
-        sprintf(buff, "%lld", (long long)(init + by));
-        *val = init + by;
-        fdb_slice_destroy(slice_value);
-        slice_value = fdb_slice_create(buff, strlen(buff));
-        retval = keys_set_string(context, slot, key, slice_value); 
-    }else{
-        retval = FDB_ERR;
+    if(fdb_slice_length(key) == 0){
+        fprintf(stderr, "%s empty key!\n", __func__);
+        return FDB_ERR;
     }
-
-end:
-    if(slice_value!=NULL) fdb_slice_destroy(slice_value);
-    return retval;
+    return keys_incr_string(context, slot, key, init, by, val);
 }
@@ -14,6 +14,11 @@ int string_set(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_s
 
 int string_setnx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value);
 
+//ts is the absolute expiry in milliseconds, the value and its expiry are written at once
+int string_setex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value, int64_t ts);
+
+int string_setnxex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value, int64_t ts);
+
 int string_setxx(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* value);
 
 int string_mset(fdb_context_t* context, fdb_slot_t* slot,  fdb_array_t* kvs, fdb_array_t** rets);
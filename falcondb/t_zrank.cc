@@ -0,0 +1,743 @@
+#include "t_zrank.h"
+
+#include "fdb_types.h"
+#include "fdb_define.h"
+#include "fdb_codec.h"
+#include "fdb_malloc.h"
+#include "util.h"
+
+#include <rocksdb/c.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+//entries of a node, it splits in two halves past that
+#define ZRANK_FANOUT            64
+//entries of the nodes built from a score index, leaving room for inserts
+#define ZRANK_FILL              48
+//levels of a tree built from a score index, far more than 2^64 members need
+#define ZRANK_LEVELS_MAX        16
+//node holding the root id and the next free id
+#define ZRANK_META_ID           0
+
+//a node is stored as leaf(u8) n(u8) and its entries, lex(8) len(u8) member for a leaf,
+//child(fixed32) count(fixed64) lex(8) len(u8) member for an inner node, where lex member is
+//the smallest key under child when it was split off, ignored for the first child
+struct zrank_entry_t {
+    char                    lex_[sizeof(uint64_t)];     //score as encoded in the score index
+    char*                   member_;
+    size_t                  memberlen_;
+    uint32_t                child_;
+    uint64_t                count_;
+    struct zrank_node_t*    node_;                      //child once loaded
+};
+
+struct zrank_node_t {
+    uint32_t                id_;
+    int                     leaf_;
+    int                     dirty_;
+    int                     n_;
+    struct zrank_entry_t    entries_[ZRANK_FANOUT + 1];
+};
+
+struct zrank_tree_t {
+    fdb_context_t*          context_;
+    fdb_slot_t*             slot_;
+    fdb_slice_t*            key_;
+    uint32_t                root_id_;
+    uint32_t                next_id_;
+    int                     meta_dirty_;
+    struct zrank_node_t*    root_;
+    uint32_t*               dropped_;                   //ids of the nodes emptied since open
+    size_t                  dropped_len_;
+    size_t                  dropped_cap_;
+};
+
+
+static struct zrank_node_t* zrank_node_create(uint32_t id, int leaf){
+    struct zrank_node_t *node = (struct zrank_node_t*)fdb_malloc(sizeof(struct zrank_node_t));
+    node->id_ = id;
+    node->leaf_ = leaf;
+    node->dirty_ = 1;
+    node->n_ = 0;
+    return node;
+}
+
+static void zrank_node_free(struct zrank_node_t* node){
+    if(node == NULL){
+        return;
+    }
+    for(int i=0; i<node->n_; ++i){
+        fdb_free(node->entries_[i].member_);
+        zrank_node_free(node->entries_[i].node_);
+    }
+    fdb_free(node);
+}
+
+static void zrank_entry_set(struct zrank_entry_t* entry, const char* lex, const char* member, size_t memberlen,
+                            uint32_t child, uint64_t count){
+    memcpy(entry->lex_, lex, sizeof(uint64_t));
+    entry->member_ = (char*)fdb_malloc(memberlen > 0 ? memberlen : 1);
+    if(memberlen > 0) memcpy(entry->member_, member, memberlen);
+    entry->memberlen_ = memberlen;
+    entry->child_ = child;
+    entry->count_ = count;
+    entry->node_ = NULL;
+}
+
+static uint64_t zrank_node_count(const struct zrank_node_t* node){
+    if(node->leaf_){
+        return node->n_;
+    }
+    uint64_t count = 0;
+    for(int i=0; i<node->n_; ++i){
+        count += node->entries_[i].count_;
+    }
+    return count;
+}
+
+static int zrank_compare(const struct zrank_entry_t* entry, const char* lex, const char* member, size_t memberlen){
+    int ret = memcmp(entry->lex_, lex, sizeof(uint64_t));
+    if(ret != 0){
+        return ret;
+    }
+    return compare_with_length(entry->member_, entry->memberlen_, member, memberlen);
+}
+
+//first entry from on greater than the key if upper, not less than it otherwise
+static int zrank_key_bound(const struct zrank_node_t* node, int from, const char* lex, const char* member,
+                           size_t memberlen, int upper){
+    int lo = from, hi = node->n_;
+    while(lo < hi){
+        int mid = lo + (hi - lo)/2;
+        int ret = zrank_compare(&node->entries_[mid], lex, member, memberlen);
+        if(ret < 0 || (upper && ret == 0)){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//first entry from on scored above lex if inclusive, not below it otherwise
+static int zrank_lex_bound(const struct zrank_node_t* node, int from, const char* lex, int inclusive){
+    int lo = from, hi = node->n_;
+    while(lo < hi){
+        int mid = lo + (hi - lo)/2;
+        int ret = memcmp(node->entries_[mid].lex_, lex, sizeof(uint64_t));
+        if(ret < 0 || (inclusive && ret == 0)){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//the child of an inner node the key belongs to
+static int zrank_route(const struct zrank_node_t* node, const char* lex, const char* member, size_t memberlen){
+    return zrank_key_bound(node, 1, lex, member, memberlen, 1) - 1;
+}
+
+
+static int zrank_read(zrank_tree_t* tree, uint32_t id, char** pval, size_t* pvallen){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_zrank_key_size(fdb_slice_length(tree->key_)));
+    size_t fdbkeylen = fdb_codec_encode_zrank_key(fdbkey, fdb_slice_data(tree->key_), fdb_slice_length(tree->key_), id);
+
+    char *errptr = NULL;
+    *pval = fdb_slot_writebatch_get(tree->context_, tree->slot_, fdbkey, fdbkeylen, pvallen, &errptr);
+    fdb_codec_buf_free(stack, fdbkey);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    return (*pval != NULL) ? 1 : 0;
+}
+
+static void zrank_write(zrank_tree_t* tree, uint32_t id, const char* val, size_t vallen){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_zrank_key_size(fdb_slice_length(tree->key_)));
+    size_t fdbkeylen = fdb_codec_encode_zrank_key(fdbkey, fdb_slice_data(tree->key_), fdb_slice_length(tree->key_), id);
+    if(val != NULL){
+        fdb_slot_writebatch_put(tree->slot_, fdbkey, fdbkeylen, val, vallen);
+    }else{
+        fdb_slot_writebatch_delete(tree->slot_, fdbkey, fdbkeylen);
+    }
+    fdb_codec_buf_free(stack, fdbkey);
+}
+
+static void zrank_write_node(zrank_tree_t* tree, struct zrank_node_t* node){
+    size_t head = node->leaf_ ? 0 : sizeof(uint32_t) + sizeof(uint64_t);
+    size_t size = 2;
+    for(int i=0; i<node->n_; ++i){
+        size += head + sizeof(uint64_t) + 1 + node->entries_[i].memberlen_;
+    }
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, size);
+    char *p = buf;
+    *p++ = (uint8_t)node->leaf_;
+    *p++ = (uint8_t)node->n_;
+    for(int i=0; i<node->n_; ++i){
+        const struct zrank_entry_t *entry = &node->entries_[i];
+        if(!node->leaf_){
+            rocksdb_encode_fixed32(p, entry->child_);
+            p += sizeof(uint32_t);
+            rocksdb_encode_fixed64(p, entry->count_);
+            p += sizeof(uint64_t);
+        }
+        memcpy(p, entry->lex_, sizeof(uint64_t));
+        p += sizeof(uint64_t);
+        *p++ = (uint8_t)entry->memberlen_;
+        memcpy(p, entry->member_, entry->memberlen_);
+        p += entry->memberlen_;
+    }
+    zrank_write(tree, node->id_, buf, p - buf);
+    fdb_codec_buf_free(stack, buf);
+    node->dirty_ = 0;
+}
+
+static void zrank_write_meta(zrank_tree_t* tree){
+    if(tree->root_id_ == 0){
+        zrank_write(tree, ZRANK_META_ID, NULL, 0);
+    }else{
+        char buf[2*sizeof(uint32_t)] = {0};
+        rocksdb_encode_fixed32(buf, tree->root_id_);
+        rocksdb_encode_fixed32(buf + sizeof(uint32_t), tree->next_id_);
+        zrank_write(tree, ZRANK_META_ID, buf, sizeof(buf));
+    }
+    tree->meta_dirty_ = 0;
+}
+
+static struct zrank_node_t* zrank_load(zrank_tree_t* tree, uint32_t id){
+    char *val = NULL;
+    size_t vallen = 0;
+    int ret = zrank_read(tree, id, &val, &vallen);
+    if(ret == 0){
+        fprintf(stderr, "%s node %u missing.\n", __func__, id);
+    }
+    if(ret != 1){
+        return NULL;
+    }
+
+    struct zrank_node_t *node = NULL;
+    const char *p = val, *pend = val + vallen;
+    size_t head = 0;
+    int n = 0;
+    if(vallen < 2){
+        goto err;
+    }
+    node = zrank_node_create(id, (uint8_t)p[0]);
+    node->dirty_ = 0;
+    n = (uint8_t)p[1];
+    p += 2;
+    head = node->leaf_ ? 0 : sizeof(uint32_t) + sizeof(uint64_t);
+    if(n > ZRANK_FANOUT){
+        goto err;
+    }
+    for(int i=0; i<n; ++i){
+        if((size_t)(pend - p) < head + sizeof(uint64_t) + 1){
+            goto err;
+        }
+        uint32_t child = 0;
+        uint64_t count = 0;
+        if(!node->leaf_){
+            child = rocksdb_decode_fixed32(p);
+            p += sizeof(uint32_t);
+            count = rocksdb_decode_fixed64(p);
+            p += sizeof(uint64_t);
+        }
+        const char *lex = p;
+        p += sizeof(uint64_t);
+        size_t memberlen = (uint8_t)*p++;
+        if((size_t)(pend - p) < memberlen){
+            goto err;
+        }
+        zrank_entry_set(&node->entries_[node->n_++], lex, p, memberlen, child, count);
+        p += memberlen;
+    }
+    rocksdb_free(val);
+    return node;
+
+err:
+    fprintf(stderr, "%s node %u corrupted.\n", __func__, id);
+    zrank_node_free(node);
+    rocksdb_free(val);
+    return NULL;
+}
+
+static struct zrank_node_t* zrank_child(zrank_tree_t* tree, struct zrank_node_t* node, int i){
+    struct zrank_entry_t *entry = &node->entries_[i];
+    if(entry->node_ == NULL){
+        entry->node_ = zrank_load(tree, entry->child_);
+    }
+    return entry->node_;
+}
+
+//the root, NULL for an empty tree or if it could not be read, told apart by root_id_
+static struct zrank_node_t* zrank_root(zrank_tree_t* tree){
+    if(tree->root_ == NULL && tree->root_id_ != 0){
+        tree->root_ = zrank_load(tree, tree->root_id_);
+    }
+    return tree->root_;
+}
+
+static uint32_t zrank_next_id(zrank_tree_t* tree){
+    tree->meta_dirty_ = 1;
+    return tree->next_id_++;
+}
+
+static void zrank_drop(zrank_tree_t* tree, uint32_t id){
+    if(tree->dropped_len_ == tree->dropped_cap_){
+        tree->dropped_cap_ = (tree->dropped_cap_ == 0) ? 8 : 2*tree->dropped_cap_;
+        tree->dropped_ = (uint32_t*)fdb_realloc(tree->dropped_, tree->dropped_cap_*sizeof(uint32_t));
+    }
+    tree->dropped_[tree->dropped_len_++] = id;
+}
+
+
+//appending an entry to the open node of level, the node is written out once full
+static int zrank_build_push(zrank_tree_t* tree, struct zrank_node_t** levels, uint64_t* emitted, int level,
+                            const char* lex, const char* member, size_t memberlen, uint32_t child, uint64_t count);
+
+//writing out the open node of level and adding it to the level above
+static int zrank_build_close(zrank_tree_t* tree, struct zrank_node_t** levels, uint64_t* emitted, int level){
+    struct zrank_node_t *node = levels[level];
+    zrank_write_node(tree, node);
+    ++emitted[level];
+    levels[level] = NULL;
+    const struct zrank_entry_t *first = &node->entries_[0];
+    int ret = zrank_build_push(tree, levels, emitted, level + 1, first->lex_, first->member_, first->memberlen_,
+                               node->id_, zrank_node_count(node));
+    zrank_node_free(node);
+    return ret;
+}
+
+static int zrank_build_push(zrank_tree_t* tree, struct zrank_node_t** levels, uint64_t* emitted, int level,
+                            const char* lex, const char* member, size_t memberlen, uint32_t child, uint64_t count){
+    if(level >= ZRANK_LEVELS_MAX){
+        fprintf(stderr, "%s too many levels!\n", __func__);
+        return -1;
+    }
+    if(levels[level] != NULL && levels[level]->n_ == ZRANK_FILL){
+        if(zrank_build_close(tree, levels, emitted, level) < 0){
+            return -1;
+        }
+    }
+    if(levels[level] == NULL){
+        levels[level] = zrank_node_create(zrank_next_id(tree), level == 0);
+    }
+    struct zrank_node_t *node = levels[level];
+    zrank_entry_set(&node->entries_[node->n_++], lex, member, memberlen, child, count);
+    return 0;
+}
+
+//bulk loading the tree of a zset from its score index, which is already in order,
+//returns 1 if the zset has members, 0 if not, -1 on error
+static int zrank_build(zrank_tree_t* tree){
+    struct zrank_node_t *levels[ZRANK_LEVELS_MAX] = {NULL};
+    uint64_t emitted[ZRANK_LEVELS_MAX] = {0};
+    const char *key = fdb_slice_data(tree->key_);
+    size_t keylen = fdb_slice_length(tree->key_);
+    int ret = 0;
+
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *prefix = fdb_codec_buf(stack, fdb_codec_zscore_key_size(keylen, 0));
+    fdb_codec_encode_zscore_key(prefix, key, keylen, NULL, 0, 0.0);
+    size_t prefixlen = 2 + keylen;
+
+    char *errptr = NULL;
+    rocksdb_iterator_t *iterator = rocksdb_create_iterator_cf(tree->context_->db_, tree->context_->scanoptions_,
+                                                              tree->slot_->handle_);
+    rocksdb_iter_seek(iterator, prefix, prefixlen);
+    for(; rocksdb_iter_valid(iterator); rocksdb_iter_next(iterator)){
+        size_t klen = 0;
+        const char *rkey = rocksdb_iter_key(iterator, &klen);
+        if(klen < prefixlen || memcmp(rkey, prefix, prefixlen)!=0){
+            break;
+        }
+        fdb_view_t member;
+        if(fdb_codec_decode_zscore_key(rkey, klen, NULL, &member, NULL)!=0){
+            continue;
+        }
+        if(zrank_build_push(tree, levels, emitted, 0, rkey + prefixlen, member.data_, member.length_, 0, 0) < 0){
+            ret = -1;
+            goto end;
+        }
+    }
+    rocksdb_iter_get_error(iterator, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s rocksdb_iter_get_error fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        ret = -1;
+        goto end;
+    }
+
+    //the only node of the topmost level is the root
+    for(int level=0; level<ZRANK_LEVELS_MAX && levels[level]!=NULL; ++level){
+        if(emitted[level] == 0){
+            zrank_write_node(tree, levels[level]);
+            tree->root_id_ = levels[level]->id_;
+            break;
+        }
+        if(zrank_build_close(tree, levels, emitted, level) < 0){
+            ret = -1;
+            goto end;
+        }
+    }
+    if(tree->root_id_ != 0){
+        zrank_write_meta(tree);
+        ret = 1;
+    }
+
+end:
+    for(int level=0; level<ZRANK_LEVELS_MAX; ++level){
+        zrank_node_free(levels[level]);
+    }
+    rocksdb_iter_destroy(iterator);
+    fdb_codec_buf_free(stack, prefix);
+    return ret;
+}
+
+
+int zrank_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, zrank_tree_t** ptree){
+    zrank_tree_t *tree = (zrank_tree_t*)fdb_malloc(sizeof(zrank_tree_t));
+    memset(tree, 0, sizeof(zrank_tree_t));
+    tree->context_ = context;
+    tree->slot_ = slot;
+    tree->key_ = fdb_slice_create(fdb_slice_data(key), fdb_slice_length(key));
+    tree->next_id_ = ZRANK_META_ID + 1;
+
+    char *val = NULL;
+    size_t vallen = 0;
+    int ret = zrank_read(tree, ZRANK_META_ID, &val, &vallen);
+    if(ret == 1){
+        if(vallen != 2*sizeof(uint32_t)){
+            fprintf(stderr, "%s root corrupted.\n", __func__);
+            rocksdb_free(val);
+            goto err;
+        }
+        tree->root_id_ = rocksdb_decode_fixed32(val);
+        tree->next_id_ = rocksdb_decode_fixed32(val + sizeof(uint32_t));
+        rocksdb_free(val);
+        ret = 0;
+    }else if(ret == 0){
+        ret = zrank_build(tree);
+    }
+    if(ret < 0){
+        goto err;
+    }
+    *ptree = tree;
+    return ret;
+
+err:
+    zrank_destroy(tree);
+    return -1;
+}
+
+static int zrank_flush_node(zrank_tree_t* tree, struct zrank_node_t* node){
+    if(node == NULL){
+        return 0;
+    }
+    int count = 0;
+    if(node->dirty_){
+        zrank_write_node(tree, node);
+        ++count;
+    }
+    if(!node->leaf_){
+        for(int i=0; i<node->n_; ++i){
+            count += zrank_flush_node(tree, node->entries_[i].node_);
+        }
+    }
+    return count;
+}
+
+int zrank_flush(zrank_tree_t* tree){
+    int count = zrank_flush_node(tree, tree->root_);
+    for(size_t i=0; i<tree->dropped_len_; ++i){
+        zrank_write(tree, tree->dropped_[i], NULL, 0);
+        ++count;
+    }
+    tree->dropped_len_ = 0;
+    if(tree->meta_dirty_){
+        zrank_write_meta(tree);
+        ++count;
+    }
+    return count;
+}
+
+void zrank_destroy(zrank_tree_t* tree){
+    if(tree == NULL){
+        return;
+    }
+    zrank_node_free(tree->root_);
+    fdb_free(tree->dropped_);
+    fdb_slice_destroy(tree->key_);
+    fdb_free(tree);
+}
+
+uint64_t zrank_size(zrank_tree_t* tree){
+    struct zrank_node_t *root = zrank_root(tree);
+    return (root != NULL) ? zrank_node_count(root) : 0;
+}
+
+
+//inserting under node, the upper half of node is returned in split when it overflows
+static int zrank_node_insert(zrank_tree_t* tree, struct zrank_node_t* node, const char* lex, const char* member,
+                             size_t memberlen, struct zrank_node_t** psplit){
+    *psplit = NULL;
+    if(node->leaf_){
+        int pos = zrank_key_bound(node, 0, lex, member, memberlen, 0);
+        if(pos < node->n_ && zrank_compare(&node->entries_[pos], lex, member, memberlen)==0){
+            return 0;
+        }
+        memmove(&node->entries_[pos + 1], &node->entries_[pos], (node->n_ - pos)*sizeof(struct zrank_entry_t));
+        zrank_entry_set(&node->entries_[pos], lex, member, memberlen, 0, 0);
+        ++node->n_;
+    }else{
+        int i = zrank_route(node, lex, member, memberlen);
+        struct zrank_node_t *child = zrank_child(tree, node, i);
+        if(child == NULL){
+            return -1;
+        }
+        struct zrank_node_t *split = NULL;
+        int ret = zrank_node_insert(tree, child, lex, member, memberlen, &split);
+        if(ret <= 0){
+            return ret;
+        }
+        node->entries_[i].count_ += 1;
+        if(split != NULL){
+            uint64_t moved = zrank_node_count(split);
+            node->entries_[i].count_ -= moved;
+            memmove(&node->entries_[i + 2], &node->entries_[i + 1], (node->n_ - i - 1)*sizeof(struct zrank_entry_t));
+            const struct zrank_entry_t *first = &split->entries_[0];
+            zrank_entry_set(&node->entries_[i + 1], first->lex_, first->member_, first->memberlen_, split->id_, moved);
+            node->entries_[i + 1].node_ = split;
+            ++node->n_;
+        }
+    }
+    node->dirty_ = 1;
+
+    if(node->n_ > ZRANK_FANOUT){
+        struct zrank_node_t *right = zrank_node_create(zrank_next_id(tree), node->leaf_);
+        int mid = node->n_/2;
+        memcpy(right->entries_, &node->entries_[mid], (node->n_ - mid)*sizeof(struct zrank_entry_t));
+        right->n_ = node->n_ - mid;
+        node->n_ = mid;
+        *psplit = right;
+    }
+    return 1;
+}
+
+int zrank_insert(zrank_tree_t* tree, const char* member, size_t memberlen, double score){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+
+    struct zrank_node_t *root = zrank_root(tree);
+    if(root == NULL){
+        if(tree->root_id_ != 0){
+            return -1;
+        }
+        root = tree->root_ = zrank_node_create(zrank_next_id(tree), 1);
+        tree->root_id_ = root->id_;
+    }
+    struct zrank_node_t *split = NULL;
+    if(zrank_node_insert(tree, root, lex, member, memberlen, &split) < 0){
+        return -1;
+    }
+    if(split != NULL){
+        struct zrank_node_t *top = zrank_node_create(zrank_next_id(tree), 0);
+        const struct zrank_entry_t *first = &root->entries_[0];
+        zrank_entry_set(&top->entries_[0], first->lex_, first->member_, first->memberlen_, root->id_, zrank_node_count(root));
+        top->entries_[0].node_ = root;
+        first = &split->entries_[0];
+        zrank_entry_set(&top->entries_[1], first->lex_, first->member_, first->memberlen_, split->id_, zrank_node_count(split));
+        top->entries_[1].node_ = split;
+        top->n_ = 2;
+        tree->root_ = top;
+        tree->root_id_ = top->id_;
+    }
+    return 0;
+}
+
+//removing from under node, a node left empty is dropped by its parent, there is no merging
+//of half empty nodes, they fill up again with later inserts
+static int zrank_node_delete(zrank_tree_t* tree, struct zrank_node_t* node, const char* lex, const char* member,
+                             size_t memberlen){
+    if(node->leaf_){
+        int pos = zrank_key_bound(node, 0, lex, member, memberlen, 0);
+        if(pos >= node->n_ || zrank_compare(&node->entries_[pos], lex, member, memberlen)!=0){
+            return 0;
+        }
+        fdb_free(node->entries_[pos].member_);
+        memmove(&node->entries_[pos], &node->entries_[pos + 1], (node->n_ - pos - 1)*sizeof(struct zrank_entry_t));
+        --node->n_;
+        node->dirty_ = 1;
+        return 1;
+    }
+    int i = zrank_route(node, lex, member, memberlen);
+    struct zrank_node_t *child = zrank_child(tree, node, i);
+    if(child == NULL){
+        return -1;
+    }
+    int ret = zrank_node_delete(tree, child, lex, member, memberlen);
+    if(ret <= 0){
+        return ret;
+    }
+    node->entries_[i].count_ -= 1;
+    if(child->n_ == 0){
+        zrank_drop(tree, child->id_);
+        zrank_node_free(child);
+        fdb_free(node->entries_[i].member_);
+        memmove(&node->entries_[i], &node->entries_[i + 1], (node->n_ - i - 1)*sizeof(struct zrank_entry_t));
+        --node->n_;
+    }
+    node->dirty_ = 1;
+    return 1;
+}
+
+int zrank_delete(zrank_tree_t* tree, const char* member, size_t memberlen, double score){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+
+    struct zrank_node_t *root = zrank_root(tree);
+    if(root == NULL){
+        return (tree->root_id_ != 0) ? -1 : 0;
+    }
+    int ret = zrank_node_delete(tree, root, lex, member, memberlen);
+    if(ret <= 0){
+        return ret;
+    }
+    while(!root->leaf_ && root->n_ == 1){
+        struct zrank_node_t *child = zrank_child(tree, root, 0);
+        if(child == NULL){
+            return -1;
+        }
+        zrank_drop(tree, root->id_);
+        root->entries_[0].node_ = NULL;
+        zrank_node_free(root);
+        root = tree->root_ = child;
+        tree->root_id_ = child->id_;
+        tree->meta_dirty_ = 1;
+    }
+    if(root->leaf_ && root->n_ == 0){
+        zrank_drop(tree, root->id_);
+        zrank_node_free(root);
+        tree->root_ = NULL;
+        tree->root_id_ = 0;
+        tree->meta_dirty_ = 1;
+    }
+    return 1;
+}
+
+int zrank_rank(zrank_tree_t* tree, const char* member, size_t memberlen, double score, uint64_t* rank){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+
+    struct zrank_node_t *node = zrank_root(tree);
+    if(node == NULL){
+        return (tree->root_id_ != 0) ? -1 : 0;
+    }
+    uint64_t before = 0;
+    while(!node->leaf_){
+        int i = zrank_route(node, lex, member, memberlen);
+        for(int j=0; j<i; ++j){
+            before += node->entries_[j].count_;
+        }
+        node = zrank_child(tree, node, i);
+        if(node == NULL){
+            return -1;
+        }
+    }
+    int pos = zrank_key_bound(node, 0, lex, member, memberlen, 0);
+    if(pos >= node->n_ || zrank_compare(&node->entries_[pos], lex, member, memberlen)!=0){
+        return 0;
+    }
+    *rank = before + pos;
+    return 1;
+}
+
+int zrank_count_below(zrank_tree_t* tree, double score, int inclusive, uint64_t* count){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+
+    *count = 0;
+    struct zrank_node_t *node = zrank_root(tree);
+    if(node == NULL){
+        return (tree->root_id_ != 0) ? -1 : 0;
+    }
+    uint64_t before = 0;
+    while(!node->leaf_){
+        int i = zrank_lex_bound(node, 1, lex, inclusive) - 1;
+        for(int j=0; j<i; ++j){
+            before += node->entries_[j].count_;
+        }
+        node = zrank_child(tree, node, i);
+        if(node == NULL){
+            return -1;
+        }
+    }
+    *count = before + zrank_lex_bound(node, 0, lex, inclusive);
+    return 0;
+}
+
+int zrank_count_before(zrank_tree_t* tree, const char* member, size_t memberlen, double score, int inclusive, uint64_t* count){
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+
+    *count = 0;
+    struct zrank_node_t *node = zrank_root(tree);
+    if(node == NULL){
+        return (tree->root_id_ != 0) ? -1 : 0;
+    }
+    uint64_t before = 0;
+    while(!node->leaf_){
+        int i = zrank_key_bound(node, 1, lex, member, memberlen, inclusive) - 1;
+        for(int j=0; j<i; ++j){
+            before += node->entries_[j].count_;
+        }
+        node = zrank_child(tree, node, i);
+        if(node == NULL){
+            return -1;
+        }
+    }
+    *count = before + zrank_key_bound(node, 0, lex, member, memberlen, inclusive);
+    return 0;
+}
+
+int zrank_select(zrank_tree_t* tree, uint64_t rank, double* score, fdb_view_t* member){
+    struct zrank_node_t *node = zrank_root(tree);
+    if(node == NULL){
+        return (tree->root_id_ != 0) ? -1 : 0;
+    }
+    if(rank >= zrank_node_count(node)){
+        return 0;
+    }
+    while(!node->leaf_){
+        int i = 0;
+        while(i < node->n_ - 1 && rank >= node->entries_[i].count_){
+            rank -= node->entries_[i].count_;
+            ++i;
+        }
+        node = zrank_child(tree, node, i);
+        if(node == NULL){
+            return -1;
+        }
+    }
+    if(rank >= (uint64_t)node->n_){
+        fprintf(stderr, "%s counts out of step with node %u.\n", __func__, node->id_);
+        return -1;
+    }
+    const struct zrank_entry_t *entry = &node->entries_[rank];
+    if(score != NULL){
+        *score = lex_to_double(rocksdb_decode_fixed64(entry->lex_));
+    }
+    if(member != NULL){
+        member->data_ = entry->member_;
+        member->length_ = entry->memberlen_;
+    }
+    return 1;
+}
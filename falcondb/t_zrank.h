@@ -0,0 +1,46 @@
+#ifndef FDB_T_ZRANK_H
+#define FDB_T_ZRANK_H
+
+#include "fdb_context.h"
+#include "fdb_slice.h"
+#include "fdb_codec.h"
+
+#include <stdint.h>
+
+//counted B+tree over the members of a zset in score order, every entry of an inner node
+//carries the number of members under it, so ranks are found in O(log n) node reads,
+//nodes are read through the slot batch and written back to it by zrank_flush
+typedef struct zrank_tree_t                 zrank_tree_t;
+
+//opening the tree of the zset key, key prefixed by its seq, a zset written before the tree
+//existed gets it built from its score index into the slot batch, returns 1 if built that
+//way, 0 if opened, -1 on error
+int zrank_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, zrank_tree_t** ptree);
+
+//writing the nodes changed since open to the slot batch
+int zrank_flush(zrank_tree_t* tree);
+
+void zrank_destroy(zrank_tree_t* tree);
+
+uint64_t zrank_size(zrank_tree_t* tree);
+
+int zrank_insert(zrank_tree_t* tree, const char* member, size_t memberlen, double score);
+
+//returns 1 if removed, 0 if not in the tree, -1 on error
+int zrank_delete(zrank_tree_t* tree, const char* member, size_t memberlen, double score);
+
+//position of member in ascending order, returns 1 if found, 0 if not, -1 on error
+int zrank_rank(zrank_tree_t* tree, const char* member, size_t memberlen, double score, uint64_t* rank);
+
+//number of members scored below score, or up to it if inclusive
+int zrank_count_below(zrank_tree_t* tree, double score, int inclusive, uint64_t* count);
+
+//number of members ordered below member at score, or up to it if inclusive, member need not be in it
+int zrank_count_before(zrank_tree_t* tree, const char* member, size_t memberlen, double score, int inclusive, uint64_t* count);
+
+//member at rank in ascending order, valid until the tree is destroyed, returns 1 if found,
+//0 if rank is out of range, -1 on error
+int zrank_select(zrank_tree_t* tree, uint64_t rank, double* score, fdb_view_t* member);
+
+
+#endif //FDB_T_ZRANK_H
@@ -1,13 +1,17 @@
 #include "t_zset.h"
 #include "t_keys.h"
+#include "t_zrank.h"
+#include "t_packed.h"
+#include "t_dels.h"
 
 #include "fdb_types.h"
 #include "fdb_iterator.h"
 #include "fdb_define.h"
 #include "fdb_slice.h"
 #include "fdb_context.h"
-#include "fdb_bytes.h"
+#include "fdb_codec.h"
 #include "fdb_malloc.h"
+#include "fdb_waiter.h"
 #include "util.h"
 
 #include <limits>
@@ -23,179 +27,111 @@ const double    FDB_SCORE_MAX = std::numeric_limits<double>::max();
 const double    FDB_SCORE_MIN = std::numeric_limits<double>::lowest();
 const uint8_t   OPEN_ITERVAL_LEFT   = 0x01;
 const uint8_t   OPEN_ITERVAL_RIGHT  = 0x02;
+const uint8_t   LEX_UNBOUNDED_LEFT  = 0x04;
+const uint8_t   LEX_UNBOUNDED_RIGHT = 0x08;
+const uint64_t  ZSTORE_BATCH_MEMBERS = 4096;
+const uint64_t  ZREWRITE_MIN_MEMBERS = 1024;
 
 
 
-static int zset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double score);
+static int zset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    double score, zrank_tree_t* tree, int found, double old_score);
 
-static int zrem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member);
+static void zput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen, double score);
 
-static int zget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double* pscore);
+static int zrem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    zrank_tree_t* tree);
 
-static int zget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length);
+static int zdel_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen, double score,
+                    zrank_tree_t* tree);
+
+static int zget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    double* pscore);
+
+static int zget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length);
 
 static int zset_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by);
 
-static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t offset, uint64_t limit,
-                      int reverse, fdb_iterator_t** piterator);
+static int zset_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by);
+
+static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, zrank_tree_t* tree, uint64_t offset,
+                      uint64_t limit, int reverse, fdb_iterator_t** piterator);
 
 static int zget_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double sstart, 
                      double send, uint64_t limit, int reverse, fdb_iterator_t** piterator);
 
+static int zrange_rewrites(uint64_t size, uint64_t count);
+
+static int zset_rewrite_ends(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t head, uint64_t tail);
+
 
 void encode_zsize_key(const char* key, size_t keylen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_ZSIZE);
-    *pslice = slice;
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_size_key_size(keylen));
+    size_t len = fdb_codec_encode_size_key(buf, FDB_DATA_TYPE_ZSIZE, key, keylen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 int decode_zsize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice){
-    int ret = 0;
-    fdb_slice_t *key_slice = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen); 
-
-    uint8_t type = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-
-    }
-    if(type == FDB_DATA_TYPE_ZSIZE){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &key_slice) == -1){
-        ret = -1;
-        goto end;
+    fdb_view_t key;
+    if(fdb_codec_decode_size_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_ZSIZE, &key)!=0){
+        return -1;
     }
-    *pslice = key_slice;
-    fdb_incr_ref_count(key_slice);
-    ret = 0;
-
-end:
-  fdb_bytes_destroy(bytes);
-  fdb_slice_destroy(key_slice);
-  return ret; 
+    *pslice = fdb_slice_create(key.data_, key.length_);
+    return 0;
 }
 
 void encode_zset_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice){
-    fdb_slice_t* slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_ZSET);
-    fdb_slice_uint8_push_back(slice, '=');
-    fdb_slice_string_push_back(slice, member, memberlen);
-    *pslice = slice;
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_member_key_size(keylen, memberlen));
+    size_t len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_ZSET, key, keylen, member, memberlen);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 int decode_zset_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pmember){
-    int ret = 0;
-    fdb_slice_t *key_slice = NULL, *member_slice = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen); 
-
-    uint8_t type = 0, len = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(type != FDB_DATA_TYPE_ZSET){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_uint8(bytes, &len)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_uint8(bytes, &key_slice)==-1){
-        ret = -1;
-        goto end;
+    fdb_view_t key, member;
+    if(fdb_codec_decode_member_key(fdbkey, fdbkeylen, FDB_DATA_TYPE_ZSET, &key, &member)!=0){
+        return -1;
     }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto end;
+    if(pkey!=NULL){
+        *pkey = fdb_slice_create(key.data_, key.length_);
     }
-    if(fdb_bytes_read_slice_len_left(bytes, &member_slice)==-1){
-        ret = -1;
-        goto end;
+    if(pmember!=NULL){
+        *pmember = fdb_slice_create(member.data_, member.length_);
     }
-    *pkey = key_slice;
-    *pmember = member_slice;
-    fdb_incr_ref_count(key_slice);
-    fdb_incr_ref_count(member_slice);
-    ret = 0;
-
-end:
-    fdb_bytes_destroy(bytes);
-    fdb_slice_destroy(key_slice);
-    fdb_slice_destroy(member_slice);
-    return ret;
+    return 0;
 }
 
 
 void encode_zscore_key(const char* key, size_t keylen, const char* member, size_t memberlen, double score, fdb_slice_t** pslice){
-    fdb_slice_t *slice = fdb_slice_create(key, keylen);
-    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
-    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_ZSCORE);
-    uint64_t lex_score = double_to_lex(score);
-    fdb_slice_uint64_push_back(slice, lex_score);
-    fdb_slice_uint8_push_back(slice, '=');
-    fdb_slice_string_push_back(slice, member, memberlen);
-    *pslice = slice;
-
-    //printf("%s, score=%20f\n", __func__, score);
-    //printbuf(&lex_score, sizeof(uint64_t));
-    //printbuf(fdb_slice_data(slice), fdb_slice_length(slice));
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_zscore_key_size(keylen, memberlen));
+    size_t len = fdb_codec_encode_zscore_key(buf, key, keylen, member, memberlen, score);
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
 }
 
 int decode_zscore_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pmember,  double *pscore){
-    int ret = 0;
-    fdb_slice_t *key_slice = NULL, *member_slice = NULL;
-    fdb_bytes_t* bytes = fdb_bytes_create(fdbkey, fdbkeylen); 
-
-    uint8_t type = 0;
-    uint64_t lex_score = 0;
-    if(fdb_bytes_read_uint8(bytes, &type)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_uint8(bytes, &key_slice)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_uint64(bytes, &lex_score)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_skip(bytes, 1)==-1){
-        ret = -1;
-        goto end;
-    }
-    if(fdb_bytes_read_slice_len_left(bytes, &member_slice)==-1){
-        ret = -1;
-        goto end;
+    fdb_view_t key, member;
+    if(fdb_codec_decode_zscore_key(fdbkey, fdbkeylen, &key, &member, pscore)!=0){
+        return -1;
     }
     if(pkey!=NULL){
-        *pkey = key_slice;
-        fdb_incr_ref_count(key_slice);
+        *pkey = fdb_slice_create(key.data_, key.length_);
     }
     if(pmember!=NULL){
-        *pmember = member_slice;
-        fdb_incr_ref_count(member_slice); 
+        *pmember = fdb_slice_create(member.data_, member.length_);
     }
-    if(pscore!=NULL){
-        *pscore = lex_to_double(lex_score); 
-    }
-    ret = 0;
-
-end:
-    fdb_bytes_destroy(bytes);
-    fdb_slice_destroy(key_slice);
-    fdb_slice_destroy(member_slice);
-    return ret;
+    return 0;
 }
 
 
-static int zset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double score){
- 
+//found and old_score are member as the caller looked it up in a zset in subkeys, found -1 if not
+static int zset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    double score, zrank_tree_t* tree, int found, double old_score){
+
     if(fdb_slice_length(key)==0 || fdb_slice_length(member)==0){
         fprintf(stderr, "%s empty key or member!\n", __func__);
         return -1;
@@ -208,63 +144,78 @@ static int zset_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         fprintf(stderr, "%s key too long!\n", __func__);
         return -1;
     } 
-    double old_score = 0.0;
-    int found = zget_one(context, slot, key, member, &old_score);
+    if(packed != NULL){
+        return packed_put(packed, fdb_slice_data(member), fdb_slice_length(member), NULL, 0, score);
+    }
+    if(found < 0){
+        found = zget_one(context, slot, key, NULL, member, &old_score);
+    }
+    if(found < 0){
+        return -1;
+    }
     if(found == 0 || old_score != score){
+        if(found != 0 && zrank_delete(tree, fdb_slice_data(member), fdb_slice_length(member), old_score) < 0){
+            return -1;
+        }
+        if(zrank_insert(tree, fdb_slice_data(member), fdb_slice_length(member), score) < 0){
+            return -1;
+        }
         if(found != 0){
-            fdb_slice_t *slice_key1 = NULL;
             //delete zscore key
-            encode_zscore_key(fdb_slice_data(key),
-                              fdb_slice_length(key),
-                              fdb_slice_data(member),
-                              fdb_slice_length(member),
-                              old_score,
-                              &slice_key1);
-            fdb_slot_writebatch_delete(slot, fdb_slice_data(slice_key1), fdb_slice_length(slice_key1));
-            fdb_slice_destroy(slice_key1);
+            char stack[FDB_CODEC_STACK_SIZE];
+            char *fdbkey = fdb_codec_buf(stack, fdb_codec_zscore_key_size(fdb_slice_length(key), fdb_slice_length(member)));
+            size_t fdbkeylen = fdb_codec_encode_zscore_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key),
+                                                           fdb_slice_data(member), fdb_slice_length(member), old_score);
+            fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
+            fdb_codec_buf_free(stack, fdbkey);
         }
-        fdb_slice_t *slice_key2 = NULL;
-        //add score key
-        encode_zscore_key(fdb_slice_data(key),
-                          fdb_slice_length(key),
-                          fdb_slice_data(member),
-                          fdb_slice_length(member),
-                          score,
-                          &slice_key2);
-        char buf0[sizeof(uint8_t)] = {0};
-        rocksdb_encode_fixed8(buf0, 1);
-        fdb_slot_writebatch_put(slot, fdb_slice_data(slice_key2), fdb_slice_length(slice_key2), buf0, sizeof(uint8_t));
-        fdb_slice_destroy(slice_key2);
-
-        fdb_slice_t *slice_key0 = NULL;
-        encode_zset_key(fdb_slice_data(key),
-                        fdb_slice_length(key),
-                        fdb_slice_data(member),
-                        fdb_slice_length(member),
-                        &slice_key0);
-        char buf1[sizeof(uint64_t)] = {0};
-        rocksdb_encode_fixed64(buf1, double_to_lex(score));
-        fdb_slot_writebatch_put(slot, fdb_slice_data(slice_key0), fdb_slice_length(slice_key0), buf1, sizeof(uint64_t));
-        fdb_slice_destroy(slice_key0);
+        zput_one(slot, key, fdb_slice_data(member), fdb_slice_length(member), score);
         return (found==1) ? 0 : 1;
     }
     return 0;
 }
 
-static int zget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double* pscore){
-    fdb_slice_t *slice_key = NULL;
-    encode_zset_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(member), fdb_slice_length(member), &slice_key);
-    rocksdb_readoptions_t *readoptions = rocksdb_readoptions_create();
+static void zput_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen, double score){
+    //the score key is the longer one, the member key fits in the same buffer
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_zscore_key_size(fdb_slice_length(key), memberlen));
+    size_t fdbkeylen = fdb_codec_encode_zscore_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key),
+                                                   member, memberlen, score);
+    char buf0[sizeof(uint8_t)] = {0};
+    rocksdb_encode_fixed8(buf0, 1);
+    fdb_slot_writebatch_put(slot, fdbkey, fdbkeylen, buf0, sizeof(uint8_t));
+
+    fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_ZSET, fdb_slice_data(key), fdb_slice_length(key),
+                                            member, memberlen);
+    char buf1[sizeof(uint64_t)] = {0};
+    rocksdb_encode_fixed64(buf1, double_to_lex(score));
+    fdb_slot_writebatch_put(slot, fdbkey, fdbkeylen, buf1, sizeof(uint64_t));
+    fdb_codec_buf_free(stack, fdbkey);
+}
+
+static int zget_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    double* pscore){
+    if(packed != NULL){
+        long pos = packed_find(packed, fdb_slice_data(member), fdb_slice_length(member));
+        if(pos < 0){
+            return 0;
+        }
+        *pscore = packed_at(packed, (size_t)pos)->score_;
+        return 1;
+    }
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), fdb_slice_length(member)));
+    size_t fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_ZSET, fdb_slice_data(key), fdb_slice_length(key),
+                                                   fdb_slice_data(member), fdb_slice_length(member));
     char *errptr = NULL;
     size_t vallen = 0;
 
-    char *val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    fdb_slice_destroy(slice_key);
-    rocksdb_readoptions_destroy(readoptions);
+    char *val = fdb_slot_writebatch_get(context, slot, fdbkey, fdbkeylen, &vallen, &errptr);
+    fdb_codec_buf_free(stack, fdbkey);
 
     int ret = 0;
     if(errptr!=NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
+        fprintf(stderr, "%s fdb_slot_writebatch_get fail %s.\n", __func__, errptr);
         rocksdb_free(errptr);
         ret = -1;
         goto end;
@@ -283,7 +234,8 @@ end:
     return  ret;
 }
 
-static int zrem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member){
+static int zrem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, fdb_slice_t* member,
+                    zrank_tree_t* tree){
     if(fdb_slice_length(key) > FDB_DATA_TYPE_KEY_LEN_MAX){
         fprintf(stderr, "%s name too long!\n", __func__);
         return -1; 
@@ -292,104 +244,134 @@ static int zrem_one(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
         fprintf(stderr, "%s member too long!\n", __func__);
         return -1;
     }
+    if(packed != NULL){
+        return packed_del(packed, fdb_slice_data(member), fdb_slice_length(member));
+    }
     double old_score = 0;
-    int found = zget_one(context, slot, key, member, &old_score);
+    int found = zget_one(context, slot, key, NULL, member, &old_score);
     if(found != 1){
-        return 0;
+        return found;
     }
-    fdb_slice_t *slice_key1 = NULL;
-    encode_zscore_key(fdb_slice_data(key),
-                      fdb_slice_length(key),
-                      fdb_slice_data(member),
-                      fdb_slice_length(member),
-                      old_score,
-                      &slice_key1);
-    fdb_slot_writebatch_delete(slot, fdb_slice_data(slice_key1), fdb_slice_length(slice_key1));
-    fdb_slice_destroy(slice_key1);
-
-    fdb_slice_t *slice_key0 = NULL;
-    encode_zset_key(fdb_slice_data(key),
-                    fdb_slice_length(key),
-                    fdb_slice_data(member),
-                    fdb_slice_length(member),
-                    &slice_key0);
-    fdb_slot_writebatch_delete(slot, fdb_slice_data(slice_key0), fdb_slice_length(slice_key0));
-    fdb_slice_destroy(slice_key0);
-    return 1;
+    return zdel_one(slot, key, fdb_slice_data(member), fdb_slice_length(member), old_score, tree);
 }
 
-static int zget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t* length){  
-    fdb_slice_t *slice_key = NULL;
-    encode_zsize_key(fdb_slice_data(key),
-                     fdb_slice_length(key),
-                     &slice_key);
+//member known to be in the zset at score, out of the tree, the score index and the member subkeys
+static int zdel_one(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen, double score,
+                    zrank_tree_t* tree){
+    if(zrank_delete(tree, member, memberlen, score) < 0){
+        return -1;
+    }
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *fdbkey = fdb_codec_buf(stack, fdb_codec_zscore_key_size(fdb_slice_length(key), memberlen));
+    size_t fdbkeylen = fdb_codec_encode_zscore_key(fdbkey, fdb_slice_data(key), fdb_slice_length(key),
+                                                   member, memberlen, score);
+    fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
 
-    char *val, *errptr = NULL;
-    size_t vallen = 0;
-    rocksdb_readoptions_t* readoptions = rocksdb_readoptions_create();
-    val = rocksdb_get_cf(context->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
-    rocksdb_readoptions_destroy(readoptions);
-    fdb_slice_destroy(slice_key);
+    fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_ZSET, fdb_slice_data(key), fdb_slice_length(key),
+                                            member, memberlen);
+    fdb_slot_writebatch_delete(slot, fdbkey, fdbkeylen);
+    fdb_codec_buf_free(stack, fdbkey);
+    return 1;
+}
 
-    int ret = 0;
-    if(errptr != NULL){
-        fprintf(stderr, "%s rocksdb_get_cf fail %s.\n", __func__, errptr);
-        rocksdb_free(errptr);
-        ret = -1;
-        goto end;
-    }
-    if(val != NULL){
-        assert(vallen == sizeof(uint64_t));
-        *length = rocksdb_decode_fixed64(val);
-        rocksdb_free(val);
-        ret = 1;
-    }else{
-        ret = 0;
+static int zget_len(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, uint64_t* length){
+    if(packed != NULL){
+        *length = packed_length(packed);
+        return 1;
     }
-
-end:
-    return ret;
+    return (keys_get_count(context, slot, key, FDB_DATA_TYPE_ZSIZE, length) == FDB_OK) ? 1 : -1;
 }
 
 static int zset_incr_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t by){
-    uint64_t length = 0;
-    int ret = zget_len(context, slot, key, &length);
-    if(ret < 0) return -1;
-
-    int64_t size = (int64_t)length;
-    size += by;
-
-    fdb_slice_t *slice_key = NULL;
-    encode_zsize_key(fdb_slice_data(key),
-                     fdb_slice_length(key),
-                     &slice_key);
-    if(size <= 0){
-        fdb_slot_writebatch_delete(slot, fdb_slice_data(slice_key), fdb_slice_length(slice_key));
-    }else{
-        length = size;
-        char buff[sizeof(uint64_t)] = {0};
-        rocksdb_encode_fixed64(buff, length);
-        fdb_slot_writebatch_put(slot, fdb_slice_data(slice_key), fdb_slice_length(slice_key), buff, sizeof(uint64_t));
+    if(by == 0){
+        return 0;
     }
-    fdb_slice_destroy(slice_key);
-    return 0;
+    return (keys_incr_count(context, slot, key, FDB_DATA_TYPE_ZSIZE, by) == FDB_OK) ? 0 : -1;
 }
 
-static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t offset, uint64_t limit,
-                      int reverse, fdb_iterator_t** piterator){
+static int zset_update(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by){
+    if(packed == NULL){
+        return zset_incr_size(context, slot, key, by);
+    }
+    if(packed_fits(context, packed)){
+        return (packed_store(context, slot, key, packed) == FDB_OK) ? 0 : -1;
+    }
+    //over the limits, the members go to the score index and a rank tree of their own
+    zrank_tree_t *tree = NULL;
+    if(zrank_open(context, slot, key, &tree) < 0){
+        return -1;
+    }
+    for(size_t i=0; i<packed_length(packed); ++i){
+        const packed_entry_t *entry = packed_at(packed, i);
+        if(zrank_insert(tree, entry->member_.data_, entry->member_.length_, entry->score_) < 0){
+            zrank_destroy(tree);
+            return -1;
+        }
+        zput_one(slot, key, entry->member_.data_, entry->member_.length_, entry->score_);
+    }
+    zrank_flush(tree);
+    zrank_destroy(tree);
+    if(keys_set_packed(context, slot, key, NULL) != FDB_OK){
+        return -1;
+    }
+    return zset_incr_size(context, slot, key, (int64_t)packed_length(packed));
+}
 
-    if((offset+limit) > limit){
-        limit = offset + limit;
+//whether score is within min and max, either bound left out if open
+static int zscore_in_range(double score, double min, int open_min, double max, int open_max){
+    if(score < min || (open_min && score == min)){
+        return 0;
     }
+    if(score > max || (open_max && score == max)){
+        return 0;
+    }
+    return 1;
+}
+
+static void zpush_entry(fdb_array_t* array, const packed_entry_t* entry){
+    fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
+    snode->val_.dval_ = entry->score_;
+    fdb_array_push_back(array, snode);
+
+    fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
+    mnode->val_.vval_ = fdb_slice_create(entry->member_.data_, entry->member_.length_);
+    fdb_array_push_back(array, mnode);
+}
+
+//the iterator starts right past the member ranked before offset, found through the rank tree,
+//rather than stepping over offset members
+static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, zrank_tree_t* tree, uint64_t offset,
+                      uint64_t limit, int reverse, fdb_iterator_t** piterator){
+
+    *piterator = NULL;
     fdb_slice_t *key_start = NULL, *key_end = NULL;
-    if(reverse == 0){
-        double sstart = FDB_SCORE_MIN, send = FDB_SCORE_MAX;
+    if(offset > 0){
+        uint64_t size = zrank_size(tree);
+        if(offset >= size){
+            return -1;
+        }
+        double score = 0.0;
+        fdb_view_t member;
+        if(zrank_select(tree, reverse ? size - offset : offset - 1, &score, &member) != 1){
+            return -1;
+        }
         encode_zscore_key(fdb_slice_data(key),
                           fdb_slice_length(key),
-                          NULL,
-                          0,
-                          sstart,
+                          member.data_,
+                          member.length_,
+                          score,
                           &key_start);
+    }
+    if(reverse == 0){
+        double sstart = FDB_SCORE_MIN, send = FDB_SCORE_MAX;
+        if(key_start == NULL){
+            encode_zscore_key(fdb_slice_data(key),
+                              fdb_slice_length(key),
+                              NULL,
+                              0,
+                              sstart,
+                              &key_start);
+        }
         encode_zscore_key(fdb_slice_data(key),
                           fdb_slice_length(key),
                           "\xff",
@@ -399,12 +381,14 @@ static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key
         *piterator = fdb_iterator_create(context, slot, key_start, key_end, limit, FORWARD);  
     }else{
         double sstart = FDB_SCORE_MAX, send = FDB_SCORE_MIN;
-        encode_zscore_key(fdb_slice_data(key),
-                          fdb_slice_length(key),
-                          "\xff",
-                          strlen("\xff"),
-                          sstart,
-                          &key_start);
+        if(key_start == NULL){
+            encode_zscore_key(fdb_slice_data(key),
+                              fdb_slice_length(key),
+                              "\xff",
+                              strlen("\xff"),
+                              sstart,
+                              &key_start);
+        }
         encode_zscore_key(fdb_slice_data(key),
                           fdb_slice_length(key),
                           NULL,
@@ -415,9 +399,24 @@ static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key
     }
     fdb_slice_destroy(key_start);
     fdb_slice_destroy(key_end);
+    return 0;
+}
 
-    if(offset>0){
-        if(fdb_iterator_skip(*piterator, offset)<0){
+//the rank tree of key for a command that only reads, a tree built from the score index on the
+//way is committed at once, so later reads find it
+static int zrank_open_read(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, zrank_tree_t** ptree){
+    int ret = zrank_open(context, slot, key, ptree);
+    if(ret < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return -1;
+    }
+    if(ret > 0){
+        char *errptr = NULL;
+        fdb_slot_writebatch_commit(context, slot, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            zrank_destroy(*ptree);
             return -1;
         }
     }
@@ -427,7 +426,7 @@ static int zget_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key
 static int zget_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double sstart, 
                      double send, uint64_t limit, int reverse, fdb_iterator_t** piterator){
     double score = 0.0;
-    if(fdb_slice_length(member)==0 || zget_one(context, slot, key, member, &score)!=1){
+    if(fdb_slice_length(member)==0 || zget_one(context, slot, key, NULL, member, &score)!=1){
         score = sstart;
     }
     fdb_slice_t *key_start = NULL, *key_end = NULL;
@@ -476,235 +475,530 @@ static int zget_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key,
 }
 
 
-int zset_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, int64_t* count){
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_ZSET);
-    if(retval != FDB_OK){
-        return retval;
+//committing the removals from a packed zset, which is destroyed
+static int zset_commit_packed(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, int64_t by){
+    int ret = (by != 0) ? zset_update(context, slot, key, packed, by) : 0;
+    packed_destroy(packed);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
     }
-
-    if((sms->length_%2)==1){
-        return FDB_ERR_WRONG_NUMBER_ARGUMENTS;
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
     }
+    return FDB_OK;
+}
 
-    int64_t _count = 0;
-    for(size_t i=0; i<sms->length_;){
-        double score = fdb_array_at(sms, i++)->val_.dval_; 
-        fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(sms, i++)->val_.vval_);
-        int ret = zset_one(context, slot, key, member, score);
-        if(ret >=0){
-            if(ret > 0){
-                if(zset_incr_size(context, slot, key, 1) == 0){
-                    ++_count;
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
-            }
+
+//waking up to count of the callers zset_pop_park left on key, name is the key before its seq
+//prefix, NULL if nobody was parked when the command started
+static void zset_wake(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* name, int64_t count){
+    if(name != NULL){
+        if(count > 0){
+            fdb_waiter_wake((fdb_waiter_t*)context->waiter_, slot->id_, fdb_slice_data(name), fdb_slice_length(name), (size_t)count);
         }
+        fdb_slice_destroy(name);
     }
+}
 
-    *count = _count;
-    return FDB_OK;
+static fdb_slice_t* zset_wake_name(fdb_context_t* context, fdb_slice_t* key){
+    if(!fdb_waiter_parked((fdb_waiter_t*)context->waiter_)){
+        return NULL;
+    }
+    return fdb_slice_create(fdb_slice_data(key), fdb_slice_length(key));
 }
 
-int zset_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+//dropping members off the low end, or the high end if max, until at most cap are left, a zset
+//in subkeys finds them by rank in its tree, which has the members the command put so far
+static int ztrim_cap(fdb_slot_t* slot, fdb_slice_t* key, packed_t* packed, zrank_tree_t* tree, uint64_t cap, int max,
+                     int64_t* trimmed){
+    *trimmed = 0;
+    if(packed != NULL){
+        while(packed_length(packed) > cap){
+            packed_del_at(packed, max ? packed_length(packed) - 1 : 0);
+            *trimmed += 1;
+        }
+        return 0;
+    }
+    uint64_t size = zrank_size(tree);
+    while(size > cap){
+        double score = 0.0;
+        fdb_view_t view;
+        if(zrank_select(tree, max ? size - 1 : 0, &score, &view) != 1){
+            return -1;
+        }
+        //the view points into a node the delete changes
+        fdb_slice_t *member = fdb_slice_create(view.data_, view.length_);
+        int ret = zdel_one(slot, key, fdb_slice_data(member), fdb_slice_length(member), score, tree);
+        fdb_slice_destroy(member);
+        if(ret < 0){
+            return -1;
+        }
+        --size;
+        *trimmed += 1;
+    }
+    return 0;
+}
+
+static int zadd_members(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, uint64_t cap,
+                        int trim_max, int64_t* count, int64_t* trimmed){
+    if((sms->length_%2)==1){
+        return FDB_ERR_WRONG_NUMBER_ARGUMENTS;
+    }
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 1, &packed);
     if(retval != FDB_OK){
         return retval;
     }
+    zrank_tree_t *tree = NULL;
+    if(packed == NULL && zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+
+    //the members of a zset in subkeys are looked up together, one repeated in sms is read back
+    //from the batch and counted once
+    size_t len = sms->length_/2;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_slice_t **mbrs = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    char **vals = (char**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(char*));
+    size_t *vallens = (size_t*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(size_t));
+    uint8_t *repeats = (uint8_t*)fdb_malloc_in(arena, (len > 0 ? len : 1));
+    for(size_t i=0; i<len; ++i){
+        mbrs[i] = (fdb_slice_t*)(fdb_array_at(sms, 2*i + 1)->val_.vval_);
+    }
+    int ret = 0;
+    if(packed == NULL){
+        ret = keys_get_members(context, slot, key, FDB_DATA_TYPE_ZSET, len, mbrs, vals, vallens, repeats);
+    }
 
     int64_t _count = 0;
-    for(size_t i=0; i<members->length_; ++i){ 
-        fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
-        int ret = zrem_one(context, slot, key, member);
-        if(ret >= 0){
-            if(ret > 0){
-                if(zset_incr_size(context, slot, key, -ret)==0){
-                    ++_count;
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
+    for(size_t i=0; ret == 0 && i<len; ++i){
+        double score = fdb_array_at(sms, 2*i)->val_.dval_; 
+        int found = -1;
+        double old_score = 0.0;
+        if(packed == NULL && !repeats[i]){
+            found = (vals[i] != NULL) ? 1 : 0;
+            if(vals[i] != NULL){
+                assert(vallens[i] == sizeof(uint64_t));
+                old_score = lex_to_double(rocksdb_decode_fixed64(vals[i]));
             }
         }
+        if(packed == NULL && vals[i] != NULL){
+            rocksdb_free(vals[i]);
+        }
+        if(zset_one(context, slot, key, packed, mbrs[i], score, tree, found, old_score) > 0){
+            ++_count;
+        }
+    }
+    int64_t _trimmed = 0;
+    if(ret == 0 && cap != UINT64_MAX){
+        ret = ztrim_cap(slot, key, packed, tree, cap, trim_max, &_trimmed);
+    }
+    if(tree != NULL){
+        zrank_flush(tree);
+        zrank_destroy(tree);
+    }
+    if(ret == 0){
+        ret = zset_update(context, slot, key, packed, _count - _trimmed);
+    }
+    packed_destroy(packed);
+    fdb_free_in(arena, mbrs);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, vallens);
+    fdb_free_in(arena, repeats);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
     }
 
     *count = _count;
-    return FDB_OK; 
+    *trimmed = _trimmed;
+    return FDB_OK;
 }
 
-int zset_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* size){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
-    if(retval != FDB_OK){
-        return retval;
-    }
+int zset_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, int64_t* count){
+    fdb_slice_t *name = zset_wake_name(context, key);
+    int64_t trimmed = 0;
+    int retval = zadd_members(context, slot, key, sms, UINT64_MAX, 0, count, &trimmed);
+    zset_wake(context, slot, name, (retval == FDB_OK) ? *count : 0);
+    return retval;
+}
 
-    uint64_t length = 0;
-    int ret = zget_len(context, slot, key, &length);
-    if(ret < 0){
-        retval = FDB_ERR;
-    }else if(ret >=0){
-        retval = FDB_OK;
-        *size = (int64_t)length; 
-    }
-    return retval;    
+int zset_add_capped(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, uint64_t cap,
+                    int trim_max, int64_t* count, int64_t* trimmed){
+    fdb_slice_t *name = zset_wake_name(context, key);
+    int retval = zadd_members(context, slot, key, sms, cap, trim_max, count, trimmed);
+    zset_wake(context, slot, name, (retval == FDB_OK) ? *count : 0);
+    return retval;
 }
 
-int zset_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double* pscore){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+static int zwindow_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double now,
+                       double window, int64_t ttl, int64_t* count, int64_t* added){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 1, &packed);
     if(retval != FDB_OK){
         return retval;
     }
-
-    int ret = zget_one(context, slot, key, member, pscore);
-    if(ret ==1){
-        retval = FDB_OK;
-    }else if(ret == 0){
-        retval = FDB_OK_NOT_EXIST;
-    }else{
-        retval = FDB_ERR;
+    double cutoff = now - window;
+    int64_t removed = 0;
+    int ret = 0;
+    zrank_tree_t *tree = NULL;
+    if(packed != NULL){
+        //in score order, the ones out of the window lead
+        while(packed_length(packed) > 0 && packed_at(packed, 0)->score_ <= cutoff){
+            packed_del_at(packed, 0);
+            ++removed;
+        }
+    }else if(zrank_open(context, slot, key, &tree) < 0){
+        ret = -1;
+    }else{
+        //the score index as committed, the batch has no subkeys of this command yet
+        fdb_iterator_t *ziterator = NULL;
+        zget_scan(context, slot, key, NULL, FDB_SCORE_MIN, cutoff, INT32_MAX, 0, &ziterator);
+        while(ret == 0 && fdb_iterator_valid(ziterator)){
+            size_t len = 0;
+            const char* fdbkey = fdb_iterator_key_raw(ziterator, &len);
+            fdb_view_t zmember;
+            double score = 0.0;
+            if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &zmember, &score)==0){
+                if(score > cutoff){
+                    break;
+                }
+                if(zdel_one(slot, key, zmember.data_, zmember.length_, score, tree) < 0){
+                    ret = -1;
+                }
+                ++removed;
+            }
+            if(fdb_iterator_next(ziterator)){
+                break;
+            }
+        }
+        fdb_iterator_destroy(ziterator);
+    }
+
+    *added = 0;
+    if(ret == 0){
+        int one = zset_one(context, slot, key, packed, member, now, tree, -1, 0.0);
+        if(one < 0){
+            ret = -1;
+        }else{
+            *added = one;
+        }
+    }
+    uint64_t size = 0;
+    if(tree != NULL){
+        size = zrank_size(tree);
+        zrank_flush(tree);
+        zrank_destroy(tree);
+    }else if(packed != NULL){
+        size = packed_length(packed);
+    }
+    if(ret == 0){
+        ret = zset_update(context, slot, key, packed, *added - removed);
+    }
+    packed_destroy(packed);
+    if(ret == 0 && ttl > 0 && keys_set_pexpire(context, slot, key, (int64_t)time_ms() + ttl) != FDB_OK){
+        ret = -1;
+    }
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+    *count = (int64_t)size;
+    return FDB_OK;
+}
+
+int zset_window_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double now,
+                    double window, int64_t ttl, int64_t* count){
+    fdb_slice_t *name = zset_wake_name(context, key);
+    int64_t added = 0;
+    int retval = zwindow_add(context, slot, key, member, now, window, ttl, count, &added);
+    zset_wake(context, slot, name, (retval == FDB_OK) ? added : 0);
+    return retval;
+}
+
+int zset_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+
+    zrank_tree_t *tree = NULL;
+    if(packed == NULL && zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+
+    int64_t _count = 0;
+    for(size_t i=0; i<members->length_; ++i){ 
+        fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
+        int ret = zrem_one(context, slot, key, packed, member, tree);
+        if(ret > 0){
+            ++_count;
+        }
+    }
+    if(tree != NULL){
+        zrank_flush(tree);
+        zrank_destroy(tree);
+    }
+    int ret = (_count > 0) ? zset_update(context, slot, key, packed, -_count) : 0;
+    packed_destroy(packed);
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+
+    *count = _count;
+    return FDB_OK; 
+}
+
+int zset_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* size){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+
+    uint64_t length = 0;
+    int ret = zget_len(context, slot, key, packed, &length);
+    if(ret < 0){
+        retval = FDB_ERR;
+    }else if(ret >=0){
+        retval = FDB_OK;
+        *size = (int64_t)length; 
+    }
+    packed_destroy(packed);
+    return retval;    
+}
+
+int zset_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double* pscore){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+
+    int ret = zget_one(context, slot, key, packed, member, pscore);
+    if(ret ==1){
+        retval = FDB_OK;
+    }else if(ret == 0){
+        retval = FDB_OK_NOT_EXIST;
+    }else{
+        retval = FDB_ERR;
+    }
+    packed_destroy(packed);
+    return retval;
+}
+
+int zset_mscore(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, fdb_array_t** rets){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    size_t len = members->length_;
+    fdb_arena_t *arena = fdb_arena_current();
+    fdb_slice_t **mbrs = (fdb_slice_t**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(fdb_slice_t*));
+    char **vals = (char**)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(char*));
+    size_t *vallens = (size_t*)fdb_malloc_in(arena, (len > 0 ? len : 1) * sizeof(size_t));
+    for(size_t i=0; i<len; ++i){
+        mbrs[i] = (fdb_slice_t*)(fdb_array_at(members, i)->val_.vval_);
+    }
+    int ret = 0;
+    if(packed == NULL){
+        ret = keys_get_members(context, slot, key, FDB_DATA_TYPE_ZSET, len, mbrs, vals, vallens, NULL);
+    }
+    if(ret == 0){
+        fdb_array_t *array = fdb_array_create(len);
+        for(size_t i=0; i<len; ++i){
+            fdb_val_node_t *node = fdb_val_node_create_in(arena);
+            int found = 0;
+            if(packed != NULL){
+                found = zget_one(context, slot, key, packed, mbrs[i], &node->val_.dval_);
+            }else if(vals[i] != NULL){
+                assert(vallens[i] == sizeof(uint64_t));
+                node->val_.dval_ = lex_to_double(rocksdb_decode_fixed64(vals[i]));
+                rocksdb_free(vals[i]);
+                found = 1;
+            }
+            node->retval_ = found ? FDB_OK : FDB_OK_NOT_EXIST;
+            fdb_array_push_back(array, node);
+        }
+        *rets = array;
+        retval = FDB_OK;
+    }else{
+        retval = FDB_ERR;
     }
+    packed_destroy(packed);
+    fdb_free_in(arena, mbrs);
+    fdb_free_in(arena, vals);
+    fdb_free_in(arena, vallens);
     return retval;
 }
 
 int zset_incr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double init, double by, double* pscore){
-    int retval = keys_enc(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 1, &packed);
     if(retval != FDB_OK){
         return retval;
     }
-    double score = init;
-    int ret = zget_one(context, slot, key, member, &score);
+    zrank_tree_t *tree = NULL;
+    if(packed == NULL && zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    double old_score = init, score = init;
+    int ret = zget_one(context, slot, key, packed, member, &old_score);
     if(ret >=0){
-        score += by;
-        ret = zset_one(context, slot, key, member, score);
-        if(ret >= 0){
-            if(ret > 0){
-                if(zset_incr_size(context, slot, key, ret) != 0){
-                    return FDB_ERR;
-                }
-            }
-            char *errptr = NULL;
-            fdb_slot_writebatch_commit(context, slot, &errptr);
-            if(errptr != NULL){
-                fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                rocksdb_free(errptr);
-                return FDB_ERR;
-            }
-            *pscore = score;
-            retval = FDB_OK;
-        }else{
-            retval = FDB_ERR;
-        } 
-    }else {
+        score = old_score + by;
+        ret = zset_one(context, slot, key, packed, member, score, tree, ret, old_score);
+    }
+    if(tree != NULL){
+        zrank_flush(tree);
+        zrank_destroy(tree);
+    }
+    if(ret >= 0 && zset_update(context, slot, key, packed, ret) != 0){
+        ret = -1;
+    }
+    packed_destroy(packed);
+    if(ret >= 0){
+        char *errptr = NULL;
+        fdb_slot_writebatch_commit(context, slot, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            return FDB_ERR;
+        }
+        *pscore = score;
+        retval = FDB_OK;
+    }else{
+        fdb_slot_writebatch_discard(context, slot);
         retval = FDB_ERR;
     }
     return retval;
 }
 
 int zset_rank(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, int reverse, int64_t* rank){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
-    fdb_iterator_t *ziterator = NULL;
-    zget_range(context, slot, key, 0, INT32_MAX, reverse, &ziterator);
-
-    fdb_slice_t *zmember = NULL;
-    int64_t _rank = 0;
-    while(1){
-        if(!fdb_iterator_valid(ziterator)){
-            retval = FDB_OK_NOT_EXIST;
-            break;
-        }
-        size_t klen = 0;
-        const char* key = fdb_iterator_key_raw(ziterator, &klen);
-        if(decode_zscore_key(key, klen, NULL, &zmember, NULL)<0){
-            retval = FDB_OK_NOT_EXIST;
-            break;
-        }
-        if(compare_with_length(fdb_slice_data(member), fdb_slice_length(member), fdb_slice_data(zmember), fdb_slice_length(zmember))==0){
-            retval = FDB_OK;
-            *rank = _rank;
-            break;
-        } 
-        fdb_slice_destroy(zmember);
-        if(fdb_iterator_next(ziterator)){
+    if(packed != NULL){
+        long pos = packed_find(packed, fdb_slice_data(member), fdb_slice_length(member));
+        if(pos < 0){
             retval = FDB_OK_NOT_EXIST;
-            break;
+        }else{
+            *rank = reverse ? (int64_t)(packed_length(packed) - 1 - pos) : (int64_t)pos;
         }
-        ++_rank;
+        packed_destroy(packed);
+        return retval;
     }
-    fdb_iterator_destroy(ziterator);
+    double score = 0.0;
+    int ret = zget_one(context, slot, key, NULL, member, &score);
+    if(ret != 1){
+        return (ret == 0) ? FDB_OK_NOT_EXIST : FDB_ERR;
+    }
+    zrank_tree_t *tree = NULL;
+    if(zrank_open_read(context, slot, key, &tree) < 0){
+        return FDB_ERR;
+    }
+
+    uint64_t _rank = 0;
+    ret = zrank_rank(tree, fdb_slice_data(member), fdb_slice_length(member), score, &_rank);
+    if(ret == 1){
+        *rank = reverse ? (int64_t)(zrank_size(tree) - 1 - _rank) : (int64_t)_rank;
+        retval = FDB_OK;
+    }else if(ret == 0){
+        retval = FDB_OK_NOT_EXIST;
+    }else{
+        retval = FDB_ERR;
+    }
+    zrank_destroy(tree);
     return retval;
 }
 
 int zset_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, uint8_t type, int64_t* count){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
 
     if(fabs(score_start - score_end)<=0.000001 && ((type&OPEN_ITERVAL_LEFT)||(type &OPEN_ITERVAL_RIGHT)) ){
+        packed_destroy(packed);
         *count = 0;
         return FDB_OK;
     }
 
-    fdb_iterator_t *ziterator = NULL;
-    zget_scan(context, slot, key, NULL, score_start, score_end, INT32_MAX, 0, &ziterator);
-
-
-    int64_t _count = 0;
-    if(fdb_iterator_valid(ziterator)){
-        double score = 0.0;
-        size_t len = 0;
-        const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
-        if(decode_zscore_key(fdbkey, len, NULL, NULL, &score)==0){
-            if((score_start<score && score<score_end) || 
-               (fabs(score-score_start)<=0.000001 && !(type&OPEN_ITERVAL_LEFT)) ||
-               (fabs(score-score_end)<=0.000001 && !(type&OPEN_ITERVAL_RIGHT))){
-                _count++; 
+    if(packed != NULL){
+        int64_t _count = 0;
+        for(size_t i=0; i<packed_length(packed); ++i){
+            if(zscore_in_range(packed_at(packed, i)->score_, score_start, type & OPEN_ITERVAL_LEFT,
+                               score_end, type & OPEN_ITERVAL_RIGHT)){
+                ++_count;
             }
         }
-    }else{
-        *count = 0;
-        retval = FDB_OK;
-        goto end;
+        packed_destroy(packed);
+        *count = _count;
+        return FDB_OK;
     }
 
-    while(!fdb_iterator_next(ziterator)){
-        double score = 0.0;
-        size_t len = 0;
-        const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
-        if(decode_zscore_key(fdbkey, len, NULL, NULL, &score)==0){
-            if(fabs(score_end-score)<=0.000001 && (type & OPEN_ITERVAL_RIGHT)){
-                break;
-            }
-            _count++;
-        }
-
+    zrank_tree_t *tree = NULL;
+    if(zrank_open_read(context, slot, key, &tree) < 0){
+        return FDB_ERR;
     }
-    *count = _count;
-    retval = FDB_OK;
 
-end:
-    fdb_iterator_destroy(ziterator);
+    //members below the end bound less those below the start bound
+    uint64_t below_start = 0, below_end = 0;
+    if(zrank_count_below(tree, score_start, (type & OPEN_ITERVAL_LEFT) ? 1 : 0, &below_start) < 0 ||
+       zrank_count_below(tree, score_end, (type & OPEN_ITERVAL_RIGHT) ? 0 : 1, &below_end) < 0){
+        retval = FDB_ERR;
+    }else{
+        *count = (below_end > below_start) ? (int64_t)(below_end - below_start) : 0;
+        retval = FDB_OK;
+    }
+    zrank_destroy(tree);
     return retval;
 }
 
 int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int rank_start, int rank_end, int reverse, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
     uint64_t offset, limit, length = 0;
-    int ret = zget_len(context, slot, key, &length); 
+    int ret = zget_len(context, slot, key, packed, &length); 
     if(ret != 1 && ret != 0){
+        packed_destroy(packed);
         return FDB_ERR;
     }
 
@@ -718,6 +1012,7 @@ int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int r
         rank_start = 0;
     }
     if(rank_start > rank_end || rank_start >= (int)length){
+        packed_destroy(packed);
         return FDB_OK_RANGE_HAVE_NONE;
     }
     if(rank_end >= (int)length){
@@ -726,12 +1021,30 @@ int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int r
     }else{
         limit = rank_end - rank_start + 1;
     }
+    if(packed != NULL){
+        fdb_array_t *_rets = fdb_array_create(8);
+        for(int i=rank_start; i<=rank_end; ++i){
+            zpush_entry(_rets, packed_at(packed, reverse ? length - 1 - i : i));
+        }
+        packed_destroy(packed);
+        *rets = _rets;
+        return FDB_OK;
+    }
     offset = rank_start;
+    zrank_tree_t *tree = NULL;
+    if(zrank_open_read(context, slot, key, &tree) < 0){
+        return FDB_ERR;
+    }
     fdb_iterator_t *ziterator = NULL;
-    zget_range(context, slot, key, offset, limit, reverse, &ziterator);
+    ret = zget_range(context, slot, key, tree, offset, limit, reverse, &ziterator);
+    zrank_destroy(tree);
+    if(ret < 0){
+        return FDB_ERR;
+    }
+    uint64_t want = rank_end - rank_start + 1;
     fdb_array_t *_rets = fdb_array_create(8);
     while(1){
-        if(!fdb_iterator_valid(ziterator)){
+        if(!fdb_iterator_valid(ziterator) || _rets->length_ == 2*want){
             break;
         }
         double score = 0.0;
@@ -739,11 +1052,11 @@ int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int r
         const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
         fdb_slice_t *zmember = NULL;
         if(decode_zscore_key(fdbkey, len, NULL, &zmember, &score)==0){
-            fdb_val_node_t *snode = fdb_val_node_create();
+            fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
             snode->val_.dval_ = score;
             fdb_array_push_back(_rets, snode); 
 
-            fdb_val_node_t *mnode = fdb_val_node_create();
+            fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
             mnode->val_.vval_ = zmember;
             fdb_array_push_back(_rets, mnode);
         }
@@ -764,15 +1077,38 @@ int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int r
 }
 
 int zset_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, int reverse, uint8_t type, fdb_array_t** rets){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
 
     if(fabs(score_start - score_end)<=0.000001 && ((type&OPEN_ITERVAL_LEFT)||(type &OPEN_ITERVAL_RIGHT)) ){
+        packed_destroy(packed);
         return FDB_OK_RANGE_HAVE_NONE;
     }
 
+    if(packed != NULL){
+        //score_start is the upper bound when reverse
+        fdb_array_t *_rets = fdb_array_create(8);
+        size_t length = packed_length(packed);
+        for(size_t i=0; i<length; ++i){
+            const packed_entry_t *entry = packed_at(packed, reverse ? length - 1 - i : i);
+            int in = reverse ? zscore_in_range(entry->score_, score_end, type & OPEN_ITERVAL_RIGHT, score_start, type & OPEN_ITERVAL_LEFT)
+                             : zscore_in_range(entry->score_, score_start, type & OPEN_ITERVAL_LEFT, score_end, type & OPEN_ITERVAL_RIGHT);
+            if(in){
+                zpush_entry(_rets, entry);
+            }
+        }
+        packed_destroy(packed);
+        if(_rets->length_ == 0){
+            fdb_array_destroy(_rets);
+            return FDB_OK_RANGE_HAVE_NONE;
+        }
+        *rets = _rets;
+        return FDB_OK;
+    }
+
     fdb_iterator_t *ziterator = NULL;
     zget_scan(context, slot, key, NULL, score_start, score_end, INT32_MAX, reverse, &ziterator);
 
@@ -783,12 +1119,15 @@ int zset_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double
         const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
         fdb_slice_t *zmember = NULL;
         if(decode_zscore_key(fdbkey, len, NULL, &zmember, &score)==0){
-            if((score_start<score && score<score_end) || (fabs(score-score_start)<=0.000001 && !(type&OPEN_ITERVAL_LEFT))){
-                fdb_val_node_t *snode = fdb_val_node_create();
+            //the first one may sit on either bound
+            int in = reverse ? zscore_in_range(score, score_end, type & OPEN_ITERVAL_RIGHT, score_start, type & OPEN_ITERVAL_LEFT)
+                             : zscore_in_range(score, score_start, type & OPEN_ITERVAL_LEFT, score_end, type & OPEN_ITERVAL_RIGHT);
+            if(in){
+                fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
                 snode->val_.dval_ = score;
                 fdb_array_push_back(_rets, snode); 
 
-                fdb_val_node_t *mnode = fdb_val_node_create();
+                fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
                 mnode->val_.vval_ = zmember;
                 fdb_array_push_back(_rets, mnode);
             }
@@ -814,11 +1153,11 @@ int zset_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double
                 fdb_slice_destroy(zmember);
                 break;
             }
-            fdb_val_node_t *snode = fdb_val_node_create();
+            fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
             snode->val_.dval_ = score;
             fdb_array_push_back(_rets, snode); 
 
-            fdb_val_node_t *mnode = fdb_val_node_create();
+            fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
             mnode->val_.vval_ = zmember;
             fdb_array_push_back(_rets, mnode);
         }
@@ -837,84 +1176,615 @@ end:
 }
 
 
-int zset_rem_range_by_rank(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int rank_start, int rank_end, int64_t* count){
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+//the cursor of a score range, the lex score of the last member returned and the member
+static fdb_slice_t* zrange_cursor(fdb_array_t* array){
+    double score = fdb_array_at(array, array->length_ - 2)->val_.dval_;
+    fdb_slice_t *member = (fdb_slice_t*)(fdb_array_at(array, array->length_ - 1)->val_.vval_);
+    char lex[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(lex, double_to_lex(score));
+    fdb_slice_t *cursor = fdb_slice_create(lex, sizeof(uint64_t));
+    fdb_slice_string_push_back(cursor, fdb_slice_data(member), fdb_slice_length(member));
+    return cursor;
+}
+
+int zset_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end,
+                        uint8_t type, int reverse, uint64_t offset, uint64_t count, fdb_slice_t* cursor,
+                        fdb_array_t** rets, fdb_slice_t** pcursor){
+    *pcursor = NULL;
+    if(fdb_slice_length(cursor) > 0 && fdb_slice_length(cursor) < sizeof(uint64_t)){
+        return FDB_ERR_SYNTAX_ERROR;
+    }
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
-    uint64_t offset, limit, length = 0;
-    int ret = zget_len(context, slot, key, &length); 
-    if(ret != 1 && ret != 0){
-        return FDB_ERR;
-    }
 
-    if(rank_start < 0){
-        rank_start = rank_start + length;
-    }
-    if(rank_end < 0){
-        rank_end = rank_end + length;
-    }
-    if(rank_start < 0){
-        rank_start = 0;
-    }
-    if(rank_start > rank_end || rank_start >= (int)length){
+    //the bounds in ascending order
+    double min = reverse ? score_end : score_start, max = reverse ? score_start : score_end;
+    int open_min = reverse ? (type & OPEN_ITERVAL_RIGHT) : (type & OPEN_ITERVAL_LEFT);
+    int open_max = reverse ? (type & OPEN_ITERVAL_LEFT) : (type & OPEN_ITERVAL_RIGHT);
+    if(min > max || (min == max && (open_min || open_max))){
+        packed_destroy(packed);
         return FDB_OK_RANGE_HAVE_NONE;
     }
-    if(rank_end >= (int)length){
-        rank_end = (int)(length - 1);
-        limit = rank_end - rank_start + 10;
-    }else{
-        limit = rank_end - rank_start + 1;
+    const char *clex = NULL;
+    const char *cmember = NULL;
+    size_t cmemberlen = 0;
+    if(fdb_slice_length(cursor) > 0){
+        clex = fdb_slice_data(cursor);
+        cmember = clex + sizeof(uint64_t);
+        cmemberlen = fdb_slice_length(cursor) - sizeof(uint64_t);
+        offset = 0;
     }
-    offset = rank_start;
-    fdb_iterator_t *ziterator = NULL;
-    zget_range(context, slot, key, offset, limit, 0, &ziterator); 
 
-    *count = 0;
-    do{
-        if((*count)==limit){
-            break;
+    fdb_array_t *_rets = fdb_array_create(8);
+    int more = 0;
+    if(packed != NULL){
+        size_t length = packed_length(packed);
+        uint64_t skipped = 0;
+        for(size_t i=0; i<length; ++i){
+            const packed_entry_t *entry = packed_at(packed, reverse ? length - 1 - i : i);
+            if(!zscore_in_range(entry->score_, min, open_min, max, open_max)){
+                continue;
+            }
+            if(clex != NULL){
+                int cmp = memcmp(entry->lex_, clex, sizeof(uint64_t));
+                if(cmp == 0){
+                    cmp = compare_with_length(entry->member_.data_, entry->member_.length_, cmember, cmemberlen);
+                }
+                if(reverse ? cmp >= 0 : cmp <= 0){
+                    continue;
+                }
+            }
+            if(skipped < offset){
+                ++skipped;
+                continue;
+            }
+            if(count > 0 && _rets->length_ == 2*count){
+                more = 1;
+                break;
+            }
+            zpush_entry(_rets, entry);
         }
-        if(!fdb_iterator_valid(ziterator)){
-            break;
+        packed_destroy(packed);
+        goto end;
+    }
+
+    {
+        //the first entry is free of the limit, so one past count is read to tell whether the
+        //range goes on
+        uint64_t limit = (count > 0) ? count : INT32_MAX;
+        fdb_iterator_t *ziterator = NULL;
+        if(clex != NULL){
+            //right past the cursor, whatever its rank is by now
+            fdb_slice_t *key_start = NULL, *key_end = NULL;
+            encode_zscore_key(fdb_slice_data(key), fdb_slice_length(key), cmember, cmemberlen,
+                              lex_to_double(rocksdb_decode_fixed64(clex)), &key_start);
+            if(reverse == 0){
+                encode_zscore_key(fdb_slice_data(key), fdb_slice_length(key), "\xff", strlen("\xff"), FDB_SCORE_MAX, &key_end);
+            }else{
+                encode_zscore_key(fdb_slice_data(key), fdb_slice_length(key), NULL, 0, FDB_SCORE_MIN, &key_end);
+            }
+            ziterator = fdb_iterator_create(context, slot, key_start, key_end, limit, reverse ? BACKWARD : FORWARD);
+            fdb_slice_destroy(key_start);
+            fdb_slice_destroy(key_end);
+        }else{
+            //the members before the range and offset are stepped over through the rank tree
+            zrank_tree_t *tree = NULL;
+            if(zrank_open_read(context, slot, key, &tree) < 0){
+                fdb_array_destroy(_rets);
+                return FDB_ERR;
+            }
+            uint64_t below = 0;
+            int ret = reverse ? zrank_count_below(tree, max, open_max ? 0 : 1, &below)
+                              : zrank_count_below(tree, min, open_min ? 1 : 0, &below);
+            uint64_t skip = (reverse ? zrank_size(tree) - below : below) + offset;
+            if(ret < 0 || (skip < zrank_size(tree) && zget_range(context, slot, key, tree, skip, limit, reverse, &ziterator) < 0)){
+                zrank_destroy(tree);
+                fdb_array_destroy(_rets);
+                return FDB_ERR;
+            }
+            zrank_destroy(tree);
         }
-        size_t len = 0;
-        const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
-        fdb_slice_t *zmember = NULL;
-        if(decode_zscore_key(fdbkey, len, NULL, &zmember, NULL)==0){
-            int ret = zrem_one(context, slot, key, zmember);
-            if(ret >= 0){
-                if(ret > 0){
-                    if(zset_incr_size(context, slot, key, -ret)==0){
-                        *count += 1;
+
+        while(ziterator != NULL && fdb_iterator_valid(ziterator)){
+            size_t len = 0;
+            const char* fdbkey = fdb_iterator_key_raw(ziterator, &len);
+            fdb_view_t member;
+            double score = 0.0;
+            if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
+                if(!zscore_in_range(score, min, open_min, max, open_max)){
+                    //past the far bound the range is done
+                    if(reverse ? (score < min || (open_min && score == min)) : (score > max || (open_max && score == max))){
+                        break;
                     }
-                }
-                char *errptr = NULL;
-                fdb_slot_writebatch_commit(context, slot, &errptr);
-                if(errptr != NULL){
-                    fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                    rocksdb_free(errptr);
+                }else if(count > 0 && _rets->length_ == 2*count){
+                    more = 1;
+                    break;
+                }else{
+                    fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
+                    snode->val_.dval_ = score;
+                    fdb_array_push_back(_rets, snode);
+                    fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
+                    mnode->val_.vval_ = fdb_slice_create(member.data_, member.length_);
+                    fdb_array_push_back(_rets, mnode);
                 }
             }
-            fdb_slice_destroy(zmember);
-        } 
-    }while(!fdb_iterator_next(ziterator));
+            if(fdb_iterator_next(ziterator)){
+                break;
+            }
+        }
+        fdb_iterator_destroy(ziterator);
+    }
 
-    fdb_iterator_destroy(ziterator);
-    return FDB_OK;
-}
+end:
+    if(_rets->length_ == 0){
+        fdb_array_destroy(_rets);
+        return FDB_OK_RANGE_HAVE_NONE;
+    }
+    if(more){
+        *pcursor = zrange_cursor(_rets);
+    }
+    *rets = _rets;
+    return FDB_OK;
+}
+
+int zset_zscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+               uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    fdb_array_t *array = fdb_array_create(32);
+    fdb_slice_t *next = NULL;
+    if(packed != NULL){
+        for(size_t i=0; i<packed_length(packed); ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(keys_match(pattern, entry->member_.data_, entry->member_.length_)){
+                zpush_entry(array, entry);
+            }
+        }
+        packed_destroy(packed);
+        *rets = array;
+        *pcursor = NULL;
+        return FDB_OK;
+    }
+
+    //the member subkeys, which hold the scores, rather than the score index
+    fdb_slice_t *key_start = NULL, *key_end = NULL;
+    encode_zset_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(cursor), fdb_slice_length(cursor), &key_start);
+    encode_zset_key(fdb_slice_data(key), fdb_slice_length(key), "\xff", strlen("\xff"), &key_end);
+    fdb_iterator_t *iterator = fdb_iterator_create(context, slot, key_start, key_end, count, FORWARD);
+    fdb_slice_destroy(key_start);
+    fdb_slice_destroy(key_end);
+    uint64_t seen = 0;
+    int more = fdb_iterator_valid(iterator);
+    while(more && seen < count){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
+        fdb_view_t member;
+        if(fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_ZSET, NULL, &member)==0 && rvlen == sizeof(uint64_t)){
+            if(keys_match(pattern, member.data_, member.length_)){
+                fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
+                snode->val_.dval_ = lex_to_double(rocksdb_decode_fixed64(rval));
+                fdb_array_push_back(array, snode);
+                fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
+                mnode->val_.vval_ = fdb_slice_create(member.data_, member.length_);
+                fdb_array_push_back(array, mnode);
+            }
+            if(++seen == count){
+                next = fdb_slice_create(member.data_, member.length_);
+            }
+        }
+        more = (fdb_iterator_next(iterator) == 0);
+    }
+    fdb_iterator_destroy(iterator);
+    if(!more){
+        fdb_slice_destroy(next);
+        next = NULL;
+    }
+    *rets = array;
+    *pcursor = next;
+    return FDB_OK;
+}
+
+
+//a lex range in ascending order, a NULL bound left out
+struct zlex_range_t {
+    fdb_slice_t*    min_;
+    int             open_min_;
+    fdb_slice_t*    max_;
+    int             open_max_;
+};
+
+//the range from start to end, start the upper bound when reverse, returns 0 if nothing can be in it
+static int zlex_parse(fdb_slice_t* start, fdb_slice_t* end, uint8_t type, int reverse, struct zlex_range_t* range){
+    fdb_slice_t *sstart = (type & LEX_UNBOUNDED_LEFT) ? NULL : start;
+    fdb_slice_t *send = (type & LEX_UNBOUNDED_RIGHT) ? NULL : end;
+    range->min_ = reverse ? send : sstart;
+    range->max_ = reverse ? sstart : send;
+    range->open_min_ = reverse ? (type & OPEN_ITERVAL_RIGHT) : (type & OPEN_ITERVAL_LEFT);
+    range->open_max_ = reverse ? (type & OPEN_ITERVAL_LEFT) : (type & OPEN_ITERVAL_RIGHT);
+    if(range->min_ == NULL || range->max_ == NULL){
+        return 1;
+    }
+    int cmp = compare_with_length(fdb_slice_data(range->min_), fdb_slice_length(range->min_),
+                                  fdb_slice_data(range->max_), fdb_slice_length(range->max_));
+    return (cmp < 0 || (cmp == 0 && !range->open_min_ && !range->open_max_)) ? 1 : 0;
+}
+
+//-1 if member is below the range, 1 if above it, 0 if in it
+static int zlex_compare(const struct zlex_range_t* range, const char* member, size_t memberlen){
+    if(range->min_ != NULL){
+        int cmp = compare_with_length(member, memberlen, fdb_slice_data(range->min_), fdb_slice_length(range->min_));
+        if(cmp < 0 || (cmp == 0 && range->open_min_)){
+            return -1;
+        }
+    }
+    if(range->max_ != NULL){
+        int cmp = compare_with_length(member, memberlen, fdb_slice_data(range->max_), fdb_slice_length(range->max_));
+        if(cmp > 0 || (cmp == 0 && range->open_max_)){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//a key right above or below all the member subkeys of the zset, its '=' bumped up or down
+static void zlex_edge_key(fdb_slice_t* key, int above, fdb_slice_t** pslice){
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *buf = fdb_codec_buf(stack, fdb_codec_member_key_size(fdb_slice_length(key), 0));
+    size_t len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_ZSET, fdb_slice_data(key), fdb_slice_length(key), NULL, 0);
+    buf[len - 1] = above ? '=' + 1 : '=' - 1;
+    *pslice = fdb_slice_create_in(fdb_arena_current(), buf, len);
+    fdb_codec_buf_free(stack, buf);
+}
+
+//a member of the range walked, stepped over while under offset, otherwise pushed to array and
+//removed through tree as given, returns 1 if taken, 0 if stepped over, -1 on error
+static int zlex_visit(fdb_slot_t* slot, fdb_slice_t* key, const char* member, size_t memberlen, double score,
+                      uint64_t offset, uint64_t* skipped, fdb_array_t* array, zrank_tree_t* tree){
+    if(*skipped < offset){
+        *skipped += 1;
+        return 0;
+    }
+    if(array != NULL){
+        fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
+        snode->val_.dval_ = score;
+        fdb_array_push_back(array, snode);
+        fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
+        mnode->val_.vval_ = fdb_slice_create(member, memberlen);
+        fdb_array_push_back(array, mnode);
+    }
+    if(tree != NULL && zdel_one(slot, key, member, memberlen, score, tree) < 0){
+        return -1;
+    }
+    return 1;
+}
+
+//the members of a zset in subkeys within range, in member order as their subkeys sort, from the
+//top if reverse, offset of them stepped over and at most count taken, count 0 for all, the walk
+//stops at the first member past the far bound, returns how many were taken, -1 on error
+static int64_t zlex_walk(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, const struct zlex_range_t* range,
+                         int reverse, uint64_t offset, uint64_t count, fdb_array_t* array, zrank_tree_t* tree){
+    fdb_slice_t *near = reverse ? range->max_ : range->min_;
+    int open_near = reverse ? range->open_max_ : range->open_min_;
+    uint64_t skipped = 0;
+    int64_t taken = 0;
+
+    //the iterator starts right past the near bound, so a bound in range is looked up on its own
+    if(near != NULL && !open_near){
+        double score = 0.0;
+        int found = zget_one(context, slot, key, NULL, near, &score);
+        if(found == 1){
+            found = zlex_visit(slot, key, fdb_slice_data(near), fdb_slice_length(near), score, offset, &skipped, array, tree);
+            taken += found;
+        }
+        if(found < 0){
+            return -1;
+        }
+    }
+    if(count > 0 && taken == (int64_t)count){
+        return taken;
+    }
+
+    fdb_slice_t *key_start = NULL, *key_end = NULL;
+    if(near != NULL){
+        encode_zset_key(fdb_slice_data(key), fdb_slice_length(key), fdb_slice_data(near), fdb_slice_length(near), &key_start);
+    }else{
+        zlex_edge_key(key, reverse, &key_start);
+    }
+    zlex_edge_key(key, !reverse, &key_end);
+    uint64_t limit = (count > 0) ? (offset - skipped) + (count - taken) : INT32_MAX;
+    fdb_iterator_t *iterator = fdb_iterator_create(context, slot, key_start, key_end, limit, reverse ? BACKWARD : FORWARD);
+    fdb_slice_destroy(key_start);
+    fdb_slice_destroy(key_end);
+
+    int more = fdb_iterator_valid(iterator);
+    while(more && (count == 0 || taken < (int64_t)count)){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(iterator, &rklen);
+        const char* rval = fdb_iterator_val_raw(iterator, &rvlen);
+        fdb_view_t zkey, member;
+        if(fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_ZSET, &zkey, &member) != 0 || rvlen != sizeof(uint64_t) ||
+           compare_with_length(zkey.data_, zkey.length_, fdb_slice_data(key), fdb_slice_length(key)) != 0){
+            break;
+        }
+        if(zlex_compare(range, member.data_, member.length_) != 0){
+            break;
+        }
+        int ret = zlex_visit(slot, key, member.data_, member.length_, lex_to_double(rocksdb_decode_fixed64(rval)),
+                             offset, &skipped, array, tree);
+        if(ret < 0){
+            taken = -1;
+            break;
+        }
+        taken += ret;
+        more = (fdb_iterator_next(iterator) == 0);
+    }
+    fdb_iterator_destroy(iterator);
+    return taken;
+}
+
+//by member, as the member subkeys sort
+static int compare_zlex_entry(const void* a, const void* b){
+    const packed_entry_t *ea = *(const packed_entry_t* const*)a;
+    const packed_entry_t *eb = *(const packed_entry_t* const*)b;
+    return compare_with_length(ea->member_.data_, ea->member_.length_, eb->member_.data_, eb->member_.length_);
+}
+
+int zset_lex_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                   uint8_t type, int64_t* count){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    struct zlex_range_t range;
+    *count = 0;
+    if(!zlex_parse(slice_start, slice_end, type, 0, &range)){
+        packed_destroy(packed);
+        return FDB_OK;
+    }
+    if(packed != NULL){
+        for(size_t i=0; i<packed_length(packed); ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(zlex_compare(&range, entry->member_.data_, entry->member_.length_) == 0){
+                *count += 1;
+            }
+        }
+        packed_destroy(packed);
+        return FDB_OK;
+    }
+
+    zrank_tree_t *tree = NULL;
+    if(zrank_open_read(context, slot, key, &tree) < 0){
+        return FDB_ERR;
+    }
+    //members sharing one score, as lex ranges take them to, are in member order in the tree as
+    //well, so the count comes from it as that of zset_count does
+    uint64_t size = zrank_size(tree);
+    double first = 0.0, last = 0.0;
+    if(size == 0){
+        retval = FDB_OK;
+    }else if(zrank_select(tree, 0, &first, NULL) == 1 && zrank_select(tree, size - 1, &last, NULL) == 1 && first == last){
+        uint64_t below_min = 0, below_max = size;
+        if(range.min_ != NULL &&
+           zrank_count_before(tree, fdb_slice_data(range.min_), fdb_slice_length(range.min_), first, range.open_min_ ? 1 : 0, &below_min) < 0){
+            retval = FDB_ERR;
+        }else if(range.max_ != NULL &&
+                 zrank_count_before(tree, fdb_slice_data(range.max_), fdb_slice_length(range.max_), first, range.open_max_ ? 0 : 1, &below_max) < 0){
+            retval = FDB_ERR;
+        }else{
+            *count = (below_max > below_min) ? (int64_t)(below_max - below_min) : 0;
+            retval = FDB_OK;
+        }
+    }else{
+        int64_t walked = zlex_walk(context, slot, key, &range, 0, 0, 0, NULL, NULL);
+        if(walked < 0){
+            retval = FDB_ERR;
+        }else{
+            *count = walked;
+            retval = FDB_OK;
+        }
+    }
+    zrank_destroy(tree);
+    return retval;
+}
+
+int zset_range_by_lex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                      uint8_t type, int reverse, uint64_t offset, uint64_t count, fdb_array_t** rets){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    struct zlex_range_t range;
+    if(!zlex_parse(slice_start, slice_end, type, reverse, &range)){
+        packed_destroy(packed);
+        return FDB_OK_RANGE_HAVE_NONE;
+    }
+    fdb_array_t *_rets = fdb_array_create(8);
+    if(packed != NULL){
+        //in score order, so the members in range are put in member order first
+        fdb_arena_t *arena = fdb_arena_current();
+        size_t length = packed_length(packed), n = 0;
+        const packed_entry_t **entries = (const packed_entry_t**)fdb_malloc_in(arena, (length > 0 ? length : 1) * sizeof(packed_entry_t*));
+        for(size_t i=0; i<length; ++i){
+            const packed_entry_t *entry = packed_at(packed, i);
+            if(zlex_compare(&range, entry->member_.data_, entry->member_.length_) == 0){
+                entries[n++] = entry;
+            }
+        }
+        qsort(entries, n, sizeof(packed_entry_t*), compare_zlex_entry);
+        for(size_t i=offset; i<n && (count == 0 || i - offset < count); ++i){
+            zpush_entry(_rets, entries[reverse ? n - 1 - i : i]);
+        }
+        fdb_free_in(arena, entries);
+        packed_destroy(packed);
+    }else if(zlex_walk(context, slot, key, &range, reverse, offset, count, _rets, NULL) < 0){
+        for(size_t i=1; i<_rets->length_; i+=2){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(_rets, i)->val_.vval_));
+        }
+        fdb_array_destroy(_rets);
+        return FDB_ERR;
+    }
+    if(_rets->length_ == 0){
+        fdb_array_destroy(_rets);
+        return FDB_OK_RANGE_HAVE_NONE;
+    }
+    *rets = _rets;
+    return FDB_OK;
+}
+
+int zset_rem_range_by_rank(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int rank_start, int rank_end, int64_t* count){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    uint64_t offset, limit, length = 0;
+    int ret = zget_len(context, slot, key, packed, &length); 
+    if(ret != 1 && ret != 0){
+        packed_destroy(packed);
+        return FDB_ERR;
+    }
+
+    if(rank_start < 0){
+        rank_start = rank_start + length;
+    }
+    if(rank_end < 0){
+        rank_end = rank_end + length;
+    }
+    if(rank_start < 0){
+        rank_start = 0;
+    }
+    if(rank_start > rank_end || rank_start >= (int)length){
+        packed_destroy(packed);
+        return FDB_OK_RANGE_HAVE_NONE;
+    }
+    if(rank_end >= (int)length){
+        rank_end = (int)(length - 1);
+        limit = rank_end - rank_start + 10;
+    }else{
+        limit = rank_end - rank_start + 1;
+    }
+    if(packed != NULL){
+        for(int i=rank_end; i>=rank_start; --i){
+            packed_del_at(packed, (size_t)i);
+        }
+        *count = rank_end - rank_start + 1;
+        return zset_commit_packed(context, slot, key, packed, -(*count));
+    }
+    if(zrange_rewrites(length, rank_end - rank_start + 1)){
+        if(zset_rewrite_ends(context, slot, key, rank_start, length - 1 - rank_end) != 0){
+            return FDB_ERR;
+        }
+        *count = rank_end - rank_start + 1;
+        return FDB_OK;
+    }
+    offset = rank_start;
+    zrank_tree_t *tree = NULL;
+    if(zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    fdb_iterator_t *ziterator = NULL;
+    if(zget_range(context, slot, key, tree, offset, limit, 0, &ziterator) < 0){
+        zrank_destroy(tree);
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+
+    *count = 0;
+    do{
+        if((*count)==limit){
+            break;
+        }
+        if(!fdb_iterator_valid(ziterator)){
+            break;
+        }
+        size_t len = 0;
+        const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
+        fdb_view_t member;
+        double score = 0.0;
+        //the score index gives the score, the member is not looked up again
+        if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
+            if(zdel_one(slot, key, member.data_, member.length_, score, tree) > 0){
+                *count += 1;
+            }
+        } 
+    }while(!fdb_iterator_next(ziterator));
+
+    fdb_iterator_destroy(ziterator);
+    zrank_flush(tree);
+    zrank_destroy(tree);
+    if(zset_incr_size(context, slot, key, -(*count)) != 0){
+        *count = 0;
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+    return FDB_OK;
+}
 
 
 int zset_rem_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, uint8_t type, int64_t* count){ 
-    int retval = keys_exs(context, slot, key, FDB_DATA_TYPE_ZSET);
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
     if(retval != FDB_OK){
         return retval;
     }
 
     if(fabs(score_start - score_end)<=0.000001 && ((type&OPEN_ITERVAL_LEFT)||(type &OPEN_ITERVAL_RIGHT)) ){
+        packed_destroy(packed);
         return FDB_OK_RANGE_HAVE_NONE;
     }
 
+    if(packed != NULL){
+        *count = 0;
+        for(size_t i=packed_length(packed); i>0; --i){
+            if(zscore_in_range(packed_at(packed, i - 1)->score_, score_start, type & OPEN_ITERVAL_LEFT,
+                               score_end, type & OPEN_ITERVAL_RIGHT)){
+                packed_del_at(packed, i - 1);
+                *count += 1;
+            }
+        }
+        return zset_commit_packed(context, slot, key, packed, -(*count));
+    }
+
+    zrank_tree_t *tree = NULL;
+    if(zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    uint64_t below = 0, upto = 0, size = zrank_size(tree);
+    if(zrank_count_below(tree, score_start, type & OPEN_ITERVAL_LEFT, &below) < 0 ||
+       zrank_count_below(tree, score_end, !(type & OPEN_ITERVAL_RIGHT), &upto) < 0){
+        zrank_destroy(tree);
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    if(upto > below && zrange_rewrites(size, upto - below)){
+        //a tree the open built from the score index goes with the old seq
+        zrank_destroy(tree);
+        fdb_slot_writebatch_discard(context, slot);
+        if(zset_rewrite_ends(context, slot, key, below, size - upto) != 0){
+            return FDB_ERR;
+        }
+        *count = upto - below;
+        return FDB_OK;
+    }
+    char *errptr = NULL;
     fdb_iterator_t *ziterator = NULL;
     zget_scan(context, slot, key, NULL, score_start, score_end, INT32_MAX, 0, &ziterator);
 
@@ -923,27 +1793,15 @@ int zset_rem_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_
         double score = 0.0;
         size_t len = 0;
         const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
-        fdb_slice_t *zmember = NULL;
-        if(decode_zscore_key(fdbkey, len, NULL, &zmember, &score)==0){
+        fdb_view_t member;
+        if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
             if((score_start<score && score<score_end) || 
                (fabs(score-score_start)<=0.000001 && !(type&OPEN_ITERVAL_LEFT)) ||
                (fabs(score-score_end)<=0.000001 && !(type&OPEN_ITERVAL_RIGHT))){
-                int ret = zrem_one(context, slot, key, zmember);
-                if(ret >= 0){
-                    if(ret > 0){
-                        if(zset_incr_size(context, slot, key, -ret)==0){
-                            *count += 1;
-                        }
-                    }
-                    char *errptr = NULL;
-                    fdb_slot_writebatch_commit(context, slot, &errptr);
-                    if(errptr != NULL){
-                        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                        rocksdb_free(errptr);
-                    }
+                if(zdel_one(slot, key, member.data_, member.length_, score, tree) > 0){
+                    *count += 1;
                 }
             }
-            fdb_slice_destroy(zmember);
         }
     }else{
         retval = FDB_OK_RANGE_HAVE_NONE;
@@ -960,32 +1818,558 @@ int zset_rem_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_
         double score = 0.0;
         size_t len = 0;
         const char* fdbkey = fdb_iterator_key_raw(ziterator, &len); 
-        fdb_slice_t *zmember = NULL;
-        if(decode_zscore_key(fdbkey, len, NULL, &zmember, &score)==0){
+        fdb_view_t member;
+        if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
             if(fabs(score_end-score)>0.000001 || !(type & OPEN_ITERVAL_RIGHT)){
-                int ret = zrem_one(context, slot, key, zmember);
-                if(ret >= 0){
-                    if(ret > 0){
-                        if(zset_incr_size(context, slot, key, -ret)==0){
-                            *count += 1;
-                        }
-                    }
-                    char *errptr = NULL;
-                    fdb_slot_writebatch_commit(context, slot, &errptr);
-                    if(errptr != NULL){
-                        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
-                        rocksdb_free(errptr);
-                    }
+                if(zdel_one(slot, key, member.data_, member.length_, score, tree) > 0){
+                    *count += 1;
                 }
             }
-            fdb_slice_destroy(zmember);
             if(fabs(score_end-score)<=0.000001 && (type & OPEN_ITERVAL_RIGHT)){
                 break;
             }
         }
     }
 
+    zrank_flush(tree);
+    if(zset_incr_size(context, slot, key, -(*count)) != 0){
+        //none of the deletions go without the size
+        *count = 0;
+        fdb_slot_writebatch_discard(context, slot);
+        retval = FDB_ERR;
+    }
+
 end:
     fdb_iterator_destroy(ziterator);
-    return FDB_OK; 
+    if(retval != FDB_ERR){
+        //a tree just built from the score index is kept even when nothing was in range
+        fdb_slot_writebatch_commit(context, slot, &errptr);
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+            retval = FDB_ERR;
+        }
+    }
+    zrank_destroy(tree);
+    return (retval == FDB_ERR) ? FDB_ERR : FDB_OK;
+}
+
+int zset_rem_range_by_lex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                          uint8_t type, int64_t* count){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    struct zlex_range_t range;
+    if(!zlex_parse(slice_start, slice_end, type, 0, &range)){
+        packed_destroy(packed);
+        return FDB_OK_RANGE_HAVE_NONE;
+    }
+    *count = 0;
+    if(packed != NULL){
+        for(size_t i=packed_length(packed); i>0; --i){
+            const packed_entry_t *entry = packed_at(packed, i - 1);
+            if(zlex_compare(&range, entry->member_.data_, entry->member_.length_) == 0){
+                packed_del_at(packed, i - 1);
+                *count += 1;
+            }
+        }
+        return zset_commit_packed(context, slot, key, packed, -(*count));
+    }
+
+    zrank_tree_t *tree = NULL;
+    if(zrank_open(context, slot, key, &tree) < 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    //every removal goes to the slot batch, committed once at the end
+    int64_t removed = zlex_walk(context, slot, key, &range, 0, 0, 0, NULL, tree);
+    if(removed < 0){
+        zrank_destroy(tree);
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    zrank_flush(tree);
+    zrank_destroy(tree);
+    if(zset_incr_size(context, slot, key, -removed) != 0){
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return FDB_ERR;
+    }
+    *count = removed;
+    return FDB_OK;
+}
+
+
+//one source of a zset store read in member order, a packed one through its entries sorted by member
+struct zstream_t {
+    fdb_slice_t*                key_;           //seq prefixed once open
+    packed_t*                   packed_;
+    const packed_entry_t**      order_;
+    size_t                      pos_;
+    fdb_iterator_t*             iterator_;
+    int                         valid_;
+    fdb_view_t                  member_;        //the current member, until the stream moves on
+    double                      score_;
+};
+
+static void zstream_load(struct zstream_t* stream){
+    stream->valid_ = 0;
+    if(stream->packed_ != NULL){
+        if(stream->pos_ < packed_length(stream->packed_)){
+            stream->member_ = stream->order_[stream->pos_]->member_;
+            stream->score_ = stream->order_[stream->pos_]->score_;
+            stream->valid_ = 1;
+        }
+    }else if(stream->iterator_ != NULL && fdb_iterator_valid(stream->iterator_)){
+        size_t rklen = 0, rvlen = 0;
+        const char* rkey = fdb_iterator_key_raw(stream->iterator_, &rklen);
+        const char* rval = fdb_iterator_val_raw(stream->iterator_, &rvlen);
+        if(fdb_codec_decode_member_key(rkey, rklen, FDB_DATA_TYPE_ZSET, NULL, &stream->member_)==0 &&
+           rvlen == sizeof(uint64_t)){
+            stream->score_ = lex_to_double(rocksdb_decode_fixed64(rval));
+            stream->valid_ = 1;
+        }
+    }
+}
+
+static int zstream_open(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* name, struct zstream_t* stream){
+    memset(stream, 0, sizeof(struct zstream_t));
+    stream->key_ = fdb_slice_create(fdb_slice_data(name), fdb_slice_length(name));
+    int retval = packed_open(context, slot, stream->key_, FDB_DATA_TYPE_ZSET, 0, &stream->packed_);
+    if(retval == FDB_OK_NOT_EXIST){
+        return FDB_OK;
+    }
+    if(retval != FDB_OK){
+        return retval;
+    }
+    if(stream->packed_ != NULL){
+        size_t len = packed_length(stream->packed_);
+        stream->order_ = (const packed_entry_t**)fdb_malloc_in(fdb_arena_current(), (len > 0 ? len : 1) * sizeof(packed_entry_t*));
+        for(size_t i=0; i<len; ++i){
+            stream->order_[i] = packed_at(stream->packed_, i);
+        }
+        qsort(stream->order_, len, sizeof(packed_entry_t*), compare_zlex_entry);
+    }else{
+        //the member subkeys, which hold the scores, are already in member order
+        fdb_slice_t *key_start = NULL, *key_end = NULL;
+        encode_zset_key(fdb_slice_data(stream->key_), fdb_slice_length(stream->key_), NULL, 0, &key_start);
+        encode_zset_key(fdb_slice_data(stream->key_), fdb_slice_length(stream->key_), "\xff", strlen("\xff"), &key_end);
+        stream->iterator_ = fdb_iterator_create(context, slot, key_start, key_end, INT32_MAX, FORWARD);
+        fdb_slice_destroy(key_start);
+        fdb_slice_destroy(key_end);
+    }
+    zstream_load(stream);
+    return FDB_OK;
+}
+
+static void zstream_next(struct zstream_t* stream){
+    if(stream->packed_ != NULL){
+        stream->pos_ += 1;
+        zstream_load(stream);
+    }else if(stream->iterator_ != NULL && fdb_iterator_next(stream->iterator_) == 0){
+        zstream_load(stream);
+    }else{
+        stream->valid_ = 0;
+    }
+}
+
+static void zstream_close(struct zstream_t* stream){
+    fdb_iterator_destroy(stream->iterator_);
+    fdb_free_in(fdb_arena_current(), stream->order_);
+    packed_destroy(stream->packed_);
+    fdb_slice_destroy(stream->key_);
+}
+
+//score of a source times its weight, a nan such as inf times 0 taken as 0
+static double zweigh(double score, double weight){
+    double weighed = score * weight;
+    return isnan(weighed) ? 0.0 : weighed;
+}
+
+static double zaggregate(int aggregate, double acc, double score){
+    if(aggregate == FDB_ZSET_AGGREGATE_MIN){
+        return (score < acc) ? score : acc;
+    }
+    if(aggregate == FDB_ZSET_AGGREGATE_MAX){
+        return (score > acc) ? score : acc;
+    }
+    double sum = acc + score;
+    return isnan(sum) ? 0.0 : sum;
+}
+
+//the zset dest a store writes, packed while it fits, then the member subkeys and score index
+//committed every ZSTORE_BATCH_MEMBERS members under a fresh seq nothing reads yet, the main key
+//moved there along with the tree and size at the end
+struct zsink_t {
+    fdb_slice_t*        dest_;          //prefixed by the fresh seq
+    packed_t*           packed_;
+    int64_t             count_;
+    uint64_t            pending_;       //members in the batch since its last commit
+    uint64_t            committed_;     //members committed by the sink so far
+};
+
+static int zsink_commit(fdb_context_t* context, fdb_slot_t* slot, struct zsink_t* sink){
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(context, slot, &errptr);
+    if(errptr != NULL){
+        fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+        rocksdb_free(errptr);
+        return -1;
+    }
+    sink->committed_ += sink->pending_;
+    sink->pending_ = 0;
+    return 0;
+}
+
+static int zsink_push(fdb_context_t* context, fdb_slot_t* slot, struct zsink_t* sink, const fdb_view_t* member, double score){
+    sink->count_ += 1;
+    if(sink->packed_ != NULL){
+        packed_put(sink->packed_, member->data_, member->length_, NULL, 0, score);
+        if(packed_fits(context, sink->packed_)){
+            return 0;
+        }
+        for(size_t i=0; i<packed_length(sink->packed_); ++i){
+            const packed_entry_t *entry = packed_at(sink->packed_, i);
+            zput_one(slot, sink->dest_, entry->member_.data_, entry->member_.length_, entry->score_);
+        }
+        sink->pending_ += packed_length(sink->packed_);
+        packed_destroy(sink->packed_);
+        sink->packed_ = NULL;
+    }else{
+        zput_one(slot, sink->dest_, member->data_, member->length_, score);
+        sink->pending_ += 1;
+    }
+    return (sink->pending_ >= ZSTORE_BATCH_MEMBERS) ? zsink_commit(context, slot, sink) : 0;
+}
+
+//a dest in subkeys gets its rank tree loaded in one pass from the score index, so the members
+//still pending go in first, before the main key is moved to the fresh seq
+static int zsink_flush(fdb_context_t* context, fdb_slot_t* slot, struct zsink_t* sink){
+    if(sink->packed_ != NULL){
+        return 0;
+    }
+    if(sink->pending_ > 0 && zsink_commit(context, slot, sink) != 0){
+        return -1;
+    }
+    zrank_tree_t *tree = NULL;
+    if(zrank_open(context, slot, sink->dest_, &tree) < 0){
+        return -1;
+    }
+    zrank_destroy(tree);
+    return 0;
+}
+
+//the payload or size of dest once its main key is at the fresh seq, in the last batch
+static int zsink_finish(fdb_context_t* context, fdb_slot_t* slot, struct zsink_t* sink){
+    if(sink->packed_ != NULL){
+        return (packed_store(context, slot, sink->dest_, sink->packed_) == FDB_OK) ? 0 : -1;
+    }
+    return zset_incr_size(context, slot, sink->dest_, sink->count_);
+}
+
+//after a failed store the members already committed under the fresh seq go with the reclaim,
+//and the seq is not handed out again
+static void zsink_abandon(fdb_context_t* context, fdb_slot_t* slot, struct zsink_t* sink){
+    fdb_slot_writebatch_discard(context, slot);
+    if(sink->committed_ == 0){
+        return;
+    }
+    uint32_t seq = rocksdb_decode_fixed32(fdb_slice_data(sink->dest_));
+    fdb_slice_t *name = fdb_slice_create(fdb_slice_data(sink->dest_) + sizeof(uint32_t), fdb_slice_length(sink->dest_) - sizeof(uint32_t));
+    if(dels_mark(context, slot, name, seq) != 1 || zsink_commit(context, slot, sink) != 0){
+        fprintf(stderr, "%s dels_mark of the fresh seq fail.\n", __func__);
+        fdb_slot_writebatch_discard(context, slot);
+    }
+    fdb_slice_destroy(name);
+}
+
+//whether removing count of the size members of a zset in subkeys is cheaper by zset_rewrite_ends,
+//which writes the members kept rather than deletes the ones removed
+static int zrange_rewrites(uint64_t size, uint64_t count){
+    return count >= ZREWRITE_MIN_MEMBERS && count >= size - count;
+}
+
+//keeping only the head lowest and tail highest members of the zset in subkeys key, which are
+//written anew through a sink under a fresh seq before the key moves there in one last batch,
+//so a failed commit on the way leaves the zset as it was, the old seq with the members dropped
+//is left to the reclaim in the background, so the live key gets no deletes to step over
+static int zset_rewrite_ends(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, uint64_t head, uint64_t tail){
+    fdb_iterator_t *iterators[2] = {NULL, NULL};
+    uint64_t keeps[2] = {head, tail};
+    struct zsink_t sink;
+    memset(&sink, 0, sizeof(struct zsink_t));
+    uint32_t seq = 0;
+    if(keys_fresh_seq(context, slot, key, &seq) != FDB_OK){
+        return -1;
+    }
+    //the name behind the seq keys_exs put in front, under the fresh one
+    sink.dest_ = fdb_slice_create(fdb_slice_data(key) + sizeof(uint32_t), fdb_slice_length(key) - sizeof(uint32_t));
+    fdb_slice_uint32_push_front(sink.dest_, seq);
+    if(context->packed_entries_ > 0){
+        sink.packed_ = packed_create(FDB_DATA_TYPE_ZSET);
+    }
+    int ret = 0;
+    for(int end=0; ret == 0 && end<2; ++end){
+        if(keeps[end] > 0 && zget_range(context, slot, key, NULL, 0, keeps[end], end, &iterators[end]) < 0){
+            ret = -1;
+        }
+    }
+    for(int end=0; ret == 0 && end<2; ++end){
+        uint64_t taken = 0;
+        while(ret == 0 && taken < keeps[end] && fdb_iterator_valid(iterators[end])){
+            size_t len = 0;
+            const char* fdbkey = fdb_iterator_key_raw(iterators[end], &len);
+            fdb_view_t member;
+            double score = 0.0;
+            if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
+                ret = zsink_push(context, slot, &sink, &member, score);
+                ++taken;
+            }
+            if(fdb_iterator_next(iterators[end])){
+                break;
+            }
+        }
+    }
+    if(ret == 0 && (zsink_flush(context, slot, &sink) != 0 || keys_move_seq(context, slot, key, seq) != FDB_OK ||
+                    zsink_finish(context, slot, &sink) != 0 || zsink_commit(context, slot, &sink) != 0)){
+        ret = -1;
+    }
+    if(ret != 0){
+        zsink_abandon(context, slot, &sink);
+    }
+    fdb_iterator_destroy(iterators[0]);
+    fdb_iterator_destroy(iterators[1]);
+    packed_destroy(sink.packed_);
+    fdb_slice_destroy(sink.dest_);
+    return ret;
+}
+
+//the k-way merge of the sources in member order, a member taken when op wants it with the
+//weighted scores it has combined
+static int zset_merge(fdb_context_t* context, fdb_slot_t* slot, int op, size_t num, struct zstream_t* streams,
+                      const double* weights, int aggregate, struct zsink_t* sink){
+    while(1){
+        size_t min = num, valid = 0;
+        for(size_t i=0; i<num; ++i){
+            if(!streams[i].valid_){
+                continue;
+            }
+            ++valid;
+            if(min == num || compare_with_length(streams[i].member_.data_, streams[i].member_.length_,
+                                                 streams[min].member_.data_, streams[min].member_.length_) < 0){
+                min = i;
+            }
+        }
+        if(min == num || (op == ZSET_INTER && valid < num) || (op == ZSET_DIFF && !streams[0].valid_)){
+            return 0;
+        }
+        const fdb_view_t member = streams[min].member_;
+        size_t at = 0;
+        double score = 0.0;
+        for(size_t i=min; i<num; ++i){
+            if(!streams[i].valid_ || compare_with_length(streams[i].member_.data_, streams[i].member_.length_,
+                                                         member.data_, member.length_) != 0){
+                continue;
+            }
+            double weighed = zweigh(streams[i].score_, (weights != NULL) ? weights[i] : 1.0);
+            score = (at == 0) ? weighed : zaggregate(aggregate, score, weighed);
+            ++at;
+        }
+        int take = (op == ZSET_UNION) || (op == ZSET_INTER && at == num) || (op == ZSET_DIFF && min == 0 && at == 1);
+        if(take && zsink_push(context, slot, sink, &member, (op == ZSET_DIFF) ? streams[0].score_ : score) != 0){
+            return -1;
+        }
+        //member is a view into the min stream, the others move on before it does
+        for(size_t i=num; i-- > min;){
+            if(streams[i].valid_ && compare_with_length(streams[i].member_.data_, streams[i].member_.length_,
+                                                        member.data_, member.length_) == 0){
+                zstream_next(&streams[i]);
+            }
+        }
+    }
+}
+
+int zset_combine_store(fdb_context_t* context, fdb_slot_t* slot, int op, fdb_slice_t* dest, size_t num,
+                       fdb_slice_t* const* keys, const double* weights, int aggregate, int64_t* count){
+    if(num == 0){
+        return FDB_ERR_WRONG_NUMBER_ARGUMENTS;
+    }
+    fdb_arena_t *arena = fdb_arena_current();
+    struct zstream_t *streams = (struct zstream_t*)fdb_malloc_in(arena, num * sizeof(struct zstream_t));
+    struct zsink_t sink;
+    memset(&sink, 0, sizeof(struct zsink_t));
+    size_t opened = 0;
+    uint32_t seq = 0;
+    fdb_slice_t *name = NULL;
+    int retval = keys_renew_seq(context, slot, dest, &seq);
+    if(retval != FDB_OK){
+        goto end;
+    }
+    sink.dest_ = fdb_slice_create(fdb_slice_data(dest), fdb_slice_length(dest));
+    fdb_slice_uint32_push_front(sink.dest_, seq);
+    if(context->packed_entries_ > 0){
+        sink.packed_ = packed_create(FDB_DATA_TYPE_ZSET);
+    }
+    while(opened < num){
+        retval = zstream_open(context, slot, keys[opened], &streams[opened]);
+        ++opened;
+        if(retval != FDB_OK){
+            goto end;
+        }
+    }
+    if(zset_merge(context, slot, op, num, streams, weights, aggregate, &sink) != 0){
+        retval = FDB_ERR;
+        goto end;
+    }
+    if(sink.count_ == 0){
+        //an empty result leaves no dest behind
+        fdb_slot_writebatch_discard(context, slot);
+        int64_t deleted = 0;
+        retval = keys_del(context, slot, dest, &deleted);
+        goto end;
+    }
+    //dest is made anew only now, in the last batch, the sources it may be among were opened
+    //under its old seq and their iterators keep reading it as it was
+    name = fdb_slice_create(fdb_slice_data(dest), fdb_slice_length(dest));
+    if(zsink_flush(context, slot, &sink) != 0 || keys_renew_at(context, slot, name, FDB_DATA_TYPE_ZSET, seq) != FDB_OK ||
+       zsink_finish(context, slot, &sink) != 0 || zsink_commit(context, slot, &sink) != 0){
+        retval = FDB_ERR;
+    }
+    fdb_slice_destroy(name);
+
+end:
+    if(retval != FDB_OK && sink.dest_ != NULL){
+        zsink_abandon(context, slot, &sink);
+    }
+    for(size_t i=0; i<opened; ++i){
+        zstream_close(&streams[i]);
+    }
+    fdb_free_in(arena, streams);
+    packed_destroy(sink.packed_);
+    fdb_slice_destroy(sink.dest_);
+    if(retval == FDB_OK){
+        *count = sink.count_;
+    }
+    return retval;
+}
+
+
+int zset_pop(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int max, uint64_t count, fdb_array_t** rets){
+    packed_t *packed = NULL;
+    int retval = packed_open(context, slot, key, FDB_DATA_TYPE_ZSET, 0, &packed);
+    if(retval != FDB_OK){
+        return retval;
+    }
+    fdb_array_t *array = fdb_array_create(8);
+    if(packed != NULL){
+        uint64_t len = packed_length(packed);
+        uint64_t n = (count < len) ? count : len;
+        for(uint64_t i=0; i<n; ++i){
+            zpush_entry(array, packed_at(packed, max ? len - 1 - i : i));
+        }
+        for(uint64_t i=0; i<n; ++i){
+            packed_del_at(packed, max ? len - 1 - i : 0);
+        }
+        *rets = array;
+        if(n == 0){
+            packed_destroy(packed);
+            return FDB_OK;
+        }
+        return zset_commit_packed(context, slot, key, packed, -(int64_t)n);
+    }
+
+    //one seek of the score index at the end popped from, the members go with the scores it has
+    uint64_t length = 0;
+    int ret = zget_len(context, slot, key, NULL, &length);
+    if(ret != 1 && ret != 0){
+        fdb_array_destroy(array);
+        return FDB_ERR;
+    }
+    if(length == 0 || count == 0){
+        *rets = array;
+        return FDB_OK;
+    }
+    if(count > length){
+        count = length;
+    }
+    zrank_tree_t *tree = NULL;
+    fdb_iterator_t *ziterator = NULL;
+    if(zrank_open(context, slot, key, &tree) < 0 || zget_range(context, slot, key, tree, 0, count, max, &ziterator) < 0){
+        zrank_destroy(tree);
+        fdb_array_destroy(array);
+        fdb_slot_writebatch_discard(context, slot);
+        return FDB_ERR;
+    }
+    int64_t popped = 0;
+    ret = 0;
+    while(ret == 0 && (uint64_t)popped < count && fdb_iterator_valid(ziterator)){
+        size_t len = 0;
+        const char* fdbkey = fdb_iterator_key_raw(ziterator, &len);
+        fdb_view_t member;
+        double score = 0.0;
+        if(fdb_codec_decode_zscore_key(fdbkey, len, NULL, &member, &score)==0){
+            fdb_val_node_t *snode = fdb_val_node_create_in(fdb_arena_current());
+            snode->val_.dval_ = score;
+            fdb_array_push_back(array, snode);
+            fdb_val_node_t *mnode = fdb_val_node_create_in(fdb_arena_current());
+            mnode->val_.vval_ = fdb_slice_create(member.data_, member.length_);
+            fdb_array_push_back(array, mnode);
+            ret = (zdel_one(slot, key, member.data_, member.length_, score, tree) < 0) ? -1 : 0;
+            ++popped;
+        }
+        if(fdb_iterator_next(ziterator)){
+            break;
+        }
+    }
+    fdb_iterator_destroy(ziterator);
+    zrank_flush(tree);
+    zrank_destroy(tree);
+    if(ret == 0){
+        ret = zset_incr_size(context, slot, key, -popped);
+    }
+    char *errptr = NULL;
+    if(ret != 0){
+        fdb_slot_writebatch_discard(context, slot);
+    }else{
+        fdb_slot_writebatch_commit(context, slot, &errptr);
+    }
+    if(ret != 0 || errptr != NULL){
+        if(errptr != NULL){
+            fprintf(stderr, "%s fdb_slot_writebatch_commit fail %s.\n", __func__, errptr);
+            rocksdb_free(errptr);
+        }
+        for(size_t i=1; i<array->length_; i+=2){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(array, i)->val_.vval_));
+        }
+        fdb_array_destroy(array);
+        return FDB_ERR;
+    }
+    *rets = array;
+    return FDB_OK;
+}
+
+int zset_pop_park(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int max, fdb_array_t** rets, fdb_wait_t** pwait){
+    //the key as named, zset_pop leaves it prefixed by its seq
+    fdb_slice_t *name = fdb_slice_create(fdb_slice_data(key), fdb_slice_length(key));
+    *rets = NULL;
+    *pwait = NULL;
+    int retval = zset_pop(context, slot, key, max, 1, rets);
+    if(retval == FDB_OK_NOT_EXIST || (retval == FDB_OK && (*rets)->length_ == 0)){
+        if(*rets != NULL){
+            fdb_array_destroy(*rets);
+            *rets = NULL;
+        }
+        *pwait = fdb_waiter_park((fdb_waiter_t*)context->waiter_, slot->id_, fdb_slice_data(name), fdb_slice_length(name));
+        retval = FDB_OK_NOT_EXIST;
+    }
+    fdb_slice_destroy(name);
+    return retval;
 }
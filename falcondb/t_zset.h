@@ -5,6 +5,7 @@
 #include "fdb_slice.h"
 #include "fdb_context.h"
 #include "fdb_object.h"
+#include "fdb_waiter.h"
 
 
 void encode_zsize_key(const char* key, size_t keylen, fdb_slice_t** pslice);
@@ -13,34 +14,92 @@ int decode_zsize_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pslice)
 void encode_zset_key(const char* key, size_t keylen, const char* member, size_t memberlen, fdb_slice_t** pslice);
 int decode_zset_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t **pkey, fdb_slice_t **pmember);
 
-void encode_zscore_key(const char* key, size_t keylen, const char* member, size_t memberlen, int64_t score, fdb_slice_t** pslice);
+void encode_zscore_key(const char* key, size_t keylen, const char* member, size_t memberlen, double score, fdb_slice_t** pslice);
 int decode_zscore_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pmember, double* pscore);
 
 
 int zset_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, int64_t* count);
 
+//zset_add keeping at most cap members, the lowest scored trimmed, or the highest if trim_max,
+//in the same batch as the add, *trimmed the members trimmed, added ones among them
+int zset_add_capped(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* sms, uint64_t cap,
+                    int trim_max, int64_t* count, int64_t* trimmed);
+
+//a sliding window of now and the window before it, as a rate limiter keeps one, the members
+//scored at or below now - window are removed, member is added at now, the key expires ttl ms
+//on, ttl 0 leaving its expiry as is, all in one batch, *count is the members left
+int zset_window_add(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double now,
+                    double window, int64_t ttl, int64_t* count);
+
+//up to count members off the lowest scored end, or the highest if max, score and member nodes in
+//the order popped, one seek of the score index and one batch
+int zset_pop(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int max, uint64_t count, fdb_array_t** rets);
+
+//zset_pop of one member, or with nothing to pop FDB_OK_NOT_EXIST and *pwait parked on key until
+//a zset_add into it, to be waited on by fdb_waiter_wait once the caller let go of its lock on key
+int zset_pop_park(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int max, fdb_array_t** rets, fdb_wait_t** pwait);
+
 int zset_rem(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, int64_t* count);
 
 int zset_size(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int64_t* size);
 
 int zset_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double *pscore);
 
+//zset_score of every member, one node each with dval_ and FDB_OK or FDB_OK_NOT_EXIST, looked up together
+int zset_mscore(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_array_t* members, fdb_array_t** rets);
+
 int zset_incr(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, double init, double by, double* pscore);
 
 int zset_rank(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* member, int reverse, int64_t* rank);
 
 int zset_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, uint8_t type, int64_t* count);
 
-int zset_lex_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end, uint8_t type);
+//members from slice_start to slice_end in member order, either bound left out as type opens it,
+//0x04 leaving slice_start unbounded and 0x08 slice_end, as "-" and "+" do
+int zset_lex_count(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                   uint8_t type, int64_t* count);
 
 int zset_range(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int rank_start, int rank_end, int reverse, fdb_array_t** rets);
 
 int zset_scan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, int reverse, uint8_t type, fdb_array_t** rets);
 
+//the members of zset_lex_count, slice_start the upper bound when reverse, offset of them skipped
+//and at most count returned, count 0 for all, score and member nodes
+int zset_range_by_lex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                      uint8_t type, int reverse, uint64_t offset, uint64_t count, fdb_array_t** rets);
+
+//members scored from score_start to score_end, score_start the upper bound when reverse, either
+//bound left out as type opens it, offset of them skipped and at most count returned, count 0
+//for all, score and member nodes, *pcursor resumes the range right past the last one returned,
+//or is NULL once the range is done, a cursor given takes the place of offset
+int zset_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end,
+                        uint8_t type, int reverse, uint64_t offset, uint64_t count, fdb_slice_t* cursor,
+                        fdb_array_t** rets, fdb_slice_t** pcursor);
+
+//a chunk of the zset past the member cursor, in member order, as hash_hscan has it, score and
+//member nodes
+int zset_zscan(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* cursor, fdb_slice_t* pattern,
+               uint64_t count, fdb_array_t** rets, fdb_slice_t** pcursor);
+
 int zset_rem_range_by_rank(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, int rank_start, int rank_end, int64_t* count);
 
 int zset_rem_range_by_score(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, double score_start, double score_end, uint8_t type, int64_t* count);
 
-int zset_rem_range_by_lex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end, uint8_t type, int64_t* count);
+int zset_rem_range_by_lex(fdb_context_t* context, fdb_slot_t* slot, fdb_slice_t* key, fdb_slice_t* slice_start, fdb_slice_t* slice_end,
+                          uint8_t type, int64_t* count);
+
+enum {
+    ZSET_INTER = 0,
+    ZSET_UNION = 1,
+    ZSET_DIFF = 2
+};
+
+//the members in all num zsets for ZSET_INTER, in any for ZSET_UNION, in the first and none of
+//the others for ZSET_DIFF, written to the zset dest replacing whatever it held, scores times
+//weights, NULL for all 1, combined by aggregate, a difference keeps the scores of the first,
+//the sources are merged in member order and dest committed every few thousand members with its
+//rank tree built once at the end, an empty result removes dest, count is the members written
+int zset_combine_store(fdb_context_t* context, fdb_slot_t* slot, int op, fdb_slice_t* dest, size_t num,
+                       fdb_slice_t* const* keys, const double* weights, int aggregate, int64_t* count);
 
 #endif //FDB_T_ZSET_H
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <ctype.h>
 
 
 
@@ -98,3 +99,88 @@ int is_int64_overflow(int64_t val, int64_t by){
     return 0;
 }
 
+static int match_char(char a, char b, int nocase){
+    if(nocase){
+        a = (char)tolower((unsigned char)a);
+        b = (char)tolower((unsigned char)b);
+    }
+    return a == b;
+}
+
+int string_match_len(const char* pattern, size_t patternlen, const char* str, size_t stringlen, int nocase){
+    const char *p = pattern, *pend = pattern + patternlen;
+    const char *s = str, *send = str + stringlen;
+    //where to pick up again after the last star, if the rest does not match
+    const char *pstar = NULL, *sstar = NULL;
+    while(s < send){
+        if(p < pend && *p == '*'){
+            while(p < pend && *p == '*'){
+                ++p;
+            }
+            if(p == pend){
+                return 1;
+            }
+            pstar = p;
+            sstar = s;
+            continue;
+        }
+        int matched = 0;
+        const char *pnext = p + 1;
+        if(p < pend){
+            if(*p == '?'){
+                matched = 1;
+            }else if(*p == '[' && p + 1 < pend){
+                const char *q = p + 1;
+                int negate = 0;
+                if(*q == '^'){
+                    negate = 1;
+                    ++q;
+                }
+                int in = 0;
+                while(q < pend && *q != ']'){
+                    if(*q == '\\' && q + 1 < pend){
+                        ++q;
+                        if(match_char(*q, *s, nocase)) in = 1;
+                    }else if(q + 2 < pend && q[1] == '-' && q[2] != ']'){
+                        unsigned char lo = (unsigned char)q[0], hi = (unsigned char)q[2];
+                        unsigned char c = (unsigned char)*s;
+                        if(lo > hi){
+                            unsigned char t = lo; lo = hi; hi = t;
+                        }
+                        if(nocase){
+                            lo = (unsigned char)tolower(lo);
+                            hi = (unsigned char)tolower(hi);
+                            c = (unsigned char)tolower(c);
+                        }
+                        if(c >= lo && c <= hi) in = 1;
+                        q += 2;
+                    }else if(match_char(*q, *s, nocase)){
+                        in = 1;
+                    }
+                    ++q;
+                }
+                //an unclosed class runs to the end of the pattern
+                pnext = (q < pend) ? q + 1 : pend;
+                matched = negate ? !in : in;
+            }else if(*p == '\\' && p + 1 < pend){
+                pnext = p + 2;
+                matched = match_char(p[1], *s, nocase);
+            }else{
+                matched = match_char(*p, *s, nocase);
+            }
+        }
+        if(matched){
+            p = pnext;
+            ++s;
+        }else if(pstar != NULL){
+            p = pstar;
+            s = ++sstar;
+        }else{
+            return 0;
+        }
+    }
+    while(p < pend && *p == '*'){
+        ++p;
+    }
+    return p == pend;
+}
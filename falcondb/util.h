@@ -26,5 +26,8 @@ uint64_t double_to_lex(double v);
 double lex_to_double(uint64_t v);
 
 int is_int64_overflow(int64_t val, int64_t by); 
+
+//whether str matches the glob pattern, * ? [a-z] [^a] and \ escapes as redis has them
+int string_match_len(const char* pattern, size_t patternlen, const char* str, size_t stringlen, int nocase);
 #endif //FDB_UTIL_H
 
@@ -0,0 +1,237 @@
+#include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_cache.h>
+#include <falcondb/fdb_context.h>
+#include <falcondb/fdb_define.h>
+#include <falcondb/fdb_types.h>
+#include <falcondb/t_string.h>
+#include <falcondb/t_keys.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TEST_CACHE_THREADS  8
+#define TEST_CACHE_ROUNDS   2000
+
+static void test_cache_deleter(void* val){
+    fdb_slice_destroy(val);
+}
+
+void test_cache_basic(){
+    fdb_cache_t *cache = fdb_cache_create(1024*1024, 4, 3);
+
+    fdb_slice_t *val = fdb_slice_create("val", 3);
+    fdb_cache_insert(cache, 1, "key", 3, val, fdb_slice_length(val), test_cache_deleter);
+    assert(fdb_cache_lookup(cache, 2, "key", 3) == NULL);
+    fdb_slice_t *got = (fdb_slice_t*)fdb_cache_lookup(cache, 1, "key", 3);
+    assert(got == val);
+    fdb_slice_destroy(got);
+
+    //the cache keeps its own reference
+    fdb_slice_destroy(val);
+    got = (fdb_slice_t*)fdb_cache_lookup(cache, 1, "key", 3);
+    assert(got != NULL && memcmp(fdb_slice_data(got), "val", 3)==0);
+    fdb_slice_destroy(got);
+
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    fdb_cache_stats(cache, 1, &hits, &misses, &evictions);
+    assert(hits == 2 && misses == 0 && evictions == 0);
+    fdb_cache_stats(cache, 2, &hits, &misses, &evictions);
+    assert(hits == 0 && misses == 1 && evictions == 0);
+
+    //replacing, then dropping one id only
+    val = fdb_slice_create("new", 3);
+    fdb_cache_insert(cache, 1, "key", 3, val, fdb_slice_length(val), test_cache_deleter);
+    fdb_slice_destroy(val);
+    val = fdb_slice_create("two", 3);
+    fdb_cache_insert(cache, 2, "key", 3, val, fdb_slice_length(val), test_cache_deleter);
+    fdb_slice_destroy(val);
+    got = (fdb_slice_t*)fdb_cache_lookup(cache, 1, "key", 3);
+    assert(got != NULL && memcmp(fdb_slice_data(got), "new", 3)==0);
+    fdb_cache_erase_id(cache, 1);
+    //a reader holding the value keeps it alive
+    assert(memcmp(fdb_slice_data(got), "new", 3)==0);
+    fdb_slice_destroy(got);
+    assert(fdb_cache_lookup(cache, 1, "key", 3) == NULL);
+    got = (fdb_slice_t*)fdb_cache_lookup(cache, 2, "key", 3);
+    assert(got != NULL);
+    fdb_slice_destroy(got);
+
+    fdb_cache_erase(cache, 2, "key", 3);
+    assert(fdb_cache_lookup(cache, 2, "key", 3) == NULL);
+    assert(fdb_cache_usage(cache) == 0);
+    fdb_cache_destroy(cache);
+}
+
+void test_cache_eviction(){
+    //a single shard, so the budget is easy to reason about
+    size_t capacity = 64*1024;
+    fdb_cache_t *cache = fdb_cache_create(capacity, 1, 2);
+    char skey[64] = {0};
+    for(int i=0; i<10000; ++i){
+        sprintf(skey, "cache_key%d", i);
+        fdb_slice_t *val = fdb_slice_create(skey, strlen(skey));
+        fdb_cache_insert(cache, 1, skey, strlen(skey), val, 100, test_cache_deleter);
+        fdb_slice_destroy(val);
+        //key0 is looked up all the time, the clock keeps it
+        fdb_slice_t *got = (fdb_slice_t*)fdb_cache_lookup(cache, 1, "cache_key0", strlen("cache_key0"));
+        assert(got != NULL);
+        fdb_slice_destroy(got);
+        assert(fdb_cache_usage(cache) <= capacity);
+    }
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    fdb_cache_stats(cache, 1, &hits, &misses, &evictions);
+    assert(evictions > 0);
+    assert(fdb_cache_lookup(cache, 1, "cache_key1", strlen("cache_key1")) == NULL);
+
+    //shrinking evicts down to the new budget at once
+    fdb_cache_set_capacity(cache, capacity / 4);
+    assert(fdb_cache_usage(cache) <= capacity / 4);
+    fdb_cache_set_capacity(cache, capacity);
+
+    //bigger than the shard, not cached at all
+    fdb_slice_t *val = fdb_slice_create("big", 3);
+    fdb_cache_insert(cache, 1, "big", 3, val, capacity, test_cache_deleter);
+    fdb_slice_destroy(val);
+    assert(fdb_cache_lookup(cache, 1, "big", 3) == NULL);
+    fdb_cache_destroy(cache);
+}
+
+struct test_cache_arg_t{
+    fdb_context_t*  ctx_;
+    fdb_slot_t*     slot_;
+};
+
+//readers race a writer on the same key, every value read must be one that was written
+void* test_cache_reader(void* arg){
+    struct test_cache_arg_t *targ = (struct test_cache_arg_t*)arg;
+    for(int i=0; i<TEST_CACHE_ROUNDS; ++i){
+        fdb_slice_t *key = fdb_slice_create("cache_hot", strlen("cache_hot"));
+        fdb_slice_t *val = NULL;
+        assert(string_get(targ->ctx_, targ->slot_, key, &val) == FDB_OK);
+        assert(fdb_slice_length(val) == 8 && memcmp(fdb_slice_data(val), "hot_", 4)==0);
+        fdb_slice_destroy(val);
+        fdb_slice_destroy(key);
+    }
+    return NULL;
+}
+
+void* test_cache_writer(void* arg){
+    struct test_cache_arg_t *targ = (struct test_cache_arg_t*)arg;
+    char sval[64] = {0};
+    for(int i=0; i<TEST_CACHE_ROUNDS; ++i){
+        sprintf(sval, "hot_%04d", i % 10000);
+        fdb_slice_t *key = fdb_slice_create("cache_hot", strlen("cache_hot"));
+        fdb_slice_t *val = fdb_slice_create(sval, strlen(sval));
+        assert(string_set(targ->ctx_, targ->slot_, key, val) == FDB_OK);
+        fdb_slice_destroy(val);
+        fdb_slice_destroy(key);
+    }
+    return NULL;
+}
+
+void test_cache_context(){
+    fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_cache", 128, 128, 2);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+
+    fdb_slice_t *key = fdb_slice_create("cache_hot", strlen("cache_hot"));
+    fdb_slice_t *val = fdb_slice_create("hot_init", strlen("hot_init"));
+    assert(string_set(ctx, slots[1], key, val) == FDB_OK);
+    fdb_slice_destroy(val);
+    fdb_slice_destroy(key);
+
+    struct test_cache_arg_t arg;
+    arg.ctx_ = ctx;
+    arg.slot_ = slots[1];
+    pthread_t threads[TEST_CACHE_THREADS];
+    for(int i=0; i<TEST_CACHE_THREADS; ++i){
+        assert(pthread_create(&threads[i], NULL, i==0 ? test_cache_writer : test_cache_reader, &arg) == 0);
+    }
+    for(int i=0; i<TEST_CACHE_THREADS; ++i){
+        pthread_join(threads[i], NULL);
+    }
+
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    fdb_context_keys_cache_stats(ctx, slots[1], &hits, &misses, &evictions);
+    assert(hits > 0);
+    fdb_context_keys_cache_stats(ctx, slots[2], &hits, &misses, &evictions);
+    assert(hits == 0 && evictions == 0);
+
+    //dropping the slot drops its cached keys
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+    key = fdb_slice_create("cache_hot", strlen("cache_hot"));
+    val = NULL;
+    assert(string_get(ctx, slots[1], key, &val) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(key);
+
+    fdb_context_destroy(ctx);
+}
+
+void test_cache_string_get(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int retval){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t *val = NULL;
+    assert(string_get(ctx, slot, key, &val) == retval);
+    if(val != NULL) fdb_slice_destroy(val);
+    fdb_slice_destroy(key);
+}
+
+void test_cache_absent(){
+    fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_cache", 128, 128, 2);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+
+    //the first miss reads the db, the rest are answered by the cache
+    uint64_t hits = 0, fills = 0;
+    fdb_context_keys_absent_stats(ctx, slots[1], &hits, &fills);
+    test_cache_string_get(ctx, slots[1], "cache_absent", FDB_OK_NOT_EXIST);
+    test_cache_string_get(ctx, slots[1], "cache_absent", FDB_OK_NOT_EXIST);
+    test_cache_string_get(ctx, slots[1], "cache_absent", FDB_OK_NOT_EXIST);
+    uint64_t hits2 = 0, fills2 = 0;
+    fdb_context_keys_absent_stats(ctx, slots[1], &hits2, &fills2);
+    assert(fills2 == fills + 1 && hits2 == hits + 2);
+
+    //a write replaces the absent entry
+    fdb_slice_t *key = fdb_slice_create("cache_absent", strlen("cache_absent"));
+    fdb_slice_t *val = fdb_slice_create("v", 1);
+    assert(string_setnx(ctx, slots[1], key, val) == FDB_OK);
+    assert(string_setnx(ctx, slots[1], key, val) == FDB_OK_BUT_ALREADY_EXIST);
+    test_cache_string_get(ctx, slots[1], "cache_absent", FDB_OK);
+
+    //a delete makes it absent again without another read
+    int64_t count = 0;
+    assert(keys_del(ctx, slots[1], key, &count) == FDB_OK && count == 1);
+    fdb_context_keys_absent_stats(ctx, slots[1], &hits, &fills);
+    test_cache_string_get(ctx, slots[1], "cache_absent", FDB_OK_NOT_EXIST);
+    fdb_context_keys_absent_stats(ctx, slots[1], &hits2, &fills2);
+    assert(fills2 == fills && hits2 == hits + 1);
+    fdb_slice_destroy(val);
+    fdb_slice_destroy(key);
+
+    //collections too
+    key = fdb_slice_create("cache_absent_hash", strlen("cache_absent_hash"));
+    assert(keys_exs(ctx, slots[1], key, FDB_DATA_TYPE_HASH) == FDB_OK_NOT_EXIST);
+    assert(keys_enc(ctx, slots[1], key, FDB_DATA_TYPE_HASH) == FDB_OK);
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(ctx, slots[1], &errptr);
+    assert(errptr == NULL);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("cache_absent_hash", strlen("cache_absent_hash"));
+    assert(keys_exs(ctx, slots[1], key, FDB_DATA_TYPE_HASH) == FDB_OK);
+    fdb_slice_destroy(key);
+
+    fdb_context_destroy(ctx);
+}
+
+int main(int argc, char* argv[]){
+    test_cache_basic();
+    test_cache_eviction();
+    test_cache_context();
+    test_cache_absent();
+    return 0;
+}
@@ -0,0 +1,375 @@
+#include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_bytes.h>
+#include <falcondb/fdb_codec.h>
+#include <falcondb/fdb_define.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/t_hash.h>
+#include <falcondb/t_zset.h>
+#include <falcondb/util.h>
+#include <deps/rocksdb-4.2/include/rocksdb/c.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_CODEC_ROUNDS   200000
+
+//the slice based codecs as they were, kept to compare against
+static fdb_slice_t* legacy_encode_keys_key(const char* key, size_t keylen){
+    fdb_slice_t* slice = fdb_slice_create(key, keylen);
+    fdb_slice_uint8_push_front(slice, '+');
+    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_KEYS);
+    return slice;
+}
+
+static fdb_slice_t* legacy_encode_ttl_key(const char* key, size_t keylen, int64_t ts){
+    fdb_slice_t* slice = fdb_slice_create(key, keylen);
+    fdb_slice_uint64_push_front(slice, big_endian_uint64((uint64_t)ts));
+    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_TTL);
+    return slice;
+}
+
+static fdb_slice_t* legacy_encode_hash_key(const char* key, size_t keylen, const char* field, size_t fieldlen){
+    fdb_slice_t *slice = fdb_slice_create(key, keylen);
+    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
+    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_HASH);
+    fdb_slice_uint8_push_back(slice, '=');
+    fdb_slice_string_push_back(slice, field, fieldlen);
+    return slice;
+}
+
+static fdb_slice_t* legacy_encode_zscore_key(const char* key, size_t keylen, const char* member, size_t memberlen, double score){
+    fdb_slice_t *slice = fdb_slice_create(key, keylen);
+    fdb_slice_uint8_push_front(slice, (uint8_t)keylen);
+    fdb_slice_uint8_push_front(slice, FDB_DATA_TYPE_ZSCORE);
+    fdb_slice_uint64_push_back(slice, double_to_lex(score));
+    fdb_slice_uint8_push_back(slice, '=');
+    fdb_slice_string_push_back(slice, member, memberlen);
+    return slice;
+}
+
+static fdb_slice_t* legacy_encode_keys_val(uint8_t type, uint8_t stat, uint32_t seq, int64_t ts, const char* payload, size_t len){
+    char buf[sizeof(uint8_t)] = {0};
+    rocksdb_encode_fixed8(buf, type);
+    fdb_slice_t *slice = fdb_slice_create(buf, sizeof(uint8_t));
+    fdb_slice_uint8_push_back(slice, stat);
+    fdb_slice_uint32_push_back(slice, seq);
+    fdb_slice_uint64_push_back(slice, ts);
+    fdb_slice_string_push_back(slice, payload, len);
+    return slice;
+}
+
+static int legacy_decode_zscore_key(const char* fdbkey, size_t fdbkeylen, fdb_slice_t** pkey, fdb_slice_t** pmember, double* pscore){
+    int ret = -1;
+    uint8_t type = 0;
+    uint64_t lex_score = 0;
+    fdb_slice_t *key = NULL, *member = NULL;
+    fdb_bytes_t *bytes = fdb_bytes_create(fdbkey, fdbkeylen);
+    if(fdb_bytes_read_uint8(bytes, &type)!=-1 &&
+       fdb_bytes_read_slice_len_uint8(bytes, &key)!=-1 &&
+       fdb_bytes_read_uint64(bytes, &lex_score)!=-1 &&
+       fdb_bytes_skip(bytes, 1)!=-1 &&
+       fdb_bytes_read_slice_len_left(bytes, &member)!=-1){
+        *pkey = key;
+        *pmember = member;
+        *pscore = lex_to_double(lex_score);
+        ret = 0;
+    }
+    fdb_bytes_destroy(bytes);
+    return ret;
+}
+
+static int legacy_decode_keys_val(const char* val, size_t vallen, uint8_t* type, uint8_t* stat, uint32_t* seq,
+                                  int64_t* ts, fdb_slice_t** payload){
+    int ret = -1;
+    fdb_bytes_t *bytes = fdb_bytes_create(val, vallen);
+    if(fdb_bytes_read_uint8(bytes, type)!=-1 &&
+       fdb_bytes_read_uint8(bytes, stat)!=-1 &&
+       fdb_bytes_read_uint32(bytes, seq)!=-1 &&
+       fdb_bytes_read_int64(bytes, ts)!=-1 &&
+       fdb_bytes_read_slice_len_left(bytes, payload)!=-1){
+        ret = 0;
+    }
+    fdb_bytes_destroy(bytes);
+    return ret;
+}
+
+static double time_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char* name, double before, double after){
+    fprintf(stdout, "%-12s before %8.1f ns/op  after %8.1f ns/op\n", name,
+            before / TEST_CODEC_ROUNDS, after / TEST_CODEC_ROUNDS);
+}
+
+static void assert_same(fdb_slice_t* slice, const char* buf, size_t len){
+    assert(fdb_slice_length(slice) == len);
+    assert(memcmp(fdb_slice_data(slice), buf, len) == 0);
+}
+
+void test_codec_roundtrip(){
+    const char *key = "codec_key", *member = "codec_member";
+    size_t keylen = strlen(key), memberlen = strlen(member);
+    char buf[FDB_CODEC_STACK_SIZE];
+    fdb_view_t vkey, vmember;
+
+    //the same bytes as the slice codecs
+    size_t len = fdb_codec_encode_keys_key(buf, key, keylen);
+    assert(len == fdb_codec_keys_key_size(keylen));
+    fdb_slice_t *slice = legacy_encode_keys_key(key, keylen);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    assert(fdb_codec_decode_keys_key(buf, len, &vkey) == 0);
+    assert(vkey.length_ == keylen && memcmp(vkey.data_, key, keylen) == 0);
+    assert(fdb_codec_decode_dels_key(buf, len, &vkey) == -1);
+
+    len = fdb_codec_encode_ttl_key(buf, key, keylen, 1234567);
+    assert(len == fdb_codec_ttl_key_size(keylen));
+    slice = legacy_encode_ttl_key(key, keylen, 1234567);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    int64_t ts = 0;
+    assert(fdb_codec_decode_ttl_key(buf, len, &ts, &vkey) == 0);
+    assert(ts == 1234567 && vkey.length_ == keylen);
+
+    len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_HASH, key, keylen, member, memberlen);
+    assert(len == fdb_codec_member_key_size(keylen, memberlen));
+    slice = legacy_encode_hash_key(key, keylen, member, memberlen);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    encode_hash_key(key, keylen, member, memberlen, &slice);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    assert(fdb_codec_decode_member_key(buf, len, FDB_DATA_TYPE_HASH, &vkey, &vmember) == 0);
+    assert(vkey.length_ == keylen && memcmp(vkey.data_, key, keylen) == 0);
+    assert(vmember.length_ == memberlen && memcmp(vmember.data_, member, memberlen) == 0);
+    assert(fdb_codec_decode_member_key(buf, len, FDB_DATA_TYPE_SET, &vkey, &vmember) == -1);
+    //a key length pointing past the end
+    assert(fdb_codec_decode_member_key(buf, 2 + keylen, FDB_DATA_TYPE_HASH, &vkey, &vmember) == -1);
+
+    len = fdb_codec_encode_zscore_key(buf, key, keylen, member, memberlen, -3.5);
+    assert(len == fdb_codec_zscore_key_size(keylen, memberlen));
+    slice = legacy_encode_zscore_key(key, keylen, member, memberlen, -3.5);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    double score = 0.0;
+    assert(fdb_codec_decode_zscore_key(buf, len, &vkey, &vmember, &score) == 0);
+    assert(score == -3.5 && vmember.length_ == memberlen && memcmp(vmember.data_, member, memberlen) == 0);
+
+    //the zset member key reads back right, the old decoder skipped one byte too many
+    len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_ZSET, key, keylen, member, memberlen);
+    fdb_slice_t *skey = NULL, *smember = NULL;
+    assert(decode_zset_key(buf, len, &skey, &smember) == 0);
+    assert_same(skey, key, keylen);
+    assert_same(smember, member, memberlen);
+    fdb_slice_destroy(skey);
+    fdb_slice_destroy(smember);
+
+    len = fdb_codec_encode_size_key(buf, FDB_DATA_TYPE_ZSIZE, key, keylen);
+    assert(len == fdb_codec_size_key_size(keylen));
+    assert(fdb_codec_decode_size_key(buf, len, FDB_DATA_TYPE_ZSIZE, &vkey) == 0);
+    assert(vkey.length_ == keylen);
+    assert(decode_zsize_key(buf, len, &skey) == 0);
+    assert_same(skey, key, keylen);
+    fdb_slice_destroy(skey);
+
+    len = fdb_codec_encode_keys_val(buf, FDB_DATA_TYPE_STRING, FDB_KEY_STAT_NORMAL, 7, -1, "payload", 7);
+    assert(len == fdb_codec_keys_val_size(7));
+    slice = legacy_encode_keys_val(FDB_DATA_TYPE_STRING, FDB_KEY_STAT_NORMAL, 7, -1, "payload", 7);
+    assert_same(slice, buf, len);
+    fdb_slice_destroy(slice);
+    uint8_t type = 0, stat = 1;
+    uint32_t seq = 0;
+    fdb_view_t payload;
+    assert(fdb_codec_decode_keys_val(buf, len, &type, &stat, &seq, &ts, &payload) == 0);
+    assert(type == FDB_DATA_TYPE_STRING && stat == FDB_KEY_STAT_NORMAL && seq == 7 && ts == -1);
+    assert(payload.length_ == 7 && memcmp(payload.data_, "payload", 7) == 0);
+    assert(fdb_codec_decode_keys_val(buf, 5, &type, &stat, &seq, &ts, &payload) == -1);
+
+    //subkeys of one collection share their prefix, other keys have none
+    len = fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_HASH, key, keylen, member, memberlen);
+    assert(fdb_codec_subkey_prefix_size(buf, len) == 2 + keylen);
+    assert(fdb_codec_subkey_prefix_size(buf, 2 + keylen) == 2 + keylen);
+    assert(fdb_codec_subkey_prefix_size(buf, 1 + keylen) == 0);
+    len = fdb_codec_encode_zscore_key(buf, key, keylen, member, memberlen, 1.0);
+    assert(fdb_codec_subkey_prefix_size(buf, len) == 2 + keylen);
+    len = fdb_codec_encode_zrank_key(buf, key, keylen, 0);
+    assert(fdb_codec_subkey_prefix_size(buf, len) == 2 + keylen);
+    len = fdb_codec_encode_keys_key(buf, key, keylen);
+    assert(fdb_codec_subkey_prefix_size(buf, len) == 0);
+    len = fdb_codec_encode_size_key(buf, FDB_DATA_TYPE_HSIZE, key, keylen);
+    assert(fdb_codec_subkey_prefix_size(buf, len) == 0);
+
+    //varints of the packed payloads, a truncated one is rejected
+    uint32_t varints[] = {0, 1, 127, 128, 300, 16383, 16384, 0xffffffff};
+    for(size_t i=0; i<sizeof(varints)/sizeof(varints[0]); ++i){
+        len = fdb_codec_encode_varint32(buf, varints[i]);
+        assert(len == fdb_codec_varint32_size(varints[i]));
+        const char *p = buf;
+        uint32_t v = 0;
+        assert(fdb_codec_decode_varint32(&p, buf + len, &v) == 0);
+        assert(v == varints[i] && p == buf + len);
+        p = buf;
+        assert(len == 1 || fdb_codec_decode_varint32(&p, buf + len - 1, &v) == -1);
+    }
+
+    //the count of a collection in subkeys is told from a packed payload
+    uint64_t count = 0;
+    len = fdb_codec_encode_subkeys_payload(buf, 12345);
+    assert(len == fdb_codec_subkeys_payload_size());
+    assert(fdb_codec_decode_subkeys_payload(buf, len, &count) == 0 && count == 12345);
+    len = fdb_codec_encode_varint32(buf, 0);
+    assert(fdb_codec_decode_subkeys_payload(buf, len, &count) == -1);
+    assert(fdb_codec_decode_subkeys_payload(NULL, 0, &count) == -1);
+
+    //past the stack, the buffer comes from the heap
+    char big[FDB_CODEC_STACK_SIZE * 2];
+    memset(big, 'b', sizeof(big));
+    char stack[FDB_CODEC_STACK_SIZE];
+    char *heap = fdb_codec_buf(stack, fdb_codec_keys_val_size(sizeof(big)));
+    assert(heap != stack);
+    len = fdb_codec_encode_keys_val(heap, FDB_DATA_TYPE_STRING, 0, 1, 0, big, sizeof(big));
+    assert(fdb_codec_decode_keys_val(heap, len, &type, &stat, &seq, &ts, &payload) == 0);
+    assert(payload.length_ == sizeof(big));
+    fdb_codec_buf_free(stack, heap);
+}
+
+//ns/op of the slice codecs against the buffer ones, for each kind of key
+void test_codec_bench(){
+    const char *key = "bench_user:1000042", *member = "bench_field_name";
+    size_t keylen = strlen(key), memberlen = strlen(member);
+    size_t sink = 0;
+    double start = 0, before = 0, after = 0;
+
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *slice = legacy_encode_keys_key(key, keylen);
+        sink += fdb_slice_length(slice);
+        fdb_slice_destroy(slice);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        char buf[FDB_CODEC_STACK_SIZE];
+        sink += fdb_codec_encode_keys_key(buf, key, keylen);
+    }
+    after = time_ns() - start;
+    report("keys", before, after);
+
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *slice = legacy_encode_ttl_key(key, keylen, i);
+        sink += fdb_slice_length(slice);
+        fdb_slice_destroy(slice);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        char buf[FDB_CODEC_STACK_SIZE];
+        sink += fdb_codec_encode_ttl_key(buf, key, keylen, i);
+    }
+    after = time_ns() - start;
+    report("ttl", before, after);
+
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *slice = legacy_encode_hash_key(key, keylen, member, memberlen);
+        sink += fdb_slice_length(slice);
+        fdb_slice_destroy(slice);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        char buf[FDB_CODEC_STACK_SIZE];
+        sink += fdb_codec_encode_member_key(buf, FDB_DATA_TYPE_HASH, key, keylen, member, memberlen);
+    }
+    after = time_ns() - start;
+    report("hash", before, after);
+
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *slice = legacy_encode_zscore_key(key, keylen, member, memberlen, i);
+        sink += fdb_slice_length(slice);
+        fdb_slice_destroy(slice);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        char buf[FDB_CODEC_STACK_SIZE];
+        sink += fdb_codec_encode_zscore_key(buf, key, keylen, member, memberlen, i);
+    }
+    after = time_ns() - start;
+    report("zscore", before, after);
+
+    char zbuf[FDB_CODEC_STACK_SIZE];
+    size_t zlen = fdb_codec_encode_zscore_key(zbuf, key, keylen, member, memberlen, 1.5);
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *skey = NULL, *smember = NULL;
+        double score = 0;
+        legacy_decode_zscore_key(zbuf, zlen, &skey, &smember, &score);
+        sink += fdb_slice_length(smember);
+        fdb_slice_destroy(skey);
+        fdb_slice_destroy(smember);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_view_t vkey, vmember;
+        double score = 0;
+        fdb_codec_decode_zscore_key(zbuf, zlen, &vkey, &vmember, &score);
+        sink += vmember.length_;
+    }
+    after = time_ns() - start;
+    report("zscore_dec", before, after);
+
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        fdb_slice_t *slice = legacy_encode_keys_val(FDB_DATA_TYPE_STRING, 0, i, 0, member, memberlen);
+        sink += fdb_slice_length(slice);
+        fdb_slice_destroy(slice);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        char buf[FDB_CODEC_STACK_SIZE];
+        sink += fdb_codec_encode_keys_val(buf, FDB_DATA_TYPE_STRING, 0, i, 0, member, memberlen);
+    }
+    after = time_ns() - start;
+    report("keys_val", before, after);
+
+    char vbuf[FDB_CODEC_STACK_SIZE];
+    size_t vlen = fdb_codec_encode_keys_val(vbuf, FDB_DATA_TYPE_HASH, 0, 3, 0, NULL, 0);
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        uint8_t type = 0, stat = 0;
+        uint32_t seq = 0;
+        int64_t ts = 0;
+        fdb_slice_t *payload = NULL;
+        legacy_decode_keys_val(vbuf, vlen, &type, &stat, &seq, &ts, &payload);
+        sink += seq;
+        fdb_slice_destroy(payload);
+    }
+    before = time_ns() - start;
+    start = time_ns();
+    for(int i=0; i<TEST_CODEC_ROUNDS; ++i){
+        uint8_t type = 0, stat = 0;
+        uint32_t seq = 0;
+        int64_t ts = 0;
+        fdb_codec_decode_keys_val(vbuf, vlen, &type, &stat, &seq, &ts, NULL);
+        sink += seq;
+    }
+    after = time_ns() - start;
+    report("keys_val_dec", before, after);
+
+    assert(sink > 0);
+}
+
+int main(int argc, char* argv[]){
+    test_codec_roundtrip();
+    test_codec_bench();
+    return 0;
+}
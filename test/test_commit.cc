@@ -0,0 +1,201 @@
+#include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_context.h>
+#include <falcondb/fdb_define.h>
+#include <falcondb/fdb_types.h>
+#include <falcondb/t_hash.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define TEST_COMMIT_THREADS  8
+#define TEST_COMMIT_FIELDS   200
+
+struct test_commit_arg_t{
+    fdb_context_t*  ctx_;
+    fdb_slot_t*     slot_;
+    int             id_;
+};
+
+//every thread fills a hash of its own, all in the same slot
+void* test_commit_main(void* arg){
+    struct test_commit_arg_t *targ = (struct test_commit_arg_t*)arg;
+    char skey[64] = {0}, sfield[64] = {0};
+    sprintf(skey, "commit_key%d", targ->id_);
+    for(int i=0; i<TEST_COMMIT_FIELDS; ++i){
+        sprintf(sfield, "commit_fld%d", i);
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_slice_t *field = fdb_slice_create(sfield, strlen(sfield));
+        fdb_slice_t *value = fdb_slice_create(sfield, strlen(sfield));
+        int64_t count = -1;
+        assert(hash_set(targ->ctx_, targ->slot_, key, field, value, &count) == FDB_OK);
+        assert(count == 1);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(field);
+        fdb_slice_destroy(value);
+    }
+    return NULL;
+}
+
+void test_commit_hash_set(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* sfield){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t *field = fdb_slice_create(sfield, strlen(sfield));
+    fdb_slice_t *value = fdb_slice_create(sfield, strlen(sfield));
+    int64_t count = -1;
+    assert(hash_set(ctx, slot, key, field, value, &count) == FDB_OK);
+    fdb_slice_destroy(key);
+    fdb_slice_destroy(field);
+    fdb_slice_destroy(value);
+}
+
+void test_commit_hash_length(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int64_t length){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    int64_t len = -1;
+    assert(hash_length(ctx, slot, key, &len) == FDB_OK);
+    assert(len == length);
+    fdb_slice_destroy(key);
+}
+
+int main(int argc, char* argv[]){
+    fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_commit", 128, 128, 2);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+
+    uint64_t groups = 0, batches = 0, bytes = 0, latency_us = 0, depth = 0, depth_max = 0;
+    fdb_context_commit_stats(ctx, &groups, &batches, &bytes, &latency_us, &depth, &depth_max);
+    assert(groups == 0 && batches == 0 && depth == 0);
+
+    //concurrent commands in one slot no longer flush each other's half-built batches
+    pthread_t threads[TEST_COMMIT_THREADS];
+    struct test_commit_arg_t args[TEST_COMMIT_THREADS];
+    for(int i=0; i<TEST_COMMIT_THREADS; ++i){
+        args[i].ctx_ = ctx;
+        args[i].slot_ = slots[1];
+        args[i].id_ = i;
+        assert(pthread_create(&threads[i], NULL, test_commit_main, &args[i]) == 0);
+    }
+    for(int i=0; i<TEST_COMMIT_THREADS; ++i){
+        pthread_join(threads[i], NULL);
+    }
+    for(int i=0; i<TEST_COMMIT_THREADS; ++i){
+        char skey[64] = {0};
+        sprintf(skey, "commit_key%d", i);
+        test_commit_hash_length(ctx, slots[1], skey, TEST_COMMIT_FIELDS);
+    }
+
+    //one batch per command, some of them written together
+    fdb_context_commit_stats(ctx, &groups, &batches, &bytes, &latency_us, &depth, &depth_max);
+    assert(batches == TEST_COMMIT_THREADS * TEST_COMMIT_FIELDS);
+    assert(groups > 0 && groups <= batches);
+    assert(bytes > 0);
+    assert(depth == 0);
+    assert(depth_max >= 1 && depth_max <= TEST_COMMIT_THREADS);
+    fprintf(stdout, "groups %lu batches %lu bytes %lu latency_us %lu depth_max %lu\n",
+            groups, batches, bytes, latency_us, depth_max);
+
+    //a discarded batch leaves nothing behind, not even in the keys cache
+    fdb_slot_writebatch_put(slots[1], "k+commit_key0", strlen("k+commit_key0"), "x", 1);
+    fdb_slot_writebatch_discard(ctx, slots[1]);
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(ctx, slots[1], &errptr);
+    assert(errptr == NULL);
+    test_commit_hash_length(ctx, slots[1], "commit_key0", TEST_COMMIT_FIELDS);
+
+    //reads through the batch see its last put or delete of a key, of that slot only
+    char bkey[32], bval[300];
+    memset(bval, 'v', sizeof(bval));
+    for(int i=0; i<5000; ++i){
+        size_t bklen = sprintf(bkey, "b+commit_%d", i);
+        fdb_slot_writebatch_put(slots[1], bkey, bklen, bval, (size_t)(i % 300));
+    }
+    for(int i=0; i<5000; i+=3){
+        size_t bklen = sprintf(bkey, "b+commit_%d", i);
+        fdb_slot_writebatch_delete(slots[1], bkey, bklen);
+    }
+    for(int i=0; i<5000; i+=6){
+        size_t bklen = sprintf(bkey, "b+commit_%d", i);
+        fdb_slot_writebatch_put(slots[1], bkey, bklen, "again", 5);
+    }
+    for(int i=0; i<5000; ++i){
+        size_t bklen = sprintf(bkey, "b+commit_%d", i), vlen = 0;
+        char *val = fdb_slot_writebatch_get(ctx, slots[1], bkey, bklen, &vlen, &errptr);
+        assert(errptr == NULL);
+        if(i % 6 == 0){
+            assert(val != NULL && vlen == 5 && memcmp(val, "again", 5) == 0);
+        }else if(i % 3 == 0){
+            assert(val == NULL);
+        }else{
+            assert(val != NULL && vlen == (size_t)(i % 300) && memcmp(val, bval, vlen) == 0);
+        }
+        rocksdb_free(val);
+        val = fdb_slot_writebatch_get(ctx, slots[0], bkey, bklen, &vlen, &errptr);
+        assert(errptr == NULL && val == NULL);
+    }
+    const char *bkeys[2] = {"b+commit_1", "b+commit_none"};
+    size_t bklens[2] = {strlen(bkeys[0]), strlen(bkeys[1])}, bvlens[2];
+    char *bvals[2];
+    assert(fdb_slot_writebatch_multi_get(ctx, slots[1], 2, bkeys, bklens, bvals, bvlens, &errptr) == 0);
+    assert(bvals[0] != NULL && bvlens[0] == 1 && bvals[1] == NULL);
+    rocksdb_free(bvals[0]);
+    fdb_slot_writebatch_discard(ctx, slots[1]);
+    size_t bvlen = 0;
+    assert(fdb_slot_writebatch_get(ctx, slots[1], bkeys[0], bklens[0], &bvlen, &errptr) == NULL);
+
+    //durability, async slots leave the wal unsynced
+    uint64_t syncs = 0, unsynced = 0, unsynced_before = 0;
+    assert(fdb_context_set_durability(ctx, slots[1], FDB_DURABILITY_NUM, 0, 0) == FDB_ERR);
+    fdb_context_sync_stats(ctx, &syncs, &unsynced);
+    assert(syncs == 0 && unsynced > 0);
+    assert(fdb_context_sync(ctx) == FDB_OK);
+    fdb_context_sync_stats(ctx, &syncs, &unsynced);
+    assert(syncs == 1 && unsynced == 0);
+
+    //no wal, nothing to sync
+    assert(fdb_context_set_durability(ctx, slots[1], FDB_DURABILITY_NO_WAL, 0, 0) == FDB_OK);
+    test_commit_hash_set(ctx, slots[1], "commit_nowal", "f");
+    test_commit_hash_length(ctx, slots[1], "commit_nowal", 1);
+    fdb_context_sync_stats(ctx, &syncs, &unsynced);
+    assert(syncs == 1 && unsynced == 0);
+
+    //synced writes leave nothing behind either
+    assert(fdb_context_set_durability(ctx, slots[1], FDB_DURABILITY_SYNC, 0, 0) == FDB_OK);
+    test_commit_hash_set(ctx, slots[1], "commit_sync", "f");
+    test_commit_hash_length(ctx, slots[1], "commit_sync", 1);
+    fdb_context_sync_stats(ctx, &syncs, &unsynced);
+    assert(syncs == 1 && unsynced == 0);
+
+    //periodic by bytes, the write that passes the bound syncs, the choice survives recreating the slot
+    assert(fdb_context_set_durability(ctx, slots[1], FDB_DURABILITY_PERIODIC, 0, 1024) == FDB_OK);
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+    for(int i=0; i<100; ++i){
+        char sfield[64] = {0};
+        sprintf(sfield, "commit_fld%d", i);
+        unsynced_before = unsynced;
+        test_commit_hash_set(ctx, slots[1], "commit_periodic", sfield);
+        fdb_context_sync_stats(ctx, &syncs, &unsynced);
+        assert(unsynced < 1024);
+        if(syncs > 1){
+            break;
+        }
+    }
+    assert(syncs == 2 && unsynced == 0 && unsynced_before > 0);
+
+    //periodic by time, due once sync_ms passed since the last sync
+    assert(fdb_context_set_durability(ctx, slots[1], FDB_DURABILITY_PERIODIC, 1, 0) == FDB_OK);
+    usleep(2000);
+    test_commit_hash_set(ctx, slots[1], "commit_periodic", "commit_fld_last");
+    fdb_context_sync_stats(ctx, &syncs, &unsynced);
+    assert(syncs == 3 && unsynced == 0);
+
+    //other slots are untouched
+    assert(slots[2]->durability_ == FDB_DURABILITY_ASYNC);
+    assert(fdb_context_set_durability(ctx, NULL, FDB_DURABILITY_ASYNC, 0, 0) == FDB_OK);
+    assert(slots[1]->durability_ == FDB_DURABILITY_ASYNC);
+
+    fdb_context_destroy(ctx);
+    return 0;
+}
@@ -3,12 +3,115 @@
 #include <falcondb/fdb_define.h>
 #include <falcondb/fdb_malloc.h>
 #include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_cache.h>
 #include <falcondb/t_string.h>
+#include <falcondb/t_keys.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
 
+static void test_context_profiles_check(fdb_context_t* ctx, const int* profiles, size_t num){
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    assert(slots[0]->profile_ == FDB_PROFILE_DEFAULT);
+    for(size_t i=0; i<num; ++i){
+        assert(slots[i+1]->profile_ == profiles[i]);
+    }
+}
+
+static void test_context_profiles(){
+    const char *name = "/tmp/falcondb_test_context_profiles";
+    fdb_drop_db(name);
+    int profiles[4] = {FDB_PROFILE_WRITE_HEAVY, FDB_PROFILE_READ_HEAVY, FDB_PROFILE_CACHE, FDB_PROFILE_COLD};
+    int bad[4] = {FDB_PROFILE_DEFAULT, FDB_PROFILE_NUM, FDB_PROFILE_DEFAULT, FDB_PROFILE_DEFAULT};
+    assert(fdb_context_create_profiles(name, 16, 32, 4, bad) == NULL);
+
+    fdb_context_t *ctx = fdb_context_create_profiles(name, 16, 32, 4, profiles);
+    assert(ctx != NULL);
+    test_context_profiles_check(ctx, profiles, 4);
+
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    fdb_slice_t *key = fdb_slice_create("profile_key", strlen("profile_key"));
+    fdb_slice_t *val = fdb_slice_create("profile_val", strlen("profile_val"));
+    fdb_slice_t *get_val = NULL;
+    for(size_t i=1; i<=4; ++i){
+        assert(string_set(ctx, slots[i], key, val) == FDB_OK);
+    }
+
+    //the ttl index backfill of a slot is done once
+    assert(slots[1]->ttl_indexed_ == 0);
+    assert(keys_ttl_backfill(ctx, slots[1], 1024, 0) == 0);
+    assert(slots[1]->ttl_indexed_ == 1);
+
+    //the profiles asked for on reopening go only to slots not created yet
+    fdb_context_destroy(ctx);
+    int others[5] = {FDB_PROFILE_COLD, FDB_PROFILE_COLD, FDB_PROFILE_COLD, FDB_PROFILE_COLD, FDB_PROFILE_WRITE_HEAVY};
+    ctx = fdb_context_create_profiles(name, 16, 32, 5, others);
+    assert(ctx != NULL);
+    test_context_profiles_check(ctx, profiles, 4);
+    slots = (fdb_slot_t**)ctx->slots_;
+    assert(slots[5]->profile_ == FDB_PROFILE_WRITE_HEAVY);
+    assert(slots[1]->ttl_indexed_ == 1);
+    assert(slots[2]->ttl_indexed_ == 0);
+    for(size_t i=1; i<=4; ++i){
+        assert(string_get(ctx, slots[i], key, &get_val) == FDB_OK);
+        assert(fdb_slice_length(get_val) == fdb_slice_length(val));
+        assert(memcmp(fdb_slice_data(get_val), fdb_slice_data(val), fdb_slice_length(val)) == 0);
+        fdb_slice_destroy(get_val);
+        get_val = NULL;
+    }
+
+    //a dropped slot recreated under another profile, or under its own
+    fdb_context_drop_slot(ctx, slots[1]);
+    assert(fdb_context_create_slot_profile(ctx, slots[1], FDB_PROFILE_NUM) == FDB_ERR);
+    assert(fdb_context_create_slot_profile(ctx, slots[1], FDB_PROFILE_COLD) == FDB_OK);
+    assert(string_get(ctx, slots[1], key, &get_val) == FDB_OK_NOT_EXIST);
+    assert(string_set(ctx, slots[1], key, val) == FDB_OK);
+    fdb_context_drop_slot(ctx, slots[2]);
+    fdb_context_create_slot(ctx, slots[2]);
+    assert(slots[2]->profile_ == FDB_PROFILE_READ_HEAVY);
+    fdb_context_destroy(ctx);
+
+    profiles[0] = FDB_PROFILE_COLD;
+    ctx = fdb_context_create(name, 16, 32, 5);
+    assert(ctx != NULL);
+    test_context_profiles_check(ctx, profiles, 4);
+    slots = (fdb_slot_t**)ctx->slots_;
+    assert(slots[5]->profile_ == FDB_PROFILE_WRITE_HEAVY);
+    assert(string_get(ctx, slots[1], key, &get_val) == FDB_OK);
+    fdb_slice_destroy(get_val);
+
+    fdb_slice_destroy(key);
+    fdb_slice_destroy(val);
+    fdb_context_destroy(ctx);
+    fdb_drop_db(name);
+}
+
+//a keys cache much smaller than what the keys need evicts
+static void test_context_keys_cache(){
+    const char *name = "/tmp/falcondb_test_context_keys_cache";
+    fdb_drop_db(name);
+    fdb_context_t *ctx = fdb_context_create(name, 16, 32, 1);
+    assert(ctx != NULL);
+    fdb_context_set_keys_cache_size(ctx, 64*1024);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    fdb_slice_t *val = fdb_slice_create("cache_val", strlen("cache_val"));
+    char buf[32];
+    for(int i=0; i<1024; ++i){
+        snprintf(buf, sizeof(buf), "cache_key%d", i);
+        fdb_slice_t *key = fdb_slice_create(buf, strlen(buf));
+        assert(string_set(ctx, slots[1], key, val) == FDB_OK);
+        fdb_slice_destroy(key);
+    }
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    fdb_context_keys_cache_stats(ctx, slots[1], &hits, &misses, &evictions);
+    assert(evictions > 0);
+    assert(fdb_cache_usage((fdb_cache_t*)ctx->keys_cache_) <= 64*1024);
+    fdb_slice_destroy(val);
+    fdb_context_destroy(ctx);
+    fdb_drop_db(name);
+}
+
 int main(int argc, char* argv[]){
     fdb_drop_db("/tmp/falcondb_test_context");
     fdb_context_t *ctx = fdb_context_create("/tmp/falcondb_test_context", 16, 32, 5);
@@ -38,5 +141,8 @@ int main(int argc, char* argv[]){
     fdb_slice_destroy(key1);
     fdb_slice_destroy(val1);
     fdb_context_destroy(ctx);
+
+    test_context_profiles();
+    test_context_keys_cache();
     return 0;
 }
@@ -0,0 +1,353 @@
+#include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_context.h>
+#include <falcondb/fdb_define.h>
+#include <falcondb/fdb_types.h>
+#include <falcondb/fdb_object.h>
+#include <falcondb/fdb_codec.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/t_dels.h>
+#include <falcondb/t_hash.h>
+#include <falcondb/t_set.h>
+#include <falcondb/t_zset.h>
+#include <falcondb/fdb_malloc.h>
+#include <falcondb/util.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+void test_dels_hash_set(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* sfield, const char* svalue){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t* field = fdb_slice_create(sfield, strlen(sfield));
+    fdb_slice_t* value = fdb_slice_create(svalue, strlen(svalue));
+
+    int64_t count = -1;
+    int ret = hash_set(ctx, slot, key, field, value, &count);
+    assert(ret == FDB_OK);
+    fdb_slice_destroy(key);
+    fdb_slice_destroy(field);
+    fdb_slice_destroy(value);
+}
+
+void test_dels_set_add(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* smember){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t* member = fdb_slice_create(smember, strlen(smember));
+    fdb_array_t* members = fdb_array_create(1);
+    fdb_val_node_t* node = fdb_val_node_create();
+    node->val_.vval_ = member;
+    fdb_array_push_back(members, node);
+
+    int64_t count = -1;
+    int ret = set_add(ctx, slot, key, members, &count);
+    assert(ret == FDB_OK);
+    fdb_array_destroy(members);
+    fdb_slice_destroy(member);
+    fdb_slice_destroy(key);
+}
+
+void test_dels_keys_del(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int64_t count){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    int64_t del_count = -1;
+    int ret = keys_del(ctx, slot, key, &del_count);
+    assert(ret == FDB_OK);
+    assert(del_count == count);
+    fdb_slice_destroy(key);
+}
+
+void test_dels_hash_length(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int retcode, int64_t length){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    int64_t len = -1;
+    int ret = hash_length(ctx, slot, key, &len);
+    assert(ret == retcode);
+    if(ret == FDB_OK){
+        assert(len == length);
+    }
+    fdb_slice_destroy(key);
+}
+
+
+struct test_dels_exs_arg_t{
+    fdb_context_t*  ctx_;
+    fdb_slot_t*     slot_;
+    const char*     key_;
+    int             ret_;
+};
+
+void* test_dels_exs_main(void* ptr){
+    struct test_dels_exs_arg_t* arg = (struct test_dels_exs_arg_t*)ptr;
+    fdb_slice_t* key = fdb_slice_create(arg->key_, strlen(arg->key_));
+    arg->ret_ = keys_exs(arg->ctx_, arg->slot_, key, FDB_DATA_TYPE_HASH);
+    fdb_slice_destroy(key);
+    return NULL;
+}
+
+int test_dels_exs_other_thread(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey){
+    struct test_dels_exs_arg_t arg = {ctx, slot, skey, -1};
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, test_dels_exs_main, &arg) == 0);
+    pthread_join(tid, NULL);
+    return arg.ret_;
+}
+
+void* test_dels_reclaim_main(void* ptr){
+    struct test_dels_exs_arg_t* arg = (struct test_dels_exs_arg_t*)ptr;
+    arg->ret_ = keys_ttl_reclaim(arg->ctx_, arg->slot_, 1024, 0);
+    return NULL;
+}
+
+int test_dels_reclaim_other_thread(fdb_context_t* ctx, fdb_slot_t* slot){
+    struct test_dels_exs_arg_t arg = {ctx, slot, NULL, -1};
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, test_dels_reclaim_main, &arg) == 0);
+    pthread_join(tid, NULL);
+    return arg.ret_;
+}
+
+int main(int argc, char* argv[]){
+
+    fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_dels", 128, 128, 2);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    //collections kept in subkeys, as only those leave work to the reclaim
+    fdb_context_set_packed_limits(ctx, 0, 0);
+
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+
+    //nothing to reclaim
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 0);
+
+    test_dels_hash_set(ctx, slots[1], "dels_key1", "dels_fld1", "dels_val1");
+    test_dels_hash_set(ctx, slots[1], "dels_key1", "dels_fld2", "dels_val2");
+    test_dels_hash_set(ctx, slots[1], "dels_key1", "dels_fld3", "dels_val3");
+    test_dels_set_add(ctx, slots[1], "dels_key2", "dels_mbr1");
+    test_dels_set_add(ctx, slots[1], "dels_key2", "dels_mbr2");
+
+    test_dels_keys_del(ctx, slots[1], "dels_key1", 1);
+    test_dels_keys_del(ctx, slots[1], "dels_key2", 1);
+
+    //recreated under a new seq, must survive the reclaim of the old one
+    test_dels_hash_set(ctx, slots[1], "dels_key1", "dels_fld4", "dels_val4");
+    test_dels_hash_length(ctx, slots[1], "dels_key1", FDB_OK, 1);
+
+    //budget is honoured, the marker visited takes one of it, the marker stays until its subkeys are all gone
+    int ret = dels_self_reclaim(ctx, slots[1], 3);
+    assert(ret == 2);
+    assert(slots[1]->dels_markers_ == 0);
+    assert(slots[1]->dels_subkeys_ == 2);
+
+    ret = dels_self_reclaim(ctx, slots[1], 1024);
+    assert(ret == 3);
+    assert(slots[1]->dels_markers_ == 2);
+    assert(slots[1]->dels_subkeys_ == 5);
+    assert(slots[1]->dels_bytes_ > 0);
+
+    //markers are gone
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 0);
+    assert(slots[1]->dels_markers_ == 2);
+
+    test_dels_hash_length(ctx, slots[1], "dels_key1", FDB_OK, 1);
+
+    //a string delete drops the main key, a new hash must not reuse a seq still being reclaimed
+    test_dels_keys_del(ctx, slots[1], "dels_key1", 1);
+    fdb_slice_t* key3 = fdb_slice_create("dels_key1", strlen("dels_key1"));
+    fdb_slice_t* val3 = fdb_slice_create("dels_val", strlen("dels_val"));
+    assert(keys_set_string(ctx, slots[1], key3, val3, 0) == FDB_OK);
+    test_dels_keys_del(ctx, slots[1], "dels_key1", 1);
+    test_dels_hash_set(ctx, slots[1], "dels_key1", "dels_fld5", "dels_val5");
+    ret = dels_self_reclaim(ctx, slots[1], 1024);
+    assert(ret == 1);
+    test_dels_hash_length(ctx, slots[1], "dels_key1", FDB_OK, 1);
+    fdb_slice_destroy(key3);
+    fdb_slice_destroy(val3);
+
+    //a new string skips the markers, a hash taking over the expired string must not
+    fdb_slice_t* key7 = fdb_slice_create("dels_key7", strlen("dels_key7"));
+    fdb_slice_t* val7 = fdb_slice_create("dels_val", strlen("dels_val"));
+    int64_t ttl_count = -1;
+    test_dels_hash_set(ctx, slots[1], "dels_key7", "dels_fld7", "dels_val7");
+    test_dels_keys_del(ctx, slots[1], "dels_key7", 1);
+    test_dels_hash_set(ctx, slots[1], "dels_key7", "dels_fld7", "dels_val7");
+    test_dels_keys_del(ctx, slots[1], "dels_key7", 1);
+    assert(keys_set_string(ctx, slots[1], key7, val7, 0) == FDB_OK);
+    test_dels_keys_del(ctx, slots[1], "dels_key7", 1);
+    assert(keys_set_string(ctx, slots[1], key7, val7, 0) == FDB_OK);
+    assert(keys_pexpire_at(ctx, slots[1], key7, (int64_t)time_ms() - 2000, &ttl_count) == FDB_OK);
+    test_dels_hash_set(ctx, slots[1], "dels_key7", "dels_fld8", "dels_val8");
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 2);
+    test_dels_hash_length(ctx, slots[1], "dels_key7", FDB_OK, 1);
+    fdb_slice_destroy(key7);
+    fdb_slice_destroy(val7);
+
+    //due keys are expired from the ttl index, a collection leaves a marker behind
+    int64_t now = (int64_t)time_ms();
+    int64_t exp_count = -1;
+    fdb_slice_t* key4 = fdb_slice_create("dels_key4", strlen("dels_key4"));
+    fdb_slice_t* key5 = fdb_slice_create("dels_key5", strlen("dels_key5"));
+    fdb_slice_t* key6 = fdb_slice_create("dels_key6", strlen("dels_key6"));
+    fdb_slice_t* val4 = fdb_slice_create("dels_val", strlen("dels_val"));
+    assert(keys_set_string(ctx, slots[1], key4, val4, 0) == FDB_OK);
+    assert(keys_set_string(ctx, slots[1], key6, val4, 0) == FDB_OK);
+    test_dels_hash_set(ctx, slots[1], "dels_key5", "dels_fld6", "dels_val6");
+    assert(keys_pexpire_at(ctx, slots[1], key4, now + 1000*1000, &exp_count) == FDB_OK);
+    assert(exp_count == 1);
+    assert(keys_pexpire_at(ctx, slots[1], key4, now - 2000, &exp_count) == FDB_OK);
+    assert(keys_pexpire_at(ctx, slots[1], key5, now - 2000, &exp_count) == FDB_OK);
+    assert(keys_pexpire_at(ctx, slots[1], key6, now + 1000*1000, &exp_count) == FDB_OK);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 2);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 0);
+    fdb_slice_t* val4_get = NULL;
+    assert(keys_get_string(ctx, slots[1], key4, &val4_get) == FDB_OK_NOT_EXIST);
+    assert(keys_get_string(ctx, slots[1], key6, &val4_get) == FDB_OK);
+    fdb_slice_destroy(val4_get);
+    test_dels_hash_length(ctx, slots[1], "dels_key5", FDB_OK_NOT_EXIST, 0);
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 1);
+    assert(keys_pexpire_persist(ctx, slots[1], key6, &exp_count) == FDB_OK);
+    fdb_slice_destroy(key4);
+    fdb_slice_destroy(key5);
+    fdb_slice_destroy(key6);
+    fdb_slice_destroy(val4);
+
+    //keys given a ts before the ttl index have no entry, the backfill walks them in steps
+    const char *unindexed[3] = {"dels_key8", "dels_key9", "dels_key10"};
+    now = (int64_t)time_ms();
+    for(int i=0; i<3; ++i){
+        fdb_slice_t* key = fdb_slice_create(unindexed[i], strlen(unindexed[i]));
+        fdb_slice_t* val = fdb_slice_create("dels_val", strlen("dels_val"));
+        int64_t ts = (i < 2) ? now - 2000 : now + 1000*1000;
+        assert(keys_set_string(ctx, slots[1], key, val, 0) == FDB_OK);
+        assert(keys_pexpire_at(ctx, slots[1], key, ts, &exp_count) == FDB_OK);
+        char ttlkey[64];
+        size_t ttlkeylen = fdb_codec_encode_ttl_key(ttlkey, unindexed[i], strlen(unindexed[i]), ts);
+        char *errptr = NULL;
+        rocksdb_delete_cf(ctx->db_, ctx->writeoptions_[FDB_DURABILITY_SYNC], slots[1]->handle_, ttlkey, ttlkeylen, &errptr);
+        assert(errptr == NULL);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(val);
+    }
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 0);
+    assert(slots[1]->ttl_indexed_ == 0);
+    int backfilled = 0, steps = 0;
+    while(!slots[1]->ttl_indexed_){
+        ret = keys_ttl_backfill(ctx, slots[1], 2, 0);
+        assert(ret >= 0);
+        backfilled += ret;
+        ++steps;
+    }
+    assert(backfilled == 3);
+    assert(steps > 2);
+    assert(keys_ttl_backfill(ctx, slots[1], 1024, 0) == 0);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 2);
+    fdb_slice_t* key10 = fdb_slice_create("dels_key10", strlen("dels_key10"));
+    int64_t left = 0;
+    assert(keys_pexpire_left(ctx, slots[1], key10, &left) == FDB_OK);
+    assert(left > 0);
+    fdb_slice_destroy(key10);
+
+    //a command that opened an expiring key keeps the sweeper off it until it leaves
+    test_dels_hash_set(ctx, slots[1], "dels_key11", "dels_fld11", "dels_val11");
+    fdb_slice_t* key11 = fdb_slice_create("dels_key11", strlen("dels_key11"));
+    assert(keys_pexpire_at(ctx, slots[1], key11, (int64_t)time_ms() + 50, &exp_count) == FDB_OK);
+    fdb_slice_t* key14 = fdb_slice_create("dels_key14", strlen("dels_key14"));
+    fdb_slice_t* val14 = fdb_slice_create("dels_val", strlen("dels_val"));
+    assert(keys_set_string(ctx, slots[1], key14, val14, 0) == FDB_OK);
+    assert(keys_pexpire_at(ctx, slots[1], key14, (int64_t)time_ms() + 60, &exp_count) == FDB_OK);
+    fdb_arena_enter();
+    fdb_slice_t* open11 = fdb_slice_create("dels_key11", strlen("dels_key11"));
+    assert(keys_exs(ctx, slots[1], open11, FDB_DATA_TYPE_HASH) == FDB_OK);
+    usleep(100*1000);
+    //the skipped entry takes the whole budget of one
+    assert(keys_ttl_reclaim(ctx, slots[1], 1, 0) == 0);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 1);
+    assert(keys_get_string(ctx, slots[1], key14, &val4_get) == FDB_OK_NOT_EXIST);
+    fdb_arena_leave();
+    fdb_slice_destroy(key14);
+    fdb_slice_destroy(val14);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 1);
+    test_dels_hash_length(ctx, slots[1], "dels_key11", FDB_OK_NOT_EXIST, 0);
+    fdb_slice_destroy(open11);
+    fdb_slice_destroy(key11);
+
+    //other threads see a main key once its batch is committed, a discarded one never
+    fdb_slice_t* key12 = fdb_slice_create("dels_key12", strlen("dels_key12"));
+    assert(keys_enc(ctx, slots[1], key12, FDB_DATA_TYPE_HASH) == FDB_OK);
+    assert(test_dels_exs_other_thread(ctx, slots[1], "dels_key12") == FDB_OK_NOT_EXIST);
+    test_dels_hash_length(ctx, slots[1], "dels_key12", FDB_OK, 0);
+    fdb_slot_writebatch_discard(ctx, slots[1]);
+    test_dels_hash_length(ctx, slots[1], "dels_key12", FDB_OK_NOT_EXIST, 0);
+    fdb_slice_destroy(key12);
+    key12 = fdb_slice_create("dels_key12", strlen("dels_key12"));
+    assert(keys_enc(ctx, slots[1], key12, FDB_DATA_TYPE_HASH) == FDB_OK);
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(ctx, slots[1], &errptr);
+    assert(errptr == NULL);
+    assert(test_dels_exs_other_thread(ctx, slots[1], "dels_key12") == FDB_OK);
+    fdb_slice_destroy(key12);
+
+    //the background sweeper gets there by itself
+    test_dels_keys_del(ctx, slots[1], "dels_key1", 1);
+    fdb_context_start_sweeper(ctx, 10, 1024, 10);
+    for(int i=0; i<500 && slots[1]->dels_markers_ < 7; ++i){
+        usleep(10*1000);
+    }
+    fdb_context_stop_sweeper(ctx);
+    assert(slots[1]->dels_markers_ == 7);
+    assert(slots[1]->dels_subkeys_ == 11);
+
+    //an expired key made anew is kept from the sweeper until its batch is committed
+    test_dels_hash_set(ctx, slots[1], "dels_key13", "dels_fld13", "dels_val13");
+    fdb_slice_t* key13 = fdb_slice_create("dels_key13", strlen("dels_key13"));
+    assert(keys_pexpire_at(ctx, slots[1], key13, (int64_t)time_ms() + 50, &exp_count) == FDB_OK);
+    usleep(100*1000);
+    fdb_arena_enter();
+    fdb_slice_t* open13 = fdb_slice_create("dels_key13", strlen("dels_key13"));
+    assert(keys_enc(ctx, slots[1], open13, FDB_DATA_TYPE_HASH) == FDB_OK);
+    assert(test_dels_reclaim_other_thread(ctx, slots[1]) == 0);
+    fdb_slot_writebatch_commit(ctx, slots[1], &errptr);
+    assert(errptr == NULL);
+    fdb_arena_leave();
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 0);
+    assert(test_dels_exs_other_thread(ctx, slots[1], "dels_key13") == FDB_OK);
+    test_dels_hash_length(ctx, slots[1], "dels_key13", FDB_OK, 0);
+    fdb_slice_destroy(open13);
+    fdb_slice_destroy(key13);
+
+    //markers with nothing left to drop take the budget as well, and go in one write
+    assert(dels_self_reclaim(ctx, slots[1], 1024) >= 0);
+    uint64_t markers = slots[1]->dels_markers_;
+    const char *bare[3] = {"dels_key15", "dels_key16", "dels_key17"};
+    for(int i=0; i<3; ++i){
+        fdb_slice_t* key = fdb_slice_create(bare[i], strlen(bare[i]));
+        assert(dels_mark(ctx, slots[1], key, 100) == 1);
+        fdb_slice_destroy(key);
+    }
+    fdb_slot_writebatch_commit(ctx, slots[1], &errptr);
+    assert(errptr == NULL);
+    assert(dels_self_reclaim(ctx, slots[1], 2) == 0);
+    assert(slots[1]->dels_markers_ == markers + 2);
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 0);
+    assert(slots[1]->dels_markers_ == markers + 3);
+
+    //a packed collection has no subkeys, expiring it leaves no marker behind
+    fdb_context_set_packed_limits(ctx, 128, 4096);
+    fdb_slice_t* key18 = fdb_slice_create("dels_key18", strlen("dels_key18"));
+    fdb_slice_t* key19 = fdb_slice_create("dels_key19", strlen("dels_key19"));
+    test_dels_hash_set(ctx, slots[1], "dels_key18", "dels_fld18", "dels_val18");
+    test_dels_hash_set(ctx, slots[1], "dels_key19", "dels_fld19", "dels_val19");
+    assert(keys_pexpire_at(ctx, slots[1], key18, (int64_t)time_ms() - 2000, &exp_count) == FDB_OK);
+    assert(keys_ttl_reclaim(ctx, slots[1], 1024, 0) == 1);
+    assert(keys_pexpire_at(ctx, slots[1], key19, (int64_t)time_ms() - 2000, &exp_count) == FDB_OK);
+    int64_t clr_count = 0;
+    assert(keys_clr(ctx, slots[1], key19, &clr_count) == FDB_OK);
+    assert(clr_count == 1);
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 0);
+    assert(slots[1]->dels_markers_ == markers + 3);
+    test_dels_hash_length(ctx, slots[1], "dels_key18", FDB_OK_NOT_EXIST, 0);
+    test_dels_hash_length(ctx, slots[1], "dels_key19", FDB_OK_NOT_EXIST, 0);
+    fdb_slice_destroy(key18);
+    fdb_slice_destroy(key19);
+
+    fdb_context_destroy(ctx);
+    return 0;
+}
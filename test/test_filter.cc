@@ -0,0 +1,112 @@
+#include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_context.h>
+#include <falcondb/fdb_define.h>
+#include <falcondb/fdb_types.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/t_dels.h>
+#include <falcondb/t_hash.h>
+#include <falcondb/util.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+
+//whether the main key record is still on disk, bypassing the keys cache
+int test_filter_exists(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey){
+    fdb_slice_t* slice_key = NULL;
+    encode_keys_key(skey, strlen(skey), &slice_key);
+    char *errptr = NULL;
+    size_t vallen = 0;
+    rocksdb_readoptions_t* readoptions = rocksdb_readoptions_create();
+    char* val = rocksdb_get_cf(ctx->db_, readoptions, slot->handle_, fdb_slice_data(slice_key), fdb_slice_length(slice_key), &vallen, &errptr);
+    rocksdb_readoptions_destroy(readoptions);
+    fdb_slice_destroy(slice_key);
+    assert(errptr == NULL);
+    if(val == NULL){
+        return 0;
+    }
+    rocksdb_free(val);
+    return 1;
+}
+
+void test_filter_compact(fdb_context_t* ctx, fdb_slot_t* slot){
+    rocksdb_compact_range_cf(ctx->db_, slot->handle_, NULL, 0, NULL, 0);
+}
+
+void test_filter_hash_set(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* sfield){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t* field = fdb_slice_create(sfield, strlen(sfield));
+    int64_t count = -1;
+    int ret = hash_set(ctx, slot, key, field, field, &count);
+    assert(ret == FDB_OK);
+    fdb_slice_destroy(key);
+    fdb_slice_destroy(field);
+}
+
+void test_filter_pexpire_at(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int64_t ts){
+    fdb_slice_t* key = fdb_slice_create(skey, strlen(skey));
+    int64_t count = -1;
+    int ret = keys_pexpire_at(ctx, slot, key, ts, &count);
+    assert(ret == FDB_OK);
+    assert(count == 1);
+    fdb_slice_destroy(key);
+}
+
+
+int main(int argc, char* argv[]){
+
+    fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_filter", 128, 128, 2);
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    //collections kept in subkeys, as only those leave work to the reclaim
+    fdb_context_set_packed_limits(ctx, 0, 0);
+
+    fdb_context_drop_slot(ctx, slots[1]);
+    fdb_context_create_slot(ctx, slots[1]);
+
+    int64_t now = (int64_t)time_ms();
+    fdb_slice_t* val = fdb_slice_create("filter_val", strlen("filter_val"));
+    const char* skeys[] = {"filter_key1", "filter_key2"};
+    for(int i=0; i<2; ++i){
+        fdb_slice_t* key = fdb_slice_create(skeys[i], strlen(skeys[i]));
+        assert(keys_set_string(ctx, slots[1], key, val, 0) == FDB_OK);
+        fdb_slice_destroy(key);
+    }
+    test_filter_pexpire_at(ctx, slots[1], "filter_key1", now - 1000);
+    test_filter_pexpire_at(ctx, slots[1], "filter_key2", now + 1000*1000);
+
+    //an expired collection still owns its subkeys, a deleted one waits for the reclaim
+    test_filter_hash_set(ctx, slots[1], "filter_key3", "filter_fld");
+    test_filter_hash_set(ctx, slots[1], "filter_key4", "filter_fld");
+    test_filter_hash_set(ctx, slots[1], "filter_key5", "filter_fld");
+    test_filter_pexpire_at(ctx, slots[1], "filter_key3", now - 1000);
+    fdb_slice_t* key4 = fdb_slice_create("filter_key4", strlen("filter_key4"));
+    fdb_slice_t* key5 = fdb_slice_create("filter_key5", strlen("filter_key5"));
+    int64_t count = -1;
+    assert(keys_del(ctx, slots[1], key4, &count) == FDB_OK);
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 1);
+    assert(keys_del(ctx, slots[1], key5, &count) == FDB_OK);
+
+    test_filter_compact(ctx, slots[1]);
+    assert(test_filter_exists(ctx, slots[1], "filter_key1") == 0);
+    assert(test_filter_exists(ctx, slots[1], "filter_key2") == 1);
+    assert(test_filter_exists(ctx, slots[1], "filter_key3") == 1);
+    assert(test_filter_exists(ctx, slots[1], "filter_key4") == 0);
+    assert(test_filter_exists(ctx, slots[1], "filter_key5") == 1);
+
+    //once reclaimed it goes at the next compaction
+    assert(dels_self_reclaim(ctx, slots[1], 1024) == 1);
+    test_filter_compact(ctx, slots[1]);
+    assert(test_filter_exists(ctx, slots[1], "filter_key5") == 0);
+
+    //a recreated key starts over cleanly
+    test_filter_hash_set(ctx, slots[1], "filter_key4", "filter_fld");
+    int64_t length = -1;
+    assert(hash_length(ctx, slots[1], key4, &length) == FDB_OK);
+    assert(length == 1);
+
+    fdb_slice_destroy(key4);
+    fdb_slice_destroy(key5);
+    fdb_slice_destroy(val);
+    fdb_context_destroy(ctx);
+    return 0;
+}
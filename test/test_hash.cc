@@ -3,6 +3,8 @@
 #include <falcondb/fdb_define.h>
 #include <falcondb/fdb_types.h>
 #include <falcondb/t_hash.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/fdb_codec.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -126,6 +128,314 @@ void print_hash_getall(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, i
     fdb_slice_destroy(key);
 }
 
+//1 if the hash is packed in its main key, 0 if in subkeys with *count kept in the main key,
+//-1 if its count is in a size key
+int test_hash_main_payload(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, uint64_t* count){
+    char fdbkey[64];
+    size_t fdbkeylen = fdb_codec_encode_keys_key(fdbkey, skey, strlen(skey));
+    char *errptr = NULL;
+    size_t vallen = 0;
+    char *val = rocksdb_get_cf(ctx->db_, ctx->readoptions_, slot->handle_, fdbkey, fdbkeylen, &vallen, &errptr);
+    assert(errptr == NULL && val != NULL);
+    uint8_t type = 0, stat = 0;
+    uint32_t seq = 0;
+    int64_t ts = 0;
+    fdb_view_t payload;
+    assert(fdb_codec_decode_keys_val(val, vallen, &type, &stat, &seq, &ts, &payload) == 0);
+    int ret = 1;
+    if(fdb_codec_decode_subkeys_payload(payload.data_, payload.length_, count) == 0){
+        ret = 0;
+    }else if(payload.length_ == 0){
+        ret = -1;
+    }
+    rocksdb_free(val);
+    return ret;
+}
+
+//a hash kept in its main key until it outgrows the packed limits, then in subkeys for good
+void test_hash_packed(fdb_context_t* ctx, fdb_slot_t* slot){
+    fdb_context_set_packed_limits(ctx, 4, 64);
+    uint64_t count = 0;
+
+    test_hash_set(ctx, slot, "packed_key1", "fld3", "val3", FDB_OK, 1);
+    test_hash_set(ctx, slot, "packed_key1", "fld1", "val1", FDB_OK, 1);
+    test_hash_set(ctx, slot, "packed_key1", "fld2", "val2", FDB_OK, 1);
+    test_hash_set(ctx, slot, "packed_key1", "fld2", "val2x", FDB_OK, 0);
+    test_hash_setnx(ctx, slot, "packed_key1", "fld1", "val1", FDB_OK_BUT_ALREADY_EXIST, 1);
+    test_hash_incr(ctx, slot, "packed_key1", "fld4", 10, 5, 15, FDB_OK);
+    test_hash_length(ctx, slot, "packed_key1", 4, FDB_OK);
+    assert(test_hash_main_payload(ctx, slot, "packed_key1", &count) == 1);
+    test_hash_get(ctx, slot, "packed_key1", "fld2", "val2x", FDB_OK);
+    test_hash_get(ctx, slot, "packed_key1", "fld5", NULL, FDB_OK_NOT_EXIST);
+    test_hash_del(ctx, slot, "packed_key1", "fld3", FDB_OK, 1);
+    test_hash_del(ctx, slot, "packed_key1", "fld3", FDB_OK, 0);
+    test_hash_exists(ctx, slot, "packed_key1", "fld3", FDB_OK, 0);
+
+    //fields come back in order either way
+    const char *fields[] = {"fld1", "fld2", "fld4", "fld5", "fld6"};
+    for(int round=0; round<2; ++round){
+        if(round == 1){
+            test_hash_set(ctx, slot, "packed_key1", "fld5", "val5", FDB_OK, 1);
+            test_hash_set(ctx, slot, "packed_key1", "fld6", "val6", FDB_OK, 1);
+            assert(test_hash_main_payload(ctx, slot, "packed_key1", &count) == 0 && count == 5);
+        }
+        fdb_slice_t *key = fdb_slice_create("packed_key1", strlen("packed_key1"));
+        fdb_array_t *fvs = NULL;
+        assert(hash_getall(ctx, slot, key, &fvs) == FDB_OK);
+        size_t expect = (round == 0) ? 3 : 5;
+        assert(fvs->length_ == 2*expect);
+        for(size_t k=0; k<expect; ++k){
+            fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(fvs, 2*k)->val_.vval_);
+            assert(fdb_slice_length(sl) == strlen(fields[k]) && memcmp(fdb_slice_data(sl), fields[k], 4) == 0);
+        }
+        for(size_t k=0; k<fvs->length_; ++k){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(fvs, k)->val_.vval_));
+        }
+        fdb_array_destroy(fvs);
+        fdb_slice_destroy(key);
+    }
+    test_hash_length(ctx, slot, "packed_key1", 5, FDB_OK);
+    test_hash_get(ctx, slot, "packed_key1", "fld4", "15", FDB_OK);
+
+    //back under the limits it stays in subkeys
+    test_hash_del(ctx, slot, "packed_key1", "fld5", FDB_OK, 1);
+    test_hash_del(ctx, slot, "packed_key1", "fld6", FDB_OK, 1);
+    test_hash_length(ctx, slot, "packed_key1", 3, FDB_OK);
+    assert(test_hash_main_payload(ctx, slot, "packed_key1", &count) == 0 && count == 3);
+
+    //a value past the byte limit moves it out as well
+    char big[80];
+    memset(big, 'v', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    test_hash_set(ctx, slot, "packed_key2", "fld1", "val1", FDB_OK, 1);
+    assert(test_hash_main_payload(ctx, slot, "packed_key2", &count) == 1);
+    test_hash_set(ctx, slot, "packed_key2", "fld2", big, FDB_OK, 1);
+    assert(test_hash_main_payload(ctx, slot, "packed_key2", &count) == 0 && count == 2);
+    test_hash_get(ctx, slot, "packed_key2", "fld2", big, FDB_OK);
+    test_hash_length(ctx, slot, "packed_key2", 2, FDB_OK);
+
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+}
+
+//a hash written while its count was in a size key, the count moves to the main key at its next write
+void test_hash_legacy_count(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *skey = "legacy_key";
+    char seqkey[32], fdbkey[64], fdbval[64];
+    rocksdb_encode_fixed32(seqkey, 7);
+    memcpy(seqkey + sizeof(uint32_t), skey, strlen(skey));
+    size_t seqkeylen = sizeof(uint32_t) + strlen(skey);
+
+    rocksdb_writeoptions_t *options = rocksdb_writeoptions_create();
+    char *errptr = NULL;
+    size_t fdbkeylen = fdb_codec_encode_keys_key(fdbkey, skey, strlen(skey));
+    size_t fdbvallen = fdb_codec_encode_keys_val(fdbval, FDB_DATA_TYPE_HASH, FDB_KEY_STAT_NORMAL, 7, 0, NULL, 0);
+    rocksdb_put_cf(ctx->db_, options, slot->handle_, fdbkey, fdbkeylen, fdbval, fdbvallen, &errptr);
+    assert(errptr == NULL);
+    fdbkeylen = fdb_codec_encode_member_key(fdbkey, FDB_DATA_TYPE_HASH, seqkey, seqkeylen, "fld1", 4);
+    rocksdb_put_cf(ctx->db_, options, slot->handle_, fdbkey, fdbkeylen, "val1", 4, &errptr);
+    assert(errptr == NULL);
+    char size[sizeof(uint64_t)];
+    rocksdb_encode_fixed64(size, 1);
+    size_t sizekeylen = fdb_codec_encode_size_key(fdbkey, FDB_DATA_TYPE_HSIZE, seqkey, seqkeylen);
+    rocksdb_put_cf(ctx->db_, options, slot->handle_, fdbkey, sizekeylen, size, sizeof(size), &errptr);
+    assert(errptr == NULL);
+    rocksdb_writeoptions_destroy(options);
+
+    uint64_t count = 0;
+    assert(test_hash_main_payload(ctx, slot, skey, &count) == -1);
+    test_hash_length(ctx, slot, skey, 1, FDB_OK);
+    test_hash_get(ctx, slot, skey, "fld1", "val1", FDB_OK);
+    test_hash_set(ctx, slot, skey, "fld2", "val2", FDB_OK, 1);
+    test_hash_length(ctx, slot, skey, 2, FDB_OK);
+    assert(test_hash_main_payload(ctx, slot, skey, &count) == 0 && count == 2);
+    size_t vallen = 0;
+    char *val = rocksdb_get_cf(ctx->db_, ctx->readoptions_, slot->handle_, fdbkey, sizekeylen, &vallen, &errptr);
+    assert(errptr == NULL && val == NULL);
+}
+
+//hashes scanned with prefix seeks, partly flushed to tables and partly in the memtable
+void test_hash_prefix_scan(fdb_context_t* ctx, fdb_slot_t* slot){
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    char skey[32], sfield[32];
+    for(int i=0; i<64; ++i){
+        snprintf(skey, sizeof(skey), "prefix_key%d", i);
+        for(int j=0; j<=i%8; ++j){
+            snprintf(sfield, sizeof(sfield), "fld%d", j);
+            test_hash_set(ctx, slot, skey, sfield, "val", FDB_OK, 1);
+        }
+    }
+    rocksdb_compact_range_cf(ctx->db_, slot->handle_, NULL, 0, NULL, 0);
+    for(int i=64; i<128; ++i){
+        snprintf(skey, sizeof(skey), "prefix_key%d", i);
+        for(int j=0; j<=i%8; ++j){
+            snprintf(sfield, sizeof(sfield), "fld%d", j);
+            test_hash_set(ctx, slot, skey, sfield, "val", FDB_OK, 1);
+        }
+    }
+    //one more field for the hashes on tables, so their scan spans both
+    for(int i=0; i<64; i+=3){
+        snprintf(skey, sizeof(skey), "prefix_key%d", i);
+        test_hash_set(ctx, slot, skey, "fldx", "val", FDB_OK, 1);
+    }
+
+    for(int i=0; i<128; ++i){
+        snprintf(skey, sizeof(skey), "prefix_key%d", i);
+        int64_t fields = i%8 + 1 + ((i<64 && i%3==0) ? 1 : 0);
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *fvs = NULL;
+        assert(hash_getall(ctx, slot, key, &fvs) == FDB_OK);
+        assert(fvs->length_ == fields*2);
+        for(size_t k=0; k<fvs->length_; ++k){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(fvs, k)->val_.vval_));
+        }
+        fdb_array_destroy(fvs);
+        fdb_slice_destroy(key);
+        test_hash_length(ctx, slot, skey, fields, FDB_OK);
+    }
+    test_hash_get(ctx, slot, "prefix_key3", "fld9", NULL, FDB_OK_NOT_EXIST);
+    test_hash_get(ctx, slot, "prefix_key128", "fld0", NULL, FDB_OK_NOT_EXIST);
+    test_hash_exists(ctx, slot, "prefix_key7", "fld7", FDB_OK, 1);
+
+    //the db is marked once its tables carry prefixes
+    fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
+    char *errptr = NULL;
+    size_t vallen = 0;
+    char *val = rocksdb_get_cf(ctx->db_, ctx->readoptions_, slots[0]->handle_, FDB_PREFIX_MARKER,
+                               strlen(FDB_PREFIX_MARKER), &vallen, &errptr);
+    assert(errptr == NULL && val != NULL);
+    rocksdb_free(val);
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+}
+
+
+//the increments of a hash in subkeys, a new field grows it and an overflow leaves it be
+void test_hash_incr_subkeys(fdb_context_t* ctx, fdb_slot_t* slot){
+    fdb_context_set_packed_limits(ctx, 0, 0);
+
+    test_hash_incr(ctx, slot, "incr_key1", "fld1", 10, 5, 15, FDB_OK);
+    test_hash_length(ctx, slot, "incr_key1", 1, FDB_OK);
+    test_hash_incr(ctx, slot, "incr_key1", "fld1", 10, -20, -5, FDB_OK);
+    test_hash_incr(ctx, slot, "incr_key1", "fld2", 0, INT64_MIN, INT64_MIN, FDB_OK);
+    test_hash_length(ctx, slot, "incr_key1", 2, FDB_OK);
+    test_hash_incr(ctx, slot, "incr_key1", "fld2", 0, -1, -1, FDB_ERR_INCDECR_OVERFLOW);
+    test_hash_get(ctx, slot, "incr_key1", "fld1", "-5", FDB_OK);
+    test_hash_length(ctx, slot, "incr_key1", 2, FDB_OK);
+    uint64_t count = 0;
+    assert(test_hash_main_payload(ctx, slot, "incr_key1", &count) == 0 && count == 2);
+
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+}
+
+//fields of a hash in subkeys read together, one of them repeated
+void test_hash_mget_subkeys(fdb_context_t* ctx, fdb_slot_t* slot){
+    fdb_context_set_packed_limits(ctx, 0, 0);
+
+    test_hash_set(ctx, slot, "mget_key1", "fld1", "val1", FDB_OK, 1);
+    test_hash_set(ctx, slot, "mget_key1", "fld2", "val2", FDB_OK, 1);
+    const char *sfields[] = {"fld2", "fldx", "fld1", "fld2"};
+    const char *svalues[] = {"val2", NULL, "val1", "val2"};
+    fdb_slice_t *key = fdb_slice_create("mget_key1", strlen("mget_key1"));
+    fdb_array_t *fields = fdb_array_create(4);
+    for(int i=0; i<4; ++i){
+        fdb_val_node_t *node = fdb_val_node_create();
+        node->val_.vval_ = fdb_slice_create(sfields[i], strlen(sfields[i]));
+        fdb_array_push_back(fields, node);
+    }
+    fdb_array_t *rets = NULL;
+    assert(hash_mget(ctx, slot, key, fields, &rets) == FDB_OK && rets->length_ == 4);
+    for(int i=0; i<4; ++i){
+        fdb_val_node_t *node = fdb_array_at(rets, i);
+        fdb_slice_t *sl = (fdb_slice_t*)(node->val_.vval_);
+        if(svalues[i] == NULL){
+            assert(node->retval_ == FDB_OK_NOT_EXIST && sl == NULL);
+            continue;
+        }
+        assert(node->retval_ == FDB_OK);
+        assert(fdb_slice_length(sl) == strlen(svalues[i]));
+        assert(memcmp(fdb_slice_data(sl), svalues[i], fdb_slice_length(sl)) == 0);
+        fdb_slice_destroy(sl);
+    }
+    fdb_array_destroy(rets);
+    for(int i=0; i<4; ++i){
+        fdb_slice_destroy(fdb_array_at(fields, i)->val_.vval_);
+        fdb_val_node_destroy(fdb_array_at(fields, i));
+    }
+    fdb_array_destroy(fields);
+    fdb_slice_destroy(key);
+
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+}
+
+//a whole hash_hscan in chunks of count, the fields matching pattern it came across
+static size_t test_hash_scan_all(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* spattern, uint64_t count){
+    fdb_slice_t *pattern = fdb_slice_create(spattern, strlen(spattern));
+    fdb_slice_t *cursor = NULL;
+    size_t found = 0;
+    do{
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        assert(hash_hscan(ctx, slot, key, cursor, pattern, count, &rets, &next) == FDB_OK);
+        assert(rets->length_ % 2 == 0);
+        for(size_t i=0; i<rets->length_; i+=2){
+            fdb_slice_t *fld = (fdb_slice_t*)(fdb_array_at(rets, i)->val_.vval_);
+            fdb_slice_t *val = (fdb_slice_t*)(fdb_array_at(rets, i+1)->val_.vval_);
+            assert(keys_match(pattern, fdb_slice_data(fld), fdb_slice_length(fld)));
+            //the values are the fields with v for f
+            assert(fdb_slice_length(fld) == fdb_slice_length(val));
+            assert(fdb_slice_data(val)[0] == 'v' && memcmp(fdb_slice_data(fld) + 1, fdb_slice_data(val) + 1, fdb_slice_length(fld) - 1) == 0);
+            fdb_slice_destroy(fld);
+            fdb_slice_destroy(val);
+        }
+        found += rets->length_/2;
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(cursor);
+        cursor = next;
+    }while(cursor != NULL);
+    fdb_slice_destroy(pattern);
+    return found;
+}
+
+void test_hash_scan(fdb_context_t* ctx, fdb_slot_t* slot){
+    char fld[8], val[8];
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    for(int i=0; i<25; ++i){
+        snprintf(fld, sizeof(fld), "f%02d", i);
+        snprintf(val, sizeof(val), "v%02d", i);
+        test_hash_set(ctx, slot, "scan_hash", fld, val, FDB_OK, 1);
+    }
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    for(int i=0; i<25; ++i){
+        snprintf(fld, sizeof(fld), "f%02d", i);
+        snprintf(val, sizeof(val), "v%02d", i);
+        test_hash_set(ctx, slot, "scan_hash_packed", fld, val, FDB_OK, 1);
+    }
+    const char *skeys[] = {"scan_hash", "scan_hash_packed"};
+    for(int k=0; k<2; ++k){
+        assert(test_hash_scan_all(ctx, slot, skeys[k], "", 7) == 25);
+        assert(test_hash_scan_all(ctx, slot, skeys[k], "*", 25) == 25);
+        assert(test_hash_scan_all(ctx, slot, skeys[k], "f1?", 4) == 10);
+        assert(test_hash_scan_all(ctx, slot, skeys[k], "x*", 3) == 0);
+    }
+
+    //a chunk is bounded by count, and a missing hash has nothing to scan
+    fdb_slice_t *key = fdb_slice_create("scan_hash", strlen("scan_hash"));
+    fdb_array_t *rets = NULL;
+    fdb_slice_t *next = NULL;
+    assert(hash_hscan(ctx, slot, key, NULL, NULL, 5, &rets, &next) == FDB_OK);
+    assert(rets->length_ == 10 && next != NULL);
+    assert(fdb_slice_length(next) == 3 && memcmp(fdb_slice_data(next), "f04", 3) == 0);
+    for(size_t i=0; i<rets->length_; ++i){
+        fdb_slice_destroy(fdb_array_at(rets, i)->val_.vval_);
+    }
+    fdb_array_destroy(rets);
+    fdb_slice_destroy(next);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("scan_hash_none", strlen("scan_hash_none"));
+    assert(hash_hscan(ctx, slot, key, NULL, NULL, 5, &rets, &next) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(key);
+}
 
 int main(int argc, char* argv[]){
 
@@ -159,8 +469,24 @@ int main(int argc, char* argv[]){
 
     test_hash_length(ctx ,slots[1], "hash_key1", 2, FDB_OK);
 
+    test_hash_incr(ctx, slots[1], "hash_key1", "hash_fld2", 0, INT64_MAX, -1, FDB_ERR_INCDECR_OVERFLOW);
+
+    test_hash_get(ctx, slots[1], "hash_key1", "hash_fld2", "97", FDB_OK);
+
+    test_hash_incr_subkeys(ctx, slots[1]);
+
+    test_hash_mget_subkeys(ctx, slots[1]);
+
+    test_hash_scan(ctx, slots[1]);
+
     print_hash_getall(ctx, slots[1], "hash_key1", 2*2, FDB_OK);
 
+    test_hash_packed(ctx, slots[1]);
+
+    test_hash_legacy_count(ctx, slots[1]);
+
+    test_hash_prefix_scan(ctx, slots[1]);
+
 
     /*
 
@@ -7,6 +7,61 @@
 #include <stdio.h>
 #include <string.h>
 
+//a whole keys_scan in chunks of count, the keys matching pattern it came across
+static size_t test_keys_scan(fdb_context_t* ctx, fdb_slot_t* slot, const char* spattern, uint64_t count){
+    fdb_slice_t *pattern = fdb_slice_create(spattern, strlen(spattern));
+    fdb_slice_t *cursor = NULL;
+    size_t found = 0, chunks = 0;
+    do{
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        assert(keys_scan(ctx, slot, cursor, pattern, count, &rets, &next) == FDB_OK);
+        assert(rets->length_ <= count);
+        for(size_t i=0; i<rets->length_; ++i){
+            fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, i)->val_.vval_);
+            assert(keys_match(pattern, fdb_slice_data(sl), fdb_slice_length(sl)));
+            fdb_slice_destroy(sl);
+        }
+        found += rets->length_;
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(cursor);
+        cursor = next;
+        ++chunks;
+    }while(cursor != NULL);
+    assert(chunks < 100);
+    fdb_slice_destroy(pattern);
+    return found;
+}
+
+void test_keys_scan_all(fdb_context_t* ctx, fdb_slot_t* slot){
+    char name[16];
+    for(int i=0; i<10; ++i){
+        snprintf(name, sizeof(name), "scan_key%d", i);
+        fdb_slice_t *key = fdb_slice_create(name, strlen(name));
+        fdb_slice_t *val = fdb_slice_create("v", 1);
+        //the last one expired already, which the scan leaves out
+        assert(keys_set_string(ctx, slot, key, val, (i == 9) ? 1 : 0) == FDB_OK);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(val);
+    }
+    assert(test_keys_scan(ctx, slot, "scan_key*", 3) == 9);
+    assert(test_keys_scan(ctx, slot, "scan_key*", 100) == 9);
+    assert(test_keys_scan(ctx, slot, "scan_key[2-4]", 1) == 3);
+    assert(test_keys_scan(ctx, slot, "nothing*", 4) == 0);
+
+    //names starting with 0xff sort last, longer ones too
+    const char *high[2] = {"\xff", "\xff\xffscan"};
+    for(int i=0; i<2; ++i){
+        fdb_slice_t *key = fdb_slice_create(high[i], strlen(high[i]));
+        fdb_slice_t *val = fdb_slice_create("v", 1);
+        assert(keys_set_string(ctx, slot, key, val, 0) == FDB_OK);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(val);
+    }
+    assert(test_keys_scan(ctx, slot, "\xff*", 1) == 2);
+    assert(test_keys_scan(ctx, slot, "*", 100) == 11);
+}
+
 int main(int argc, char* argv[]){
 
     fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_keys", 128, 128, 2);
@@ -15,13 +70,13 @@ int main(int argc, char* argv[]){
     fdb_slice_t* key1 = fdb_slice_create("keys_key1", strlen("keys_key1"));
     fdb_slice_t* val1 = fdb_slice_create("keys_val1", strlen("keys_val1"));
     //slot[0] string_set
-    int ret = keys_set_string(ctx, slots[0], key1, val1);
+    int ret = keys_set_string(ctx, slots[0], key1, val1, 0);
     assert(ret == FDB_OK);
 
 
     //slot[1] string_set
     fdb_slice_t* val2 = fdb_slice_create("keys_val2", strlen("keys_val2"));
-    ret = keys_set_string(ctx, slots[1], key1, val2);
+    ret = keys_set_string(ctx, slots[1], key1, val2, 0);
     assert(ret == FDB_OK);
 
     
@@ -54,6 +109,8 @@ int main(int argc, char* argv[]){
     assert(type == FDB_DATA_TYPE_STRING);
     
 
+    test_keys_scan_all(ctx, slots[0]);
+
     fdb_slice_destroy(key1);
     fdb_slice_destroy(val1);
     fdb_slice_destroy(val2);
@@ -3,6 +3,7 @@
 #include <falcondb/fdb_define.h>
 #include <falcondb/fdb_types.h>
 #include <falcondb/t_set.h>
+#include <falcondb/t_keys.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -80,6 +81,300 @@ void test_set_member_exists(fdb_context_t* ctx, fdb_slot_t* slot, const char* sk
     fdb_slice_destroy(mber);
 }
 
+//members come back in order whether the set is packed in its main key or has moved to subkeys
+void check_set_members(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char** smembers, size_t n){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_array_t *set = NULL;
+    assert(set_members(ctx, slot, key, &set) == FDB_OK);
+    assert(set->length_ == n);
+    for(size_t i=0; i<n; ++i){
+        fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(set, i)->val_.vval_);
+        assert(fdb_slice_length(sl) == strlen(smembers[i]));
+        assert(memcmp(fdb_slice_data(sl), smembers[i], fdb_slice_length(sl)) == 0);
+        fdb_slice_destroy(sl);
+    }
+    fdb_array_destroy(set);
+    fdb_slice_destroy(key);
+}
+
+void test_set_packed(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *members[] = {"pm1", "pm2", "pm3", "pm4"};
+    fdb_context_set_packed_limits(ctx, 3, 2048);
+
+    test_set_add(ctx, slot, "packed_set", "pm3", FDB_OK, 1);
+    test_set_add(ctx, slot, "packed_set", "pm1", FDB_OK, 1);
+    test_set_add(ctx, slot, "packed_set", "pm1", FDB_OK, 0);
+    test_set_add(ctx, slot, "packed_set", "pm2", FDB_OK, 1);
+    test_set_member_exists(ctx, slot, "packed_set", "pm2", FDB_OK, 1);
+    test_set_member_exists(ctx, slot, "packed_set", "pm4", FDB_OK, 0);
+    test_set_size(ctx, slot, "packed_set", FDB_OK, 3);
+    check_set_members(ctx, slot, "packed_set", members, 3);
+
+    test_set_add(ctx, slot, "packed_set", "pm4", FDB_OK, 1);
+    test_set_size(ctx, slot, "packed_set", FDB_OK, 4);
+    check_set_members(ctx, slot, "packed_set", members, 4);
+    test_set_rem(ctx, slot, "packed_set", "pm4", FDB_OK, 1);
+    test_set_rem(ctx, slot, "packed_set", "pm4", FDB_OK, 0);
+    test_set_size(ctx, slot, "packed_set", FDB_OK, 3);
+    check_set_members(ctx, slot, "packed_set", members, 3);
+
+    //an emptied set has no members either way
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    test_set_add(ctx, slot, "packed_set2", "pm1", FDB_OK, 1);
+    test_set_rem(ctx, slot, "packed_set2", "pm1", FDB_OK, 1);
+    test_set_size(ctx, slot, "packed_set2", FDB_OK, 0);
+    check_set_members(ctx, slot, "packed_set2", members, 0);
+}
+
+static fdb_array_t* test_set_slices(const char** smembers, size_t n){
+    fdb_array_t *members = fdb_array_create(n);
+    for(size_t i=0; i<n; ++i){
+        fdb_val_node_t *node = fdb_val_node_create();
+        node->val_.vval_ = fdb_slice_create(smembers[i], strlen(smembers[i]));
+        fdb_array_push_back(members, node);
+    }
+    return members;
+}
+
+static void test_set_slices_destroy(fdb_array_t* members){
+    for(size_t i=0; i<members->length_; ++i){
+        fdb_slice_destroy(fdb_array_at(members, i)->val_.vval_);
+        fdb_val_node_destroy(fdb_array_at(members, i));
+    }
+    fdb_array_destroy(members);
+}
+
+//members added and looked up many at a time, with repeats, packed and in subkeys
+void test_set_many(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *adds[] = {"m1", "m2", "m1", "m3", "m2"};
+    const char *more[] = {"m3", "m4", "m4"};
+    const char *looks[] = {"m1", "mx", "m4", "m1"};
+    const char *skeys[] = {"many_set", "many_set_packed"};
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        fdb_slice_t *key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        fdb_array_t *members = test_set_slices(adds, 5);
+        int64_t count = 0;
+        assert(set_add(ctx, slot, key, members, &count) == FDB_OK && count == 3);
+        test_set_slices_destroy(members);
+        members = test_set_slices(more, 3);
+        fdb_slice_destroy(key);
+        key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        assert(set_add(ctx, slot, key, members, &count) == FDB_OK && count == 1);
+        test_set_slices_destroy(members);
+        test_set_size(ctx, slot, skeys[k], FDB_OK, 4);
+
+        members = test_set_slices(looks, 4);
+        fdb_array_t *rets = NULL;
+        fdb_slice_destroy(key);
+        key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        assert(set_member_mexists(ctx, slot, key, members, &rets) == FDB_OK);
+        assert(rets->length_ == 4);
+        assert(fdb_array_at(rets, 0)->val_.uval_ == 1 && fdb_array_at(rets, 1)->val_.uval_ == 0);
+        assert(fdb_array_at(rets, 2)->val_.uval_ == 1 && fdb_array_at(rets, 3)->val_.uval_ == 1);
+        fdb_array_destroy(rets);
+        test_set_slices_destroy(members);
+        fdb_slice_destroy(key);
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+}
+
+//a whole set_sscan in chunks of count, the members matching pattern it came across
+static size_t test_set_scan_all(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* spattern, uint64_t count){
+    fdb_slice_t *pattern = fdb_slice_create(spattern, strlen(spattern));
+    fdb_slice_t *cursor = NULL;
+    size_t found = 0;
+    do{
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        assert(set_sscan(ctx, slot, key, cursor, pattern, count, &rets, &next) == FDB_OK);
+        assert(next == NULL || rets->length_ <= count);
+        for(size_t i=0; i<rets->length_; ++i){
+            fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, i)->val_.vval_);
+            assert(keys_match(pattern, fdb_slice_data(sl), fdb_slice_length(sl)));
+            fdb_slice_destroy(sl);
+        }
+        found += rets->length_;
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(cursor);
+        cursor = next;
+    }while(cursor != NULL);
+    fdb_slice_destroy(pattern);
+    return found;
+}
+
+void test_set_scan(fdb_context_t* ctx, fdb_slot_t* slot){
+    char member[8];
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int i=0; i<30; ++i){
+            snprintf(member, sizeof(member), "m%02d", i);
+            test_set_add(ctx, slot, (k == 0) ? "scan_set" : "scan_set_packed", member, FDB_OK, 1);
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+    const char *skeys[] = {"scan_set", "scan_set_packed"};
+    for(int k=0; k<2; ++k){
+        assert(test_set_scan_all(ctx, slot, skeys[k], "", 4) == 30);
+        assert(test_set_scan_all(ctx, slot, skeys[k], "m2*", 6) == 10);
+        assert(test_set_scan_all(ctx, slot, skeys[k], "m[0-1]5", 1) == 2);
+    }
+}
+
+static int alg_a(int i){ return i % 2 == 0; }
+static int alg_b(int i){ return i % 3 == 0; }
+static int alg_c(int i){ return i % 5 == 0; }
+static int alg_none(int i){ return 0; }
+static int alg_inter(int i){ return alg_a(i) && alg_b(i) && alg_c(i); }
+static int alg_inter_ab(int i){ return alg_a(i) && alg_b(i); }
+static int alg_union(int i){ return alg_a(i) || alg_b(i) || alg_c(i); }
+static int alg_diff(int i){ return alg_a(i) && !alg_b(i) && !alg_c(i); }
+
+//the members of rets against the ones of 0..39 that pred takes, in order
+static void check_set_algebra(fdb_array_t* rets, int (*pred)(int)){
+    char member[8];
+    size_t n = 0;
+    for(int i=0; i<40; ++i){
+        if(!pred(i)){
+            continue;
+        }
+        assert(n < rets->length_);
+        snprintf(member, sizeof(member), "a%02d", i);
+        fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, n)->val_.vval_);
+        assert(fdb_slice_length(sl) == strlen(member));
+        assert(memcmp(fdb_slice_data(sl), member, fdb_slice_length(sl)) == 0);
+        ++n;
+    }
+    assert(n == rets->length_);
+}
+
+static void test_set_combine(fdb_context_t* ctx, fdb_slot_t* slot, int op, const char** skeys, size_t n, int (*pred)(int)){
+    fdb_slice_t *keys[4];
+    for(size_t i=0; i<n; ++i){
+        keys[i] = fdb_slice_create(skeys[i], strlen(skeys[i]));
+    }
+    fdb_array_t *rets = NULL;
+    assert(set_combine(ctx, slot, op, n, keys, &rets) == FDB_OK);
+    check_set_algebra(rets, pred);
+    for(size_t i=0; i<rets->length_; ++i){
+        fdb_slice_destroy(fdb_array_at(rets, i)->val_.vval_);
+    }
+    fdb_array_destroy(rets);
+    for(size_t i=0; i<n; ++i){
+        fdb_slice_destroy(keys[i]);
+    }
+}
+
+static int64_t test_set_combine_store(fdb_context_t* ctx, fdb_slot_t* slot, int op, const char* sdest, const char** skeys, size_t n){
+    fdb_slice_t *keys[4];
+    for(size_t i=0; i<n; ++i){
+        keys[i] = fdb_slice_create(skeys[i], strlen(skeys[i]));
+    }
+    fdb_slice_t *dest = fdb_slice_create(sdest, strlen(sdest));
+    int64_t count = -1;
+    assert(set_combine_store(ctx, slot, op, dest, n, keys, &count) == FDB_OK);
+    fdb_slice_destroy(dest);
+    for(size_t i=0; i<n; ++i){
+        fdb_slice_destroy(keys[i]);
+    }
+    return count;
+}
+
+static void check_set_stored(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int (*pred)(int)){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_array_t *set = NULL;
+    assert(set_members(ctx, slot, key, &set) == FDB_OK);
+    check_set_algebra(set, pred);
+    test_set_size(ctx, slot, skey, FDB_OK, (int64_t)set->length_);
+    for(size_t i=0; i<set->length_; ++i){
+        fdb_slice_destroy(fdb_array_at(set, i)->val_.vval_);
+    }
+    fdb_array_destroy(set);
+    fdb_slice_destroy(key);
+}
+
+//inter, union and diff of sets in subkeys and packed, mixed, and stored back over a source
+void test_set_algebra(fdb_context_t* ctx, fdb_slot_t* slot){
+    char member[8];
+    const char *subkeys[] = {"alg_a", "alg_b", "alg_c"};
+    const char *packed[] = {"alg_pa", "alg_pb", "alg_pc"};
+    const char *mixed[] = {"alg_a", "alg_pb", "alg_c"};
+    int (*preds[])(int) = {alg_a, alg_b, alg_c};
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int s=0; s<3; ++s){
+            for(int i=0; i<40; ++i){
+                if(preds[s](i)){
+                    snprintf(member, sizeof(member), "a%02d", i);
+                    test_set_add(ctx, slot, (k == 0) ? subkeys[s] : packed[s], member, FDB_OK, 1);
+                }
+            }
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+
+    const char **groups[] = {subkeys, packed, mixed};
+    for(int g=0; g<3; ++g){
+        test_set_combine(ctx, slot, SET_INTER, groups[g], 3, alg_inter);
+        test_set_combine(ctx, slot, SET_INTER, groups[g], 2, alg_inter_ab);
+        test_set_combine(ctx, slot, SET_UNION, groups[g], 3, alg_union);
+        test_set_combine(ctx, slot, SET_DIFF, groups[g], 3, alg_diff);
+        test_set_combine(ctx, slot, SET_UNION, groups[g], 1, alg_a);
+    }
+
+    //a missing set is an empty one
+    const char *with_none[] = {"alg_a", "alg_none", "alg_pb"};
+    test_set_combine(ctx, slot, SET_INTER, with_none, 3, alg_none);
+    const char *none_first[] = {"alg_none", "alg_a"};
+    test_set_combine(ctx, slot, SET_DIFF, none_first, 2, alg_none);
+    test_set_combine(ctx, slot, SET_UNION, none_first, 2, alg_a);
+    test_set_combine(ctx, slot, SET_DIFF, with_none, 2, alg_a);
+
+    fdb_slice_t *keys[2];
+    for(int i=0; i<2; ++i){
+        keys[i] = fdb_slice_create(mixed[i], strlen(mixed[i]));
+    }
+    int64_t count = 0;
+    assert(set_inter_card(ctx, slot, 2, keys, 0, &count) == FDB_OK && count == 7);
+    assert(set_inter_card(ctx, slot, 2, keys, 3, &count) == FDB_OK && count == 3);
+    assert(set_inter_card(ctx, slot, 2, keys, 100, &count) == FDB_OK && count == 7);
+    for(int i=0; i<2; ++i){
+        fdb_slice_destroy(keys[i]);
+    }
+
+    //stored packed, spilled to subkeys part way, and in subkeys from the start
+    assert(test_set_combine_store(ctx, slot, SET_UNION, "alg_dest", mixed, 3) == 30);
+    check_set_stored(ctx, slot, "alg_dest", alg_union);
+    fdb_context_set_packed_limits(ctx, 4, 2048);
+    assert(test_set_combine_store(ctx, slot, SET_DIFF, "alg_dest", packed, 3) == 11);
+    check_set_stored(ctx, slot, "alg_dest", alg_diff);
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    assert(test_set_combine_store(ctx, slot, SET_INTER, "alg_dest", subkeys, 2) == 7);
+    check_set_stored(ctx, slot, "alg_dest", alg_inter_ab);
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+
+    //dest among the sources, then an empty result leaving no dest
+    const char *onto_a[] = {"alg_a", "alg_pb"};
+    assert(test_set_combine_store(ctx, slot, SET_INTER, "alg_a", onto_a, 2) == 7);
+    check_set_stored(ctx, slot, "alg_a", alg_inter_ab);
+    const char *onto_pa[] = {"alg_pa", "alg_c"};
+    assert(test_set_combine_store(ctx, slot, SET_UNION, "alg_pa", onto_pa, 2) == 24);
+    const char *empty[] = {"alg_pa", "alg_none"};
+    assert(test_set_combine_store(ctx, slot, SET_INTER, "alg_dest", empty, 2) == 0);
+    fdb_slice_t *dest = fdb_slice_create("alg_dest", strlen("alg_dest"));
+    uint8_t type = 0;
+    assert(keys_get(ctx, slot, dest, &type) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(dest);
+}
+
 int main(int argc, char* argv[]){
     fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_set", 128, 128, 2);
     fdb_slot_t **slots = (fdb_slot_t**)ctx->slots_;
@@ -128,6 +423,37 @@ int main(int argc, char* argv[]){
     
     test_set_size(ctx, slots[1], "key1", FDB_OK, 5);
 
+    //one command is one batch, a repeated member is counted once
+    fdb_slice_t *key2 = fdb_slice_create("key2", strlen("key2"));
+    fdb_slice_t *mber = fdb_slice_create("member1", strlen("member1"));
+    fdb_array_t *members = fdb_array_create(2);
+    for(int i=0; i<2; ++i){
+        fdb_val_node_t *member_node = fdb_val_node_create();
+        member_node->val_.vval_ = mber;
+        fdb_array_push_back(members, member_node);
+    }
+    int64_t add_count = 0;
+    assert(set_add(ctx, slots[1], key2, members, &add_count) == FDB_OK);
+    assert(add_count == 1);
+    test_set_size(ctx, slots[1], "key2", FDB_OK, 1);
+    int64_t rem_count = 0;
+    fdb_slice_destroy(key2);
+    key2 = fdb_slice_create("key2", strlen("key2"));
+    assert(set_rem(ctx, slots[1], key2, members, &rem_count) == FDB_OK);
+    assert(rem_count == 1);
+    test_set_size(ctx, slots[1], "key2", FDB_OK, 0);
+    fdb_array_destroy(members);
+    fdb_slice_destroy(mber);
+    fdb_slice_destroy(key2);
+
+    test_set_packed(ctx, slots[1]);
+
+    test_set_many(ctx, slots[1]);
+
+    test_set_scan(ctx, slots[1]);
+
+    test_set_algebra(ctx, slots[1]);
+
     fdb_context_destroy(ctx);
     return 0;
 }
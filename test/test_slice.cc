@@ -1,9 +1,68 @@
 #include <falcondb/fdb_slice.h>
+#include <falcondb/fdb_malloc.h>
 #include <deps/rocksdb-4.2/include/rocksdb/c.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
+void test_arena_alloc(){
+    fdb_arena_t *arena = fdb_arena_create(256);
+    assert(fdb_arena_usage(arena) == 0);
+    char *p1 = (char*)fdb_arena_alloc(arena, 3);
+    char *p2 = (char*)fdb_arena_alloc(arena, 8);
+    assert(((size_t)p2 & 7) == 0 && p2 >= p1 + 3);
+    memset(p1, 'a', 3);
+    memset(p2, 'b', 8);
+
+    //spilling into new blocks and a large allocation of its own
+    for(int i=0; i<100; ++i){
+        memset(fdb_arena_alloc(arena, 40), 'c', 40);
+    }
+    char *big = (char*)fdb_arena_alloc(arena, 4096);
+    memset(big, 'd', 4096);
+    assert(p1[0] == 'a' && p2[7] == 'b');
+    assert(fdb_arena_usage(arena) >= 3 + 8 + 100*40 + 4096);
+
+    fdb_arena_reset(arena);
+    assert(fdb_arena_usage(arena) == 0);
+    assert(fdb_arena_alloc(arena, 3) != NULL);
+    fdb_arena_destroy(arena);
+}
+
+void test_arena_slice(){
+    fdb_arena_t *arena = fdb_arena_create(64);
+    fdb_slice_t *slice = fdb_slice_create_in(arena, "falcondb", 8);
+    //growing past the block copies, it can not realloc
+    for(int i=0; i<64; ++i){
+        fdb_slice_string_push_back(slice, "0123456789", 10);
+        fdb_slice_uint8_push_front(slice, (uint8_t)i);
+    }
+    assert(fdb_slice_length(slice) == 8 + 64*11);
+    assert(rocksdb_decode_fixed8(fdb_slice_data(slice)) == 63);
+    assert(memcmp(fdb_slice_data(slice) + 64, "falcondb0123456789", 18) == 0);
+    //destroying is only a count drop, the memory goes with the reset
+    fdb_slice_destroy(slice);
+    fdb_arena_destroy(arena);
+}
+
+void test_arena_scope(){
+    assert(fdb_arena_current() == NULL);
+    fdb_arena_enter();
+    fdb_arena_t *arena = fdb_arena_current();
+    assert(arena != NULL);
+    fdb_slice_t *slice = fdb_slice_create_in(fdb_arena_current(), "outer", 5);
+    fdb_arena_enter();
+    //the nested command shares the arena, leaving it keeps what the outer one holds
+    assert(fdb_arena_current() == arena);
+    fdb_slice_create_in(fdb_arena_current(), "inner", 5);
+    fdb_arena_leave();
+    assert(memcmp(fdb_slice_data(slice), "outer", 5) == 0);
+    assert(fdb_arena_usage(arena) > 0);
+    fdb_arena_leave();
+    assert(fdb_arena_current() == NULL);
+    assert(fdb_arena_usage(arena) == 0);
+}
+
 int main(int argc, char* argv[]){
 
     const char* falcondb = "falcondb";
@@ -73,5 +132,9 @@ int main(int argc, char* argv[]){
     assert(val_uint64_2==0xFFFFEFFF2222); 
 
     fdb_slice_destroy(slice1);
+
+    test_arena_alloc();
+    test_arena_slice();
+    test_arena_scope();
     return 0;
 }
@@ -3,6 +3,11 @@
 #include <falcondb/fdb_define.h>
 #include <falcondb/fdb_types.h>
 #include <falcondb/t_string.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/fdb_codec.h>
+#include <falcondb/fdb_cache.h>
+#include <rocksdb/c.h>
+#include <falcondb/util.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -173,7 +178,70 @@ int main(int argc, char* argv[]){
 
     fdb_array_destroy(val_rets);
     
+    //slots[1] setex, the value and its expiry arrive together
+    int64_t left = 0;
+    ret = string_setex(ctx, slots[1], key1, val1, (int64_t)time_ms() + 100*1000);
+    assert(ret == FDB_OK);
+    assert(keys_pexpire_left(ctx, slots[1], key1, &left) == FDB_OK);
+    assert(left > 0 && left <= 100*1000);
+    ret = string_setnxex(ctx, slots[1], key1, val2, (int64_t)time_ms() + 100*1000);
+    assert(ret == FDB_OK_BUT_ALREADY_EXIST);
+    ret = string_setex(ctx, slots[1], key1, val1, (int64_t)time_ms() - 1000);
+    assert(ret == FDB_OK);
+    ret = string_get(ctx, slots[1], key1, &get_val1);
+    assert(ret == FDB_OK_NOT_EXIST);
+    ret = string_setnxex(ctx, slots[1], key1, val2, (int64_t)time_ms() + 100*1000);
+    assert(ret == FDB_OK);
+    ret = string_set(ctx, slots[1], key1, val1);
+    assert(ret == FDB_OK);
+    assert(keys_pexpire_left(ctx, slots[1], key1, &left) == FDB_OK);
+    assert(left == -2);
+
+    //slots[1] incr, the counter is kept as a binary int64 and read back as decimal
+    fdb_slice_t *key5 = fdb_slice_create("string_key5", strlen("string_key5"));
+    fdb_slice_t *val5 = fdb_slice_create("41", strlen("41"));
+    assert(string_set(ctx, slots[1], key5, val5) == FDB_OK);
+    int64_t nval5 = 0;
+    assert(string_incr(ctx, slots[1], key5, 0, 1, &nval5) == FDB_OK);
+    assert(nval5 == 42);
+    assert(string_incr(ctx, slots[1], key5, 0, INT64_MAX, &nval5) == FDB_ERR_INCDECR_OVERFLOW);
+    assert(string_incr(ctx, slots[1], key5, 0, -100, &nval5) == FDB_OK);
+    assert(nval5 == -58);
+
+    char rkey5[64];
+    size_t rkey5len = fdb_codec_encode_keys_key(rkey5, "string_key5", strlen("string_key5"));
+    size_t rval5len = 0;
+    char *errptr = NULL;
+    char *rval5 = fdb_slot_writebatch_get(ctx, slots[1], rkey5, rkey5len, &rval5len, &errptr);
+    assert(errptr == NULL && rval5 != NULL);
+    assert(rval5[0] == FDB_DATA_TYPE_INT64 && rval5len == fdb_codec_keys_val_size(sizeof(int64_t)));
+    rocksdb_free(rval5);
+
+    //read back from the db as well as from the keys cache
+    for(int i=0; i<2; ++i){
+        if(i == 1){
+            fdb_cache_erase((fdb_cache_t*)ctx->keys_cache_, slots[1]->id_, "string_key5", strlen("string_key5"));
+        }
+        ret = string_get(ctx, slots[1], key5, &get_val1);
+        assert(ret == FDB_OK);
+        assert(fdb_slice_length(get_val1) == 3 && memcmp(fdb_slice_data(get_val1), "-58", 3) == 0);
+        fdb_slice_destroy(get_val1);
+    }
+    assert(string_incr(ctx, slots[1], key5, 0, 8, &nval5) == FDB_OK);
+    assert(nval5 == -50);
 
+    //a plain set takes the key back to text
+    assert(string_set(ctx, slots[1], key5, val1) == FDB_OK);
+    ret = string_get(ctx, slots[1], key5, &get_val1);
+    assert(ret == FDB_OK);
+    assert(compare_with_length(fdb_slice_data(get_val1), fdb_slice_length(get_val1), fdb_slice_data(val1), fdb_slice_length(val1)) == 0);
+    fdb_slice_destroy(get_val1);
+    fdb_slice_t *empty = fdb_slice_create("", 0);
+    assert(string_set(ctx, slots[1], key5, empty) == FDB_OK);
+    assert(string_incr(ctx, slots[1], key5, 0, 1, &nval5) == FDB_ERR_IS_NOT_INTEGER);
+    fdb_slice_destroy(empty);
+    fdb_slice_destroy(val5);
+    fdb_slice_destroy(key5);
 
 
     fdb_slice_destroy(key1);
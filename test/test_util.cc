@@ -59,6 +59,21 @@ int main(int argc, char* argv[]){
     assert(memcmp(a3_char_array, c3_char_array, sizeof(double))>0);
     assert(memcmp(a3_char_array, b3_char_array, sizeof(double))>0);
 
+    //glob patterns of the cursor scans
+    assert(string_match_len("*", 1, "", 0, 0) == 1);
+    assert(string_match_len("user:*", 6, "user:42", 7, 0) == 1);
+    assert(string_match_len("user:*", 6, "usr:42", 6, 0) == 0);
+    assert(string_match_len("*:4?", 4, "user:42", 7, 0) == 1);
+    assert(string_match_len("*:4?", 4, "user:4", 6, 0) == 0);
+    assert(string_match_len("a*b*c", 5, "axxbyybzc", 9, 0) == 1);
+    assert(string_match_len("a*b*c", 5, "axxbyybz", 8, 0) == 0);
+    assert(string_match_len("k[a-c]y", 7, "kby", 3, 0) == 1);
+    assert(string_match_len("k[^a-c]y", 8, "kby", 3, 0) == 0);
+    assert(string_match_len("k[^a-c]y", 8, "kdy", 3, 0) == 1);
+    assert(string_match_len("k\\*y", 4, "k*y", 3, 0) == 1);
+    assert(string_match_len("k\\*y", 4, "kxy", 3, 0) == 0);
+    assert(string_match_len("KEY", 3, "key", 3, 1) == 1);
+    assert(string_match_len("KEY", 3, "key", 3, 0) == 0);
 
     return 0;
 }
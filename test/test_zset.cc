@@ -3,10 +3,17 @@
 #include <falcondb/fdb_define.h>
 #include <falcondb/fdb_types.h>
 #include <falcondb/t_zset.h>
+#include <falcondb/t_keys.h>
+#include <falcondb/t_dels.h>
+#include <falcondb/util.h>
+#include <falcondb/fdb_codec.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 void print_zset_range(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int reverse){
     fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
@@ -156,6 +163,1168 @@ void test_zset_rem_range_by_score(fdb_context_t* ctx, fdb_slot_t* slot, const ch
     fdb_slice_destroy(key);
 }
 
+#define TEST_ZSET_RANK_MEMBERS  3000
+
+//the writes go through here, see test/Makefile, the one armed fails
+static int test_zset_writes_to_fail = 0;
+static int test_zset_writes = 0;
+
+extern "C" void __real_rocksdb_write(rocksdb_t* db, const rocksdb_writeoptions_t* options, rocksdb_writebatch_t* batch, char** errptr);
+
+extern "C" void __wrap_rocksdb_write(rocksdb_t* db, const rocksdb_writeoptions_t* options, rocksdb_writebatch_t* batch, char** errptr){
+    __sync_add_and_fetch(&test_zset_writes, 1);
+    if(test_zset_writes_to_fail > 0 && --test_zset_writes_to_fail == 0){
+        *errptr = strdup("injected write failure");
+        return;
+    }
+    __real_rocksdb_write(db, options, batch, errptr);
+}
+
+struct test_zset_member_t {
+    double  score_;
+    char    member_[16];
+};
+
+static int test_zset_member_compare(const void* a, const void* b){
+    const struct test_zset_member_t *ma = (const struct test_zset_member_t*)a;
+    const struct test_zset_member_t *mb = (const struct test_zset_member_t*)b;
+    if(ma->score_ != mb->score_){
+        return (ma->score_ < mb->score_) ? -1 : 1;
+    }
+    return strcmp(ma->member_, mb->member_);
+}
+
+//every rank, a few pages and counts against the members sorted here
+void check_zset_rank_index(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, struct test_zset_member_t* members, int n){
+    qsort(members, n, sizeof(struct test_zset_member_t), test_zset_member_compare);
+    for(int i=0; i<n; ++i){
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_slice_t *mber = fdb_slice_create(members[i].member_, strlen(members[i].member_));
+        int64_t rank = -1;
+        assert(zset_rank(ctx, slot, key, mber, 0, &rank) == FDB_OK && rank == i);
+        fdb_slice_destroy(key);
+        key = fdb_slice_create(skey, strlen(skey));
+        assert(zset_rank(ctx, slot, key, mber, 1, &rank) == FDB_OK && rank == n - 1 - i);
+        fdb_slice_destroy(mber);
+        fdb_slice_destroy(key);
+    }
+
+    int offsets[] = {0, 1, 47, 48, n/2, n - 11, n - 1};
+    for(size_t k=0; k<sizeof(offsets)/sizeof(offsets[0]); ++k){
+        for(int reverse=0; reverse<2; ++reverse){
+            fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+            fdb_array_t *range = NULL;
+            assert(zset_range(ctx, slot, key, offsets[k], offsets[k] + 9, reverse, &range) == FDB_OK);
+            fdb_slice_destroy(key);
+            int expect = (n - offsets[k] < 10) ? n - offsets[k] : 10;
+            assert(range->length_ == 2*(size_t)expect);
+            for(int i=0; i<expect; ++i){
+                int at = reverse ? n - 1 - offsets[k] - i : offsets[k] + i;
+                fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(range, 2*i + 1)->val_.vval_);
+                assert(fdb_array_at(range, 2*i)->val_.dval_ == members[at].score_);
+                assert(fdb_slice_length(sl) == strlen(members[at].member_));
+                assert(memcmp(fdb_slice_data(sl), members[at].member_, fdb_slice_length(sl)) == 0);
+                fdb_slice_destroy(sl);
+            }
+            fdb_array_destroy(range);
+        }
+    }
+
+    double bounds[][2] = {{-100.0, 100.0}, {-12.5, 37.2}, {0.0, 0.0}, {99.9, 1000.0}, {-1000.0, -99.9}};
+    for(size_t k=0; k<sizeof(bounds)/sizeof(bounds[0]); ++k){
+        for(uint8_t type=0; type<4; ++type){
+            if(bounds[k][0] == bounds[k][1] && type != 0){
+                continue;
+            }
+            int64_t expect = 0, count = -1;
+            for(int i=0; i<n; ++i){
+                double score = members[i].score_;
+                if((score > bounds[k][0] || (score == bounds[k][0] && !(type & 0x1))) &&
+                   (score < bounds[k][1] || (score == bounds[k][1] && !(type & 0x2)))){
+                    ++expect;
+                }
+            }
+            fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+            assert(zset_count(ctx, slot, key, bounds[k][0], bounds[k][1], type, &count) == FDB_OK);
+            assert(count == expect);
+            fdb_slice_destroy(key);
+        }
+    }
+}
+
+void test_zset_rank_index(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *skey = "key_rank";
+    struct test_zset_member_t *members = (struct test_zset_member_t*)malloc(TEST_ZSET_RANK_MEMBERS*sizeof(struct test_zset_member_t));
+    int n = TEST_ZSET_RANK_MEMBERS;
+    //scores repeat, so members break ties
+    for(int i=0; i<n; ++i){
+        members[i].score_ = ((i*7919)%2001 - 1000)/10.0;
+        sprintf(members[i].member_, "m%05d", i);
+    }
+
+    //the commands prefix the key with its seq, so each one gets its own
+    for(int i=0; i<n; i+=100){
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *array = fdb_array_create(200);
+        for(int j=i; j<i+100 && j<n; ++j){
+            fdb_val_node_t *score_node = fdb_val_node_create();
+            score_node->val_.dval_ = members[j].score_;
+            fdb_array_push_back(array, score_node);
+            fdb_val_node_t *member_node = fdb_val_node_create();
+            member_node->val_.vval_ = fdb_slice_create(members[j].member_, strlen(members[j].member_));
+            fdb_array_push_back(array, member_node);
+        }
+        int64_t count = 0;
+        assert(zset_add(ctx, slot, key, array, &count) == FDB_OK && count == (int64_t)array->length_/2);
+        for(size_t j=1; j<array->length_; j+=2){
+            fdb_slice_destroy(fdb_array_at(array, j)->val_.vval_);
+        }
+        fdb_array_destroy(array);
+        fdb_slice_destroy(key);
+    }
+    test_zset_size(ctx, slot, skey, FDB_OK, n);
+    check_zset_rank_index(ctx, slot, skey, members, n);
+
+    //moving members, the old entries leave the tree
+    for(int i=0; i<n; i+=7){
+        test_zset_incr(ctx, slot, skey, members[i].member_, FDB_OK, 0.0, 55.5, members[i].score_ + 55.5);
+        members[i].score_ += 55.5;
+    }
+    check_zset_rank_index(ctx, slot, skey, members, n);
+
+    //removing by rank, then half of the rest one by one
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    int64_t count = -1;
+    assert(zset_rem_range_by_rank(ctx, slot, key, 100, 349, &count) == FDB_OK && count == 250);
+    memmove(&members[100], &members[350], (n - 350)*sizeof(struct test_zset_member_t));
+    n -= 250;
+    fdb_slice_destroy(key);
+    test_zset_size(ctx, slot, skey, FDB_OK, n);
+    check_zset_rank_index(ctx, slot, skey, members, n);
+
+    int kept = 0;
+    for(int i=0; i<n; ++i){
+        if(i%2 == 0){
+            test_zset_rem(ctx, slot, skey, members[i].member_, FDB_OK, 1);
+        }else{
+            members[kept++] = members[i];
+        }
+    }
+    n = kept;
+    test_zset_size(ctx, slot, skey, FDB_OK, n);
+    check_zset_rank_index(ctx, slot, skey, members, n);
+
+    //a zset written before it had a tree gets one built on first use
+    key = fdb_slice_create(skey, strlen(skey));
+    assert(keys_exs(ctx, slot, key, FDB_DATA_TYPE_ZSET) == FDB_OK);
+    char meta[FDB_CODEC_STACK_SIZE];
+    size_t metalen = fdb_codec_encode_zrank_key(meta, fdb_slice_data(key), fdb_slice_length(key), 0);
+    fdb_slot_writebatch_delete(slot, meta, metalen);
+    char *errptr = NULL;
+    fdb_slot_writebatch_commit(ctx, slot, &errptr);
+    assert(errptr == NULL);
+    fdb_slice_destroy(key);
+    check_zset_rank_index(ctx, slot, skey, members, n);
+    test_zset_add(ctx, slot, skey, "m_new", -5000.0, FDB_OK, 1);
+    test_zset_rank(ctx, slot, skey, "m_new", FDB_OK, 0);
+    test_zset_rem(ctx, slot, skey, "m_new", FDB_OK, 1);
+
+    for(int i=0; i<n; ++i){
+        test_zset_rem(ctx, slot, skey, members[i].member_, FDB_OK, 1);
+    }
+    test_zset_size(ctx, slot, skey, FDB_OK, 0);
+    free(members);
+}
+
+
+static void test_zset_same_array(int ret1, fdb_array_t* a1, int ret2, fdb_array_t* a2){
+    assert(ret1 == ret2);
+    if(ret1 != FDB_OK){
+        return;
+    }
+    assert(a1->length_ == a2->length_);
+    for(size_t i=0; i<a1->length_; i+=2){
+        assert(fdb_array_at(a1, i)->val_.dval_ == fdb_array_at(a2, i)->val_.dval_);
+        fdb_slice_t *m1 = (fdb_slice_t*)(fdb_array_at(a1, i + 1)->val_.vval_);
+        fdb_slice_t *m2 = (fdb_slice_t*)(fdb_array_at(a2, i + 1)->val_.vval_);
+        assert(fdb_slice_length(m1) == fdb_slice_length(m2));
+        assert(memcmp(fdb_slice_data(m1), fdb_slice_data(m2), fdb_slice_length(m1)) == 0);
+        fdb_slice_destroy(m1);
+        fdb_slice_destroy(m2);
+    }
+    fdb_array_destroy(a1);
+    fdb_array_destroy(a2);
+}
+
+//ranges, ranks, counts and scans of zset skey against those of pkey, same members kept otherwise
+static void check_zset_same(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* pkey){
+    int ranks[][2] = {{0, -1}, {1, 3}, {-3, -1}, {2, 100}, {5, 2}};
+    for(size_t k=0; k<sizeof(ranks)/sizeof(ranks[0]); ++k){
+        for(int reverse=0; reverse<2; ++reverse){
+            fdb_slice_t *key1 = fdb_slice_create(skey, strlen(skey));
+            fdb_slice_t *key2 = fdb_slice_create(pkey, strlen(pkey));
+            fdb_array_t *a1 = NULL, *a2 = NULL;
+            int ret1 = zset_range(ctx, slot, key1, ranks[k][0], ranks[k][1], reverse, &a1);
+            int ret2 = zset_range(ctx, slot, key2, ranks[k][0], ranks[k][1], reverse, &a2);
+            test_zset_same_array(ret1, a1, ret2, a2);
+            fdb_slice_destroy(key1);
+            fdb_slice_destroy(key2);
+        }
+    }
+
+    double bounds[][2] = {{-100.0, 100.0}, {-2.5, 3.5}, {1.5, 1.5}, {-1000.0, -99.0}};
+    for(size_t k=0; k<sizeof(bounds)/sizeof(bounds[0]); ++k){
+        for(uint8_t type=0; type<4; ++type){
+            fdb_slice_t *key1 = fdb_slice_create(skey, strlen(skey));
+            fdb_slice_t *key2 = fdb_slice_create(pkey, strlen(pkey));
+            int64_t c1 = -1, c2 = -1;
+            assert(zset_count(ctx, slot, key1, bounds[k][0], bounds[k][1], type, &c1) == FDB_OK);
+            assert(zset_count(ctx, slot, key2, bounds[k][0], bounds[k][1], type, &c2) == FDB_OK);
+            assert(c1 == c2);
+            fdb_slice_destroy(key1);
+            fdb_slice_destroy(key2);
+
+            key1 = fdb_slice_create(skey, strlen(skey));
+            key2 = fdb_slice_create(pkey, strlen(pkey));
+            fdb_array_t *a1 = NULL, *a2 = NULL;
+            int ret1 = zset_scan(ctx, slot, key1, bounds[k][0], bounds[k][1], 0, type, &a1);
+            int ret2 = zset_scan(ctx, slot, key2, bounds[k][0], bounds[k][1], 0, type, &a2);
+            test_zset_same_array(ret1, a1, ret2, a2);
+            fdb_slice_destroy(key1);
+            fdb_slice_destroy(key2);
+        }
+    }
+
+    const char *members[] = {"pm0", "pm1", "pm2", "pm3", "pm4", "pm5", "pm6", "pm7", "pm8", "pm9", "pmx"};
+    for(size_t k=0; k<sizeof(members)/sizeof(members[0]); ++k){
+        for(int reverse=0; reverse<2; ++reverse){
+            fdb_slice_t *key1 = fdb_slice_create(skey, strlen(skey));
+            fdb_slice_t *key2 = fdb_slice_create(pkey, strlen(pkey));
+            fdb_slice_t *member = fdb_slice_create(members[k], strlen(members[k]));
+            int64_t r1 = -1, r2 = -1;
+            assert(zset_rank(ctx, slot, key1, member, reverse, &r1) == zset_rank(ctx, slot, key2, member, reverse, &r2));
+            assert(r1 == r2);
+            fdb_slice_destroy(member);
+            fdb_slice_destroy(key1);
+            fdb_slice_destroy(key2);
+        }
+    }
+}
+
+//a zset packed in its main key answers as one in subkeys, before and after it outgrows the limits
+void test_zset_packed(fdb_context_t* ctx, fdb_slot_t* slot){
+    double scores[] = {1.5, -2.5, 3.5, 1.5, 0.0, -99.0, 7.25, 1.5, 3.5, 100.0};
+    char member[8];
+
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    for(int i=0; i<6; ++i){
+        snprintf(member, sizeof(member), "pm%d", i);
+        test_zset_add(ctx, slot, "subkeys_zset", member, scores[i], FDB_OK, 1);
+    }
+    fdb_context_set_packed_limits(ctx, 8, 2048);
+    for(int i=5; i>=0; --i){
+        snprintf(member, sizeof(member), "pm%d", i);
+        test_zset_add(ctx, slot, "packed_zset", member, scores[i], FDB_OK, 1);
+    }
+    test_zset_add(ctx, slot, "packed_zset", "pm2", scores[2], FDB_OK, 0);
+    test_zset_size(ctx, slot, "packed_zset", FDB_OK, 6);
+    test_zset_score(ctx, slot, "packed_zset", "pm1", FDB_OK, -2.5);
+    test_zset_score(ctx, slot, "packed_zset", "pmx", FDB_OK_NOT_EXIST, 0.0);
+    check_zset_same(ctx, slot, "subkeys_zset", "packed_zset");
+
+    test_zset_incr(ctx, slot, "subkeys_zset", "pm4", FDB_OK, 0.0, 2.0, 2.0);
+    test_zset_incr(ctx, slot, "packed_zset", "pm4", FDB_OK, 0.0, 2.0, 2.0);
+    test_zset_incr(ctx, slot, "subkeys_zset", "pm6", FDB_OK, 7.0, 0.25, 7.25);
+    test_zset_incr(ctx, slot, "packed_zset", "pm6", FDB_OK, 7.0, 0.25, 7.25);
+    test_zset_rem(ctx, slot, "subkeys_zset", "pm0", FDB_OK, 1);
+    test_zset_rem(ctx, slot, "packed_zset", "pm0", FDB_OK, 1);
+    check_zset_same(ctx, slot, "subkeys_zset", "packed_zset");
+
+    //the ninth member moves it to subkeys
+    for(int i=7; i<10; ++i){
+        snprintf(member, sizeof(member), "pm%d", i);
+        test_zset_add(ctx, slot, "subkeys_zset", member, scores[i], FDB_OK, 1);
+        test_zset_add(ctx, slot, "packed_zset", member, scores[i], FDB_OK, 1);
+        check_zset_same(ctx, slot, "subkeys_zset", "packed_zset");
+    }
+    test_zset_size(ctx, slot, "packed_zset", FDB_OK, 9);
+
+    test_zset_rem_range_by_rank(ctx, slot, "subkeys_zset", FDB_OK, 0, 1, 2);
+    test_zset_rem_range_by_rank(ctx, slot, "packed_zset", FDB_OK, 0, 1, 2);
+    check_zset_same(ctx, slot, "subkeys_zset", "packed_zset");
+
+    //and the same on one still packed
+    test_zset_add(ctx, slot, "packed_zset2", "pm3", 1.5, FDB_OK, 1);
+    test_zset_add(ctx, slot, "packed_zset2", "pm1", -2.5, FDB_OK, 1);
+    test_zset_add(ctx, slot, "packed_zset2", "pm5", -99.0, FDB_OK, 1);
+    test_zset_add(ctx, slot, "packed_zset2", "pm2", 3.5, FDB_OK, 1);
+    test_zset_rem_range_by_rank(ctx, slot, "packed_zset2", FDB_OK, 0, 1, 2);
+    test_zset_rank(ctx, slot, "packed_zset2", "pm2", FDB_OK, 1);
+    test_zset_rem_range_by_score(ctx, slot, "packed_zset2", FDB_OK, 1.5, 3.5, 1, 1);
+    test_zset_size(ctx, slot, "packed_zset2", FDB_OK, 1);
+    test_zset_rank(ctx, slot, "packed_zset2", "pm3", FDB_OK, 0);
+
+    test_zset_rem_range_by_score(ctx, slot, "subkeys_zset", FDB_OK, -2.5, 3.5, 2, 3);
+    test_zset_rem_range_by_score(ctx, slot, "packed_zset", FDB_OK, -2.5, 3.5, 2, 3);
+    check_zset_same(ctx, slot, "subkeys_zset", "packed_zset");
+
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+}
+
+//members added and scored many at a time, a repeated member taking its last score
+void test_zset_many(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *smembers[] = {"zm1", "zm2", "zm1", "zm3"};
+    double scores[] = {1.0, 2.0, 5.0, -3.0};
+    const char *looks[] = {"zm3", "zmx", "zm1", "zm2"};
+    const char *skeys[] = {"many_zset", "many_zset_packed"};
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        fdb_slice_t *key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        fdb_array_t *sms = fdb_array_create(8);
+        for(int i=0; i<4; ++i){
+            fdb_val_node_t *score_node = fdb_val_node_create();
+            score_node->val_.dval_ = scores[i];
+            fdb_array_push_back(sms, score_node);
+            fdb_val_node_t *member_node = fdb_val_node_create();
+            member_node->val_.vval_ = fdb_slice_create(smembers[i], strlen(smembers[i]));
+            fdb_array_push_back(sms, member_node);
+        }
+        int64_t count = -1;
+        assert(zset_add(ctx, slot, key, sms, &count) == FDB_OK && count == 3);
+        for(int i=0; i<4; ++i){
+            fdb_slice_destroy(fdb_array_at(sms, 2*i+1)->val_.vval_);
+        }
+        fdb_array_destroy(sms);
+        test_zset_size(ctx, slot, skeys[k], FDB_OK, 3);
+        test_zset_rank(ctx, slot, skeys[k], "zm1", FDB_OK, 2);
+
+        fdb_array_t *members = fdb_array_create(4);
+        for(int i=0; i<4; ++i){
+            fdb_val_node_t *node = fdb_val_node_create();
+            node->val_.vval_ = fdb_slice_create(looks[i], strlen(looks[i]));
+            fdb_array_push_back(members, node);
+        }
+        fdb_array_t *rets = NULL;
+        fdb_slice_destroy(key);
+        key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        assert(zset_mscore(ctx, slot, key, members, &rets) == FDB_OK && rets->length_ == 4);
+        assert(fdb_array_at(rets, 0)->retval_ == FDB_OK && fdb_array_at(rets, 0)->val_.dval_ == -3.0);
+        assert(fdb_array_at(rets, 1)->retval_ == FDB_OK_NOT_EXIST);
+        assert(fdb_array_at(rets, 2)->retval_ == FDB_OK && fdb_array_at(rets, 2)->val_.dval_ == 5.0);
+        assert(fdb_array_at(rets, 3)->retval_ == FDB_OK && fdb_array_at(rets, 3)->val_.dval_ == 2.0);
+        fdb_array_destroy(rets);
+        for(int i=0; i<4; ++i){
+            fdb_slice_destroy(fdb_array_at(members, i)->val_.vval_);
+        }
+        fdb_array_destroy(members);
+        fdb_slice_destroy(key);
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+}
+
+//a whole zset_zscan in chunks of count, the members matching pattern it came across, each
+//with the score it was given below
+static size_t test_zset_scan_all(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* spattern, uint64_t count){
+    fdb_slice_t *pattern = fdb_slice_create(spattern, strlen(spattern));
+    fdb_slice_t *cursor = NULL;
+    size_t found = 0;
+    do{
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        assert(zset_zscan(ctx, slot, key, cursor, pattern, count, &rets, &next) == FDB_OK);
+        for(size_t i=0; i<rets->length_; i+=2){
+            double score = fdb_array_at(rets, i)->val_.dval_;
+            fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, i+1)->val_.vval_);
+            assert(keys_match(pattern, fdb_slice_data(sl), fdb_slice_length(sl)));
+            assert(score == -atoi(fdb_slice_data(sl) + 1) * 1.5);
+            fdb_slice_destroy(sl);
+        }
+        found += rets->length_/2;
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(cursor);
+        cursor = next;
+    }while(cursor != NULL);
+    fdb_slice_destroy(pattern);
+    return found;
+}
+
+void test_zset_zscan(fdb_context_t* ctx, fdb_slot_t* slot){
+    char member[8];
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int i=0; i<20; ++i){
+            snprintf(member, sizeof(member), "z%02d", i);
+            test_zset_add(ctx, slot, (k == 0) ? "scan_zset" : "scan_zset_packed", member, -i * 1.5, FDB_OK, 1);
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+    const char *skeys[] = {"scan_zset", "scan_zset_packed"};
+    for(int k=0; k<2; ++k){
+        assert(test_zset_scan_all(ctx, slot, skeys[k], "", 3) == 20);
+        assert(test_zset_scan_all(ctx, slot, skeys[k], "z1*", 20) == 10);
+        assert(test_zset_scan_all(ctx, slot, skeys[k], "*7", 2) == 2);
+    }
+}
+
+//a whole zset_range_by_score in chunks of count, offset only on the first, the scores checked
+//in range and in order, returns how many it came across
+static size_t test_zset_range_by_score_all(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, double start, double end,
+                                           uint8_t type, int reverse, uint64_t offset, uint64_t count, const char* sfirst){
+    double min = reverse ? end : start, max = reverse ? start : end;
+    int open_min = reverse ? (type & 0x2) : (type & 0x1), open_max = reverse ? (type & 0x1) : (type & 0x2);
+    fdb_slice_t *cursor = NULL;
+    size_t found = 0;
+    double last = 0.0;
+    do{
+        fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        int ret = zset_range_by_score(ctx, slot, key, start, end, type, reverse, offset, count, cursor, &rets, &next);
+        fdb_slice_destroy(key);
+        fdb_slice_destroy(cursor);
+        cursor = NULL;
+        if(ret == FDB_OK_RANGE_HAVE_NONE){
+            assert(next == NULL);
+            break;
+        }
+        assert(ret == FDB_OK);
+        assert(count == 0 || rets->length_/2 <= count);
+        for(size_t i=0; i<rets->length_; i+=2){
+            double score = fdb_array_at(rets, i)->val_.dval_;
+            fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, i+1)->val_.vval_);
+            assert(score >= min && score <= max);
+            assert(!(open_min && score == min) && !(open_max && score == max));
+            if(found > 0){
+                assert(reverse ? score < last : score > last);
+            }else if(sfirst != NULL){
+                assert(fdb_slice_length(sl) == strlen(sfirst) && memcmp(fdb_slice_data(sl), sfirst, strlen(sfirst)) == 0);
+            }
+            last = score;
+            ++found;
+            fdb_slice_destroy(sl);
+        }
+        fdb_array_destroy(rets);
+        cursor = next;
+        offset = 0;
+    }while(cursor != NULL);
+    return found;
+}
+
+//on the zsets of test_zset_zscan, z00 to z19 scored 0.0 down to -28.5
+void test_zset_range_by_score(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *skeys[] = {"scan_zset", "scan_zset_packed"};
+    for(int k=0; k<2; ++k){
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -30.0, 0.0, 0, 0, 0, 3, "z19") == 20);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], 0.0, -30.0, 0, 1, 0, 7, "z00") == 20);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -30.0, 0.0, 0, 0, 0, 20, "z19") == 20);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -15.0, -3.0, 0, 0, 0, 2, "z10") == 9);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -15.0, -3.0, 0x1|0x2, 0, 0, 2, "z09") == 7);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -3.0, -15.0, 0x1, 1, 0, 4, "z03") == 8);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -15.0, -3.0, 0, 0, 2, 0, "z08") == 7);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -3.0, -15.0, 0, 1, 2, 2, "z04") == 7);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -15.0, -3.0, 0, 0, 100, 2, NULL) == 0);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -3.0, -15.0, 0, 0, 0, 2, NULL) == 0);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], -3.0, -3.0, 0x1, 0, 0, 2, NULL) == 0);
+        assert(test_zset_range_by_score_all(ctx, slot, skeys[k], 1.0, 5.0, 0, 0, 0, 2, NULL) == 0);
+
+        //the cursor goes on right past the member it ends on, even once that one is gone
+        fdb_slice_t *key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        fdb_array_t *rets = NULL;
+        fdb_slice_t *next = NULL;
+        assert(zset_range_by_score(ctx, slot, key, -30.0, 0.0, 0, 0, 0, 3, NULL, &rets, &next) == FDB_OK);
+        assert(rets->length_ == 6 && next != NULL);
+        for(size_t i=0; i<rets->length_; i+=2){
+            fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(rets, i+1)->val_.vval_));
+        }
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(key);
+        test_zset_rem(ctx, slot, skeys[k], "z17", FDB_OK, 1);
+        key = fdb_slice_create(skeys[k], strlen(skeys[k]));
+        fdb_slice_t *cursor = next;
+        assert(zset_range_by_score(ctx, slot, key, -30.0, 0.0, 0, 0, 0, 1, cursor, &rets, &next) == FDB_OK);
+        fdb_slice_destroy(cursor);
+        fdb_slice_destroy(next);
+        fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, 1)->val_.vval_);
+        assert(rets->length_ == 2 && memcmp(fdb_slice_data(sl), "z16", 3) == 0);
+        fdb_slice_destroy(sl);
+        fdb_array_destroy(rets);
+        fdb_slice_destroy(key);
+    }
+}
+
+static const char *lex_members[] = {"a", "ab", "b", "ba", "bb", "c", "d", "e"};
+
+//the members of lex_members in range as zlex takes it, brute force
+static int test_zset_lex_in(const char* m, const char* min, const char* max, uint8_t type){
+    if(!(type & 0x4)){
+        int cmp = strcmp(m, min);
+        if(cmp < 0 || (cmp == 0 && (type & 0x1))){
+            return 0;
+        }
+    }
+    if(!(type & 0x8)){
+        int cmp = strcmp(m, max);
+        if(cmp > 0 || (cmp == 0 && (type & 0x2))){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_zset_lex_check(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* min, const char* max, uint8_t type){
+    size_t n = sizeof(lex_members)/sizeof(lex_members[0]);
+    int64_t expect = 0;
+    for(size_t i=0; i<n; ++i){
+        expect += test_zset_lex_in(lex_members[i], min, max, type);
+    }
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t *smin = fdb_slice_create(min, strlen(min));
+    fdb_slice_t *smax = fdb_slice_create(max, strlen(max));
+    int64_t count = -1;
+    assert(zset_lex_count(ctx, slot, key, smin, smax, type, &count) == FDB_OK);
+    assert(count == expect);
+    fdb_slice_destroy(key);
+
+    uint64_t offsets[] = {0, 1, 3};
+    uint64_t counts[] = {0, 1, 2, 100};
+    for(int reverse=0; reverse<2; ++reverse){
+        for(size_t o=0; o<3; ++o){
+            for(size_t c=0; c<4; ++c){
+                //the swapped bits open and unbound the same ends in reverse
+                uint8_t rtype = (uint8_t)(((type & 0x1) << 1) | ((type & 0x2) >> 1) | ((type & 0x4) << 1) | ((type & 0x8) >> 1));
+                key = fdb_slice_create(skey, strlen(skey));
+                fdb_array_t *rets = NULL;
+                int ret = reverse ? zset_range_by_lex(ctx, slot, key, smax, smin, rtype, 1, offsets[o], counts[c], &rets)
+                                  : zset_range_by_lex(ctx, slot, key, smin, smax, type, 0, offsets[o], counts[c], &rets);
+                fdb_slice_destroy(key);
+                size_t got = 0, seen = 0;
+                for(size_t k=0; k<n; ++k){
+                    const char *m = lex_members[reverse ? n - 1 - k : k];
+                    if(!test_zset_lex_in(m, min, max, type)){
+                        continue;
+                    }
+                    if(seen++ < offsets[o] || (counts[c] > 0 && got == counts[c])){
+                        continue;
+                    }
+                    assert(ret == FDB_OK && 2*got + 1 < rets->length_);
+                    fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, 2*got + 1)->val_.vval_);
+                    assert(fdb_slice_length(sl) == strlen(m) && memcmp(fdb_slice_data(sl), m, strlen(m)) == 0);
+                    fdb_slice_destroy(sl);
+                    ++got;
+                }
+                if(got == 0){
+                    assert(ret == FDB_OK_RANGE_HAVE_NONE);
+                }else{
+                    assert(rets->length_ == 2*got);
+                    fdb_array_destroy(rets);
+                }
+            }
+        }
+    }
+    fdb_slice_destroy(smin);
+    fdb_slice_destroy(smax);
+}
+
+static void test_zset_lex_rem(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* min, const char* max,
+                              uint8_t type, int64_t count){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t *smin = fdb_slice_create(min, strlen(min));
+    fdb_slice_t *smax = fdb_slice_create(max, strlen(max));
+    int64_t _count = -1;
+    assert(zset_rem_range_by_lex(ctx, slot, key, smin, smax, type, &_count) == FDB_OK);
+    assert(_count == count);
+    fdb_slice_destroy(key);
+    fdb_slice_destroy(smin);
+    fdb_slice_destroy(smax);
+}
+
+//one score for all in subkeys, mixed scores in subkeys, and packed
+void test_zset_lex(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *skeys[] = {"lex_zset", "lex_zset_mixed", "lex_zset_packed"};
+    size_t n = sizeof(lex_members)/sizeof(lex_members[0]);
+    for(int k=0; k<3; ++k){
+        if(k < 2){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(size_t i=0; i<n; ++i){
+            test_zset_add(ctx, slot, skeys[k], lex_members[i], (k == 1) ? (double)((i * 7) % 5) : 0.0, FDB_OK, 1);
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+    const char *bounds[][2] = {{"a", "c"}, {"", "e"}, {"b", "b"}, {"ba", "bz"}, {"c", "a"}, {"aa", "bab"}, {"x", "z"}};
+    for(int k=0; k<3; ++k){
+        for(size_t b=0; b<sizeof(bounds)/sizeof(bounds[0]); ++b){
+            for(uint8_t type=0; type<16; ++type){
+                test_zset_lex_check(ctx, slot, skeys[k], bounds[b][0], bounds[b][1], type);
+            }
+        }
+    }
+    for(int k=0; k<3; ++k){
+        test_zset_lex_rem(ctx, slot, skeys[k], "b", "c", 0x2, 3);
+        test_zset_size(ctx, slot, skeys[k], FDB_OK, 5);
+        test_zset_rank(ctx, slot, skeys[k], "c", FDB_OK, (k == 1) ? 1 : 2);
+        test_zset_lex_rem(ctx, slot, skeys[k], "", "", 0x4|0x8, 5);
+        test_zset_size(ctx, slot, skeys[k], FDB_OK, 0);
+    }
+}
+
+//the whole of zset skey in score order against the n members expected
+static void check_zset_stored(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, struct test_zset_member_t* expect, int n){
+    qsort(expect, n, sizeof(struct test_zset_member_t), test_zset_member_compare);
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_array_t *range = NULL;
+    assert(zset_range(ctx, slot, key, 0, -1, 0, &range) == FDB_OK);
+    assert(range->length_ == 2*(size_t)n);
+    for(int i=0; i<n; ++i){
+        fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(range, 2*i + 1)->val_.vval_);
+        assert(fdb_array_at(range, 2*i)->val_.dval_ == expect[i].score_);
+        assert(fdb_slice_length(sl) == strlen(expect[i].member_));
+        assert(memcmp(fdb_slice_data(sl), expect[i].member_, fdb_slice_length(sl)) == 0);
+        fdb_slice_destroy(sl);
+    }
+    fdb_array_destroy(range);
+    fdb_slice_destroy(key);
+    test_zset_size(ctx, slot, skey, FDB_OK, n);
+}
+
+static int64_t test_zset_combine_store(fdb_context_t* ctx, fdb_slot_t* slot, int op, const char* sdest, const char** skeys,
+                                       size_t n, const double* weights, int aggregate){
+    fdb_slice_t *keys[4];
+    for(size_t i=0; i<n; ++i){
+        keys[i] = fdb_slice_create(skeys[i], strlen(skeys[i]));
+    }
+    fdb_slice_t *dest = fdb_slice_create(sdest, strlen(sdest));
+    int64_t count = -1;
+    assert(zset_combine_store(ctx, slot, op, dest, n, keys, weights, aggregate, &count) == FDB_OK);
+    fdb_slice_destroy(dest);
+    for(size_t i=0; i<n; ++i){
+        fdb_slice_destroy(keys[i]);
+    }
+    return count;
+}
+
+//member i of source s, if in it, and its score there
+static int test_zset_store_source(int s, int i, double* score){
+    switch(s){
+        case 0: *score = i; return i % 2 == 0;
+        case 1: *score = 10.0 + i; return i % 3 == 0;
+        default: *score = -i; return i % 5 == 0;
+    }
+}
+
+//what a store of sources srcs of the three above over members 0..39 should leave
+static int test_zset_store_expect(int op, const int* srcs, size_t n, const double* weights, int aggregate,
+                                  struct test_zset_member_t* expect){
+    int len = 0;
+    for(int i=0; i<40; ++i){
+        size_t at = 0;
+        double score = 0.0, first = 0.0;
+        int in_first = test_zset_store_source(srcs[0], i, &first);
+        for(size_t k=0; k<n; ++k){
+            double one = 0.0;
+            if(!test_zset_store_source(srcs[k], i, &one)){
+                continue;
+            }
+            one *= (weights != NULL) ? weights[k] : 1.0;
+            if(at++ == 0){
+                score = one;
+            }else if(aggregate == FDB_ZSET_AGGREGATE_MIN){
+                score = (one < score) ? one : score;
+            }else if(aggregate == FDB_ZSET_AGGREGATE_MAX){
+                score = (one > score) ? one : score;
+            }else{
+                score += one;
+            }
+        }
+        if((op == ZSET_UNION && at > 0) || (op == ZSET_INTER && at == n) || (op == ZSET_DIFF && in_first && at == 1)){
+            expect[len].score_ = (op == ZSET_DIFF) ? first : score;
+            snprintf(expect[len].member_, sizeof(expect[len].member_), "z%02d", i);
+            ++len;
+        }
+    }
+    return len;
+}
+
+//union, intersection and difference with weights and aggregates, packed and in subkeys sources,
+//a dest packed, spilled, large enough to commit in several batches, and among its sources
+void test_zset_store(fdb_context_t* ctx, fdb_slot_t* slot){
+    char member[16];
+    const char *names[] = {"zst_a", "zst_b", "zst_c", "zst_pa", "zst_pb", "zst_pc"};
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int s=0; s<3; ++s){
+            for(int i=0; i<40; ++i){
+                double score = 0.0;
+                if(test_zset_store_source(s, i, &score)){
+                    snprintf(member, sizeof(member), "z%02d", i);
+                    test_zset_add(ctx, slot, names[3*k + s], member, score, FDB_OK, 1);
+                }
+            }
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+
+    struct test_zset_member_t expect[40];
+    int srcs[] = {0, 1, 2};
+    double weights[] = {1.0, 2.0, -0.5};
+    int ops[] = {ZSET_UNION, ZSET_INTER, ZSET_DIFF};
+    const char *mixed[] = {"zst_a", "zst_pb", "zst_c"};
+    for(int o=0; o<3; ++o){
+        for(int aggregate=0; aggregate<3; ++aggregate){
+            for(int w=0; w<2; ++w){
+                const double *ws = (w == 1 && ops[o] != ZSET_DIFF) ? weights : NULL;
+                int n = test_zset_store_expect(ops[o], srcs, 3, ws, aggregate, expect);
+                assert(test_zset_combine_store(ctx, slot, ops[o], "zst_dest", mixed, 3, ws, aggregate) == n);
+                check_zset_stored(ctx, slot, "zst_dest", expect, n);
+                n = test_zset_store_expect(ops[o], srcs, 3, ws, aggregate, expect);
+                assert(test_zset_combine_store(ctx, slot, ops[o], "zst_pdest", names + 3, 3, ws, aggregate) == n);
+                check_zset_stored(ctx, slot, "zst_pdest", expect, n);
+            }
+        }
+    }
+
+    //spilled to subkeys part way, then over a source it reads
+    fdb_context_set_packed_limits(ctx, 4, 2048);
+    int n = test_zset_store_expect(ZSET_UNION, srcs, 2, NULL, FDB_ZSET_AGGREGATE_SUM, expect);
+    assert(test_zset_combine_store(ctx, slot, ZSET_UNION, "zst_dest", names + 3, 2, NULL, FDB_ZSET_AGGREGATE_SUM) == n);
+    check_zset_stored(ctx, slot, "zst_dest", expect, n);
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    const char *onto_a[] = {"zst_a", "zst_pb"};
+    n = test_zset_store_expect(ZSET_INTER, srcs, 2, weights, FDB_ZSET_AGGREGATE_MAX, expect);
+    assert(test_zset_combine_store(ctx, slot, ZSET_INTER, "zst_a", onto_a, 2, weights, FDB_ZSET_AGGREGATE_MAX) == n);
+    check_zset_stored(ctx, slot, "zst_a", expect, n);
+
+    //an empty result leaves no dest
+    const char *none[] = {"zst_pa", "zst_none"};
+    assert(test_zset_combine_store(ctx, slot, ZSET_INTER, "zst_dest", none, 2, NULL, FDB_ZSET_AGGREGATE_SUM) == 0);
+    fdb_slice_t *dest = fdb_slice_create("zst_dest", strlen("zst_dest"));
+    uint8_t type = 0;
+    assert(keys_get(ctx, slot, dest, &type) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(dest);
+
+    //past a batch of members, the rank tree of dest loaded at the end
+    int big = 6000;
+    for(int i=0; i<big; ++i){
+        snprintf(member, sizeof(member), "zb%05d", i);
+        test_zset_add(ctx, slot, (i < big/2) ? "zst_big1" : "zst_big2", member, (double)(i % 97), FDB_OK, 1);
+    }
+    const char *bigs[] = {"zst_big1", "zst_big2"};
+    assert(test_zset_combine_store(ctx, slot, ZSET_UNION, "zst_big", bigs, 2, weights, FDB_ZSET_AGGREGATE_SUM) == big);
+    struct test_zset_member_t *members = (struct test_zset_member_t*)malloc(big*sizeof(struct test_zset_member_t));
+    for(int i=0; i<big; ++i){
+        members[i].score_ = (double)(i % 97) * ((i < big/2) ? 1.0 : 2.0);
+        snprintf(members[i].member_, sizeof(members[i].member_), "zb%05d", i);
+    }
+    test_zset_size(ctx, slot, "zst_big", FDB_OK, big);
+    check_zset_rank_index(ctx, slot, "zst_big", members, big);
+
+    //failing once the first batch of members is committed, dest is left as it was and the
+    //members under the fresh seq go in the background
+    fdb_slice_t *keys[2] = {fdb_slice_create(bigs[0], strlen(bigs[0])), fdb_slice_create(bigs[1], strlen(bigs[1]))};
+    dest = fdb_slice_create("zst_big", strlen("zst_big"));
+    int64_t count = -1;
+    test_zset_writes_to_fail = 2;
+    assert(zset_combine_store(ctx, slot, ZSET_UNION, dest, 2, keys, NULL, FDB_ZSET_AGGREGATE_SUM, &count) == FDB_ERR);
+    assert(test_zset_writes_to_fail == 0);
+    test_zset_size(ctx, slot, "zst_big", FDB_OK, big);
+    check_zset_rank_index(ctx, slot, "zst_big", members, big);
+    int64_t reclaimed = 0;
+    for(int ret = 1; ret > 0; reclaimed += ret){
+        ret = dels_self_reclaim(ctx, slot, 1024);
+    }
+    assert(reclaimed >= 2*4096);
+    check_zset_rank_index(ctx, slot, "zst_big", members, big);
+    assert(zset_combine_store(ctx, slot, ZSET_UNION, dest, 2, keys, NULL, FDB_ZSET_AGGREGATE_SUM, &count) == FDB_OK);
+    assert(count == big);
+    for(int i=0; i<big; ++i){
+        members[i].score_ = (double)(i % 97);
+        snprintf(members[i].member_, sizeof(members[i].member_), "zb%05d", i);
+    }
+    check_zset_rank_index(ctx, slot, "zst_big", members, big);
+    fdb_slice_destroy(dest);
+    fdb_slice_destroy(keys[0]);
+    fdb_slice_destroy(keys[1]);
+    free(members);
+}
+
+static void test_zset_pop_check(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, int max, uint64_t count,
+                                struct test_zset_member_t* expect, int n){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_array_t *rets = NULL;
+    assert(zset_pop(ctx, slot, key, max, count, &rets) == FDB_OK);
+    fdb_slice_destroy(key);
+    assert(rets->length_ == 2*(size_t)n);
+    for(int i=0; i<n; ++i){
+        fdb_slice_t *sl = (fdb_slice_t*)(fdb_array_at(rets, 2*i + 1)->val_.vval_);
+        assert(fdb_array_at(rets, 2*i)->val_.dval_ == expect[i].score_);
+        assert(fdb_slice_length(sl) == strlen(expect[i].member_));
+        assert(memcmp(fdb_slice_data(sl), expect[i].member_, fdb_slice_length(sl)) == 0);
+        fdb_slice_destroy(sl);
+    }
+    fdb_array_destroy(rets);
+}
+
+struct test_zset_waker_t {
+    fdb_context_t*  ctx_;
+    fdb_slot_t*     slot_;
+    const char*     key_;
+};
+
+static void* test_zset_waker(void* arg){
+    struct test_zset_waker_t *waker = (struct test_zset_waker_t*)arg;
+    usleep(50*1000);
+    test_zset_add(waker->ctx_, waker->slot_, waker->key_, "woken", 3.5, FDB_OK, 1);
+    return NULL;
+}
+
+void test_zset_pop(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *names[] = {"zpop_sub", "zpop_packed"};
+    struct test_zset_member_t members[10];
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int i=0; i<10; ++i){
+            members[i].score_ = (i - 4) * 1.5;
+            snprintf(members[i].member_, sizeof(members[i].member_), "zp%02d", i);
+            test_zset_add(ctx, slot, names[k], members[i].member_, members[i].score_, FDB_OK, 1);
+        }
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+
+        test_zset_pop_check(ctx, slot, names[k], 0, 3, members, 3);
+        struct test_zset_member_t tops[] = {members[9], members[8]};
+        test_zset_pop_check(ctx, slot, names[k], 1, 2, tops, 2);
+        test_zset_pop_check(ctx, slot, names[k], 0, 0, NULL, 0);
+        test_zset_size(ctx, slot, names[k], FDB_OK, 5);
+        test_zset_rank(ctx, slot, names[k], "zp03", FDB_OK, 0);
+        test_zset_rank(ctx, slot, names[k], "zp07", FDB_OK, 4);
+        test_zset_pop_check(ctx, slot, names[k], 0, 100, members + 3, 5);
+
+        test_zset_size(ctx, slot, names[k], FDB_OK, 0);
+        test_zset_pop_check(ctx, slot, names[k], 1, 1, NULL, 0);
+    }
+    fdb_slice_t *missing = fdb_slice_create("zpop_none", strlen("zpop_none"));
+    fdb_array_t *none = NULL;
+    assert(zset_pop(ctx, slot, missing, 1, 1, &none) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(missing);
+
+    //the rank tree stays right as its ends go
+    int n = 500;
+    struct test_zset_member_t *many = (struct test_zset_member_t*)malloc(n*sizeof(struct test_zset_member_t));
+    for(int i=0; i<n; ++i){
+        many[i].score_ = (double)(i % 37);
+        snprintf(many[i].member_, sizeof(many[i].member_), "zm%04d", i);
+        test_zset_add(ctx, slot, "zpop_many", many[i].member_, many[i].score_, FDB_OK, 1);
+    }
+    qsort(many, n, sizeof(struct test_zset_member_t), test_zset_member_compare);
+    test_zset_pop_check(ctx, slot, "zpop_many", 0, 60, many, 60);
+    struct test_zset_member_t tops[40];
+    for(int i=0; i<40; ++i){
+        tops[i] = many[n - 1 - i];
+    }
+    test_zset_pop_check(ctx, slot, "zpop_many", 1, 40, tops, 40);
+    test_zset_size(ctx, slot, "zpop_many", FDB_OK, n - 100);
+    check_zset_rank_index(ctx, slot, "zpop_many", many + 60, n - 100);
+    free(many);
+
+    //parked on a missing key, a timeout and then a zadd from another thread
+    fdb_waiter_t *waiter = (fdb_waiter_t*)ctx->waiter_;
+    for(int woken=0; woken<2; ++woken){
+        fdb_slice_t *key = fdb_slice_create("zpop_block", strlen("zpop_block"));
+        fdb_array_t *rets = NULL;
+        fdb_wait_t *wait = NULL;
+        assert(zset_pop_park(ctx, slot, key, 0, &rets, &wait) == FDB_OK_NOT_EXIST);
+        fdb_slice_destroy(key);
+        assert(rets == NULL && wait != NULL && fdb_waiter_parked(waiter));
+        if(!woken){
+            assert(fdb_waiter_wait(waiter, wait, 20) == 0);
+            assert(!fdb_waiter_parked(waiter));
+            continue;
+        }
+        pthread_t tid;
+        struct test_zset_waker_t waker = {ctx, slot, "zpop_block"};
+        assert(pthread_create(&tid, NULL, test_zset_waker, &waker) == 0);
+        assert(fdb_waiter_wait(waiter, wait, 0) == 1);
+        pthread_join(tid, NULL);
+        assert(!fdb_waiter_parked(waiter));
+
+        key = fdb_slice_create("zpop_block", strlen("zpop_block"));
+        assert(zset_pop_park(ctx, slot, key, 1, &rets, &wait) == FDB_OK);
+        fdb_slice_destroy(key);
+        assert(wait == NULL && rets->length_ == 2 && fdb_array_at(rets, 0)->val_.dval_ == 3.5);
+        fdb_slice_destroy((fdb_slice_t*)(fdb_array_at(rets, 1)->val_.vval_));
+        fdb_array_destroy(rets);
+    }
+}
+
+struct test_zset_parked_t {
+    fdb_waiter_t*   waiter_;
+    fdb_wait_t*     wait_;
+    int             ret_;
+};
+
+void* test_zset_parked(void* ptr){
+    struct test_zset_parked_t *parked = (struct test_zset_parked_t*)ptr;
+    parked->ret_ = fdb_waiter_wait(parked->waiter_, parked->wait_, 0);
+    return NULL;
+}
+
+//a caller parked for good when the context goes is sent back with an error first
+void test_zset_pop_destroy(fdb_context_t* ctx, fdb_slot_t* slot){
+    fdb_slice_t *key = fdb_slice_create("zpop_closed", strlen("zpop_closed"));
+    fdb_array_t *rets = NULL;
+    fdb_wait_t *wait = NULL;
+    assert(zset_pop_park(ctx, slot, key, 0, &rets, &wait) == FDB_OK_NOT_EXIST);
+    fdb_slice_destroy(key);
+    struct test_zset_parked_t parked = {(fdb_waiter_t*)ctx->waiter_, wait, 0};
+    pthread_t tid;
+    assert(pthread_create(&tid, NULL, test_zset_parked, &parked) == 0);
+    usleep(20*1000);
+    fdb_context_destroy(ctx);
+    pthread_join(tid, NULL);
+    assert(parked.ret_ == -1);
+}
+
+static void test_zset_add_capped(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, struct test_zset_member_t* members,
+                                 int n, uint64_t cap, int trim_max, int64_t count, int64_t trimmed){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_array_t *sms = fdb_array_create(8);
+    for(int i=0; i<n; ++i){
+        fdb_val_node_t *snode = fdb_val_node_create();
+        snode->val_.dval_ = members[i].score_;
+        fdb_array_push_back(sms, snode);
+        fdb_val_node_t *mnode = fdb_val_node_create();
+        mnode->val_.vval_ = fdb_slice_create(members[i].member_, strlen(members[i].member_));
+        fdb_array_push_back(sms, mnode);
+    }
+    int64_t _count = -1, _trimmed = -1;
+    assert(zset_add_capped(ctx, slot, key, sms, cap, trim_max, &_count, &_trimmed) == FDB_OK);
+    assert(_count == count && _trimmed == trimmed);
+    for(size_t i=0; i<sms->length_; ++i){
+        fdb_val_node_t *node = fdb_array_at(sms, i);
+        if(i % 2 == 1){
+            fdb_slice_destroy(node->val_.vval_);
+        }
+        fdb_val_node_destroy(node);
+    }
+    fdb_array_destroy(sms);
+    fdb_slice_destroy(key);
+}
+
+static int64_t test_zset_window(fdb_context_t* ctx, fdb_slot_t* slot, const char* skey, const char* smember, double now,
+                                double window, int64_t ttl){
+    fdb_slice_t *key = fdb_slice_create(skey, strlen(skey));
+    fdb_slice_t *mber = fdb_slice_create(smember, strlen(smember));
+    int64_t count = -1;
+    assert(zset_window_add(ctx, slot, key, mber, now, window, ttl, &count) == FDB_OK);
+    fdb_slice_destroy(mber);
+    fdb_slice_destroy(key);
+    return count;
+}
+
+void test_zset_capped(fdb_context_t* ctx, fdb_slot_t* slot){
+    const char *names[] = {"zcap_sub", "zcap_packed"};
+    const char *windows[] = {"zwin_sub", "zwin_packed"};
+    struct test_zset_member_t members[10], expect[10];
+    for(int k=0; k<2; ++k){
+        if(k == 0){
+            fdb_context_set_packed_limits(ctx, 0, 0);
+        }
+        for(int i=0; i<10; ++i){
+            members[i].score_ = (double)((i*7) % 10);
+            snprintf(members[i].member_, sizeof(members[i].member_), "zc%02d", i);
+        }
+        //the five highest kept
+        test_zset_add_capped(ctx, slot, names[k], members, 10, 5, 0, 10, 5);
+        int n = 0;
+        for(int i=0; i<10; ++i){
+            if(members[i].score_ >= 5.0){
+                expect[n++] = members[i];
+            }
+        }
+        check_zset_stored(ctx, slot, names[k], expect, n);
+
+        //one scored below them all is trimmed right away, one above takes the place of the lowest
+        struct test_zset_member_t low = {-1.0, "zclow"}, high = {100.0, "zchigh"};
+        test_zset_add_capped(ctx, slot, names[k], &low, 1, 5, 0, 1, 1);
+        check_zset_stored(ctx, slot, names[k], expect, n);
+        test_zset_add_capped(ctx, slot, names[k], &high, 1, 5, 0, 1, 1);
+        expect[0] = high;
+        check_zset_stored(ctx, slot, names[k], expect, n);
+
+        //down to the three lowest
+        test_zset_add_capped(ctx, slot, names[k], &low, 1, 3, 1, 1, 3);
+        expect[2] = expect[1];
+        expect[1] = expect[0];
+        expect[0] = low;
+        check_zset_stored(ctx, slot, names[k], expect, 3);
+
+        //a window of 100, the members at or before now - 100 go
+        assert(test_zset_window(ctx, slot, windows[k], "w1", 1000.0, 100.0, 0) == 1);
+        assert(test_zset_window(ctx, slot, windows[k], "w2", 1050.0, 100.0, 0) == 2);
+        assert(test_zset_window(ctx, slot, windows[k], "w3", 1100.0, 100.0, 0) == 2);
+        assert(test_zset_window(ctx, slot, windows[k], "w2", 1200.0, 100.0, 0) == 1);
+        struct test_zset_member_t left = {1200.0, "w2"};
+        check_zset_stored(ctx, slot, windows[k], &left, 1);
+
+        fdb_slice_t *key = fdb_slice_create(windows[k], strlen(windows[k]));
+        int64_t ttl = -1;
+        assert(keys_pexpire_left(ctx, slot, key, &ttl) == FDB_OK && ttl == -2);
+        assert(test_zset_window(ctx, slot, windows[k], "w4", 1250.0, 100.0, 60*1000) == 2);
+        assert(keys_pexpire_left(ctx, slot, key, &ttl) == FDB_OK);
+        assert(ttl > 0 && ttl <= 60*1000);
+        fdb_slice_destroy(key);
+        fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    }
+
+    //capped and windowed past the packed limits, the rank tree checked after
+    int big = 400;
+    struct test_zset_member_t *many = (struct test_zset_member_t*)malloc(big*sizeof(struct test_zset_member_t));
+    for(int i=0; i<big; ++i){
+        many[i].score_ = (double)((i*131) % big);
+        snprintf(many[i].member_, sizeof(many[i].member_), "zb%04d", i);
+    }
+    for(int i=0; i<big; i+=50){
+        test_zset_add_capped(ctx, slot, "zcap_big", many + i, 50, 250, 1, 50, (i + 50 > 250) ? 50 : 0);
+    }
+    qsort(many, big, sizeof(struct test_zset_member_t), test_zset_member_compare);
+    check_zset_rank_index(ctx, slot, "zcap_big", many, 250);
+
+    char member[16];
+    for(int i=0; i<big; ++i){
+        snprintf(member, sizeof(member), "zw%04d", i);
+        assert(test_zset_window(ctx, slot, "zwin_big", member, (double)i, 300.0, 0) == ((i < 300) ? i + 1 : 300));
+        if(i < 300){
+            snprintf(many[i].member_, sizeof(many[i].member_), "zw%04d", i + 100);
+            many[i].score_ = (double)(i + 100);
+        }
+    }
+    check_zset_rank_index(ctx, slot, "zwin_big", many, 300);
+    free(many);
+}
+
+//ranges past the rewrite threshold, the members kept written anew and the old ones reclaimed
+void test_zset_rem_range_big(fdb_context_t* ctx, fdb_slot_t* slot){
+    int n = 3000;
+    struct test_zset_member_t *members = (struct test_zset_member_t*)malloc(n*sizeof(struct test_zset_member_t));
+    for(int i=0; i<n; ++i){
+        members[i].score_ = (double)((i*7) % n);
+        snprintf(members[i].member_, sizeof(members[i].member_), "zr%04d", i);
+        test_zset_add(ctx, slot, "zrem_big", members[i].member_, members[i].score_, FDB_OK, 1);
+    }
+    qsort(members, n, sizeof(struct test_zset_member_t), test_zset_member_compare);
+    fdb_slice_t *key = fdb_slice_create("zrem_big", strlen("zrem_big"));
+    int64_t count = 0, left = 0;
+    assert(keys_pexpire_at(ctx, slot, key, (int64_t)time_ms() + 60*1000, &count) == FDB_OK && count == 1);
+
+    //by rank, 200 in subkeys kept around 2800 removed
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    assert(zset_rem_range_by_rank(ctx, slot, key, 100, -101, &count) == FDB_OK && count == n - 200);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("zrem_big", strlen("zrem_big"));
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    memmove(members + 100, members + n - 100, 100*sizeof(struct test_zset_member_t));
+    test_zset_size(ctx, slot, "zrem_big", FDB_OK, 200);
+    check_zset_rank_index(ctx, slot, "zrem_big", members, 200);
+    assert(keys_pexpire_left(ctx, slot, key, &left) == FDB_OK && left > 0);
+
+    //the old seq goes in the background, the new one is left alone
+    int64_t reclaimed = 0;
+    for(int ret = 1; ret > 0; reclaimed += ret){
+        ret = dels_self_reclaim(ctx, slot, 1024);
+    }
+    assert(reclaimed >= 2*(n - 200));
+    check_zset_rank_index(ctx, slot, "zrem_big", members, 200);
+
+    //by score, open at the bottom, what is kept packed again
+    for(int i=0; i<n; ++i){
+        members[i].score_ = (double)i;
+        snprintf(members[i].member_, sizeof(members[i].member_), "zt%04d", i);
+        test_zset_add(ctx, slot, "zrem_score", members[i].member_, members[i].score_, FDB_OK, 1);
+        test_zset_add(ctx, slot, "zrem_all", members[i].member_, members[i].score_, FDB_OK, 1);
+    }
+    test_zset_rem_range_by_score(ctx, slot, "zrem_score", FDB_OK, 10.0, (double)(n - 10), 0x1, n - 20);
+    memmove(members + 11, members + n - 9, 9*sizeof(struct test_zset_member_t));
+    check_zset_stored(ctx, slot, "zrem_score", members, 20);
+
+    //all of a big one at once
+    test_zset_rem_range_by_score(ctx, slot, "zrem_all", FDB_OK, -1.0, (double)n, 0, n);
+    test_zset_size(ctx, slot, "zrem_all", FDB_OK, 0);
+    test_zset_add(ctx, slot, "zrem_all", "zt_again", 1.0, FDB_OK, 1);
+    test_zset_size(ctx, slot, "zrem_all", FDB_OK, 1);
+    assert(keys_pexpire_left(ctx, slot, key, &left) == FDB_OK && left > 0);
+    fdb_slice_destroy(key);
+    free(members);
+}
+
+//a rewrite failing once some of the members kept are committed leaves the zset as it was
+void test_zset_rewrite_fail(fdb_context_t* ctx, fdb_slot_t* slot){
+    int n = 10000;
+    struct test_zset_member_t *members = (struct test_zset_member_t*)malloc(n*sizeof(struct test_zset_member_t));
+    for(int i=0; i<n; ++i){
+        members[i].score_ = (double)i;
+        snprintf(members[i].member_, sizeof(members[i].member_), "zf%05d", i);
+        test_zset_add(ctx, slot, "zrem_fail", members[i].member_, members[i].score_, FDB_OK, 1);
+    }
+    fdb_slice_t *key = fdb_slice_create("zrem_fail", strlen("zrem_fail"));
+    int64_t count = 0, left = 0;
+    assert(keys_pexpire_at(ctx, slot, key, (int64_t)time_ms() + 60*1000, &count) == FDB_OK && count == 1);
+
+    //5000 kept, the first 4096 committed, the rest fail before the key moves
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    test_zset_writes_to_fail = 2;
+    assert(zset_rem_range_by_rank(ctx, slot, key, 2500, -2501, &count) == FDB_ERR);
+    assert(test_zset_writes_to_fail == 0);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("zrem_fail", strlen("zrem_fail"));
+    test_zset_size(ctx, slot, "zrem_fail", FDB_OK, n);
+    check_zset_rank_index(ctx, slot, "zrem_fail", members, n);
+
+    //the members under the fresh seq go in the background, the live ones stay
+    int64_t reclaimed = 0;
+    for(int ret = 1; ret > 0; reclaimed += ret){
+        ret = dels_self_reclaim(ctx, slot, 1024);
+    }
+    assert(reclaimed >= 2*4096);
+    test_zset_size(ctx, slot, "zrem_fail", FDB_OK, n);
+    check_zset_rank_index(ctx, slot, "zrem_fail", members, n);
+
+    //once again, with nothing failing
+    assert(zset_rem_range_by_rank(ctx, slot, key, 2500, -2501, &count) == FDB_OK && count == n - 5000);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("zrem_fail", strlen("zrem_fail"));
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    memmove(members + 2500, members + n - 2500, 2500*sizeof(struct test_zset_member_t));
+    test_zset_size(ctx, slot, "zrem_fail", FDB_OK, 5000);
+    check_zset_rank_index(ctx, slot, "zrem_fail", members, 5000);
+    assert(keys_pexpire_left(ctx, slot, key, &left) == FDB_OK && left > 0);
+
+    //a small range by score goes in one write, and a failed one leaves the zset as it was
+    fdb_context_set_packed_limits(ctx, 0, 0);
+    test_zset_writes_to_fail = 1;
+    assert(zset_rem_range_by_score(ctx, slot, key, 0.0, 9.0, 0, &count) == FDB_ERR);
+    assert(test_zset_writes_to_fail == 0);
+    fdb_slice_destroy(key);
+    key = fdb_slice_create("zrem_fail", strlen("zrem_fail"));
+    test_zset_size(ctx, slot, "zrem_fail", FDB_OK, 5000);
+    check_zset_rank_index(ctx, slot, "zrem_fail", members, 5000);
+    int writes = test_zset_writes;
+    assert(zset_rem_range_by_score(ctx, slot, key, 0.0, 9.0, 0, &count) == FDB_OK && count == 10);
+    assert(test_zset_writes == writes + 1);
+    fdb_context_set_packed_limits(ctx, FDB_PACKED_ENTRIES, FDB_PACKED_BYTES);
+    test_zset_size(ctx, slot, "zrem_fail", FDB_OK, 4990);
+    check_zset_rank_index(ctx, slot, "zrem_fail", members + 10, 4990);
+    fdb_slice_destroy(key);
+    free(members);
+}
 
 int main(int argc, char* argv[]){
     fdb_context_t* ctx = fdb_context_create("/tmp/falcondb_test_zset", 128, 128, 2);
@@ -285,7 +1454,27 @@ int main(int argc, char* argv[]){
 
     test_zset_size(ctx, slots[1], "key1", FDB_OK, 0);
 
+    test_zset_rank_index(ctx, slots[1]);
 
-    fdb_context_destroy(ctx);
+    test_zset_packed(ctx, slots[1]);
+
+    test_zset_many(ctx, slots[1]);
+
+    test_zset_zscan(ctx, slots[1]);
+
+    test_zset_range_by_score(ctx, slots[1]);
+
+    test_zset_lex(ctx, slots[1]);
+
+    test_zset_store(ctx, slots[1]);
+
+    test_zset_pop(ctx, slots[1]);
+
+    test_zset_capped(ctx, slots[1]);
+
+    test_zset_rem_range_big(ctx, slots[1]);
+    test_zset_rewrite_fail(ctx, slots[1]);
+
+    test_zset_pop_destroy(ctx, slots[1]);
     return 0;
 }